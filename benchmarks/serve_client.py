@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Load generator for `compiler --serve=PATH`.
+Sends small requests over several persistent connections and reports
+throughput, latency and how many requests the server shed.
+
+    ../build/compiler --serve=/tmp/compiler.sock &
+    python3 serve_client.py /tmp/compiler.sock --requests 20000 --clients 8
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+SOURCE = "let s = 0;\nfor (let i = 0; i < 10; i = i + 1) { s = s + i; }\nprint(s);\n"
+
+
+def request(sock, payload):
+    """Send one framed request and return the response payload."""
+    data = payload.encode()
+    sock.sendall(struct.pack(">I", len(data)) + data)
+    size = struct.unpack(">I", receive(sock, 4))[0]
+    return receive(sock, size).decode()
+
+
+def receive(sock, size):
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        data += chunk
+    return data
+
+
+def client(path, count, latencies, statuses):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    for _ in range(count):
+        start = time.perf_counter()
+        response = request(sock, "\n" + SOURCE)
+        latencies.append((time.perf_counter() - start) * 1e6)
+        status = response.split("\n", 1)[0]
+        statuses[status] = statuses.get(status, 0) + 1
+    sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("socket")
+    parser.add_argument("--requests", type=int, default=10000)
+    parser.add_argument("--clients", type=int, default=4)
+    args = parser.parse_args()
+
+    latencies = []
+    statuses = {}
+    per_client = args.requests // args.clients
+    threads = [
+        threading.Thread(target=client,
+                         args=(args.socket, per_client, latencies, statuses))
+        for _ in range(args.clients)
+    ]
+    start = time.perf_counter()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - start
+
+    latencies.sort()
+    total = len(latencies)
+    print(f"{total} requests in {elapsed:.2f}s: {total / elapsed:.0f} req/s")
+    print(f"latency p50 {latencies[total // 2]:.0f}us, "
+          f"p99 {latencies[int(total * 0.99)]:.0f}us")
+    print("statuses: " + ", ".join(f"{k} {v}" for k, v in sorted(statuses.items())))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,10 @@
 #ifndef COMPILER_AST_H
 #define COMPILER_AST_H
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -22,6 +25,16 @@ public:
 class Stmt : public ASTNode {
 public:
   ~Stmt() override = default;
+
+  /**
+   * Source line of a branch or loop, used to match profile data; 0 for
+   * other statements and for code the optimizer created
+   */
+  int line() const { return line_; }
+  void setLine(int line) { line_ = line; }
+
+private:
+  int line_ = 0;
 };
 
 // Expression Nodes (6 types)
@@ -78,6 +91,9 @@ public:
   const Expr &right() const { return *right_; }
   Operator op() const { return op_; }
 
+  std::unique_ptr<Expr> &mutableLeft() { return left_; }
+  std::unique_ptr<Expr> &mutableRight() { return right_; }
+
 private:
   std::unique_ptr<Expr> left_;
   Operator op_;
@@ -99,6 +115,8 @@ public:
   const Expr &operand() const { return *operand_; }
   Operator op() const { return op_; }
 
+  std::unique_ptr<Expr> &mutableOperand() { return operand_; }
+
 private:
   Operator op_;
   std::unique_ptr<Expr> operand_;
@@ -111,6 +129,7 @@ public:
 
   const std::string &name() const { return name_; }
   const std::vector<std::unique_ptr<Expr>> &args() const { return args_; }
+  std::vector<std::unique_ptr<Expr>> &mutableArgs() { return args_; }
 
   void accept(ASTVisitor &visitor) const override;
 
@@ -130,6 +149,7 @@ public:
   const std::vector<std::unique_ptr<Expr>> &elements() const {
     return elements_;
   }
+  std::vector<std::unique_ptr<Expr>> &mutableElements() { return elements_; }
 
   void accept(ASTVisitor &visitor) const override;
 
@@ -151,6 +171,9 @@ public:
   std::unique_ptr<Expr> takeTarget() { return std::move(target_); }
   std::unique_ptr<Expr> takeIndex() { return std::move(index_); }
 
+  std::unique_ptr<Expr> &mutableTarget() { return target_; }
+  std::unique_ptr<Expr> &mutableIndex() { return index_; }
+
   void accept(ASTVisitor &visitor) const override;
 
 private:
@@ -182,6 +205,7 @@ public:
 
   const std::string &name() const { return name_; }
   const Expr &value() const { return *value_; }
+  std::unique_ptr<Expr> &mutableValue() { return value_; }
 
   void accept(ASTVisitor &visitor) const override;
 
@@ -191,18 +215,29 @@ private:
 };
 
 /**
- * Statement node for array element assignment
+ * Statement node for array element assignment. With a compound operator it
+ * is `target[index] op= value`: target and index are evaluated once, then
+ * value, then the element is updated in place.
  */
 class ArrayAssignmentStmt : public Stmt {
 public:
-  ArrayAssignmentStmt(std::unique_ptr<Expr> target, std::unique_ptr<Expr> index,
-                      std::unique_ptr<Expr> value)
+  ArrayAssignmentStmt(
+      std::unique_ptr<Expr> target, std::unique_ptr<Expr> index,
+      std::unique_ptr<Expr> value,
+      std::optional<BinaryOpExpr::Operator> compoundOp = std::nullopt)
       : target_(std::move(target)), index_(std::move(index)),
-        value_(std::move(value)) {}
+        value_(std::move(value)), compoundOp_(compoundOp) {}
 
   const Expr &target() const { return *target_; }
   const Expr &index() const { return *index_; }
   const Expr &value() const { return *value_; }
+  std::optional<BinaryOpExpr::Operator> compoundOp() const {
+    return compoundOp_;
+  }
+
+  std::unique_ptr<Expr> &mutableTarget() { return target_; }
+  std::unique_ptr<Expr> &mutableIndex() { return index_; }
+  std::unique_ptr<Expr> &mutableValue() { return value_; }
 
   void accept(ASTVisitor &visitor) const override;
 
@@ -210,6 +245,7 @@ private:
   std::unique_ptr<Expr> target_;
   std::unique_ptr<Expr> index_;
   std::unique_ptr<Expr> value_;
+  std::optional<BinaryOpExpr::Operator> compoundOp_;
 };
 
 class ExpressionStmt : public Stmt {
@@ -220,6 +256,7 @@ public:
   void accept(ASTVisitor &visitor) const override;
 
   const Expr &expr() const { return *expr_; }
+  std::unique_ptr<Expr> &mutableExpr() { return expr_; }
 
 private:
   std::unique_ptr<Expr> expr_;
@@ -232,6 +269,7 @@ public:
   void accept(ASTVisitor &visitor) const override;
 
   const Expr &value() const { return *value_; }
+  std::unique_ptr<Expr> &mutableValue() { return value_; }
 
 private:
   std::unique_ptr<Expr> value_;
@@ -247,6 +285,8 @@ public:
 
   const Expr &condition() const { return *condition_; }
   const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+  std::unique_ptr<Expr> &mutableCondition() { return condition_; }
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() { return body_; }
 
 private:
   std::unique_ptr<Expr> condition_;
@@ -263,6 +303,8 @@ public:
 
   const Expr &condition() const { return *condition_; }
   const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+  std::unique_ptr<Expr> &mutableCondition() { return condition_; }
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() { return body_; }
 
 private:
   std::unique_ptr<Expr> condition_;
@@ -283,6 +325,13 @@ public:
   const Expr *condition() const { return condition_.get(); }
   const Stmt *increment() const { return increment_.get(); }
   const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() { return body_; }
+
+  std::unique_ptr<Stmt> &mutableInit() { return init_; }
+  std::unique_ptr<Expr> &mutableCondition() { return condition_; }
+  std::unique_ptr<Stmt> &mutableIncrement() { return increment_; }
+
+  std::unique_ptr<Stmt> takeInit() { return std::move(init_); }
 
 private:
   std::unique_ptr<Stmt> init_;
@@ -291,6 +340,113 @@ private:
   std::vector<std::unique_ptr<Stmt>> body_;
 };
 
+/**
+ * Represents for (variable in iterable) { stmt* }
+ * The body runs once per element of the array `iterable` evaluates to, with
+ * the element assigned to `variable` first. The array is evaluated once.
+ */
+class ForInStmt : public Stmt {
+public:
+  ForInStmt(std::string variable, std::unique_ptr<Expr> iterable,
+            std::vector<std::unique_ptr<Stmt>> body)
+      : variable_(std::move(variable)), iterable_(std::move(iterable)),
+        body_(std::move(body)) {}
+
+  void accept(ASTVisitor &visitor) const override;
+
+  const std::string &variable() const { return variable_; }
+  const Expr &iterable() const { return *iterable_; }
+  const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+  std::unique_ptr<Expr> &mutableIterable() { return iterable_; }
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() { return body_; }
+
+private:
+  std::string variable_;
+  std::unique_ptr<Expr> iterable_;
+  std::vector<std::unique_ptr<Stmt>> body_;
+};
+
+/**
+ * A variable a parallel for combines across its iterations
+ */
+struct Reduction {
+  enum class Operator { SUM, MIN, MAX };
+  Operator op;
+  std::string variable;
+};
+
+/**
+ * Represents
+ *   parallel for (i = start; i < end; i++) reduce(+: s, min: m) { stmt* }
+ * Iterations may run concurrently, each with its own copy of the variables
+ * in scope; arrays are shared. The body may assign outer variables only if
+ * they are reduced, and may not break or return. `end` is evaluated once.
+ * Reduced variables may only be updated as `s = s + e` / `s = s - e` (+)
+ * or `if (e < m) { m = e; }` (min; `>` for max).
+ */
+class ParallelForStmt : public Stmt {
+public:
+  ParallelForStmt(std::string variable, std::unique_ptr<Expr> start,
+                  std::unique_ptr<Expr> end, std::vector<Reduction> reductions,
+                  std::vector<std::unique_ptr<Stmt>> body)
+      : variable_(std::move(variable)), start_(std::move(start)),
+        end_(std::move(end)), reductions_(std::move(reductions)),
+        body_(std::move(body)) {}
+
+  void accept(ASTVisitor &visitor) const override;
+
+  const std::string &variable() const { return variable_; }
+  const Expr &start() const { return *start_; }
+  const Expr &end() const { return *end_; }
+  const std::vector<Reduction> &reductions() const { return reductions_; }
+  const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+  std::unique_ptr<Expr> &mutableStart() { return start_; }
+  std::unique_ptr<Expr> &mutableEnd() { return end_; }
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() { return body_; }
+
+private:
+  std::string variable_;
+  std::unique_ptr<Expr> start_;
+  std::unique_ptr<Expr> end_;
+  std::vector<Reduction> reductions_;
+  std::vector<std::unique_ptr<Stmt>> body_;
+};
+
+/**
+ * One arm of a switch: its labels (NumberExpr or StringLiteralExpr; none
+ * for the default arm) and its statements
+ */
+struct SwitchCase {
+  std::vector<std::unique_ptr<Expr>> labels;
+  std::vector<std::unique_ptr<Stmt>> body;
+};
+
+/**
+ * Represents switch (value) { case 1, 2: stmt* case "a": stmt* default: stmt* }
+ * Arms do not fall through; break and continue belong to the enclosing loop.
+ */
+class SwitchStmt : public Stmt {
+public:
+  SwitchStmt(std::unique_ptr<Expr> value, std::vector<SwitchCase> cases)
+      : value_(std::move(value)), cases_(std::move(cases)) {}
+
+  void accept(ASTVisitor &visitor) const override;
+
+  const Expr &value() const { return *value_; }
+  const std::vector<SwitchCase> &cases() const { return cases_; }
+  std::unique_ptr<Expr> &mutableValue() { return value_; }
+  std::vector<SwitchCase> &mutableCases() { return cases_; }
+
+  bool hasDefault() const {
+    return std::any_of(cases_.begin(), cases_.end(),
+                       [](const SwitchCase &arm) { return arm.labels.empty(); });
+  }
+
+private:
+  std::unique_ptr<Expr> value_;
+  std::vector<SwitchCase> cases_;
+};
+
 class BreakStmt : public Stmt {
 public:
   BreakStmt() = default;
@@ -314,6 +470,7 @@ public:
   void accept(ASTVisitor &visitor) const override;
 
   const Expr *value() const { return value_.get(); }
+  std::unique_ptr<Expr> &mutableValue() { return value_; }
 
 private:
   std::unique_ptr<Expr> value_;
@@ -333,6 +490,9 @@ public:
   const std::vector<std::unique_ptr<Stmt>> &statements() const {
     return statements_;
   }
+  std::vector<std::unique_ptr<Stmt>> &mutableStatements() {
+    return statements_;
+  }
 
 private:
   std::vector<std::unique_ptr<Stmt>> statements_;
@@ -348,21 +508,48 @@ private:
  */
 class FunctionDecl : public ASTNode {
 public:
+  // Produces the body of a pre-parsed function on first use
+  using BodyParser = std::function<std::vector<std::unique_ptr<Stmt>>()>;
+
   FunctionDecl(std::string name, std::vector<std::string> params,
                std::vector<std::unique_ptr<Stmt>> body)
       : name_(std::move(name)), params_(std::move(params)),
         body_(std::move(body)) {}
 
+  FunctionDecl(std::string name, std::vector<std::string> params,
+               BodyParser bodyParser)
+      : name_(std::move(name)), params_(std::move(params)),
+        bodyParser_(std::move(bodyParser)) {}
+
   void accept(ASTVisitor &visitor) const override;
 
   const std::string &name() const { return name_; }
   const std::vector<std::string> &params() const { return params_; }
-  const std::vector<std::unique_ptr<Stmt>> &body() const { return body_; }
+
+  /**
+   * Get the body, parsing it first if it was deferred
+   * @throws ParserError if the deferred body is malformed
+   */
+  const std::vector<std::unique_ptr<Stmt>> &body() const;
+
+  /**
+   * Get the body for in-place rewriting (parses a deferred body first)
+   */
+  std::vector<std::unique_ptr<Stmt>> &mutableBody() {
+    body();
+    return body_;
+  }
+
+  /**
+   * False until a deferred body has been parsed
+   */
+  bool isBodyParsed() const { return !bodyParser_; }
 
 private:
   std::string name_;
   std::vector<std::string> params_;
-  std::vector<std::unique_ptr<Stmt>> body_;
+  mutable std::vector<std::unique_ptr<Stmt>> body_;
+  mutable BodyParser bodyParser_;
 };
 
 /**
@@ -377,6 +564,7 @@ public:
   void accept(ASTVisitor &visitor) const override;
 
   const std::vector<std::unique_ptr<ASTNode>> &items() const { return items_; }
+  std::vector<std::unique_ptr<ASTNode>> &mutableItems() { return items_; }
 
 private:
   std::vector<std::unique_ptr<ASTNode>> items_;
@@ -418,6 +606,9 @@ public:
   virtual void visitIfStmt(const IfStmt &) = 0;
   virtual void visitWhileStmt(const WhileStmt &) = 0;
   virtual void visitForStmt(const ForStmt &) = 0;
+  virtual void visitForInStmt(const ForInStmt &) = 0;
+  virtual void visitParallelForStmt(const ParallelForStmt &) = 0;
+  virtual void visitSwitchStmt(const SwitchStmt &) = 0;
   virtual void visitBreakStmt(const BreakStmt &) = 0;
   virtual void visitContinueStmt(const ContinueStmt &) = 0;
   virtual void visitReturnStmt(const ReturnStmt &) = 0;
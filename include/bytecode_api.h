@@ -0,0 +1,109 @@
+#ifndef COMPILER_BYTECODE_API_H
+#define COMPILER_BYTECODE_API_H
+
+/*
+ * C interface to the bytecode_core library, for hosts that embed the
+ * compiler and VM instead of running the compiler binary.
+ *
+ * Compile once into a program handle, then execute it as often as needed;
+ * each execution returns a run handle with the output, error and stats.
+ * A program is read-only after compilation, so several threads may execute
+ * the same handle at once. Every handle must be released with its free
+ * function. Strings returned by the library belong to the handle they came
+ * from and stay valid until it is freed.
+ *
+ * Option and stats structs start with struct_size, set by their init
+ * function, so that fields can be added at the end without breaking hosts
+ * built against an older header: the library reads (or, for stats, writes)
+ * only the fields the caller's struct has, and uses the defaults for the
+ * rest of the options. Always call the init function first.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct bc_program bc_program;
+typedef struct bc_run bc_run;
+
+/* Compile-time settings */
+typedef struct bc_compile_options {
+  size_t struct_size; /* sizeof(bc_compile_options), set by init */
+  int optimize;       /* Run the AST optimizer (default 1) */
+} bc_compile_options;
+
+/* Run-time settings */
+typedef struct bc_exec_options {
+  size_t struct_size;         /* sizeof(bc_exec_options), set by init */
+  int jit;                    /* Trace hot loops (default 0) */
+  int memoize;                /* Cache results of pure functions (default 0) */
+  int profile;                /* Count instructions and calls (default 0) */
+  uint32_t threads;           /* Threads for parallel for, 0 = one per core */
+  uint64_t instruction_limit; /* Stop after this many, 0 = no limit */
+  uint64_t max_output;        /* Stop once output passes this many bytes,
+                                 0 = no limit */
+} bc_exec_options;
+
+/* Statistics of one run */
+typedef struct bc_stats {
+  size_t struct_size;    /* sizeof(bc_stats), set by init */
+  double compile_ms;     /* Time spent compiling the program */
+  double execute_ms;     /* Time spent in the VM */
+  uint64_t instructions; /* Instructions executed */
+  uint64_t calls;        /* Function calls, memo hits included (0 unless
+                            profiled) */
+  uint64_t memo_hits;    /* Calls answered from memo tables */
+} bc_stats;
+
+void bc_compile_options_init(bc_compile_options *options);
+void bc_exec_options_init(bc_exec_options *options);
+void bc_stats_init(bc_stats *stats);
+
+/*
+ * Compile source text. Returns NULL only when out of memory; on a lexer,
+ * parser or codegen error the handle holds the message instead of a
+ * program, as it does when options has an invalid struct_size. options may
+ * be NULL for the defaults.
+ */
+bc_program *bc_compile(const char *source, size_t length,
+                       const bc_compile_options *options);
+
+/* Error message of a failed compilation, or NULL if it succeeded */
+const char *bc_program_error(const bc_program *program);
+
+/* Time spent compiling, whether or not it succeeded */
+double bc_program_compile_ms(const bc_program *program);
+
+void bc_program_free(bc_program *program);
+
+/*
+ * Run a compiled program from a fresh state. Returns NULL only when out of
+ * memory, given a program that failed to compile or given options with an
+ * invalid struct_size; a run that fails still returns a handle with the
+ * output printed so far and the error. options may be NULL for the
+ * defaults.
+ */
+bc_run *bc_execute(const bc_program *program, const bc_exec_options *options);
+
+/* Everything the run printed; length (if not NULL) receives its size */
+const char *bc_run_output(const bc_run *run, size_t *length);
+
+/* Error that ended the run, or NULL if it completed */
+const char *bc_run_error(const bc_run *run);
+
+/*
+ * Fill the fields stats has room for (per its struct_size); stats with an
+ * invalid struct_size are left untouched
+ */
+void bc_run_stats(const bc_run *run, bc_stats *stats);
+
+void bc_run_free(bc_run *run);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPILER_BYTECODE_API_H */
@@ -0,0 +1,66 @@
+#ifndef COMPILER_CALLGRAPH_H
+#define COMPILER_CALLGRAPH_H
+
+#include "ast.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Call graph built from FunctionCallExpr nodes.
+ *
+ * Construction starts at the top-level statements and only follows calls into
+ * functions that are actually reached, so pre-parsed (lazy) bodies of unused
+ * functions are never parsed. Functions that are not reachable have no node.
+ */
+class CallGraph {
+public:
+  explicit CallGraph(const Program &program);
+
+  /**
+   * Functions called directly from top-level statements
+   */
+  const std::unordered_set<std::string> &topLevelCallees() const {
+    return topLevel_;
+  }
+
+  /**
+   * Functions called directly by a reachable function (empty if unknown)
+   */
+  const std::unordered_set<std::string> &callees(const std::string &fn) const;
+
+  /**
+   * All declared functions reachable from top-level statements
+   */
+  const std::unordered_set<std::string> &reachable() const {
+    return reachable_;
+  }
+
+  bool isReachable(const std::string &fn) const {
+    return reachable_.count(fn) > 0;
+  }
+
+  /**
+   * True if a reachable function can call itself, directly or indirectly
+   */
+  bool isRecursive(const std::string &fn) const;
+
+  /**
+   * Collect the names of all functions called in a statement (with repeats)
+   */
+  static void collectCalls(const Stmt *stmt, std::vector<std::string> &calls);
+
+  /**
+   * Collect the names of all functions called in an expression
+   */
+  static void collectCallsFromExpr(const Expr *expr,
+                                   std::vector<std::string> &calls);
+
+private:
+  std::unordered_set<std::string> topLevel_;
+  std::unordered_map<std::string, std::unordered_set<std::string>> edges_;
+  std::unordered_set<std::string> reachable_;
+};
+
+#endif // COMPILER_CALLGRAPH_H
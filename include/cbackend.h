@@ -0,0 +1,53 @@
+#ifndef COMPILER_CBACKEND_H
+#define COMPILER_CBACKEND_H
+
+#include "codegen.h"
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
+
+/**
+ * Ahead-of-time backend that translates a BytecodeProgram into a standalone
+ * C++ translation unit.
+ *
+ * Every instruction becomes straight-line C++ under a label, jumps become
+ * gotos and CALL/RETURN keep the VM's frame layout, so the emitted program
+ * behaves exactly like VirtualMachine::execute but without dispatch or
+ * operand decoding. The output embeds a small runtime for Values, strings and
+ * arrays and only depends on the C++17 standard library:
+ *
+ *   ./compiler script.src --emit-c=script.cpp
+ *   c++ -O2 -std=c++17 script.cpp -o script
+ */
+class CBackend {
+public:
+  CBackend() = default;
+
+  /**
+   * Translate a program into C++ source
+   * @param program The compiled bytecode program
+   * @return Complete translation unit with a main() function
+   * @throws CodegenError if the program contains an unsupported opcode
+   */
+  std::string emit(const BytecodeProgram &program) const;
+
+  /**
+   * Translate a program and write the source to a stream
+   */
+  void emit(const BytecodeProgram &program, std::ostream &os) const;
+
+private:
+  // Instruction indices that need a label (jump targets, entries, returns)
+  std::set<uint16_t> collectLabels(const BytecodeProgram &program) const;
+
+  void emitConstants(const BytecodeProgram &program, std::ostream &os) const;
+  void emitInstruction(const BytecodeProgram &program, uint16_t ip,
+                       std::ostream &os) const;
+  void emitReturnDispatch(const BytecodeProgram &program,
+                          std::ostream &os) const;
+
+  static std::string escapeString(const std::string &value);
+};
+
+#endif // COMPILER_CBACKEND_H
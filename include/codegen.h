@@ -9,10 +9,17 @@
 
 #include <vector>
 
+class ProfileData;
+
 // ============================================================================
 // Bytecode Program Structures
 // ============================================================================
 
+/**
+ * Entry point of a function whose body has not been generated yet
+ */
+constexpr uint16_t LAZY_FUNCTION_ENTRY = 0xFFFF;
+
 /**
  * Holds metadata for a compiled function
  */
@@ -23,14 +30,66 @@ struct FunctionInfo {
   uint8_t localCount; // Number of local variables
 };
 
+/**
+ * A conditional jump compiled from a source `if`, `while` or `for`, which
+ * lets profile counts for bytecode offsets be filed under source lines
+ */
+struct BranchSite {
+  std::string function; // Empty for top-level code
+  int line;             // Source line of the statement
+  bool loop;
+  uint16_t test;  // Conditional jump on the condition (a JUMP_IF_NOT_ZERO
+                  // jumps when the condition holds, a JUMP_IF_ZERO when not)
+  uint16_t entry; // Loops: the JUMP from before the loop to its condition
+};
+
+/**
+ * Jump targets of a TABLE_SWITCH (dense int labels, indexed by value - low)
+ * or LOOKUP_SWITCH (sparse int or string labels, hashed); values without a
+ * label go to defaultTarget
+ */
+struct SwitchTable {
+  int32_t low = 0;
+  std::vector<uint16_t> targets;
+  std::unordered_map<int32_t, uint16_t> intCases;
+  std::unordered_map<std::string, uint16_t> stringCases;
+  uint16_t defaultTarget = 0;
+
+  /**
+   * Target for a switch value
+   */
+  uint16_t targetFor(const Value &value) const;
+};
+
+/**
+ * A `parallel for`: the loop variable is in local indexSlot and the end it
+ * runs to in indexSlot + 1. Iterations are the code from bodyStart up to
+ * the PARALLEL_NEXT before exit.
+ */
+struct ParallelLoop {
+  struct Reduction {
+    uint16_t slot;
+    ::Reduction::Operator op;
+  };
+
+  uint16_t indexSlot = 0;
+  uint16_t bodyStart = 0;
+  uint16_t exit = 0;
+  std::vector<Reduction> reductions;
+};
+
 /**
  * Represents a complete compiled bytecode program
  */
 struct BytecodeProgram {
-  std::vector<Instruction> code;       // Bytecode instructions
-  std::vector<Value> constants;        // Constant pool
-  std::vector<FunctionInfo> functions; // Function metadata
-  uint16_t mainEntry = 0;              // Entry point for main code
+  std::vector<Instruction> code;           // Bytecode instructions
+  std::vector<Value> constants;            // Constant pool
+  std::vector<FunctionInfo> functions;     // Function metadata
+  uint16_t mainEntry = 0;                  // Entry point for main code
+  uint16_t mainLocalCount = 0;             // Number of slots used by main code
+  std::vector<BranchSite> branchSites;     // Source branches and loops
+  std::vector<SwitchTable> switchTables;   // Operands of *_SWITCH opcodes
+  std::vector<ParallelLoop> parallelLoops; // Operands of PARALLEL_* opcodes
 
   /**
    * Dump the bytecode to stdout for debugging
@@ -57,7 +116,52 @@ public:
    * @param program The AST root node
    * @return The compiled bytecode program
    */
-  BytecodeProgram generate(const Program &program, bool incremental = false);
+  BytecodeProgram generate(const Program &program);
+
+  /**
+   * Compile more input (a REPL line) onto a program generated earlier by
+   * this generator: new functions and top-level code are appended, and
+   * mainEntry moves to the new top-level code, which ends by falling off
+   * the end of the program. Earlier functions and globals stay visible; a
+   * function redefined with the same arity keeps its index, so existing
+   * callers see the new body. On error the program and symbol tables are
+   * left as they were.
+   */
+  void append(BytecodeProgram &program, const Program &ast);
+
+  /**
+   * Slots of the globals that append() has declared so far
+   */
+  const std::unordered_map<std::string, uint16_t> &globalSlots() const {
+    return scopes_.front();
+  }
+
+  /**
+   * Continue appending to a program generated elsewhere (a snapshot): take
+   * its globals and functions as this generator's own
+   */
+  void restore(const BytecodeProgram &program,
+               const std::unordered_map<std::string, uint16_t> &globals);
+
+  /**
+   * Generate only the main code; functions get LAZY_FUNCTION_ENTRY stubs
+   * and are compiled on demand with compileFunction(). The AST must outlive
+   * this generator.
+   */
+  BytecodeProgram generateLazy(const Program &program);
+
+  /**
+   * Append the body of a lazily registered function to a program and patch
+   * its entry in the function table
+   * @throws CodegenError if the function is unknown or fails to compile
+   */
+  void compileFunction(BytecodeProgram &program, uint16_t funcIndex);
+
+  /**
+   * Lay out `if` bodies by the branch counts of an earlier run instead of
+   * static guesses. The profile must outlive the generator.
+   */
+  void setProfile(const ProfileData *profile) { profile_ = profile; }
 
   // Expression visitors - generate code that pushes result on stack
   void visitNumberExpr(const NumberExpr &expr) override;
@@ -77,6 +181,9 @@ public:
   void visitIfStmt(const IfStmt &stmt) override;
   void visitWhileStmt(const WhileStmt &stmt) override;
   void visitForStmt(const ForStmt &stmt) override;
+  void visitForInStmt(const ForInStmt &stmt) override;
+  void visitParallelForStmt(const ParallelForStmt &stmt) override;
+  void visitSwitchStmt(const SwitchStmt &stmt) override;
   void visitBreakStmt(const BreakStmt &stmt) override;
   void visitContinueStmt(const ContinueStmt &stmt) override;
   void visitReturnStmt(const ReturnStmt &stmt) override;
@@ -96,18 +203,47 @@ private:
   std::vector<std::unordered_map<std::string, uint16_t>>
       scopes_;                                        // Stack of local scopes
   std::unordered_map<std::string, uint16_t> globals_; // Global variable indices
+  uint16_t peakLocals_ = 0; // Most slots live at once in the current frame
 
   // Function lookup (name -> index in functions vector)
   std::unordered_map<std::string, uint16_t> functionMap_;
 
+  // Declarations awaiting lazy compilation (function index -> AST)
+  std::unordered_map<uint16_t, const FunctionDecl *> pendingFunctions_;
+
   // Loop handling
   struct LoopContext {
     int continueTarget; // Target IP for continue (or -1 if needs patching)
     std::vector<size_t> breakJumps;    // Offsets to patch for break
     std::vector<size_t> continueJumps; // Offsets to patch for continue
+    size_t coldStart;                  // First cold block inside the loop
+    bool parallel = false;             // Iterations of a parallel for
   };
   std::vector<LoopContext> loopStack_;
 
+  // Enclosing parallel fors, whose bodies run on copies of outer variables
+  struct ParallelContext {
+    size_t scope;         // Scope opened by the loop
+    std::string variable; // Loop variable
+    std::vector<::Reduction> reductions;
+  };
+  std::vector<ParallelContext> parallelStack_;
+
+  // Assignments and reads of reduced variables written in a form whose
+  // result does not depend on how iterations are split into chunks
+  std::unordered_map<const ASTNode *, ::Reduction::Operator> reductionUses_;
+
+  // Bodies of unlikely `if`s, emitted after the innermost enclosing loop or
+  // at the end of the function so that the likely path falls through
+  struct ColdBlock {
+    const IfStmt *stmt;
+    size_t jump;     // JUMP_IF_NOT_ZERO to the block
+    uint16_t resume; // Where the block continues unless it exits
+  };
+  std::vector<ColdBlock> coldBlocks_;
+  const ProfileData *profile_ = nullptr;
+  bool incremental_ = false; // REPL input: main code has no end to move to
+
   // Helpers
 
   /**
@@ -127,6 +263,11 @@ private:
    */
   uint16_t getOrCreateLocal(const std::string &name);
 
+  /**
+   * Create a variable slot in the innermost scope, shadowing outer ones
+   */
+  uint16_t declareLocal(const std::string &name);
+
   /**
    * Get a variable slot (throws if not found)
    */
@@ -137,6 +278,23 @@ private:
    */
   bool isGlobalScope() const;
 
+  /**
+   * Reject an assignment inside a parallel for whose effect would be lost
+   * with the worker's copy of the variable
+   * @throws CodegenError for outer variables that are not reduced and for
+   * the loop variable itself
+   */
+  void checkParallelWrite(const std::string &name) const;
+
+  /**
+   * Reject a read or assignment of a reduced variable unless it is one of
+   * the updates found in the loop body (`s = s + e` or `s = s - e` for +,
+   * `if (e < m) { m = e; }` for min, `if (e > m) { m = e; }` for max).
+   * Other uses would give different results serially and in chunks.
+   * @throws CodegenError for any other use
+   */
+  void checkReductionUse(const ASTNode &node, const std::string &name) const;
+
   /**
    * Patch a jump instruction with a target address
    */
@@ -157,6 +315,67 @@ private:
    * Finalize function compilation
    */
   void endFunction();
+
+  /**
+   * Register every function declared in the program (entries unset)
+   */
+  void registerFunctions(const Program &program);
+
+  /**
+   * Whether an `if` body should be moved out of line: by its profile
+   * counts if there are any, otherwise if it leaves the enclosing loop
+   */
+  bool isUnlikely(const IfStmt &stmt) const;
+
+  /**
+   * Emit the cold blocks from `first` on and drop them from the list
+   */
+  void emitColdBlocks(size_t first);
+
+  /**
+   * Emit the loop's cold blocks, patch its break and continue jumps and pop
+   * its context
+   */
+  void endLoop();
+
+  void addBranchSite(const Stmt &stmt, bool loop, size_t test,
+                     size_t entry = 0);
+};
+
+// ============================================================================
+// Lazy Function Compiler
+// ============================================================================
+
+/**
+ * Owns a program whose functions are generated on their first CALL.
+ * Attach to the VM with VirtualMachine::setLazyCompiler(); scripts that only
+ * use a few of their functions skip generating the rest entirely.
+ */
+class LazyFunctionCompiler {
+public:
+  /**
+   * Generate main code for a program (the AST, and the profile if given,
+   * must outlive the compiler)
+   */
+  explicit LazyFunctionCompiler(const Program &ast,
+                                const ProfileData *profile = nullptr);
+
+  const BytecodeProgram &program() const { return program_; }
+
+  /**
+   * Compile a function if it is still a stub
+   */
+  void compile(uint16_t funcIndex);
+
+  /**
+   * Number of functions generated so far
+   */
+  size_t compiledCount() const { return compiled_; }
+
+private:
+  CodeGenerator codegen_;
+  BytecodeProgram program_;
+  size_t compiled_ = 0;
 };
 
 #endif // COMPILER_CODEGEN_H
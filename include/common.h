@@ -84,29 +84,42 @@ struct Value {
  * Bytecode opcodes for the virtual machine
  */
 enum class Opcode : uint8_t {
-  CONST = 0x00,        // Load constant value
-  LOAD = 0x01,         // Load variable
-  STORE = 0x02,        // Store to variable
-  ADD = 0x03,          // Addition
-  SUB = 0x04,          // Subtraction
-  MUL = 0x05,          // Multiplication
-  DIV = 0x06,          // Division
-  MOD = 0x07,          // Modulo
-  JUMP = 0x08,         // Unconditional jump
-  JUMP_IF_ZERO = 0x09, // Conditional jump if stack top is zero
-  CALL = 0x0A,         // Function call
-  RETURN = 0x0B,       // Function return
-  PRINT = 0x0C,        // Print stack top
-  EQ = 0x0D,           // Equal
-  NEQ = 0x0E,          // Not Equal
-  LT = 0x0F,           // Less Than
-  LTE = 0x10,          // Less Than or Equal
-  GT = 0x11,           // Greater Than
-  GTE = 0x12,          // Greater Than or Equal
-  BUILD_ARRAY = 0x13,  // Build Array
-  ARRAY_LOAD = 0x14,   // Load from Array
-  ARRAY_STORE = 0x15,  // Store to Array
-  POP = 0x16           // Pop stack
+  CONST = 0x00,            // Load constant value
+  LOAD = 0x01,             // Load variable
+  STORE = 0x02,            // Store to variable
+  ADD = 0x03,              // Addition
+  SUB = 0x04,              // Subtraction
+  MUL = 0x05,              // Multiplication
+  DIV = 0x06,              // Division
+  MOD = 0x07,              // Modulo
+  JUMP = 0x08,             // Unconditional jump
+  JUMP_IF_ZERO = 0x09,     // Conditional jump if stack top is zero
+  CALL = 0x0A,             // Function call
+  RETURN = 0x0B,           // Function return
+  PRINT = 0x0C,            // Print stack top
+  EQ = 0x0D,               // Equal
+  NEQ = 0x0E,              // Not Equal
+  LT = 0x0F,               // Less Than
+  LTE = 0x10,              // Less Than or Equal
+  GT = 0x11,               // Greater Than
+  GTE = 0x12,              // Greater Than or Equal
+  BUILD_ARRAY = 0x13,      // Build Array
+  ARRAY_LOAD = 0x14,       // Load from Array
+  ARRAY_STORE = 0x15,      // Store to Array
+  POP = 0x16,              // Pop stack
+  SHL = 0x17,              // Multiply by 2^operand (shift left)
+  SHR = 0x18,              // Divide by 2^operand, rounding toward zero like DIV
+  MASK = 0x19,             // Remainder modulo 2^operand, signed like MOD
+  JUMP_IF_NOT_ZERO = 0x1A, // Conditional jump unless stack top is zero
+  TABLE_SWITCH = 0x1B,     // Jump through switchTables[operand] by index
+  LOOKUP_SWITCH = 0x1C,    // Jump through switchTables[operand] by hash
+  LOCAL_INC = 0x1D,        // Pop value and add it to local variable
+  ARRAY_ADD_STORE = 0x1E,  // Pop value, add it to array element in place
+  DUP2 = 0x1F,             // Duplicate top two stack values
+  ITER_NEXT = 0x20,        // Step the array iterator in locals operand..+2
+  PARALLEL_FOR = 0x21,     // Run parallelLoops[operand] (or skip it if empty)
+  PARALLEL_NEXT = 0x22,    // End of a parallel for iteration
+  LOCAL_DEC = 0x23         // Pop value and subtract it from local variable
 };
 
 /**
@@ -118,6 +131,43 @@ struct Instruction {
       operand; // Operand (immediate value, variable index, jump offset, etc.)
 };
 
+// ============================================================================
+// Power-of-Two Arithmetic
+// ============================================================================
+
+// SHL/SHR/MASK replace MUL/DIV/MOD by 2^k (1 <= k <= MAX_SHIFT) with
+// identical results, including for negative operands and on overflow
+constexpr uint16_t MAX_SHIFT = 30;
+
+inline int32_t shiftLeft(int32_t value, unsigned shift) {
+  return static_cast<int32_t>(static_cast<uint32_t>(value) << shift);
+}
+
+inline int32_t shiftRight(int32_t value, unsigned shift) {
+  // Bias negative values so the arithmetic shift truncates toward zero
+  int32_t bias = (value >> 31) & static_cast<int32_t>((1u << shift) - 1);
+  return (value + bias) >> shift;
+}
+
+inline int32_t maskLow(int32_t value, unsigned shift) {
+  int32_t mask = static_cast<int32_t>((1u << shift) - 1);
+  int32_t bias = (value >> 31) & mask;
+  return value - ((value + bias) & ~mask);
+}
+
+// ============================================================================
+// Division
+// ============================================================================
+
+// DIV and MOD wrap like the other operators, so INT32_MIN / -1 is INT32_MIN
+// and INT32_MIN % -1 is 0 instead of a hardware trap; divisor must be nonzero
+inline int32_t wrapDivide(int32_t a, int32_t b) {
+  return b == -1 ? static_cast<int32_t>(0u - static_cast<uint32_t>(a))
+                 : a / b;
+}
+
+inline int32_t wrapModulo(int32_t a, int32_t b) { return b == -1 ? 0 : a % b; }
+
 // ============================================================================
 // System Limits and Constants
 // ============================================================================
@@ -128,6 +178,9 @@ constexpr uint16_t MAX_VARIABLES = 1024;
 constexpr uint16_t MAX_INSTRUCTIONS = 65535;
 constexpr uint16_t MAX_FUNCTIONS = 256;
 
+// Deepest AST the parser builds; later passes recurse over the tree
+constexpr uint16_t MAX_NESTING_DEPTH = 1000;
+
 // Bytecode version for compatibility checks
 constexpr uint8_t BYTECODE_VERSION = 1;
 
@@ -244,6 +297,34 @@ constexpr std::string_view opcode_to_string(Opcode opcode) noexcept {
     return "ARRAY_LOAD";
   case Opcode::ARRAY_STORE:
     return "ARRAY_STORE";
+  case Opcode::POP:
+    return "POP";
+  case Opcode::SHL:
+    return "SHL";
+  case Opcode::SHR:
+    return "SHR";
+  case Opcode::MASK:
+    return "MASK";
+  case Opcode::JUMP_IF_NOT_ZERO:
+    return "JUMP_IF_NOT_ZERO";
+  case Opcode::TABLE_SWITCH:
+    return "TABLE_SWITCH";
+  case Opcode::LOOKUP_SWITCH:
+    return "LOOKUP_SWITCH";
+  case Opcode::LOCAL_INC:
+    return "LOCAL_INC";
+  case Opcode::ARRAY_ADD_STORE:
+    return "ARRAY_ADD_STORE";
+  case Opcode::DUP2:
+    return "DUP2";
+  case Opcode::ITER_NEXT:
+    return "ITER_NEXT";
+  case Opcode::PARALLEL_FOR:
+    return "PARALLEL_FOR";
+  case Opcode::PARALLEL_NEXT:
+    return "PARALLEL_NEXT";
+  case Opcode::LOCAL_DEC:
+    return "LOCAL_DEC";
   default:
     return "UNKNOWN";
   }
@@ -0,0 +1,79 @@
+#ifndef COMPILER_EFFECTS_H
+#define COMPILER_EFFECTS_H
+
+#include "ast.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * What calling a function may do, including everything it calls
+ */
+struct FunctionEffects {
+  bool prints = false;        // Reaches a print statement
+  bool readsArrays = false;   // Indexes an array
+  bool writesArrays = false;  // Stores into an array
+  bool recursive = false;     // Can call itself, directly or not
+  bool callsUnknown = false;  // Calls a function that was not analyzed
+
+  bool pure() const { return !prints && !writesArrays && !callsUnknown; }
+
+  /**
+   * Comma-separated summary, e.g. "pure, reads arrays, recursive"
+   */
+  std::string describe() const;
+};
+
+/**
+ * Side effect summaries for the functions top-level code can reach.
+ *
+ * A function is pure if neither it nor anything it calls prints or stores
+ * into an array, and it only calls declared functions. Functions cannot see
+ * globals, so a pure function called with int or string arguments computes
+ * its value from those arguments alone; calls may be cached, merged or
+ * dropped. Termination is not analyzed: a pure call may still loop or fail.
+ * Array reads and writes are tracked separately so that passes can keep
+ * array values across calls that cannot store into them. Unreachable
+ * pre-parsed bodies stay unparsed and count as unknown.
+ */
+class EffectAnalysis {
+public:
+  explicit EffectAnalysis(const Program &program);
+
+  bool isPure(const std::string &fn) const { return pure_.count(fn) > 0; }
+
+  /**
+   * Summary for a function, or nullptr if it was not analyzed
+   */
+  const FunctionEffects *effectsOf(const std::string &fn) const;
+
+  /**
+   * True unless the function is known never to store into an array
+   */
+  bool mayWriteArrays(const std::string &fn) const {
+    const FunctionEffects *effects = effectsOf(fn);
+    return !effects || effects->writesArrays || effects->callsUnknown;
+  }
+
+  /**
+   * All pure reachable functions
+   */
+  const std::unordered_set<std::string> &pureFunctions() const {
+    return pure_;
+  }
+
+  /**
+   * True if a statement contains a print (calls are not followed)
+   */
+  static bool containsPrint(const Stmt &stmt);
+
+private:
+  std::unordered_map<std::string, FunctionEffects> effects_;
+  std::unordered_set<std::string> pure_;
+
+  // Record the array loads and stores in code (calls are not followed)
+  static void collectArrayAccesses(const Stmt &stmt, FunctionEffects &effects);
+  static void collectArrayAccesses(const Expr &expr, FunctionEffects &effects);
+};
+
+#endif // COMPILER_EFFECTS_H
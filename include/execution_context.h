@@ -0,0 +1,65 @@
+#ifndef COMPILER_EXECUTION_CONTEXT_H
+#define COMPILER_EXECUTION_CONTEXT_H
+
+#include "codegen.h"
+#include "common.h"
+#include "vm.h"
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+
+class Profiler;
+
+/**
+ * One thread's view of a shared compiled program.
+ *
+ * A BytecodeProgram is never written while it runs: the VM reads its code,
+ * constants and tables, and everything a run changes (stack, frames,
+ * locals, arrays, memo tables, traces, output) lives in the VM. A context
+ * pairs the shared program with a VM and output buffer of its own, so any
+ * number of threads can run one program at the same time, one context
+ * each. A context itself must stay on one thread at a time.
+ */
+class ExecutionContext {
+public:
+  /**
+   * @throws VMError if the program still has lazily compiled functions,
+   * since compiling them would write to the shared program
+   */
+  explicit ExecutionContext(std::shared_ptr<const BytecodeProgram> program);
+
+  ExecutionContext(const ExecutionContext &) = delete;
+  ExecutionContext &operator=(const ExecutionContext &) = delete;
+
+  const BytecodeProgram &program() const { return *program_; }
+
+  /**
+   * The context's VM, for options such as setJitEnabled() and setThreads()
+   */
+  VirtualMachine &vm() { return vm_; }
+
+  /**
+   * Run the program from a fresh state; output collects in the buffer
+   * @return Value of main
+   */
+  Value execute(Profiler *profiler = nullptr);
+
+  /**
+   * Sliced runs (see VirtualMachine::start and resume)
+   */
+  void start() { vm_.start(*program_); }
+  bool resume(uint64_t safepoints) { return vm_.resume(safepoints); }
+
+  /**
+   * Everything printed since the last call
+   */
+  std::string takeOutput();
+
+private:
+  std::shared_ptr<const BytecodeProgram> program_;
+  std::ostringstream output_;
+  VirtualMachine vm_;
+};
+
+#endif // COMPILER_EXECUTION_CONTEXT_H
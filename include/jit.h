@@ -0,0 +1,178 @@
+#ifndef COMPILER_JIT_H
+#define COMPILER_JIT_H
+
+#include "codegen.h"
+#include "common.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Trace Representation
+// ============================================================================
+
+/**
+ * Operations of the compact trace form. Traces only ever see integers and
+ * array references held in locals, so values live unboxed on an int32 stack.
+ */
+enum class TraceOpKind : uint8_t {
+  PUSH_INT,        // Push immediate
+  LOAD_INT,        // Push int local (type checked once at trace entry)
+  LOAD_ARRAY,      // Push reference to array local (checked at trace entry)
+  STORE_INT,       // Pop into int local
+  INC_LOCAL,       // local += immediate (fused LOAD/PUSH/ADD/STORE)
+  BINARY,          // Arithmetic or comparison, optional immediate right side
+                   // (always the shift amount for SHL/SHR/MASK)
+  GUARD,           // Pop condition, exit if it does not match the recording
+  COMPARE_GUARD,   // Fused comparison + GUARD
+  SWITCH_GUARD,    // Exit unless the top equals imm, then pop it
+  ARRAY_LOAD_INT,  // Pop index, push int element (bounds/type guarded)
+  ARRAY_STORE_INT, // Pop value and index, store into array local
+  ARRAY_ADD_INT,   // Pop value and index, add into int element of array local
+  DUP2,            // Duplicate the top two
+  ITER_NEXT_INT,   // Step the iterator in locals slot..slot+2, push whether
+                   // there was an element (exit unless it is an int)
+  POP,             // Discard top
+  LOOP             // Jump back to the start of the trace
+};
+
+/**
+ * A single trace operation
+ */
+struct TraceOp {
+  TraceOpKind kind;
+  Opcode op = Opcode::ADD;   // Arithmetic/comparison for BINARY ops
+  bool hasImmediate = false; // BINARY/COMPARE_GUARD: right operand is imm
+  bool exitOnZero = false;   // GUARD: exit when the condition is zero
+  uint16_t slot = 0;         // Local slot (relative to the base pointer)
+  int32_t imm = 0;           // Immediate operand
+  uint16_t ip = 0;           // Bytecode instruction this op came from
+  uint16_t exitIp = 0;       // Where the interpreter resumes on a side exit
+  uint32_t executed = 0;     // Instructions of the iteration done at that exit
+  uint32_t shape = 0;        // Index into Trace::shapes for side exits
+};
+
+/**
+ * A compiled loop trace
+ */
+struct Trace {
+  uint16_t header = 0;              // Loop header instruction index
+  std::vector<TraceOp> ops;         // Optimized linear trace
+  uint64_t length = 0; // Bytecode instructions one iteration stands for
+  std::vector<uint16_t> intSlots;   // Locals that must hold ints on entry
+  std::vector<uint16_t> arraySlots; // Locals that must hold arrays on entry
+
+  // Stack layout at each side exit: -1 for an int, otherwise the local slot
+  // whose array reference sits at that depth
+  std::vector<std::vector<int32_t>> shapes;
+};
+
+// ============================================================================
+// Trace JIT
+// ============================================================================
+
+/**
+ * Tracing tier for hot loops.
+ *
+ * The interpreter reports backward jumps; once a loop header has been hit
+ * often enough the next iteration is recorded instruction by instruction
+ * together with the types it observed. The recording is turned into a linear
+ * trace with guards where control flow or types could diverge, optimized
+ * (constant propagation, type checks hoisted to trace entry, superinstruction
+ * fusion) and then executed in place of the interpreter until a guard fails,
+ * at which point the interpreter state is rebuilt and execution resumes at
+ * the corresponding bytecode instruction.
+ */
+class TraceJit {
+public:
+  struct Stats {
+    uint64_t tracesCompiled = 0;
+    uint64_t recordingsAborted = 0;
+    uint64_t traceEntries = 0;
+    uint64_t sideExits = 0;
+  };
+
+  // Backward jumps to a header before it gets recorded
+  static constexpr uint32_t HOT_LOOP_THRESHOLD = 32;
+  // Longest recording before giving up
+  static constexpr size_t MAX_TRACE_LENGTH = 2048;
+  // Failed recordings before a header is blacklisted
+  static constexpr uint32_t MAX_RECORD_ATTEMPTS = 3;
+
+  TraceJit() = default;
+
+  /**
+   * Drop all counters and traces (called when a new program starts)
+   */
+  void reset();
+
+  /**
+   * Get compiled trace for a loop header, if any
+   */
+  const Trace *traceFor(uint16_t header) const;
+
+  /**
+   * Count a backward jump; starts recording once the loop is hot
+   */
+  void onBackwardJump(uint16_t header);
+
+  /**
+   * True while an iteration is being recorded
+   */
+  bool isRecording() const { return recording_ != nullptr; }
+
+  /**
+   * Record an instruction before the interpreter executes it.
+   * Aborts the recording if the instruction cannot be traced; completes it
+   * when the backward jump to the header is seen.
+   */
+  void record(const BytecodeProgram &program, uint16_t ip,
+              const std::vector<Value> &stack, const std::vector<Value> &locals,
+              uint16_t basePointer);
+
+  /**
+   * Abandon the current recording (e.g. the loop was left)
+   */
+  void abortRecording();
+
+  /**
+   * Run a trace until a guard fails or the instruction budget runs out.
+   * Each completed iteration takes the trace's length from the budget and a
+   * side exit the instructions its iteration got through; at 0 the trace
+   * returns to the loop header, where the interpreter stops.
+   * @return Instruction index where the interpreter must resume
+   * @throws VMError on stack overflow while rebuilding the interpreter stack
+   */
+  uint16_t run(const Trace &trace, std::vector<Value> &stack,
+               std::vector<Value> &locals, uint16_t basePointer,
+               uint64_t &budget);
+
+  const Stats &getStats() const { return stats_; }
+
+private:
+  struct Recording {
+    uint16_t header;
+    std::vector<TraceOp> ops;
+    std::vector<int32_t> kinds; // Abstract stack, same encoding as shapes
+    uint64_t instructions = 0;  // Bytecode instructions recorded
+  };
+
+  Stats stats_;
+  std::unordered_map<uint16_t, uint32_t> hotness_;
+  std::unordered_map<uint16_t, uint32_t> failures_;
+  std::unordered_map<uint16_t, std::unique_ptr<Trace>> traces_;
+  std::unique_ptr<Recording> recording_;
+
+  void finishRecording();
+
+  // Optimization pipeline
+  static bool computeEntryGuards(Trace &trace);
+  static void foldConstants(std::vector<TraceOp> &ops);
+  static void fuseOps(std::vector<TraceOp> &ops);
+  static void computeShapes(Trace &trace);
+
+  static bool evalBinary(Opcode op, int32_t a, int32_t b, int32_t &result);
+};
+
+#endif // COMPILER_JIT_H
@@ -29,10 +29,15 @@ enum class TokenType {
   KW_ELSE,
   KW_WHILE,
   KW_FOR,
+  KW_IN,
+  KW_PARALLEL,
   KW_BREAK,
   KW_CONTINUE,
   KW_RETURN,
   KW_PRINT,
+  KW_SWITCH,
+  KW_CASE,
+  KW_DEFAULT,
 
   // Arithmetic operators
   PLUS,    // +
@@ -42,13 +47,18 @@ enum class TokenType {
   PERCENT, // %
 
   // Assignment and comparison
-  ASSIGN, // =
-  EQ,     // ==
-  NEQ,    // !=
-  LT,     // <
-  LTE,    // <=
-  GT,     // >
-  GTE,    // >=
+  ASSIGN,       // =
+  PLUS_ASSIGN,  // +=
+  MINUS_ASSIGN, // -=
+  STAR_ASSIGN,  // *=
+  PLUS_PLUS,    // ++
+  MINUS_MINUS,  // --
+  EQ,           // ==
+  NEQ,          // !=
+  LT,           // <
+  LTE,          // <=
+  GT,           // >
+  GTE,          // >=
 
   // Logical operators
   AND_AND, // &&
@@ -62,6 +72,7 @@ enum class TokenType {
   RBRACE,    // }
   SEMICOLON, // ;
   COMMA,     // ,
+  COLON,     // :
   LBRACKET,  // [
   RBRACKET   // ]
 };
@@ -113,6 +124,7 @@ private:
   size_t index_;
   int line_;
   int column_;
+  TokenType previousType_; // Type of the last token produced
 
   // ========================================================================
   // Core Lexing Methods
@@ -130,6 +142,12 @@ private:
    */
   char peekChar() const;
 
+  /**
+   * First non-whitespace character after the next one
+   * @return That char or '\0' if only whitespace remains
+   */
+  char peekNonWhitespaceChar() const;
+
   /**
    * Check if lexer is at end of input
    * @return True if index_ >= source_.length()
@@ -179,7 +197,9 @@ private:
   Token lexIdentifierOrKeyword();
 
   /**
-   * Lex an operator or delimiter
+   * Lex an operator or delimiter. `--` is one MINUS_MINUS token only in
+   * decrement position (after a name or `]` and before `;` or `)`);
+   * elsewhere it is two MINUS tokens, so `a--1` means `a - (-1)`.
    * @return Token of appropriate operator/delimiter type
    * @throws LexerError for unsupported character combinations
    */
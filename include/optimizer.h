@@ -2,22 +2,41 @@
 #define COMPILER_OPTIMIZER_H
 
 #include "ast.h"
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
+class ProfileData;
+
 /**
  * AST Optimizer implementing multiple optimization passes:
  * - Constant Folding: Evaluate constant expressions at compile time
- * - Dead Code Elimination: Remove unused assignments
- * - Function Inlining: Inline small non-recursive functions
+ * - Dead Code Elimination: Remove dead stores (liveness based, inside
+ *   functions), unreachable statements and constant-false branches
+ * - Partial Evaluation: Run calls of print-free functions with literal
+ *   arguments at compile time and use their result
+ * - Inline Candidates: Count small non-recursive functions (calls are not
+ *   rewritten)
+ * - Loop Unrolling: Copy the body of small counted for loops, completely for
+ *   tiny constant trip counts and four times per iteration otherwise
+ * - Strength Reduction: Replace products of loop induction variables with
+ *   derived variables advanced by addition
+ * - Common Subexpression Elimination: Compute repeated pure expressions once
+ *   into a temporary (local value numbering)
+ * - Dead Function Elimination: Remove functions unreachable from top level
  */
 class Optimizer {
 public:
   struct Stats {
     int constantsFolded = 0;
     int deadCodeRemoved = 0;
-    int functionsInlined = 0;
+    int inlineCandidates = 0;
+    int functionsRemoved = 0;
+    int subexpressionsEliminated = 0;
+    int inductionVariablesReduced = 0;
+    int loopsUnrolled = 0;
+    int callsEvaluated = 0;
   };
 
   Optimizer() = default;
@@ -39,9 +58,64 @@ public:
   void runDeadCodeElimination(Program &program);
 
   /**
-   * Run only function inlining
+   * Run only partial evaluation. Each call runs in its own VirtualMachine
+   * with an instruction limit; calls that fail or exceed it are kept.
+   */
+  void runPartialEvaluation(Program &program);
+
+  /**
+   * Count the functions that are small enough and non-recursive, for
+   * --verbose. Calls are left as they are.
+   */
+  void countInlineCandidates(Program &program);
+
+  /**
+   * Run only loop unrolling. Only innermost for loops without break or
+   * continue are unrolled, within a fixed budget of copied AST nodes;
+   * variable limits are stored in `$unrollN`.
+   */
+  void runLoopUnrolling(Program &program);
+
+  /**
+   * Run only induction variable strength reduction. Derived variables are
+   * named `$ivN`; multiply/divide/modulo by powers of two are turned into
+   * shifts by the code generator.
+   */
+  void runStrengthReduction(Program &program);
+
+  /**
+   * Run only common subexpression elimination. Repeated expressions are
+   * stored in `$cseN` temporaries; array loads are only reused while no
+   * array store or call can have intervened.
+   */
+  void runCommonSubexpressionElimination(Program &program);
+
+  /**
+   * Run only dead function elimination (uses the call graph from top-level
+   * statements; removed declarations are destroyed)
    */
-  void runFunctionInlining(Program &program);
+  void runDeadFunctionElimination(Program &program);
+
+  /**
+   * Remove functions unreachable from top-level code. Enabled by default;
+   * pass false to keep them, e.g. when later input (a REPL line) may still
+   * call them.
+   */
+  void setRemoveDeadFunctions(bool enabled) { removeDeadFunctions_ = enabled; }
+
+  /**
+   * Skip loop unrolling in run(), e.g. while collecting a profile whose loop
+   * counts should describe the source loops. Enabled by default.
+   */
+  void setUnrollLoops(bool enabled) { unrollLoops_ = enabled; }
+
+  /**
+   * Use execution counts from an earlier run (see ProfileData) for loop
+   * unrolling: loops that never ran or average fewer trips than the unroll
+   * factor stay rolled and hot ones get a larger copy budget. The profile
+   * must outlive the optimizer.
+   */
+  void setProfile(const ProfileData *profile) { profile_ = profile; }
 
   /**
    * Get optimization statistics
@@ -55,10 +129,23 @@ public:
 
 private:
   Stats stats_;
+  bool removeDeadFunctions_ = true;
+  bool unrollLoops_ = true;
+  const ProfileData *profile_ = nullptr;
 
-  // Function map for inlining
+  // Function map for the inline candidate count
   std::unordered_map<std::string, const FunctionDecl *> functionMap_;
 
+  // Functions the passes look at. With pre-parsed (lazy) bodies this is only
+  // what top-level code can reach, so unused bodies are never parsed.
+  std::unordered_set<std::string> analyzed_;
+
+  // Reachability helpers
+  void computeAnalyzedFunctions(const Program &program);
+  bool isAnalyzed(const FunctionDecl &fn) const {
+    return analyzed_.count(fn.name()) > 0;
+  }
+
   // Constant folding helpers
   void countFoldingOpportunities(const Stmt *stmt);
   std::unique_ptr<Expr> foldExpression(std::unique_ptr<Expr> expr);
@@ -68,17 +155,43 @@ private:
   int getConstantValue(const Expr &expr) const;
 
   // Dead code elimination helpers
-  std::unordered_set<std::string>
-  findUsedVariables(const std::vector<std::unique_ptr<Stmt>> &stmts);
+  using LiveSet = std::unordered_set<std::string>;
+
+  // Live variables at the targets of break and continue
+  struct LoopLiveness {
+    LiveSet exit;
+    LiveSet next;
+  };
+
+  void eliminateDeadCode(FunctionDecl &fn);
+  void eliminateDeadCode(std::vector<std::unique_ptr<Stmt>> &stmts);
+  std::unique_ptr<Stmt> simplifyBranches(std::unique_ptr<Stmt> stmt);
+  bool alwaysExits(const Stmt &stmt) const;
+  LiveSet removeDeadStores(std::vector<std::unique_ptr<Stmt>> &stmts,
+                           LiveSet live, std::vector<LoopLiveness> &loops);
+  LiveSet liveIn(const std::vector<std::unique_ptr<Stmt>> &stmts, LiveSet live,
+                 std::vector<LoopLiveness> &loops) const;
+  LiveSet liveIn(const Stmt *stmt, const LiveSet &out,
+                 std::vector<LoopLiveness> &loops) const;
+  LiveSet whileHeadLiveness(const WhileStmt &stmt, const LiveSet &out,
+                            std::vector<LoopLiveness> &loops) const;
+  LiveSet forHeadLiveness(const ForStmt &stmt, const LiveSet &out,
+                          std::vector<LoopLiveness> &loops,
+                          LiveSet &next) const;
+  LiveSet iteratorHeadLiveness(const std::vector<std::unique_ptr<Stmt>> &body,
+                               const std::string &variable,
+                               const LiveSet &out,
+                               std::vector<LoopLiveness> &loops) const;
+  bool isRemovable(const Expr &expr) const;
+  bool evaluateConstant(const Expr &expr, int32_t &result) const;
   void collectUsedVars(const Stmt *stmt, std::unordered_set<std::string> &used);
   void collectUsedVarsFromExpr(const Expr *expr,
-                               std::unordered_set<std::string> &used);
-  void countDeadCode(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                     const std::unordered_set<std::string> &used);
-  void eliminateDeadCode(std::vector<std::unique_ptr<Stmt>> &stmts);
+                               std::unordered_set<std::string> &used) const;
+  void collectAssignedVars(const Stmt *stmt,
+                           std::unordered_set<std::string> &assigned);
 
-  // Function inlining helpers
-  bool canInline(const FunctionDecl &fn) const;
+  // Inline candidate helpers
+  bool isInlineCandidate(const FunctionDecl &fn) const;
   bool containsCall(const Stmt *stmt, const std::string &fnName) const;
   bool containsCallExpr(const Expr *expr, const std::string &fnName) const;
   int countAstNodes(const FunctionDecl &fn) const;
@@ -25,6 +25,23 @@ public:
    */
   explicit Parser(const std::vector<Token> &tokens);
 
+  /**
+   * Construct a parser that shares ownership of the token stream.
+   * Lazily parsed function bodies keep a reference to it and an index
+   * range instead of copying their tokens.
+   *
+   * @param tokens Vector of tokens produced by the Lexer
+   */
+  explicit Parser(std::shared_ptr<const std::vector<Token>> tokens);
+
+  /**
+   * Pre-parse function bodies: only match braces and keep the token range,
+   * deferring full parsing until FunctionDecl::body() is first used.
+   *
+   * @param lazy True to enable pre-parsing
+   */
+  void setLazyFunctionBodies(bool lazy) { lazyBodies_ = lazy; }
+
   // ========================================================================
   // Main Entry Points
   // ========================================================================
@@ -141,22 +158,93 @@ private:
 
   std::unique_ptr<Stmt> parseVarDecl();
   std::unique_ptr<Stmt> parseAssignment();
+
+  /**
+   * Parse `= e`, `+= e`, `-= e`, `*= e`, `++` or `--` after an assignment
+   * target, without the semicolon. Compound assignments to a variable become
+   * `x = x op e`.
+   *
+   * @return The assignment, or nullptr (leaving target alone) if no
+   *         assignment operator follows
+   * @throws ParserError if target is not a variable or array element
+   */
+  std::unique_ptr<Stmt> parseAssignmentTail(std::unique_ptr<Expr> &target);
   std::unique_ptr<Expr> parsePostfix(std::unique_ptr<Expr> left);
   std::unique_ptr<Expr> parseArrayLiteral();
   std::unique_ptr<Stmt> parseIfStatement();
   std::unique_ptr<Stmt> parseWhileStatement();
   std::unique_ptr<Stmt> parseForStatement();
+
+  /**
+   * Parse the rest of `for (x in arr) { ... }` once `for (` is consumed
+   */
+  std::unique_ptr<Stmt> parseForInStatement(int line);
+
+  /**
+   * Parse `parallel for (i = start; i < end; i++) reduce(...) { ... }`;
+   * the step must be 1 and the reduce clause is optional
+   */
+  std::unique_ptr<Stmt> parseParallelForStatement();
+  std::unique_ptr<Stmt> parseSwitchStatement();
+
+  /**
+   * Parse an integer (optionally negative) or string case label.
+   *
+   * @param key Set to a text that differs for every distinct label
+   */
+  std::unique_ptr<Expr> parseCaseLabel(std::string &key);
   std::unique_ptr<Stmt> parseBreakStatement();
   std::unique_ptr<Stmt> parseContinueStatement();
   std::unique_ptr<Stmt> parseReturnStatement();
   std::unique_ptr<Stmt> parsePrintStatement();
 
+  /**
+   * Skip a function body up to (and including) its closing brace.
+   *
+   * @return Parser that builds the body from the skipped token range
+   * @throws ParserError if the body is not terminated
+   */
+  FunctionDecl::BodyParser skipFunctionBody();
+
   // ========================================================================
   // Token Navigation
   // ========================================================================
 
-  const std::vector<Token> &tokens_; ///< Reference to token stream
+  // Parse tokens [begin, end) of a shared stream; `end` is the token that
+  // stands in for end of input
+  Parser(std::shared_ptr<const std::vector<Token>> tokens, size_t begin,
+         size_t end, const Token &endToken);
+
+  std::shared_ptr<const std::vector<Token>> shared_; ///< Owned token stream
+  const std::vector<Token> *tokens_; ///< Token stream being parsed
   size_t current_;                   ///< Current position in token stream
+  size_t end_;                       ///< One past the last token to parse
+  Token endToken_;                   ///< Returned at and past end_
+  bool lazyBodies_ = false;          ///< Pre-parse function bodies
+  size_t depth_ = 0;                 ///< Nesting of the node being parsed
+
+  /**
+   * Counts levels of nesting while in scope, so that no AST deeper than
+   * MAX_NESTING_DEPTH reaches the recursive passes after the parser
+   */
+  class Nesting {
+  public:
+    explicit Nesting(Parser &parser) : parser_(parser) {}
+    ~Nesting() { parser_.depth_ -= levels_; }
+    Nesting(const Nesting &) = delete;
+    Nesting &operator=(const Nesting &) = delete;
+
+    /**
+     * Count one more level.
+     *
+     * @throws ParserError past MAX_NESTING_DEPTH
+     */
+    void enter();
+
+  private:
+    Parser &parser_;
+    size_t levels_ = 0;
+  };
 
   /**
    * Get the current token without consuming it.
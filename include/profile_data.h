@@ -0,0 +1,103 @@
+#ifndef COMPILER_PROFILE_DATA_H
+#define COMPILER_PROFILE_DATA_H
+
+#include "codegen.h"
+#include "profiler.h"
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * How often a source `if` condition held
+ */
+struct BranchProfile {
+  uint64_t taken = 0; // Evaluations where the condition held
+  uint64_t total = 0; // All evaluations
+
+  double takenRatio() const {
+    return total ? static_cast<double>(taken) / total : 0.0;
+  }
+};
+
+/**
+ * How often a source loop was entered and how many times its body ran
+ */
+struct LoopProfile {
+  uint64_t entries = 0;
+  uint64_t iterations = 0;
+
+  double averageTrips() const {
+    return entries ? static_cast<double>(iterations) / entries : 0.0;
+  }
+};
+
+/**
+ * Execution counts saved by `--profile-out` and read back by `--profile-use`.
+ *
+ * Counts are filed under function names and source lines rather than
+ * bytecode offsets, so a profile stays valid when the optimizer lays the
+ * code out differently. Top-level code is the function "<main>". Several
+ * branches on one line share a record. The file is JSON:
+ *
+ *   {"version": 1,
+ *    "functions": {"fib": {"calls": 21891}},
+ *    "branches": [{"function": "fib", "line": 2, "taken": 10946,
+ *                  "total": 21891}],
+ *    "loops": [{"function": "<main>", "line": 7, "entries": 1,
+ *               "iterations": 100}]}
+ */
+class ProfileData {
+public:
+  /**
+   * Name used for top-level code
+   */
+  static constexpr const char *kMainFunction = "<main>";
+
+  /**
+   * Gather the counts a Profiler recorded while running a program
+   */
+  static ProfileData collect(const BytecodeProgram &program,
+                             const Profiler &profiler);
+
+  /**
+   * Read a profile written by save()
+   * @throws CompilerError if the file is missing or malformed
+   */
+  static ProfileData load(const std::string &path);
+  static ProfileData fromJson(const std::string &json);
+
+  /**
+   * @throws CompilerError if the file cannot be written
+   */
+  void save(const std::string &path) const;
+  std::string toJson() const;
+
+  /**
+   * Calls to a function, or -1 if the profile has no record of it
+   */
+  int64_t callCount(const std::string &fn) const;
+
+  /**
+   * Records for the statement at a line of a function ("" for top-level
+   * code), or nullptr if there is none
+   */
+  const BranchProfile *branch(const std::string &fn, int line) const;
+  const LoopProfile *loop(const std::string &fn, int line) const;
+
+  bool empty() const {
+    return calls_.empty() && branches_.empty() && loops_.empty();
+  }
+
+private:
+  using Site = std::pair<std::string, int>; // Function and line
+
+  std::map<std::string, uint64_t> calls_;
+  std::map<Site, BranchProfile> branches_;
+  std::map<Site, LoopProfile> loops_;
+
+  static std::string functionKey(const std::string &fn) {
+    return fn.empty() ? kMainFunction : fn;
+  }
+};
+
+#endif // COMPILER_PROFILE_DATA_H
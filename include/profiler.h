@@ -23,6 +23,20 @@ public:
     totalInstructions_++;
   }
 
+  /**
+   * Called by VM for a conditional jump (jumped or fell through) and for a
+   * JUMP (always jumps)
+   */
+  void onBranch(uint16_t ip, bool jumped) {
+    BranchCounts &counts = branchCounts_[ip];
+    ++(jumped ? counts.jumped : counts.fellThrough);
+  }
+
+  /**
+   * Called by VM on each CALL, including calls answered from a memo table
+   */
+  void onCall(uint16_t funcIndex) { callCounts_[funcIndex]++; }
+
   /**
    * Start timing
    */
@@ -55,6 +69,27 @@ public:
     return it != opcodeCounts_.end() ? it->second : 0;
   }
 
+  struct BranchCounts {
+    uint64_t jumped = 0;
+    uint64_t fellThrough = 0;
+  };
+
+  /**
+   * Counts for the branch at an instruction (zero if it never ran)
+   */
+  BranchCounts getBranchCounts(uint16_t ip) const {
+    auto it = branchCounts_.find(ip);
+    return it != branchCounts_.end() ? it->second : BranchCounts{};
+  }
+
+  /**
+   * Number of calls to a function (by index in the function table)
+   */
+  uint64_t getCallCount(uint16_t funcIndex) const {
+    auto it = callCounts_.find(funcIndex);
+    return it != callCounts_.end() ? it->second : 0;
+  }
+
   /**
    * Print statistics to output stream
    */
@@ -76,10 +111,14 @@ public:
   void reset() {
     opcodeCounts_.clear();
     totalInstructions_ = 0;
+    branchCounts_.clear();
+    callCounts_.clear();
   }
 
 private:
   std::unordered_map<uint8_t, uint64_t> opcodeCounts_;
+  std::unordered_map<uint16_t, BranchCounts> branchCounts_;
+  std::unordered_map<uint16_t, uint64_t> callCounts_;
   uint64_t totalInstructions_ = 0;
   std::chrono::high_resolution_clock::time_point startTime_;
   std::chrono::high_resolution_clock::time_point endTime_;
@@ -0,0 +1,60 @@
+#ifndef COMPILER_REPL_SESSION_H
+#define COMPILER_REPL_SESSION_H
+
+#include "codegen.h"
+#include "common.h"
+#include "snapshot.h"
+#include "vm.h"
+#include <iostream>
+#include <string>
+
+/**
+ * Persistent REPL state: one growing program and the VM that runs it.
+ *
+ * Each eval() optimizes the new input on its own, appends its functions
+ * and top-level code to the session's program (see CodeGenerator::append)
+ * and runs only the new top-level code, with the globals earlier input
+ * left behind. Functions defined earlier stay callable and keep their
+ * compiled bodies; nothing is recompiled or re-run.
+ */
+class ReplSession {
+public:
+  ReplSession() = default;
+
+  /**
+   * Continue from a snapshot, as if its input had just been evaluated here
+   */
+  explicit ReplSession(const Snapshot &snapshot);
+
+  /**
+   * Optimize each input before appending it. Enabled by default; unused
+   * functions are kept since later input may call them.
+   */
+  void setOptimize(bool enabled) { optimize_ = enabled; }
+
+  void setOutputStream(std::ostream &os) { vm_.setOutputStream(os); }
+
+  /**
+   * Compile and run more input
+   * @return Value of a top-level return, or void
+   * @throws CompilerError; a compile error leaves the session unchanged, a
+   * runtime error keeps what the input did before it
+   */
+  Value eval(const std::string &source);
+
+  /**
+   * Image of the program and globals so far (see Snapshot)
+   */
+  Snapshot snapshot() const;
+
+  const BytecodeProgram &program() const { return program_; }
+  VirtualMachine &vm() { return vm_; }
+
+private:
+  bool optimize_ = true;
+  CodeGenerator codegen_;
+  BytecodeProgram program_;
+  VirtualMachine vm_;
+};
+
+#endif // COMPILER_REPL_SESSION_H
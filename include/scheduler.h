@@ -0,0 +1,119 @@
+#ifndef COMPILER_SCHEDULER_H
+#define COMPILER_SCHEDULER_H
+
+#include "codegen.h"
+#include "common.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ExecutionContext;
+
+/**
+ * Green threads: runs many programs on a fixed set of OS threads.
+ *
+ * Every job runs in an ExecutionContext of its own. A thread takes the job that
+ * is furthest behind, resumes it for one slice of safepoints and puts it
+ * back, so no job can hold a thread for longer than a slice. Priorities
+ * are weights (stride scheduling): a job with priority 3 gets three slices
+ * for each slice of a priority 1 job, and jobs of equal priority take turns.
+ */
+class Scheduler {
+public:
+  using JobId = uint64_t;
+
+  static constexpr uint64_t kDefaultSlice = 1000;
+
+  /**
+   * How a job ended
+   */
+  struct Result {
+    Value value;        // Value of main (or 0)
+    std::string output; // Everything the job printed
+    std::string error;  // Message of the error that ended it, if any
+    uint64_t slices = 0;
+  };
+
+  /**
+   * @param threads OS threads (0 = one per hardware thread)
+   * @param slice Safepoints a job runs before it yields its thread
+   */
+  explicit Scheduler(size_t threads, uint64_t slice = kDefaultSlice);
+
+  /**
+   * Stop the threads; jobs that have not ended are dropped
+   */
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  /**
+   * Queue a program; it is shared read-only, so one program can back any
+   * number of jobs
+   * @param priority Weight of the job, at least 1
+   * @throws VMError if the program cannot be shared (see ExecutionContext)
+   */
+  JobId submit(std::shared_ptr<const BytecodeProgram> program,
+               uint32_t priority = 1);
+
+  /**
+   * Wait for a job to end and take its result
+   * @throws std::out_of_range for unknown or already collected jobs
+   */
+  Result wait(JobId id);
+
+  /**
+   * Jobs that have not ended yet
+   */
+  size_t pending() const;
+
+private:
+  struct Job {
+    std::unique_ptr<ExecutionContext> context;
+    uint64_t stride = 0;
+    uint64_t pass = 0; // Virtual time the job has used
+    bool done = false;
+    Result result;
+  };
+
+  // Ready jobs, least virtual time first, then in order of arrival
+  struct Entry {
+    uint64_t pass;
+    uint64_t order;
+    Job *job;
+    bool operator>(const Entry &other) const {
+      return pass != other.pass ? pass > other.pass : order > other.order;
+    }
+  };
+
+  uint64_t slice_;
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable done_;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue_;
+  std::unordered_map<JobId, std::unique_ptr<Job>> jobs_;
+  JobId nextId_ = 0;
+  uint64_t order_ = 0;   // Tie-breaker that keeps equal jobs round-robin
+  uint64_t now_ = 0;     // Pass of the last job taken off the queue
+  size_t pending_ = 0;
+  bool stopping_ = false;
+
+  void threadLoop();
+
+  /**
+   * Resume a job for one slice
+   * @return true once the job has ended
+   */
+  bool runSlice(Job &job);
+};
+
+#endif // COMPILER_SCHEDULER_H
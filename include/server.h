@@ -0,0 +1,148 @@
+#ifndef COMPILER_SERVER_H
+#define COMPILER_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Settings of a Server
+ */
+struct ServerOptions {
+  std::string socketPath;
+  size_t workers = 0;   // Threads running requests (0 = one per core)
+  size_t maxQueue = 64; // Requests waiting for a worker before shedding
+  size_t maxRequestBytes = 1 << 20;
+  uint32_t frameTimeoutMs = 5000; // From a frame's first byte to its last
+  uint32_t writeTimeoutMs = 5000; // For a client to read its response
+  // Cap for every request (0 = none); without one a few endless loops
+  // would hold every worker
+  uint64_t instructionLimit = 50000000;
+  // Output cap for every request (0 = none), which bounds each response
+  size_t maxOutput = 1 << 20;
+};
+
+/**
+ * Long-running compile-and-run service on a Unix domain socket
+ * (`compiler --serve=/path.sock`).
+ *
+ * Frames are a 4-byte big-endian length followed by that many bytes, and a
+ * connection may carry any number of requests, one at a time. A request is
+ * `key=value` lines, an empty line, then the source:
+ *
+ *     optimize=1  jit=0  memoize=0  profile=0      (flags, default shown)
+ *     instruction_limit=N  max_output=N             (limits, 0 = none)
+ *
+ * A request's instruction_limit and max_output can only lower the server's
+ * own caps (ServerOptions::instructionLimit and maxOutput).
+ *
+ * The response has the same shape: `status=ok|error|overloaded|bad_request`,
+ * `error=...` (one line), timings `queue_us`, `compile_us`, `execute_us`,
+ * `total_us`, then `instructions` once the program ran and `truncated=1`
+ * on an error response whose run stopped at max_output (the output is then
+ * what fit), an empty line, and the program's output.
+ *
+ * One I/O thread accepts connections and reads whatever idle ones have sent
+ * without blocking, buffering each connection's partial frame; a client
+ * that has not finished a frame frameTimeoutMs after its first byte is
+ * disconnected, so a slow sender cannot stall anyone else, and so is one
+ * that has not taken its whole response writeTimeoutMs after a worker
+ * started writing it. A fixed pool of workers compiles and runs complete
+ * requests through the C API. When
+ * maxQueue requests are already waiting, new ones are answered with
+ * `status=overloaded` at once instead of queueing (load shedding).
+ */
+class Server {
+public:
+  explicit Server(ServerOptions options);
+  ~Server();
+
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  /**
+   * Listen on the socket and serve until stop()
+   * @throws std::runtime_error if the socket cannot be set up
+   */
+  void run();
+
+  /**
+   * Make run() return; safe from any thread and from signal handlers
+   */
+  void stop();
+
+  uint64_t served() const { return served_; }
+  uint64_t shed() const { return shed_; }
+
+  /**
+   * Requests waiting for a worker
+   */
+  size_t queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Task {
+    int fd;
+    std::string request;
+    Clock::time_point queued;
+  };
+
+  // Open connection, owned by the I/O thread
+  struct Connection {
+    std::string buffer;        // Received bytes not yet taken as requests
+    Clock::time_point started; // When the buffer's first byte arrived
+    bool busy = false;         // A worker has its current request
+  };
+
+  ServerOptions options_;
+  int listenFd_ = -1;
+  int wakeFds_[2] = {-1, -1}; // Self-pipe that interrupts poll()
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> served_{0};
+  std::atomic<uint64_t> shed_{0};
+
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Task> queue_;
+  std::vector<int> returned_; // Connections workers are done with
+  std::vector<int> failed_;   // Connections workers could not answer
+  std::vector<std::thread> workers_;
+  std::unordered_map<int, Connection> connections_;
+
+  void workerLoop();
+
+  /**
+   * Read what a readable connection has sent so far, without blocking
+   * @return false if the connection should be closed
+   */
+  bool receive(int fd, Connection &connection);
+
+  /**
+   * Queue or shed the complete requests buffered for an idle connection,
+   * stopping once one is queued
+   * @return false if the connection should be closed
+   */
+  bool dispatch(int fd, Connection &connection);
+
+  /**
+   * Compile and run one request
+   * @return The response payload
+   */
+  std::string process(const Task &task) const;
+
+  void wake();
+};
+
+#endif // COMPILER_SERVER_H
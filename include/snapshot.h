@@ -0,0 +1,57 @@
+#ifndef COMPILER_SNAPSHOT_H
+#define COMPILER_SNAPSHOT_H
+
+#include "codegen.h"
+#include "common.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Image of a REPL session after a prelude ran: its program (code,
+ * constants, functions and tables), the names of its globals and their
+ * values, including strings and arrays. Restoring one
+ * (ReplSession(snapshot), or `--snapshot=file`) skips re-running the
+ * prelude; later input sees its functions and globals as if it had just
+ * run.
+ *
+ * Values are deep copies: arrays that globals share stay shared within
+ * the image and within each restore, but never between a session and its
+ * snapshot or between two restores.
+ *
+ * The binary form is little-endian: the magic "BCSNAP", a version, the
+ * program, the global names, then a table of every array (elements refer
+ * to other arrays by index, so sharing and cycles survive) and the global
+ * values.
+ */
+class Snapshot {
+public:
+  BytecodeProgram program;
+  std::unordered_map<std::string, uint16_t> globals; // Name -> main slot
+  std::vector<Value> values;                         // Main's slots
+
+  /**
+   * Copy values, giving arrays fresh storage but keeping shared arrays
+   * shared among the copies
+   */
+  static std::vector<Value> deepCopy(const std::vector<Value> &values);
+
+  /**
+   * Read an image written by save(). Besides the framing, every operand,
+   * jump target, entry and table target of the program is checked, since
+   * the VM indexes them without bounds checks.
+   * @throws CompilerError ("Invalid snapshot: ...") if the file is missing
+   * or malformed
+   */
+  static Snapshot load(const std::string &path);
+  static Snapshot fromBinary(const std::string &data);
+
+  /**
+   * @throws CompilerError if the file cannot be written
+   */
+  void save(const std::string &path) const;
+  std::string toBinary() const;
+};
+
+#endif // COMPILER_SNAPSHOT_H
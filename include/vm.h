@@ -3,8 +3,13 @@
 
 #include "codegen.h"
 #include "common.h"
+#include "jit.h"
+#include "worker_pool.h"
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 // Forward declaration
@@ -17,6 +22,7 @@ struct CallFrame {
   uint16_t ip;          // Instruction pointer (return address)
   uint16_t basePointer; // Base of local variables in stack
   uint16_t funcIndex;   // Index into functions array
+  bool memoize = false; // Store the result in the callee's memo table
 };
 
 /**
@@ -37,6 +43,43 @@ public:
   Value execute(const BytecodeProgram &program, Profiler *profiler = nullptr,
                 bool keepState = false);
 
+  /**
+   * Prepare to run a program in slices with resume(); the program must
+   * outlive the run. Sliced runs skip the JIT and run parallel loops
+   * serially, so that every loop passes safepoints.
+   */
+  void start(const BytecodeProgram &program);
+
+  /**
+   * Continue the started program until it ends or has passed `safepoints`
+   * safepoints (backward jumps and calls), where it stops so that it can be
+   * resumed later with its stack, frames and locals intact
+   * @return true once the program has ended; its value is then in result()
+   * @throws VMError if the program fails, which also ends it
+   */
+  bool resume(uint64_t safepoints);
+
+  /**
+   * Whether a started program is waiting to be resumed
+   */
+  bool isSuspended() const { return suspended_ != nullptr; }
+
+  /**
+   * Value of the last program that ended under resume()
+   */
+  const Value &result() const { return result_; }
+
+  /**
+   * Main's first `count` slots, e.g. the globals left by a run with
+   * keepState (arrays are shared, not copied)
+   */
+  std::vector<Value> getLocals(size_t count) const;
+
+  /**
+   * Give main's first slots these values for the next run with keepState
+   */
+  void setLocals(const std::vector<Value> &values);
+
   /**
    * Set output stream for PRINT (defaults to std::cout)
    */
@@ -47,12 +90,175 @@ public:
    */
   const std::vector<Value> &getOutput() const { return outputValues_; }
 
+  /**
+   * Attach a compiler for functions still at LAZY_FUNCTION_ENTRY. The
+   * program passed to execute() must be the compiler's own program.
+   */
+  void setLazyCompiler(LazyFunctionCompiler *compiler) { lazy_ = compiler; }
+
+  /**
+   * Stop each run with VMError("Instruction limit exceeded") once it has
+   * executed this many instructions (0, the default, means no limit).
+   * Counting is a decrement in the dispatch loop, so the JIT and parallel
+   * loops stay on: a trace iteration counts as the instructions it was
+   * recorded from, and the workers of a parallel for each get the remaining
+   * budget, with what they spent charged when the loop ends.
+   */
+  void setInstructionLimit(uint64_t limit) { instructionLimit_ = limit; }
+
+  /**
+   * Instructions executed by the current or last run, workers included
+   */
+  uint64_t getInstructionCount() const { return budgetStart_ - budget_; }
+
+  /**
+   * Stop each run with VMError("Output limit exceeded") once PRINT would
+   * write more than this many bytes (0, the default, means no limit). The
+   * part of the line that fits is still written; workers of a parallel for
+   * share the remaining allowance the same way as the instruction budget.
+   */
+  void setOutputLimit(size_t bytes) { outputLimit_ = bytes; }
+
+  /**
+   * Enable the tracing JIT for hot loops (off by default). Tracing is
+   * skipped while a profiler is attached so opcode counts stay exact.
+   */
+  void setJitEnabled(bool enabled);
+
+  /**
+   * Cache results of the named functions when every argument is an int
+   * (see EffectAnalysis for which functions are safe). Each function gets a
+   * direct-mapped table of MEMO_TABLE_SIZE entries; only int and string
+   * results are stored. An empty set turns memoization off.
+   */
+  void setMemoizedFunctions(std::unordered_set<std::string> names) {
+    memoized_ = std::move(names);
+  }
+
+  /**
+   * Calls answered from a memo table during the last execute()
+   */
+  uint64_t getMemoHits() const { return memoHits_; }
+
+  static constexpr size_t MEMO_TABLE_SIZE = 4096;
+
+  /**
+   * Threads for parallel for loops (0, the default, uses one per core).
+   * With one thread, or while profiling or compiling lazily, the loops run
+   * serially.
+   */
+  void setThreads(size_t threads) { threads_ = threads; }
+
+  // Parallel for chunks per thread
+  static constexpr size_t kChunksPerWorker = 4;
+
+  /**
+   * Get tracing JIT statistics (nullptr if the JIT is disabled)
+   */
+  const TraceJit::Stats *getJitStats() const {
+    return jit_ ? &jit_->getStats() : nullptr;
+  }
+
 private:
   std::vector<Value> stack_;          // Value stack
   std::vector<Value> locals_;         // Local variable storage
   std::vector<CallFrame> callStack_;  // Call frames for function calls
   std::ostream *output_ = &std::cout; // Output stream
   std::vector<Value> outputValues_;   // Captured output values
+  std::unique_ptr<TraceJit> jit_;     // Tracing tier (nullptr = disabled)
+  LazyFunctionCompiler *lazy_ = nullptr; // Compiles stubs on first CALL
+
+  // Memoization
+  struct MemoEntry {
+    std::vector<int32_t> args;
+    Value result;
+    bool used = false;
+  };
+  std::unordered_set<std::string> memoized_;   // Functions to memoize
+  std::vector<std::vector<MemoEntry>> memo_;   // Tables by function index
+  std::vector<std::vector<int32_t>> memoArgs_; // Arguments of open calls
+  uint64_t memoHits_ = 0;
+
+  // Parallel loops: workers are VMs of their own, kept for reuse
+  size_t threads_ = 0;
+  std::unique_ptr<WorkerPool> pool_;
+  std::vector<std::unique_ptr<VirtualMachine>> workers_;
+  int32_t workerLoop_ = -1; // Loop whose chunks this worker runs, or -1
+  size_t workerDepth_ = 0;  // Call depth of that loop's body
+
+  // Sliced runs: where a suspended program continues
+  const BytecodeProgram *suspended_ = nullptr;
+  uint16_t resumeIp_ = 0;
+  uint16_t resumeBase_ = 0;
+  uint64_t safepoints_ = UINT64_MAX; // Left in this slice
+  bool yielded_ = false;
+  Value result_;
+
+  // Instruction limit: budget_ counts down from budgetStart_ in run()
+  uint64_t instructionLimit_ = 0;
+  uint64_t budget_ = UINT64_MAX;
+  uint64_t budgetStart_ = UINT64_MAX;
+
+  // Output limit: bytes PRINT may still write in this run
+  size_t outputLimit_ = 0;
+  size_t outputLeft_ = SIZE_MAX;
+
+  /**
+   * Write text to the output, or the part that fits and throw if it goes
+   * over the output limit
+   */
+  void writeOutput(const std::string &text);
+
+  /**
+   * Clear the stack, frames, output and memo tables (and locals unless
+   * keepState) for a new run
+   */
+  void reset(const BytecodeProgram &program, bool keepState);
+
+  /**
+   * Save where run() stopped and leave it
+   */
+  Value suspend(uint16_t ip, uint16_t basePointer);
+
+  /**
+   * Run from ip until the program ends, main returns, a sliced run reaches
+   * its last safepoint or, in a worker, the chunk ends
+   */
+  Value run(const BytecodeProgram &program, uint16_t ip, uint16_t basePointer,
+            Profiler *profiler, TraceJit *jit);
+
+  size_t threadCount() const;
+
+  /**
+   * Run a parallel for whose range is not empty on the worker pool, then
+   * print the workers' output and combine their reductions in order
+   */
+  void runParallel(const BytecodeProgram &program, uint16_t loopIndex,
+                   uint16_t basePointer);
+
+  /**
+   * Prepare a worker with a copy of the parent's frame
+   */
+  void beginWorker(const VirtualMachine &parent,
+                   const BytecodeProgram &program, uint16_t basePointer,
+                   uint16_t frameSize, uint16_t loopIndex);
+
+  /**
+   * Run iterations [from, to) of a loop and return the worker's part of
+   * each reduction
+   */
+  std::vector<Value> runChunk(const BytecodeProgram &program,
+                              const ParallelLoop &loop,
+                              const std::vector<Value> &initial, int32_t from,
+                              int32_t to, std::ostream &output);
+
+  /**
+   * Table entry for a call whose arguments are on top of the stack, or
+   * nullptr if the function is not memoized or an argument is not an int.
+   * On success the arguments are pushed onto memoArgs_.
+   */
+  MemoEntry *findMemoEntry(const BytecodeProgram &program, uint16_t funcIndex);
+  static size_t memoSlot(const std::vector<int32_t> &args);
 
   // Stack operations
   void push(Value value);
@@ -62,6 +268,15 @@ private:
   // Helper
   void printValue(const Value &value, std::ostream &os) const;
 
+  /**
+   * Print value whose enclosing arrays are `open`.
+   *
+   * @throws VMError if an array contains itself or is nested deeper than
+   *         MAX_NESTING_DEPTH
+   */
+  void printValue(const Value &value, std::ostream &os,
+                  std::vector<const std::vector<Value> *> &open) const;
+
   // Validation
   void checkStackOverflow() const;
   void checkStackUnderflow() const;
@@ -0,0 +1,54 @@
+#ifndef COMPILER_WORKER_POOL_H
+#define COMPILER_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads that run one job at a time.
+ *
+ * run() hands the same task to every worker, numbered 0..size()-1, and
+ * returns once all of them are done; the calling thread is worker 0. Tasks
+ * split the work among themselves (the VM claims chunks of a parallel for
+ * from a shared counter). The threads stay parked between jobs.
+ */
+class WorkerPool {
+public:
+  /**
+   * @param size Workers including the caller (at least 1)
+   */
+  explicit WorkerPool(size_t size);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  size_t size() const { return threads_.size() + 1; }
+
+  /**
+   * Run task(worker) on every worker and wait for all of them
+   * @throws the first exception a task threw
+   */
+  void run(const std::function<void(size_t)> &task);
+
+private:
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(size_t)> *task_ = nullptr;
+  size_t generation_ = 0; // Jobs started so far
+  size_t running_ = 0;    // Threads still busy with the current job
+  bool stopping_ = false;
+  std::exception_ptr error_;
+
+  void workerLoop(size_t worker);
+  void perform(size_t worker);
+};
+
+#endif // COMPILER_WORKER_POOL_H
@@ -0,0 +1,221 @@
+// N-API addon: compiles and runs programs in-process through the
+// bytecode_core C API, on libuv worker threads so the event loop stays free.
+//
+//   const { run } = require('./build/Release/bytecode.node');
+//   const result = await run(code, { jit: true, profile: true });
+//   // { success, output, error, stats: { compileMs, executeMs, ... } }
+
+#include "bytecode_api.h"
+#include <node_api.h>
+#include <string>
+
+namespace {
+
+// Everything one call carries from the JS thread to the worker and back
+struct RunJob {
+  std::string source;
+  bc_compile_options compileOptions;
+  bc_exec_options execOptions;
+
+  // Filled in on the worker thread
+  bool compiled = false;
+  bool failed = false;
+  std::string output;
+  std::string error;
+  bool truncated = false; // Failed at maxOutput; output is what fit
+  bc_stats stats{};
+
+  napi_deferred deferred = nullptr;
+  napi_async_work work = nullptr;
+};
+
+bool getProperty(napi_env env, napi_value object, const char *name,
+                 napi_value *value) {
+  bool has = false;
+  if (napi_has_named_property(env, object, name, &has) != napi_ok || !has) {
+    return false;
+  }
+  napi_valuetype type;
+  napi_get_named_property(env, object, name, value);
+  napi_typeof(env, *value, &type);
+  return type != napi_undefined && type != napi_null;
+}
+
+bool getBool(napi_env env, napi_value object, const char *name,
+             bool fallback) {
+  napi_value value;
+  bool result = fallback;
+  if (getProperty(env, object, name, &value)) {
+    napi_coerce_to_bool(env, value, &value);
+    napi_get_value_bool(env, value, &result);
+  }
+  return result;
+}
+
+double getNumber(napi_env env, napi_value object, const char *name,
+                 double fallback) {
+  napi_value value;
+  double result = fallback;
+  if (getProperty(env, object, name, &value)) {
+    napi_get_value_double(env, value, &result);
+  }
+  return result < 0 ? fallback : result;
+}
+
+void setString(napi_env env, napi_value object, const char *name,
+               const std::string &text) {
+  napi_value value;
+  napi_create_string_utf8(env, text.data(), text.size(), &value);
+  napi_set_named_property(env, object, name, value);
+}
+
+void setNumber(napi_env env, napi_value object, const char *name,
+               double number) {
+  napi_value value;
+  napi_create_double(env, number, &value);
+  napi_set_named_property(env, object, name, value);
+}
+
+void setBool(napi_env env, napi_value object, const char *name, bool flag) {
+  napi_value value;
+  napi_get_boolean(env, flag, &value);
+  napi_set_named_property(env, object, name, value);
+}
+
+// Worker thread: no JS values may be touched here
+void execute(napi_env, void *data) {
+  auto *job = static_cast<RunJob *>(data);
+  bc_program *program =
+      bc_compile(job->source.data(), job->source.size(), &job->compileOptions);
+  if (!program) {
+    job->failed = true;
+    job->error = "Out of memory";
+    return;
+  }
+  job->stats.compile_ms = bc_program_compile_ms(program);
+  if (const char *error = bc_program_error(program)) {
+    job->failed = true;
+    job->error = error;
+    bc_program_free(program);
+    return;
+  }
+  job->compiled = true;
+
+  bc_run *run = bc_execute(program, &job->execOptions);
+  if (!run) {
+    job->failed = true;
+    job->error = "Out of memory";
+  } else {
+    size_t length = 0;
+    const char *output = bc_run_output(run, &length);
+    job->output.assign(output, length);
+    if (const char *error = bc_run_error(run)) {
+      job->failed = true;
+      job->error = error;
+      job->truncated = job->error.find("Output limit exceeded") !=
+                       std::string::npos;
+    }
+    bc_run_stats(run, &job->stats);
+    bc_run_free(run);
+  }
+  bc_program_free(program);
+}
+
+// JS thread: turn the finished job into the result object
+void complete(napi_env env, napi_status, void *data) {
+  auto *job = static_cast<RunJob *>(data);
+
+  napi_value result;
+  napi_create_object(env, &result);
+  setBool(env, result, "success", !job->failed);
+  setBool(env, result, "compiled", job->compiled);
+  setString(env, result, "output", job->output);
+  if (job->failed) {
+    setString(env, result, "error", job->error);
+  }
+  if (job->truncated) {
+    setBool(env, result, "truncated", true);
+  }
+
+  napi_value stats;
+  napi_create_object(env, &stats);
+  setNumber(env, stats, "compileMs", job->stats.compile_ms);
+  setNumber(env, stats, "executeMs", job->stats.execute_ms);
+  setNumber(env, stats, "instructions",
+            static_cast<double>(job->stats.instructions));
+  setNumber(env, stats, "calls", static_cast<double>(job->stats.calls));
+  setNumber(env, stats, "memoHits", static_cast<double>(job->stats.memo_hits));
+  napi_set_named_property(env, result, "stats", stats);
+
+  napi_resolve_deferred(env, job->deferred, result);
+  napi_delete_async_work(env, job->work);
+  delete job;
+}
+
+// run(code, options?) -> Promise<result>
+napi_value run(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+
+  napi_valuetype type = napi_undefined;
+  if (argc >= 1) {
+    napi_typeof(env, argv[0], &type);
+  }
+  if (type != napi_string) {
+    napi_throw_type_error(env, nullptr, "run(code, options): code must be "
+                                        "a string");
+    return nullptr;
+  }
+
+  auto *job = new RunJob();
+  size_t length = 0;
+  napi_get_value_string_utf8(env, argv[0], nullptr, 0, &length);
+  job->source.resize(length + 1);
+  napi_get_value_string_utf8(env, argv[0], &job->source[0], length + 1,
+                             &length);
+  job->source.resize(length);
+
+  bc_compile_options_init(&job->compileOptions);
+  bc_exec_options_init(&job->execOptions);
+  bc_stats_init(&job->stats);
+  // Requests already run on the libuv pool; loops stay on their thread
+  job->execOptions.threads = 1;
+  napi_valuetype optionsType = napi_undefined;
+  if (argc >= 2) {
+    napi_typeof(env, argv[1], &optionsType);
+  }
+  if (optionsType == napi_object) {
+    napi_value options = argv[1];
+    job->compileOptions.optimize = getBool(env, options, "optimize", true);
+    job->execOptions.jit = getBool(env, options, "jit", false);
+    job->execOptions.memoize = getBool(env, options, "memoize", false);
+    job->execOptions.profile = getBool(env, options, "profile", false);
+    job->execOptions.threads =
+        static_cast<uint32_t>(getNumber(env, options, "threads", 1));
+    job->execOptions.instruction_limit =
+        static_cast<uint64_t>(getNumber(env, options, "instructionLimit", 0));
+    job->execOptions.max_output =
+        static_cast<uint64_t>(getNumber(env, options, "maxOutput", 0));
+  }
+
+  napi_value promise;
+  napi_create_promise(env, &job->deferred, &promise);
+  napi_value name;
+  napi_create_string_utf8(env, "bytecode.run", NAPI_AUTO_LENGTH, &name);
+  napi_create_async_work(env, nullptr, name, execute, complete, job,
+                         &job->work);
+  napi_queue_async_work(env, job->work);
+  return promise;
+}
+
+napi_value init(napi_env env, napi_value exports) {
+  napi_value fn;
+  napi_create_function(env, "run", NAPI_AUTO_LENGTH, run, nullptr, &fn);
+  napi_set_named_property(env, exports, "run", fn);
+  return exports;
+}
+
+} // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -1,8 +1,6 @@
 const express = require('express');
 const cors = require('cors');
 const bodyParser = require('body-parser');
-const { exec } = require('child_process');
-const fs = require('fs');
 const path = require('path');
 
 const app = express();
@@ -13,28 +11,25 @@ app.use(cors());
 app.use(bodyParser.json({ limit: '1mb' }));
 
 // Configuration
-const COMPILER_PATH = path.join(__dirname, '..', 'build', 'compiler');
-const TEMP_DIR = '/tmp/compiler';
-const TIMEOUT = 5000; // 5 seconds
+const ADDON_PATH = path.join(__dirname, 'build', 'Release', 'bytecode.node');
+const INSTRUCTION_LIMIT = Number(process.env.INSTRUCTION_LIMIT) || 50000000;
 const MAX_OUTPUT = 10000; // 10KB
 
-// Create temp directory
-if (!fs.existsSync(TEMP_DIR)) {
-    fs.mkdirSync(TEMP_DIR, { recursive: true });
-}
+// Compiler and VM in-process (npm install builds it, see binding.gyp)
+const bytecode = require(ADDON_PATH);
 
 // Health check
 app.get('/api/health', (req, res) => {
     res.json({
         status: 'ok',
         timestamp: new Date().toISOString(),
-        compiler: fs.existsSync(COMPILER_PATH) ? 'available' : 'missing'
+        compiler: 'in-process'
     });
 });
 
 // Compile and execute code
 app.post('/api/compile', async (req, res) => {
-    const { code } = req.body;
+    const { code, options = {} } = req.body;
 
     if (!code || typeof code !== 'string') {
         return res.status(400).json({
@@ -50,63 +45,44 @@ app.post('/api/compile', async (req, res) => {
         });
     }
 
-    const timestamp = Date.now();
-    const tempFile = path.join(TEMP_DIR, `code_${timestamp}.src`);
-
+    const started = Date.now();
     try {
-        // Write code to temp file
-        fs.writeFileSync(tempFile, code, 'utf8');
-
-        // Execute compiler with timeout
-        const child = exec(
-            `${COMPILER_PATH} ${tempFile}`,
-            {
-                timeout: TIMEOUT,
-                maxBuffer: MAX_OUTPUT
-            },
-            (error, stdout, stderr) => {
-                // Clean up temp file
-                try {
-                    fs.unlinkSync(tempFile);
-                } catch (e) {
-                    console.error('Failed to delete temp file:', e);
-                }
-
-                if (error) {
-                    // Check if timeout
-                    if (error.killed) {
-                        return res.json({
-                            success: false,
-                            error: 'Execution timeout (max 5 seconds)',
-                            timeout: true
-                        });
-                    }
-
-                    // Compilation or runtime error
-                    return res.json({
-                        success: false,
-                        error: stderr || error.message,
-                        exitCode: error.code
-                    });
-                }
+        // Runs in-process on a libuv worker thread; both limits are enforced
+        // inside the VM, so the JIT stays available under them
+        const result = await bytecode.run(code, {
+            optimize: options.optimize !== false,
+            jit: options.jit === true,
+            memoize: options.memoize === true,
+            profile: options.profile === true,
+            instructionLimit: INSTRUCTION_LIMIT,
+            maxOutput: MAX_OUTPUT
+        });
 
-                // Success
-                res.json({
-                    success: true,
-                    output: stdout,
-                    executionTime: Date.now() - timestamp
-                });
+        if (!result.success) {
+            const limited = /Instruction limit exceeded/.test(result.error);
+            let error = result.error;
+            if (limited) {
+                error = `Execution limit exceeded (max ${INSTRUCTION_LIMIT} instructions)`;
+            } else if (result.truncated) {
+                error = `Output limit exceeded (max ${MAX_OUTPUT} bytes)`;
             }
-        );
-
+            return res.json({
+                success: false,
+                error,
+                output: result.output,
+                truncated: result.truncated === true,
+                timeout: limited,
+                stats: result.stats
+            });
+        }
+
+        res.json({
+            success: true,
+            output: result.output,
+            executionTime: Date.now() - started,
+            stats: result.stats
+        });
     } catch (error) {
-        // Clean up on exception
-        try {
-            if (fs.existsSync(tempFile)) {
-                fs.unlinkSync(tempFile);
-            }
-        } catch (e) { }
-
         res.status(500).json({
             success: false,
             error: 'Internal server error: ' + error.message
@@ -166,6 +142,5 @@ app.use((err, req, res, next) => {
 // Start server
 app.listen(PORT, () => {
     console.log(`ByteCode Compiler API running on port ${PORT}`);
-    console.log(`Compiler path: ${COMPILER_PATH}`);
-    console.log(`Compiler exists: ${fs.existsSync(COMPILER_PATH)}`);
+    console.log(`Compiler addon: ${ADDON_PATH}`);
 });
@@ -0,0 +1,16 @@
+{
+  "targets": [
+    {
+      "target_name": "bytecode",
+      "sources": ["addon/bytecode_addon.cc"],
+      "include_dirs": ["../include"],
+      "libraries": ["<(module_root_dir)/../build/libbytecode_core.a", "-lpthread"],
+      "cflags_cc": ["-std=c++17", "-fexceptions"],
+      "cflags_cc!": ["-fno-exceptions"],
+      "xcode_settings": {
+        "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+        "CLANG_CXX_LANGUAGE_STANDARD": "c++17"
+      }
+    }
+  ]
+}
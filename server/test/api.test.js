@@ -0,0 +1,64 @@
+// API-level tests: start api.js as its own process and talk to it over HTTP.
+// Programs run inside that process, so one that could fault the VM would
+// take every later request down with it.
+const { test, before, after } = require('node:test');
+const assert = require('node:assert');
+const { spawn } = require('child_process');
+const path = require('path');
+
+const PORT = 3900 + (process.pid % 100);
+const BASE = `http://127.0.0.1:${PORT}`;
+let server;
+
+before(async () => {
+    server = spawn(process.execPath, [path.join(__dirname, '..', 'api.js')], {
+        env: { ...process.env, PORT: String(PORT) },
+        stdio: ['ignore', 'pipe', 'inherit']
+    });
+    await new Promise((resolve, reject) => {
+        server.stdout.on('data', (chunk) => {
+            if (chunk.toString().includes('running on port')) {
+                resolve();
+            }
+        });
+        server.on('exit', (code) => reject(new Error(`api.js exited with ${code}`)));
+    });
+});
+
+after(() => {
+    server.kill();
+});
+
+async function compile(code) {
+    const response = await fetch(`${BASE}/api/compile`, {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/json' },
+        body: JSON.stringify({ code })
+    });
+    assert.strictEqual(response.status, 200);
+    return response.json();
+}
+
+test('arithmetic that traps in C++ does not stop the server', async () => {
+    // INT_MIN / -1 wraps like the other operators
+    const overflow = await compile(
+        'let a = 0 - 2147483647 - 1;\nlet b = 0 - 1;\nprint(a / b);\nprint(a % b);\n');
+    assert.strictEqual(overflow.success, true);
+    assert.strictEqual(overflow.output, '-2147483648\n0\n');
+
+    // Also when the optimizer evaluates the call at compile time
+    const folded = await compile(
+        'fn f(a, b) { return (0 - a - 1) / (0 - b); }\n' +
+        'let x = 0;\nif (x) { print(f(2147483647, 1)); }\nprint("ok");\n');
+    assert.strictEqual(folded.output, 'ok\n');
+
+    const zero = await compile('let z = 0;\nprint(1 / z);\n');
+    assert.strictEqual(zero.success, false);
+    assert.match(zero.error, /Division by zero/);
+
+    assert.strictEqual(server.exitCode, null);
+    const next = await compile('print(42);\n');
+    assert.strictEqual(next.output, '42\n');
+    const health = await fetch(`${BASE}/api/health`);
+    assert.strictEqual(health.status, 200);
+});
@@ -66,9 +66,27 @@ void FunctionDecl::accept(ASTVisitor &visitor) const {
   visitor.visitFunctionDecl(*this);
 }
 
+const std::vector<std::unique_ptr<Stmt>> &FunctionDecl::body() const {
+  if (bodyParser_) {
+    // Only drop the parser once it succeeded so errors repeat on retry
+    body_ = bodyParser_();
+    bodyParser_ = nullptr;
+  }
+  return body_;
+}
+
 void Program::accept(ASTVisitor &visitor) const { visitor.visitProgram(*this); }
 
 void ForStmt::accept(ASTVisitor &visitor) const { visitor.visitForStmt(*this); }
+void ForInStmt::accept(ASTVisitor &visitor) const {
+  visitor.visitForInStmt(*this);
+}
+void ParallelForStmt::accept(ASTVisitor &visitor) const {
+  visitor.visitParallelForStmt(*this);
+}
+void SwitchStmt::accept(ASTVisitor &visitor) const {
+  visitor.visitSwitchStmt(*this);
+}
 void BreakStmt::accept(ASTVisitor &visitor) const {
   visitor.visitBreakStmt(*this);
 }
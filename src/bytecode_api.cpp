@@ -0,0 +1,210 @@
+#include "bytecode_api.h"
+#include "codegen.h"
+#include "effects.h"
+#include "execution_context.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_set>
+
+struct bc_program {
+  std::shared_ptr<const BytecodeProgram> program;
+  std::unordered_set<std::string> pureFunctions; // For memoize
+  std::string error;
+  double compileMs = 0;
+};
+
+struct bc_run {
+  std::string output;
+  std::string error;
+  bool failed = false;
+  bc_stats stats{};
+};
+
+namespace {
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Sizes of the first published option structs; smaller ones are invalid
+constexpr size_t kCompileOptionsMinSize = sizeof(bc_compile_options);
+constexpr size_t kExecOptionsMinSize = sizeof(bc_exec_options);
+constexpr size_t kStatsMinSize = sizeof(bc_stats);
+
+/**
+ * Copy the fields a caller's options struct has over the defaults in
+ * resolved; fields added after the caller was built keep their defaults
+ * @return false if given has an invalid struct_size
+ */
+template <typename Options>
+bool resolveOptions(const Options *given, size_t minimumSize,
+                    Options &resolved) {
+  if (!given) {
+    return true;
+  }
+  if (given->struct_size < minimumSize) {
+    return false;
+  }
+  std::memcpy(&resolved, given, std::min(given->struct_size, sizeof(Options)));
+  resolved.struct_size = sizeof(Options);
+  return true;
+}
+} // namespace
+
+extern "C" {
+
+void bc_compile_options_init(bc_compile_options *options) {
+  options->struct_size = sizeof(bc_compile_options);
+  options->optimize = 1;
+}
+
+void bc_stats_init(bc_stats *stats) {
+  *stats = bc_stats{};
+  stats->struct_size = sizeof(bc_stats);
+}
+
+void bc_exec_options_init(bc_exec_options *options) {
+  options->struct_size = sizeof(bc_exec_options);
+  options->jit = 0;
+  options->memoize = 0;
+  options->profile = 0;
+  options->threads = 0;
+  options->instruction_limit = 0;
+  options->max_output = 0;
+}
+
+bc_program *bc_compile(const char *source, size_t length,
+                       const bc_compile_options *options) {
+  bc_compile_options resolved;
+  bc_compile_options_init(&resolved);
+  bool valid = resolveOptions(options, kCompileOptionsMinSize, resolved);
+  options = &resolved;
+
+  try {
+    auto handle = std::make_unique<bc_program>();
+    if (!valid) {
+      handle->error = "Invalid bc_compile_options struct_size; call "
+                      "bc_compile_options_init first";
+      return handle.release();
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+      Lexer lexer(std::string(source, length));
+      auto tokens = lexer.tokenize();
+      Parser parser(tokens);
+      auto program = parser.parseProgram();
+      if (options->optimize) {
+        Optimizer optimizer;
+        optimizer.run(*program);
+      }
+      handle->pureFunctions = EffectAnalysis(*program).pureFunctions();
+      CodeGenerator codegen;
+      handle->program =
+          std::make_shared<const BytecodeProgram>(codegen.generate(*program));
+    } catch (const std::bad_alloc &) {
+      throw;
+    } catch (const std::exception &e) {
+      handle->error = e.what();
+    }
+    handle->compileMs = millisecondsSince(start);
+    return handle.release();
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+const char *bc_program_error(const bc_program *program) {
+  return program->program ? nullptr : program->error.c_str();
+}
+
+double bc_program_compile_ms(const bc_program *program) {
+  return program->compileMs;
+}
+
+void bc_program_free(bc_program *program) { delete program; }
+
+bc_run *bc_execute(const bc_program *program,
+                   const bc_exec_options *options) {
+  if (!program || !program->program) {
+    return nullptr;
+  }
+  bc_exec_options resolved;
+  bc_exec_options_init(&resolved);
+  if (!resolveOptions(options, kExecOptionsMinSize, resolved)) {
+    return nullptr;
+  }
+  options = &resolved;
+
+  try {
+    auto run = std::make_unique<bc_run>();
+    ExecutionContext context(program->program);
+    VirtualMachine &vm = context.vm();
+    vm.setJitEnabled(options->jit != 0);
+    vm.setThreads(options->threads);
+    if (options->memoize) {
+      vm.setMemoizedFunctions(program->pureFunctions);
+    }
+
+    vm.setInstructionLimit(options->instruction_limit);
+    vm.setOutputLimit(static_cast<size_t>(options->max_output));
+    Profiler profiler;
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+      context.execute(options->profile ? &profiler : nullptr);
+    } catch (const std::bad_alloc &) {
+      throw;
+    } catch (const std::exception &e) {
+      run->failed = true;
+      run->error = e.what();
+    }
+    run->stats.execute_ms = millisecondsSince(start);
+    run->stats.compile_ms = program->compileMs;
+    run->stats.memo_hits = vm.getMemoHits();
+    run->stats.instructions = vm.getInstructionCount();
+    if (options->profile) {
+      for (size_t i = 0; i < program->program->functions.size(); ++i) {
+        run->stats.calls += profiler.getCallCount(static_cast<uint16_t>(i));
+      }
+    }
+    run->output = context.takeOutput();
+    return run.release();
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+const char *bc_run_output(const bc_run *run, size_t *length) {
+  if (length) {
+    *length = run->output.size();
+  }
+  return run->output.c_str();
+}
+
+const char *bc_run_error(const bc_run *run) {
+  return run->failed ? run->error.c_str() : nullptr;
+}
+
+void bc_run_stats(const bc_run *run, bc_stats *stats) {
+  // Fields added after the caller was built would write past its struct
+  size_t size = stats->struct_size;
+  if (size < kStatsMinSize) {
+    return;
+  }
+  bc_stats copy = run->stats;
+  copy.struct_size = size;
+  std::memcpy(stats, &copy, std::min(size, sizeof(bc_stats)));
+}
+
+void bc_run_free(bc_run *run) { delete run; }
+
+} // extern "C"
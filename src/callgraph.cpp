@@ -0,0 +1,164 @@
+#include "callgraph.h"
+
+// ============================================================================
+// Construction
+// ============================================================================
+
+CallGraph::CallGraph(const Program &program) {
+  std::unordered_map<std::string, const FunctionDecl *> functions;
+  std::vector<std::string> calls;
+
+  for (const auto &item : program.items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      functions[fn->name()] = fn;
+    } else if (auto *stmt = dynamic_cast<const Stmt *>(item.get())) {
+      collectCalls(stmt, calls);
+    }
+  }
+  topLevel_.insert(calls.begin(), calls.end());
+
+  // Worklist over reached functions only; bodies are touched on demand
+  std::vector<std::string> worklist(topLevel_.begin(), topLevel_.end());
+  while (!worklist.empty()) {
+    std::string name = std::move(worklist.back());
+    worklist.pop_back();
+
+    auto it = functions.find(name);
+    if (it == functions.end() || !reachable_.insert(name).second) {
+      continue;
+    }
+
+    calls.clear();
+    for (const auto &stmt : it->second->body()) {
+      collectCalls(stmt.get(), calls);
+    }
+
+    auto &out = edges_[name];
+    for (auto &callee : calls) {
+      if (out.insert(callee).second) {
+        worklist.push_back(callee);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+const std::unordered_set<std::string> &
+CallGraph::callees(const std::string &fn) const {
+  static const std::unordered_set<std::string> none;
+  auto it = edges_.find(fn);
+  return it == edges_.end() ? none : it->second;
+}
+
+bool CallGraph::isRecursive(const std::string &fn) const {
+  std::unordered_set<std::string> visited;
+  std::vector<std::string> worklist(callees(fn).begin(), callees(fn).end());
+
+  while (!worklist.empty()) {
+    std::string name = std::move(worklist.back());
+    worklist.pop_back();
+    if (name == fn) {
+      return true;
+    }
+    if (!visited.insert(name).second) {
+      continue;
+    }
+    for (const auto &callee : callees(name)) {
+      worklist.push_back(callee);
+    }
+  }
+  return false;
+}
+
+// ============================================================================
+// AST Walkers
+// ============================================================================
+
+void CallGraph::collectCalls(const Stmt *stmt,
+                             std::vector<std::string> &calls) {
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
+    collectCallsFromExpr(&assign->value(), calls);
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(stmt)) {
+    collectCallsFromExpr(&arrAssign->target(), calls);
+    collectCallsFromExpr(&arrAssign->index(), calls);
+    collectCallsFromExpr(&arrAssign->value(), calls);
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(stmt)) {
+    collectCallsFromExpr(&exprStmt->expr(), calls);
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(stmt)) {
+    collectCallsFromExpr(&print->value(), calls);
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
+    collectCallsFromExpr(&ifstmt->condition(), calls);
+    for (const auto &s : ifstmt->body()) {
+      collectCalls(s.get(), calls);
+    }
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    collectCallsFromExpr(&switchstmt->value(), calls);
+    for (const auto &arm : switchstmt->cases()) {
+      for (const auto &s : arm.body) {
+        collectCalls(s.get(), calls);
+      }
+    }
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
+    collectCallsFromExpr(&whilestmt->condition(), calls);
+    for (const auto &s : whilestmt->body()) {
+      collectCalls(s.get(), calls);
+    }
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(stmt)) {
+    if (forstmt->init()) {
+      collectCalls(forstmt->init(), calls);
+    }
+    if (forstmt->condition()) {
+      collectCallsFromExpr(forstmt->condition(), calls);
+    }
+    if (forstmt->increment()) {
+      collectCalls(forstmt->increment(), calls);
+    }
+    for (const auto &s : forstmt->body()) {
+      collectCalls(s.get(), calls);
+    }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    collectCallsFromExpr(&forin->iterable(), calls);
+    for (const auto &s : forin->body()) {
+      collectCalls(s.get(), calls);
+    }
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    collectCallsFromExpr(&parallel->start(), calls);
+    collectCallsFromExpr(&parallel->end(), calls);
+    for (const auto &s : parallel->body()) {
+      collectCalls(s.get(), calls);
+    }
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
+    if (ret->value()) {
+      collectCallsFromExpr(ret->value(), calls);
+    }
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+    for (const auto &s : block->statements()) {
+      collectCalls(s.get(), calls);
+    }
+  }
+}
+
+void CallGraph::collectCallsFromExpr(const Expr *expr,
+                                     std::vector<std::string> &calls) {
+  if (auto *call = dynamic_cast<const FunctionCallExpr *>(expr)) {
+    calls.push_back(call->name());
+    for (const auto &arg : call->args()) {
+      collectCallsFromExpr(arg.get(), calls);
+    }
+  } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(expr)) {
+    collectCallsFromExpr(&binop->left(), calls);
+    collectCallsFromExpr(&binop->right(), calls);
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(expr)) {
+    collectCallsFromExpr(&unary->operand(), calls);
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(expr)) {
+    for (const auto &element : array->elements()) {
+      collectCallsFromExpr(element.get(), calls);
+    }
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(expr)) {
+    collectCallsFromExpr(&index->target(), calls);
+    collectCallsFromExpr(&index->index(), calls);
+  }
+}
@@ -0,0 +1,691 @@
+#include "cbackend.h"
+#include <algorithm>
+#include <sstream>
+
+// ============================================================================
+// Embedded Runtime
+// ============================================================================
+
+namespace {
+
+// Runtime shared by every emitted program. Mirrors the semantics and error
+// messages of VirtualMachine so a compiled script is indistinguishable from
+// an interpreted one (apart from speed).
+constexpr const char *kRuntime = R"RUNTIME(#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+struct VmError : std::runtime_error {
+  explicit VmError(const std::string &m) : std::runtime_error(m) {}
+};
+
+[[noreturn]] inline void vmError(const char *message) { throw VmError(message); }
+[[noreturn]] inline void typeError() {
+  throw std::runtime_error("Type error: expected int");
+}
+
+struct Value;
+using Array = std::vector<Value>;
+
+struct Value {
+  enum Tag : uint8_t { Void, Int, Str, Arr };
+  Tag tag = Int;
+  int32_t i = 0;
+  std::shared_ptr<const std::string> s;
+  std::shared_ptr<Array> a;
+
+  static Value integer(int32_t v) {
+    Value r;
+    r.i = v;
+    return r;
+  }
+  static Value string(std::string v) {
+    Value r;
+    r.tag = Str;
+    r.s = std::make_shared<const std::string>(std::move(v));
+    return r;
+  }
+};
+
+inline int32_t asInt(const Value &v) {
+  if (v.tag != Value::Int)
+    typeError();
+  return v.i;
+}
+
+inline int32_t wrapAdd(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) +
+                              static_cast<uint32_t>(b));
+}
+inline int32_t wrapSub(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) -
+                              static_cast<uint32_t>(b));
+}
+inline int32_t wrapMul(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) *
+                              static_cast<uint32_t>(b));
+}
+inline int32_t wrapDiv(int32_t a, int32_t b) {
+  return b == -1 ? wrapSub(0, a) : a / b;
+}
+inline int32_t wrapMod(int32_t a, int32_t b) { return b == -1 ? 0 : a % b; }
+
+inline Value add(const Value &a, const Value &b) {
+  if (a.tag == Value::Int && b.tag == Value::Int)
+    return Value::integer(wrapAdd(a.i, b.i));
+  if (a.tag == Value::Str && b.tag == Value::Str)
+    return Value::string(*a.s + *b.s);
+  vmError("Type mismatch for ADD");
+}
+
+inline bool equals(const Value &a, const Value &b) {
+  if (a.tag != b.tag)
+    return false;
+  switch (a.tag) {
+  case Value::Void:
+    return true;
+  case Value::Int:
+    return a.i == b.i;
+  case Value::Str:
+    return *a.s == *b.s;
+  case Value::Arr:
+    return a.a == b.a;
+  }
+  return false;
+}
+
+inline void print(const Value &v, std::ostream &os) {
+  switch (v.tag) {
+  case Value::Void:
+    os << "void";
+    break;
+  case Value::Int:
+    os << v.i;
+    break;
+  case Value::Str:
+    os << *v.s;
+    break;
+  case Value::Arr:
+    os << "[";
+    for (size_t k = 0; k < v.a->size(); ++k) {
+      if (k > 0)
+        os << ", ";
+      print((*v.a)[k], os);
+    }
+    os << "]";
+    break;
+  }
+}
+
+inline size_t checkIndex(const Value &array, const Value &index,
+                         const char *notArray) {
+  if (array.tag != Value::Arr)
+    vmError(notArray);
+  if (index.tag != Value::Int)
+    vmError("Runtime Error: Array index must be an integer");
+  if (index.i < 0 || static_cast<size_t>(index.i) >= array.a->size())
+    vmError("Runtime Error: Array index out of bounds");
+  return static_cast<size_t>(index.i);
+}
+
+struct Frame {
+  uint16_t ret;
+  uint16_t bp;
+  uint16_t fl; // Caller's frame size
+};
+
+constexpr int kMaxStack = 256;
+constexpr size_t kMaxVariables = 1024;
+
+} // namespace rt
+
+#define PUSH(v)                                                                \
+  do {                                                                         \
+    if (sp >= rt::kMaxStack)                                                   \
+      rt::vmError("Stack overflow");                                           \
+    stack[sp++] = (v);                                                         \
+  } while (0)
+
+#define LOCAL(slot)                                                            \
+  (static_cast<size_t>(slot) < locals.size()                                   \
+       ? locals[slot]                                                          \
+       : (rt::vmError("Invalid local variable index"), locals[0]))
+
+#define INT_BINOP(fn)                                                          \
+  do {                                                                         \
+    rt::Value &a_ = stack[sp - 2];                                             \
+    const rt::Value &b_ = stack[sp - 1];                                       \
+    if (a_.tag != rt::Value::Int || b_.tag != rt::Value::Int)                  \
+      rt::typeError();                                                         \
+    a_.i = fn(a_.i, b_.i);                                                     \
+    --sp;                                                                      \
+  } while (0)
+
+#define COMPARE(op)                                                            \
+  do {                                                                         \
+    rt::Value &a_ = stack[sp - 2];                                             \
+    const rt::Value &b_ = stack[sp - 1];                                       \
+    if (a_.tag != rt::Value::Int || b_.tag != rt::Value::Int)                  \
+      rt::vmError("Type error in comparison");                                 \
+    a_.i = (a_.i op b_.i) ? 1 : 0;                                             \
+    --sp;                                                                      \
+  } while (0)
+
+)RUNTIME";
+
+} // namespace
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+std::string CBackend::emit(const BytecodeProgram &program) const {
+  std::ostringstream os;
+  emit(program, os);
+  return os.str();
+}
+
+void CBackend::emit(const BytecodeProgram &program, std::ostream &os) const {
+  os << "// Generated by the Optimizing Bytecode Compiler (--emit-c)\n";
+  os << "// Build: c++ -O2 -std=c++17 <this file> -o <binary>\n";
+  os << kRuntime;
+
+  emitConstants(program, os);
+
+  os << "static rt::Value run() {\n";
+  os << "  rt::Value stack[rt::kMaxStack];\n";
+  os << "  int sp = 0;\n";
+  os << "  std::vector<rt::Value> locals(rt::kMaxVariables, "
+        "rt::Value::integer(0));\n";
+  os << "  std::vector<rt::Frame> frames;\n";
+  os << "  uint16_t bp = 0;\n";
+  os << "  uint16_t fl = " << program.mainLocalCount << ";\n";
+  os << "  uint16_t ret = 0;\n";
+  os << "  (void)ret;\n";
+  os << "  (void)fl;\n";
+  os << "  rt::Value result;\n";
+  os << "  result.tag = rt::Value::Void;\n";
+  os << "  goto L" << program.mainEntry << ";\n";
+
+  auto labels = collectLabels(program);
+  for (size_t i = 0; i < program.code.size(); ++i) {
+    auto ip = static_cast<uint16_t>(i);
+    if (labels.count(ip)) {
+      os << "L" << ip << ":\n";
+    }
+    emitInstruction(program, ip, os);
+  }
+
+  // Falling off the end returns the top of the stack, like the VM
+  auto end = static_cast<uint16_t>(program.code.size());
+  if (labels.count(end)) {
+    os << "L" << end << ":\n";
+  }
+  os << "  if (sp > 0)\n";
+  os << "    result = std::move(stack[--sp]);\n";
+  os << "  goto finish;\n";
+
+  emitReturnDispatch(program, os);
+
+  os << "finish:\n";
+  os << "  return result;\n";
+  os << "}\n\n";
+
+  os << "int main() {\n";
+  os << "  std::ios::sync_with_stdio(false);\n";
+  os << "  try {\n";
+  os << "    run();\n";
+  os << "  } catch (const rt::VmError &e) {\n";
+  os << "    std::cout.flush();\n";
+  os << "    std::cerr << \"Runtime error: VM error: \" << e.what() << "
+        "\"\\n\";\n";
+  os << "    return 1;\n";
+  os << "  } catch (const std::exception &e) {\n";
+  os << "    std::cout.flush();\n";
+  os << "    std::cerr << \"Error: \" << e.what() << \"\\n\";\n";
+  os << "    return 1;\n";
+  os << "  }\n";
+  os << "  return 0;\n";
+  os << "}\n";
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+std::set<uint16_t>
+CBackend::collectLabels(const BytecodeProgram &program) const {
+  std::set<uint16_t> labels;
+  labels.insert(program.mainEntry);
+  for (const auto &fn : program.functions) {
+    labels.insert(fn.entry);
+  }
+  for (size_t i = 0; i < program.code.size(); ++i) {
+    auto op = static_cast<Opcode>(program.code[i].opcode);
+    if (op == Opcode::JUMP || op == Opcode::JUMP_IF_ZERO ||
+        op == Opcode::JUMP_IF_NOT_ZERO) {
+      labels.insert(program.code[i].operand);
+    } else if (op == Opcode::PARALLEL_FOR || op == Opcode::PARALLEL_NEXT) {
+      const ParallelLoop &loop = program.parallelLoops[program.code[i].operand];
+      labels.insert(loop.bodyStart);
+      labels.insert(loop.exit);
+    } else if (op == Opcode::CALL) {
+      labels.insert(static_cast<uint16_t>(i + 1)); // Return site
+    } else if (op == Opcode::TABLE_SWITCH || op == Opcode::LOOKUP_SWITCH) {
+      const SwitchTable &table = program.switchTables[program.code[i].operand];
+      labels.insert(table.targets.begin(), table.targets.end());
+      for (const auto &[value, target] : table.intCases) {
+        labels.insert(target);
+      }
+      for (const auto &[value, target] : table.stringCases) {
+        labels.insert(target);
+      }
+      labels.insert(table.defaultTarget);
+    }
+  }
+  return labels;
+}
+
+void CBackend::emitConstants(const BytecodeProgram &program,
+                             std::ostream &os) const {
+  // Integers are inlined at their use sites; only strings need a table
+  os << "[[maybe_unused]] static const std::vector<rt::Value> &constants() "
+        "{\n";
+  os << "  static const std::vector<rt::Value> pool = {\n";
+  for (const auto &constant : program.constants) {
+    if (constant.isString()) {
+      os << "      rt::Value::string(\"" << escapeString(constant.asString())
+         << "\"),\n";
+    } else if (constant.isInt()) {
+      os << "      rt::Value::integer(" << constant.asInt() << "),\n";
+    } else {
+      throw CodegenError("Unsupported constant in C backend");
+    }
+  }
+  os << "  };\n";
+  os << "  return pool;\n";
+  os << "}\n\n";
+}
+
+void CBackend::emitInstruction(const BytecodeProgram &program, uint16_t ip,
+                               std::ostream &os) const {
+  const Instruction &instr = program.code[ip];
+  auto op = static_cast<Opcode>(instr.opcode);
+  uint16_t operand = instr.operand;
+
+  os << "  // [" << ip << "] " << opcode_to_string(op) << " " << operand
+     << "\n";
+
+  switch (op) {
+  case Opcode::CONST:
+    if (operand >= program.constants.size()) {
+      throw CodegenError("Invalid constant index");
+    }
+    if (program.constants[operand].isInt()) {
+      os << "  PUSH(rt::Value::integer(" << program.constants[operand].asInt()
+         << "));\n";
+    } else {
+      os << "  PUSH(constants()[" << operand << "]);\n";
+    }
+    break;
+
+  case Opcode::LOAD:
+    os << "  PUSH(LOCAL(static_cast<uint16_t>(bp + " << operand << ")));\n";
+    break;
+
+  case Opcode::STORE:
+    os << "  --sp;\n";
+    os << "  LOCAL(static_cast<uint16_t>(bp + " << operand
+       << ")) = std::move(stack[sp]);\n";
+    break;
+
+  case Opcode::ADD:
+    os << "  {\n";
+    os << "    rt::Value &a = stack[sp - 2];\n";
+    os << "    const rt::Value &b = stack[sp - 1];\n";
+    os << "    if (a.tag == rt::Value::Int && b.tag == rt::Value::Int)\n";
+    os << "      a.i = rt::wrapAdd(a.i, b.i);\n";
+    os << "    else\n";
+    os << "      a = rt::add(a, b);\n";
+    os << "    --sp;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::LOCAL_INC:
+    os << "  {\n";
+    os << "    rt::Value &a = LOCAL(static_cast<uint16_t>(bp + " << operand
+       << "));\n";
+    os << "    --sp;\n";
+    os << "    if (a.tag == rt::Value::Int && stack[sp].tag == rt::Value::Int)\n";
+    os << "      a.i = rt::wrapAdd(a.i, stack[sp].i);\n";
+    os << "    else\n";
+    os << "      a = rt::add(a, stack[sp]);\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::SUB:
+    os << "  INT_BINOP(rt::wrapSub);\n";
+    break;
+
+  case Opcode::LOCAL_DEC:
+    os << "  {\n";
+    os << "    rt::Value &a = LOCAL(static_cast<uint16_t>(bp + " << operand
+       << "));\n";
+    os << "    --sp;\n";
+    os << "    a.i = rt::wrapSub(rt::asInt(a), rt::asInt(stack[sp]));\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::MUL:
+    os << "  INT_BINOP(rt::wrapMul);\n";
+    break;
+
+  case Opcode::DIV:
+  case Opcode::MOD:
+    os << "  {\n";
+    os << "    int32_t b = rt::asInt(stack[sp - 1]);\n";
+    os << "    if (b == 0)\n";
+    os << "      rt::vmError(\""
+       << (op == Opcode::DIV ? "Division" : "Modulo") << " by zero\");\n";
+    os << "    int32_t a = rt::asInt(stack[sp - 2]);\n";
+    os << "    stack[sp - 2].i = rt::"
+       << (op == Opcode::DIV ? "wrapDiv" : "wrapMod") << "(a, b);\n";
+    os << "    --sp;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::SHL:
+    if (operand > MAX_SHIFT) {
+      throw CodegenError("Invalid shift amount");
+    }
+    os << "  stack[sp - 1].i = static_cast<int32_t>(\n";
+    os << "      static_cast<uint32_t>(rt::asInt(stack[sp - 1])) << " << operand
+       << ");\n";
+    break;
+
+  case Opcode::SHR:
+  case Opcode::MASK: {
+    if (operand > MAX_SHIFT) {
+      throw CodegenError("Invalid shift amount");
+    }
+    // Same rounding as DIV/MOD: bias negative values before shifting
+    uint32_t mask = (1u << operand) - 1;
+    os << "  {\n";
+    os << "    int32_t a = rt::asInt(stack[sp - 1]);\n";
+    os << "    int32_t bias = (a >> 31) & " << mask << ";\n";
+    if (op == Opcode::SHR) {
+      os << "    stack[sp - 1].i = (a + bias) >> " << operand << ";\n";
+    } else {
+      os << "    stack[sp - 1].i = a - ((a + bias) & ~" << mask << ");\n";
+    }
+    os << "  }\n";
+    break;
+  }
+
+  case Opcode::JUMP:
+    os << "  goto L" << operand << ";\n";
+    break;
+
+  case Opcode::JUMP_IF_ZERO:
+    os << "  --sp;\n";
+    os << "  if (stack[sp].tag == rt::Value::Int && stack[sp].i == 0)\n";
+    os << "    goto L" << operand << ";\n";
+    break;
+
+  case Opcode::JUMP_IF_NOT_ZERO:
+    os << "  --sp;\n";
+    os << "  if (stack[sp].tag != rt::Value::Int || stack[sp].i != 0)\n";
+    os << "    goto L" << operand << ";\n";
+    break;
+
+  case Opcode::TABLE_SWITCH:
+  case Opcode::LOOKUP_SWITCH: {
+    // Int labels become a C switch, which the C compiler lays out itself
+    const SwitchTable &table = program.switchTables[operand];
+    os << "  --sp;\n";
+    if (!table.targets.empty() || !table.intCases.empty()) {
+      os << "  if (stack[sp].tag == rt::Value::Int) {\n";
+      os << "    switch (stack[sp].i) {\n";
+      for (size_t k = 0; k < table.targets.size(); ++k) {
+        os << "    case " << table.low + static_cast<int64_t>(k) << ": goto L"
+           << table.targets[k] << ";\n";
+      }
+      for (const auto &[value, target] : table.intCases) {
+        os << "    case " << value << ": goto L" << target << ";\n";
+      }
+      os << "    default: break;\n";
+      os << "    }\n";
+      os << "  }\n";
+    }
+    if (!table.stringCases.empty()) {
+      os << "  if (stack[sp].tag == rt::Value::Str) {\n";
+      for (const auto &[value, target] : table.stringCases) {
+        os << "    if (*stack[sp].s == \"" << escapeString(value)
+           << "\") goto L" << target << ";\n";
+      }
+      os << "  }\n";
+    }
+    os << "  goto L" << table.defaultTarget << ";\n";
+    break;
+  }
+
+  case Opcode::CALL: {
+    if (operand >= program.functions.size()) {
+      throw CodegenError("Invalid function index");
+    }
+    const FunctionInfo &fn = program.functions[operand];
+    os << "  {\n";
+    os << "    frames.push_back({" << (ip + 1) << ", bp, fl});\n";
+    os << "    size_t nb = static_cast<size_t>(bp) + fl;\n";
+    os << "    if (nb + "
+       << std::max<int>(fn.localCount, fn.arity) << " > locals.size())\n";
+    os << "      rt::vmError(\"Call stack overflow\");\n";
+    for (int i = fn.arity - 1; i >= 0; --i) {
+      os << "    locals[nb + " << i << "] = std::move(stack[--sp]);\n";
+    }
+    os << "    bp = static_cast<uint16_t>(nb);\n";
+    os << "    fl = " << static_cast<int>(fn.localCount) << ";\n";
+    os << "    goto L" << fn.entry << ";\n";
+    os << "  }\n";
+    break;
+  }
+
+  case Opcode::RETURN:
+    os << "  {\n";
+    os << "    rt::Value r = std::move(stack[--sp]);\n";
+    os << "    if (frames.empty()) {\n";
+    os << "      result = std::move(r);\n";
+    os << "      goto finish;\n";
+    os << "    }\n";
+    os << "    rt::Frame f = frames.back();\n";
+    os << "    frames.pop_back();\n";
+    os << "    bp = f.bp;\n";
+    os << "    fl = f.fl;\n";
+    os << "    stack[sp++] = std::move(r);\n";
+    os << "    ret = f.ret;\n";
+    os << "    goto dispatch_return;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::PRINT:
+    os << "  rt::print(stack[--sp], std::cout);\n";
+    os << "  std::cout << '\\n';\n";
+    break;
+
+  case Opcode::EQ:
+  case Opcode::NEQ:
+    os << "  {\n";
+    os << "    bool eq = rt::equals(stack[sp - 2], stack[sp - 1]);\n";
+    os << "    stack[sp - 2] = rt::Value::integer("
+       << (op == Opcode::EQ ? "eq" : "!eq") << " ? 1 : 0);\n";
+    os << "    --sp;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::LT:
+    os << "  COMPARE(<);\n";
+    break;
+  case Opcode::LTE:
+    os << "  COMPARE(<=);\n";
+    break;
+  case Opcode::GT:
+    os << "  COMPARE(>);\n";
+    break;
+  case Opcode::GTE:
+    os << "  COMPARE(>=);\n";
+    break;
+
+  case Opcode::BUILD_ARRAY:
+    os << "  {\n";
+    os << "    rt::Value arr;\n";
+    os << "    arr.tag = rt::Value::Arr;\n";
+    os << "    arr.a = std::make_shared<rt::Array>(" << operand << ");\n";
+    os << "    for (int k = " << operand << " - 1; k >= 0; --k)\n";
+    os << "      (*arr.a)[k] = std::move(stack[--sp]);\n";
+    os << "    PUSH(std::move(arr));\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::ARRAY_LOAD:
+    os << "  {\n";
+    os << "    size_t k = rt::checkIndex(stack[sp - 2], stack[sp - 1], "
+          "\"Runtime Error: Expected array for indexing\");\n";
+    os << "    rt::Value v = (*stack[sp - 2].a)[k];\n";
+    os << "    stack[sp - 2] = std::move(v);\n";
+    os << "    --sp;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::ARRAY_STORE:
+    os << "  {\n";
+    os << "    size_t k = rt::checkIndex(stack[sp - 3], stack[sp - 2], "
+          "\"Runtime Error: Expected array for assignment\");\n";
+    os << "    (*stack[sp - 3].a)[k] = std::move(stack[sp - 1]);\n";
+    os << "    sp -= 3;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::ARRAY_ADD_STORE:
+    os << "  {\n";
+    os << "    size_t k = rt::checkIndex(stack[sp - 3], stack[sp - 2], "
+          "\"Runtime Error: Expected array for assignment\");\n";
+    os << "    rt::Value &a = (*stack[sp - 3].a)[k];\n";
+    os << "    const rt::Value &b = stack[sp - 1];\n";
+    os << "    if (a.tag == rt::Value::Int && b.tag == rt::Value::Int)\n";
+    os << "      a.i = rt::wrapAdd(a.i, b.i);\n";
+    os << "    else\n";
+    os << "      a = rt::add(a, b);\n";
+    os << "    sp -= 3;\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::POP:
+    os << "  --sp;\n";
+    break;
+
+  case Opcode::DUP2:
+    os << "  PUSH(stack[sp - 2]);\n";
+    os << "  PUSH(stack[sp - 2]);\n";
+    break;
+
+  case Opcode::ITER_NEXT:
+    os << "  {\n";
+    os << "    rt::Value &arr = LOCAL(static_cast<uint16_t>(bp + " << operand
+       << "));\n";
+    os << "    rt::Value &next = LOCAL(static_cast<uint16_t>(bp + "
+       << operand + 1 << "));\n";
+    os << "    rt::Value &elem = LOCAL(static_cast<uint16_t>(bp + "
+       << operand + 2 << "));\n";
+    os << "    if (arr.tag != rt::Value::Arr)\n";
+    os << "      rt::vmError(\"Runtime Error: Expected array for "
+          "iteration\");\n";
+    os << "    bool more = static_cast<size_t>(next.i) < arr.a->size();\n";
+    os << "    if (more) {\n";
+    os << "      elem = (*arr.a)[next.i];\n";
+    os << "      ++next.i;\n";
+    os << "    }\n";
+    os << "    PUSH(rt::Value::integer(more ? 1 : 0));\n";
+    os << "  }\n";
+    break;
+
+  case Opcode::PARALLEL_FOR:
+  case Opcode::PARALLEL_NEXT: {
+    // Generated code runs parallel loops serially
+    const ParallelLoop &loop = program.parallelLoops[operand];
+    std::string index =
+        "LOCAL(static_cast<uint16_t>(bp + " + std::to_string(loop.indexSlot) +
+        "))";
+    std::string end = "LOCAL(static_cast<uint16_t>(bp + " +
+                      std::to_string(loop.indexSlot + 1) + "))";
+    if (op == Opcode::PARALLEL_FOR) {
+      os << "  if (" << index << ".tag != rt::Value::Int || " << end
+         << ".tag != rt::Value::Int)\n";
+      os << "    rt::vmError(\"Type error in comparison\");\n";
+      os << "  if (" << index << ".i >= " << end << ".i)\n";
+      os << "    goto L" << loop.exit << ";\n";
+    } else {
+      os << "  if (++" << index << ".i < " << end << ".i)\n";
+      os << "    goto L" << loop.bodyStart << ";\n";
+    }
+    break;
+  }
+
+  default:
+    throw CodegenError("C backend does not support opcode " +
+                       std::to_string(instr.opcode));
+  }
+}
+
+void CBackend::emitReturnDispatch(const BytecodeProgram &program,
+                                  std::ostream &os) const {
+  os << "dispatch_return:\n";
+  os << "  switch (ret) {\n";
+  for (size_t i = 0; i < program.code.size(); ++i) {
+    if (static_cast<Opcode>(program.code[i].opcode) == Opcode::CALL) {
+      os << "  case " << (i + 1) << ":\n";
+      os << "    goto L" << (i + 1) << ";\n";
+    }
+  }
+  os << "  default:\n";
+  os << "    rt::vmError(\"Invalid return address\");\n";
+  os << "  }\n";
+}
+
+std::string CBackend::escapeString(const std::string &value) {
+  std::ostringstream oss;
+  for (unsigned char c : value) {
+    switch (c) {
+    case '\\':
+      oss << "\\\\";
+      break;
+    case '"':
+      oss << "\\\"";
+      break;
+    case '\n':
+      oss << "\\n";
+      break;
+    case '\t':
+      oss << "\\t";
+      break;
+    case '\r':
+      oss << "\\r";
+      break;
+    default:
+      if (c < 0x20 || c >= 0x7f) {
+        // Octal escapes cannot swallow following digits past three chars
+        oss << "\\" << static_cast<char>('0' + ((c >> 6) & 7))
+            << static_cast<char>('0' + ((c >> 3) & 7))
+            << static_cast<char>('0' + (c & 7));
+      } else {
+        oss << c;
+      }
+    }
+  }
+  return oss.str();
+}
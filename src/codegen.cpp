@@ -1,4 +1,7 @@
 #include "codegen.h"
+#include "callgraph.h"
+#include "profile_data.h"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
@@ -20,8 +23,13 @@ void BytecodeProgram::dump() const {
 
   std::cout << "Functions: " << functions.size() << std::endl;
   for (const auto &fn : functions) {
-    std::cout << "  " << fn.name << " entry=" << fn.entry
-              << " arity=" << static_cast<int>(fn.arity)
+    std::cout << "  " << fn.name << " entry=";
+    if (fn.entry == LAZY_FUNCTION_ENTRY) {
+      std::cout << "<lazy>";
+    } else {
+      std::cout << fn.entry;
+    }
+    std::cout << " arity=" << static_cast<int>(fn.arity)
               << " locals=" << static_cast<int>(fn.localCount) << std::endl;
   }
 
@@ -32,47 +40,78 @@ void BytecodeProgram::dump() const {
     // Show operand for relevant opcodes
     if (op == Opcode::CONST || op == Opcode::LOAD || op == Opcode::STORE ||
         op == Opcode::JUMP || op == Opcode::JUMP_IF_ZERO ||
-        op == Opcode::CALL) {
+        op == Opcode::JUMP_IF_NOT_ZERO ||
+        op == Opcode::CALL || op == Opcode::SHL || op == Opcode::SHR ||
+        op == Opcode::MASK || op == Opcode::TABLE_SWITCH ||
+        op == Opcode::LOOKUP_SWITCH || op == Opcode::LOCAL_INC ||
+        op == Opcode::LOCAL_DEC || op == Opcode::ITER_NEXT || op == Opcode::PARALLEL_FOR ||
+        op == Opcode::PARALLEL_NEXT) {
       std::cout << " " << code[i].operand;
     }
     std::cout << std::endl;
   }
+
+  if (!switchTables.empty()) {
+    std::cout << "Switch tables: " << switchTables.size() << std::endl;
+  }
+  for (size_t i = 0; i < switchTables.size(); ++i) {
+    const SwitchTable &table = switchTables[i];
+    std::cout << "  [" << i << "]";
+    for (size_t k = 0; k < table.targets.size(); ++k) {
+      std::cout << " " << table.low + static_cast<int64_t>(k) << "->"
+                << table.targets[k];
+    }
+    for (const auto &[value, target] : table.intCases) {
+      std::cout << " " << value << "->" << target;
+    }
+    for (const auto &[value, target] : table.stringCases) {
+      std::cout << " \"" << value << "\"->" << target;
+    }
+    std::cout << " default->" << table.defaultTarget << std::endl;
+  }
   std::cout << "Main entry: " << mainEntry << std::endl;
 }
 
+uint16_t SwitchTable::targetFor(const Value &value) const {
+  if (value.isInt() && !targets.empty()) {
+    int64_t offset = static_cast<int64_t>(value.asInt()) - low;
+    if (offset >= 0 && offset < static_cast<int64_t>(targets.size())) {
+      return targets[static_cast<size_t>(offset)];
+    }
+  } else if (value.isInt()) {
+    auto it = intCases.find(value.asInt());
+    if (it != intCases.end()) {
+      return it->second;
+    }
+  } else if (value.isString()) {
+    auto it = stringCases.find(value.asString());
+    if (it != stringCases.end()) {
+      return it->second;
+    }
+  }
+  return defaultTarget;
+}
+
 // ============================================================================
 // Code Generator Implementation
 // ============================================================================
 
-BytecodeProgram CodeGenerator::generate(const Program &program,
-                                        bool incremental) {
+BytecodeProgram CodeGenerator::generate(const Program &program) {
   // Reset state
   program_ = BytecodeProgram{};
-
-  if (!incremental) {
-    scopes_.clear();
-    scopes_.emplace_back(); // Global scope
-    globals_.clear();
-    functionMap_.clear();
-  }
-
+  scopes_.clear();
+  scopes_.emplace_back(); // Global scope
+  globals_.clear();
+  functionMap_.clear();
   currentFunction_.clear();
   loopStack_.clear();
+  parallelStack_.clear();
+  reductionUses_.clear();
+  coldBlocks_.clear();
+  incremental_ = false;
 
   // First pass: register all functions
-  for (const auto &item : program.items()) {
-    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
-      FunctionInfo info;
-      info.name = fn->name();
-      info.entry = 0; // Will be set during code generation
-      info.arity = static_cast<uint8_t>(fn->params().size());
-      info.localCount = 0;
-
-      functionMap_[fn->name()] =
-          static_cast<uint16_t>(program_.functions.size());
-      program_.functions.push_back(info);
-    }
-  }
+  registerFunctions(program);
 
   // Generate code for functions first
   for (const auto &item : program.items()) {
@@ -83,6 +122,7 @@ BytecodeProgram CodeGenerator::generate(const Program &program,
 
   // Mark main entry point (top-level statements start here)
   program_.mainEntry = currentIndex();
+  peakLocals_ = static_cast<uint16_t>(scopes_.front().size());
 
   // Generate code for top-level statements
   for (const auto &item : program.items()) {
@@ -90,18 +130,169 @@ BytecodeProgram CodeGenerator::generate(const Program &program,
       stmt->accept(*this);
     }
   }
+  program_.mainLocalCount = peakLocals_;
 
-  // Add implicit RETURN at end of main (only for non-incremental/file mode)
-  // In REPL mode, we don't want to push 0 and return - just let execution fall
-  // through
-  if (!incremental) {
-    emit(Opcode::CONST, addConstant(0));
-    emit(Opcode::RETURN);
+  // Add implicit RETURN at end of main
+  emit(Opcode::CONST, addConstant(0));
+  emit(Opcode::RETURN);
+  emitColdBlocks(0);
+
+  return std::move(program_);
+}
+
+void CodeGenerator::append(BytecodeProgram &program, const Program &ast) {
+  // What a failed line has to undo
+  auto scopes = scopes_;
+  auto globals = globals_;
+  auto functionMap = functionMap_;
+  auto functions = program.functions;
+  size_t codeSize = program.code.size();
+  size_t constantCount = program.constants.size();
+  size_t branchSiteCount = program.branchSites.size();
+  size_t switchTableCount = program.switchTables.size();
+  size_t parallelLoopCount = program.parallelLoops.size();
+  uint16_t mainEntry = program.mainEntry;
+  uint16_t mainLocalCount = program.mainLocalCount;
+
+  program_ = std::move(program);
+  currentFunction_.clear();
+  loopStack_.clear();
+  parallelStack_.clear();
+  reductionUses_.clear();
+  coldBlocks_.clear();
+  incremental_ = true;
+  try {
+    registerFunctions(ast);
+    for (const auto &item : ast.items()) {
+      if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+        fn->accept(*this);
+      }
+    }
+    // Function bodies leave a fresh global scope behind; bring back the
+    // globals of earlier input
+    scopes_ = scopes;
+
+    // Only the new top-level code runs, so it starts after the new bodies
+    program_.mainEntry = currentIndex();
+    peakLocals_ = static_cast<uint16_t>(scopes_.front().size());
+    for (const auto &item : ast.items()) {
+      if (auto *stmt = dynamic_cast<const Stmt *>(item.get())) {
+        stmt->accept(*this);
+      }
+    }
+    if (!coldBlocks_.empty()) {
+      size_t skip = emitJump(Opcode::JUMP);
+      emitColdBlocks(0);
+      patchJump(skip, currentIndex());
+    }
+    // Earlier globals keep their slots even if this line uses fewer
+    program_.mainLocalCount = std::max(mainLocalCount, peakLocals_);
+  } catch (...) {
+    program_.code.resize(codeSize);
+    program_.constants.resize(constantCount);
+    program_.functions = std::move(functions);
+    program_.branchSites.resize(branchSiteCount);
+    program_.switchTables.resize(switchTableCount);
+    program_.parallelLoops.resize(parallelLoopCount);
+    program_.mainEntry = mainEntry;
+    program_.mainLocalCount = mainLocalCount;
+    program = std::move(program_);
+    scopes_ = std::move(scopes);
+    globals_ = std::move(globals);
+    functionMap_ = std::move(functionMap);
+    incremental_ = false;
+    throw;
+  }
+  incremental_ = false;
+  program = std::move(program_);
+}
+
+void CodeGenerator::restore(
+    const BytecodeProgram &program,
+    const std::unordered_map<std::string, uint16_t> &globals) {
+  scopes_.assign(1, globals);
+  globals_.clear();
+  functionMap_.clear();
+  // Later entries won the name when they were declared
+  for (size_t i = 0; i < program.functions.size(); ++i) {
+    functionMap_[program.functions[i].name] = static_cast<uint16_t>(i);
+  }
+}
+
+BytecodeProgram CodeGenerator::generateLazy(const Program &program) {
+  program_ = BytecodeProgram{};
+  scopes_.clear();
+  scopes_.emplace_back(); // Global scope
+  globals_.clear();
+  functionMap_.clear();
+  pendingFunctions_.clear();
+  currentFunction_.clear();
+  loopStack_.clear();
+  parallelStack_.clear();
+  reductionUses_.clear();
+  coldBlocks_.clear();
+  incremental_ = false;
+
+  registerFunctions(program);
+
+  // Only remember the declarations; bodies are generated on first call
+  for (const auto &item : program.items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      uint16_t index = functionMap_[fn->name()];
+      program_.functions[index].entry = LAZY_FUNCTION_ENTRY;
+      pendingFunctions_[index] = fn;
+    }
   }
 
+  program_.mainEntry = currentIndex();
+  peakLocals_ = 0;
+
+  for (const auto &item : program.items()) {
+    if (auto *stmt = dynamic_cast<const Stmt *>(item.get())) {
+      stmt->accept(*this);
+    }
+  }
+  program_.mainLocalCount = peakLocals_;
+
+  emit(Opcode::CONST, addConstant(0));
+  emit(Opcode::RETURN);
+  emitColdBlocks(0);
+
   return std::move(program_);
 }
 
+void CodeGenerator::compileFunction(BytecodeProgram &program,
+                                   uint16_t funcIndex) {
+  auto it = pendingFunctions_.find(funcIndex);
+  if (it == pendingFunctions_.end()) {
+    throw CodegenError("No pending function with index " +
+                       std::to_string(funcIndex));
+  }
+
+  // Generate into the caller's program, appending after existing code;
+  // a body that fails leaves none of its code behind
+  size_t codeSize = program.code.size();
+  size_t constantCount = program.constants.size();
+  size_t branchSiteCount = program.branchSites.size();
+  size_t switchTableCount = program.switchTables.size();
+  size_t parallelLoopCount = program.parallelLoops.size();
+  program_ = std::move(program);
+  try {
+    it->second->accept(*this);
+  } catch (...) {
+    program_.code.resize(codeSize);
+    program_.constants.resize(constantCount);
+    program_.branchSites.resize(branchSiteCount);
+    program_.switchTables.resize(switchTableCount);
+    program_.parallelLoops.resize(parallelLoopCount);
+    program_.functions[funcIndex].entry = LAZY_FUNCTION_ENTRY;
+    program = std::move(program_);
+    throw;
+  }
+  program = std::move(program_);
+  pendingFunctions_.erase(it);
+}
+
 // ============================================================================
 // Expression Visitors
 // ============================================================================
@@ -117,11 +308,51 @@ void CodeGenerator::visitStringLiteralExpr(const StringLiteralExpr &expr) {
 }
 
 void CodeGenerator::visitIdentifierExpr(const IdentifierExpr &expr) {
+  checkReductionUse(expr, expr.name());
   uint16_t slot = getLocal(expr.name());
   emit(Opcode::LOAD, slot);
 }
 
+namespace {
+
+/**
+ * Shift amount if an operand is the constant 2^k (1 <= k <= MAX_SHIFT)
+ */
+int powerOfTwoShift(const Expr &expr) {
+  auto *num = dynamic_cast<const NumberExpr *>(&expr);
+  if (!num || num->value() < 2 || (num->value() & (num->value() - 1)) != 0) {
+    return -1;
+  }
+  int shift = 0;
+  while ((1 << shift) != num->value()) {
+    ++shift;
+  }
+  return shift <= MAX_SHIFT ? shift : -1;
+}
+
+} // namespace
+
 void CodeGenerator::visitBinaryOpExpr(const BinaryOpExpr &expr) {
+  // Multiply/divide/modulo by a power of two become shifts and masks
+  auto op = expr.op();
+  int shift = powerOfTwoShift(expr.right());
+  if (shift > 0 && (op == BinaryOpExpr::Operator::MULTIPLY ||
+                    op == BinaryOpExpr::Operator::DIVIDE ||
+                    op == BinaryOpExpr::Operator::MODULO)) {
+    expr.left().accept(*this);
+    emit(op == BinaryOpExpr::Operator::MULTIPLY ? Opcode::SHL
+         : op == BinaryOpExpr::Operator::DIVIDE ? Opcode::SHR
+                                                : Opcode::MASK,
+         static_cast<uint16_t>(shift));
+    return;
+  }
+  shift = powerOfTwoShift(expr.left());
+  if (shift > 0 && op == BinaryOpExpr::Operator::MULTIPLY) {
+    expr.right().accept(*this);
+    emit(Opcode::SHL, static_cast<uint16_t>(shift));
+    return;
+  }
+
   // Generate left operand (pushes value)
   expr.left().accept(*this);
 
@@ -182,11 +413,9 @@ void CodeGenerator::visitUnaryOpExpr(const UnaryOpExpr &expr) {
     break;
 
   case UnaryOpExpr::Operator::NOT:
-    // Push 1, then operand, then if operand is 0, result is 1; else 0
-    // Simplified: 1 - operand (works for 0/1 boolean)
+    // If operand is 0, result is 1; else 0
     expr.operand().accept(*this);
-    emit(Opcode::CONST, addConstant(0));
-    // Check if equal to zero using JUMP_IF_ZERO
+    // Check if equal to zero using JUMP_IF_ZERO (consumes the operand)
     {
       uint16_t jumpIfTrue = emit(Opcode::JUMP_IF_ZERO, 0);
       emit(Opcode::CONST, addConstant(0)); // not truthy -> false
@@ -233,7 +462,159 @@ void CodeGenerator::visitIndexExpr(const IndexExpr &expr) {
 // Statement Visitors
 // ============================================================================
 
+namespace {
+
+/**
+ * True if two expressions without calls are written alike, so evaluating
+ * them back to back gives the same value
+ */
+bool sameValue(const Expr &a, const Expr &b) {
+  if (auto *id = dynamic_cast<const IdentifierExpr *>(&a)) {
+    auto *other = dynamic_cast<const IdentifierExpr *>(&b);
+    return other && other->name() == id->name();
+  } else if (auto *num = dynamic_cast<const NumberExpr *>(&a)) {
+    auto *other = dynamic_cast<const NumberExpr *>(&b);
+    return other && other->value() == num->value();
+  } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&a)) {
+    auto *other = dynamic_cast<const BinaryOpExpr *>(&b);
+    return other && other->op() == binop->op() &&
+           sameValue(binop->left(), other->left()) &&
+           sameValue(binop->right(), other->right());
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&a)) {
+    auto *other = dynamic_cast<const UnaryOpExpr *>(&b);
+    return other && other->op() == unary->op() &&
+           sameValue(unary->operand(), other->operand());
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(&a)) {
+    auto *other = dynamic_cast<const IndexExpr *>(&b);
+    return other && sameValue(index->target(), other->target()) &&
+           sameValue(index->index(), other->index());
+  }
+  return false;
+}
+
+bool hasCall(const Expr &expr) {
+  std::vector<std::string> calls;
+  CallGraph::collectCallsFromExpr(&expr, calls);
+  return !calls.empty();
+}
+
+const Reduction *findReduction(const std::vector<Reduction> &reductions,
+                               const std::string &name) {
+  for (const auto &reduction : reductions) {
+    if (reduction.variable == name) {
+      return &reduction;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Record the updates of reduced variables in a parallel for body that give
+ * the same result whether the iterations run in one chunk or several:
+ * `s = s + e` and `s = s - e` for +, and `if (e < m) { m = e; }` (or
+ * `m > e`, `<=`, `>=`) for min, mirrored for max. The assignment and the
+ * one read of the variable it needs are marked with the operator.
+ */
+void collectReductionUpdates(
+    const Stmt &stmt, const std::vector<Reduction> &reductions,
+    std::unordered_map<const ASTNode *, Reduction::Operator> &uses) {
+  auto list = [&](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &s : stmts) {
+      collectReductionUpdates(*s, reductions, uses);
+    }
+  };
+
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(&stmt)) {
+    const Reduction *reduction = findReduction(reductions, assign->name());
+    auto *binop = dynamic_cast<const BinaryOpExpr *>(&assign->value());
+    auto *self =
+        binop ? dynamic_cast<const IdentifierExpr *>(&binop->left()) : nullptr;
+    if (reduction && reduction->op == Reduction::Operator::SUM && self &&
+        self->name() == assign->name() &&
+        (binop->op() == BinaryOpExpr::Operator::PLUS ||
+         binop->op() == BinaryOpExpr::Operator::MINUS)) {
+      uses[assign] = reduction->op;
+      uses[self] = reduction->op;
+    }
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    // The condition compares a value with the variable the body sets to it
+    auto *cond = dynamic_cast<const BinaryOpExpr *>(&ifstmt->condition());
+    auto *update =
+        ifstmt->body().size() == 1
+            ? dynamic_cast<const AssignmentStmt *>(ifstmt->body()[0].get())
+            : nullptr;
+    const Reduction *reduction =
+        update ? findReduction(reductions, update->name()) : nullptr;
+    if (cond && reduction && reduction->op != Reduction::Operator::SUM) {
+      bool less = cond->op() == BinaryOpExpr::Operator::LESS ||
+                  cond->op() == BinaryOpExpr::Operator::LESS_EQUAL;
+      bool greater = cond->op() == BinaryOpExpr::Operator::GREATER ||
+                     cond->op() == BinaryOpExpr::Operator::GREATER_EQUAL;
+      auto *right = dynamic_cast<const IdentifierExpr *>(&cond->right());
+      auto *left = dynamic_cast<const IdentifierExpr *>(&cond->left());
+      const IdentifierExpr *self = nullptr;
+      const Expr *value = nullptr;
+      Reduction::Operator op = Reduction::Operator::SUM;
+      if (right && right->name() == update->name() && (less || greater)) {
+        self = right;
+        value = &cond->left();
+        op = less ? Reduction::Operator::MIN : Reduction::Operator::MAX;
+      } else if (left && left->name() == update->name() && (less || greater)) {
+        self = left;
+        value = &cond->right();
+        op = greater ? Reduction::Operator::MIN : Reduction::Operator::MAX;
+      }
+      if (self && op == reduction->op && !hasCall(*value) &&
+          sameValue(*value, update->value())) {
+        uses[update] = op;
+        uses[self] = op;
+      }
+    }
+    list(ifstmt->body());
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(&stmt)) {
+    list(whilestmt->body());
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(&stmt)) {
+    if (forstmt->init()) {
+      collectReductionUpdates(*forstmt->init(), reductions, uses);
+    }
+    if (forstmt->increment()) {
+      collectReductionUpdates(*forstmt->increment(), reductions, uses);
+    }
+    list(forstmt->body());
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(&stmt)) {
+    list(forin->body());
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(&stmt)) {
+    list(parallel->body());
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    for (const auto &arm : switchstmt->cases()) {
+      list(arm.body);
+    }
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    list(block->statements());
+  }
+}
+
+} // namespace
+
 void CodeGenerator::visitAssignmentStmt(const AssignmentStmt &stmt) {
+  checkParallelWrite(stmt.name());
+  checkReductionUse(stmt, stmt.name());
+
+  // `x = x + v` and `x = x - v` update x in place
+  auto *binop = dynamic_cast<const BinaryOpExpr *>(&stmt.value());
+  auto *self =
+      binop ? dynamic_cast<const IdentifierExpr *>(&binop->left()) : nullptr;
+  if (self && self->name() == stmt.name() &&
+      (binop->op() == BinaryOpExpr::Operator::PLUS ||
+       binop->op() == BinaryOpExpr::Operator::MINUS)) {
+    uint16_t slot = getLocal(stmt.name());
+    binop->right().accept(*this);
+    emit(binop->op() == BinaryOpExpr::Operator::PLUS ? Opcode::LOCAL_INC
+                                                     : Opcode::LOCAL_DEC,
+         slot);
+    return;
+  }
+
   // Generate value expression
   stmt.value().accept(*this);
 
@@ -245,7 +626,35 @@ void CodeGenerator::visitAssignmentStmt(const AssignmentStmt &stmt) {
 void CodeGenerator::visitArrayAssignmentStmt(const ArrayAssignmentStmt &stmt) {
   stmt.target().accept(*this); // Push array
   stmt.index().accept(*this);  // Push index
-  stmt.value().accept(*this);  // Push value
+
+  // `a[i] = a[i] + v` is `a[i] += v` when nothing between the two reads of
+  // a[i] can change it
+  auto op = stmt.compoundOp();
+  const Expr *value = &stmt.value();
+  auto *binop = dynamic_cast<const BinaryOpExpr *>(value);
+  auto *element =
+      binop ? dynamic_cast<const IndexExpr *>(&binop->left()) : nullptr;
+  if (!op && element && binop->op() == BinaryOpExpr::Operator::PLUS &&
+      sameValue(element->target(), stmt.target()) &&
+      sameValue(element->index(), stmt.index()) && !hasCall(binop->right())) {
+    op = BinaryOpExpr::Operator::PLUS;
+    value = &binop->right();
+  }
+
+  if (op == BinaryOpExpr::Operator::PLUS) {
+    value->accept(*this);
+    emit(Opcode::ARRAY_ADD_STORE);
+    return;
+  }
+  if (op) {
+    // Keep the array and index for the store
+    emit(Opcode::DUP2);
+    emit(Opcode::ARRAY_LOAD);
+    value->accept(*this);
+    emit(*op == BinaryOpExpr::Operator::MINUS ? Opcode::SUB : Opcode::MUL);
+  } else {
+    value->accept(*this); // Push value
+  }
   emit(Opcode::ARRAY_STORE);
 }
 
@@ -262,10 +671,126 @@ void CodeGenerator::visitPrintStmt(const PrintStmt &stmt) {
   emit(Opcode::PRINT);
 }
 
+namespace {
+
+bool endsWithExit(const std::vector<std::unique_ptr<Stmt>> &body) {
+  if (body.empty()) {
+    return false;
+  }
+  const Stmt *last = body.back().get();
+  return dynamic_cast<const ReturnStmt *>(last) ||
+         dynamic_cast<const BreakStmt *>(last) ||
+         dynamic_cast<const ContinueStmt *>(last);
+}
+
+void collectNames(const Expr &expr, std::vector<std::string> &names) {
+  if (auto *id = dynamic_cast<const IdentifierExpr *>(&expr)) {
+    names.push_back(id->name());
+  } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    collectNames(binop->left(), names);
+    collectNames(binop->right(), names);
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    collectNames(unary->operand(), names);
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(&expr)) {
+    collectNames(index->target(), names);
+    collectNames(index->index(), names);
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(&expr)) {
+    for (const auto &element : array->elements()) {
+      collectNames(*element, names);
+    }
+  } else if (auto *call = dynamic_cast<const FunctionCallExpr *>(&expr)) {
+    for (const auto &arg : call->args()) {
+      collectNames(*arg, names);
+    }
+  }
+}
+
+/**
+ * Collect the variables a statement reads or assigns. Returns false for
+ * statements that open a scope, whose slots depend on where they are emitted
+ */
+bool collectNames(const Stmt &stmt, std::vector<std::string> &names) {
+  auto list = [&](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    return std::all_of(stmts.begin(), stmts.end(), [&](const auto &s) {
+      return collectNames(*s, names);
+    });
+  };
+
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(&stmt)) {
+    names.push_back(assign->name());
+    collectNames(assign->value(), names);
+  } else if (auto *arrAssign =
+                 dynamic_cast<const ArrayAssignmentStmt *>(&stmt)) {
+    collectNames(arrAssign->target(), names);
+    collectNames(arrAssign->index(), names);
+    collectNames(arrAssign->value(), names);
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(&stmt)) {
+    collectNames(exprStmt->expr(), names);
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(&stmt)) {
+    collectNames(print->value(), names);
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(&stmt)) {
+    if (ret->value()) {
+      collectNames(*ret->value(), names);
+    }
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    collectNames(ifstmt->condition(), names);
+    return list(ifstmt->body());
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(&stmt)) {
+    collectNames(whilestmt->condition(), names);
+    return list(whilestmt->body());
+  } else if (dynamic_cast<const ForStmt *>(&stmt) ||
+             dynamic_cast<const ForInStmt *>(&stmt) ||
+             dynamic_cast<const ParallelForStmt *>(&stmt)) {
+    return false;
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    collectNames(switchstmt->value(), names);
+    return std::all_of(switchstmt->cases().begin(), switchstmt->cases().end(),
+                       [&](const SwitchCase &arm) { return list(arm.body); });
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    return list(block->statements());
+  }
+  return true;
+}
+
+// Widest range of int labels compiled to a TABLE_SWITCH
+constexpr int64_t kMaxSwitchTableSpan = 1024;
+
+} // namespace
+
 void CodeGenerator::visitIfStmt(const IfStmt &stmt) {
   // Generate condition
   stmt.condition().accept(*this);
 
+  // A body that only leaves the loop is a single jump on the condition
+  if (stmt.body().size() == 1 && !loopStack_.empty()) {
+    const Stmt &only = *stmt.body().front();
+    LoopContext &loop = loopStack_.back();
+    if (dynamic_cast<const BreakStmt *>(&only) && !loop.parallel) {
+      size_t jump = emitJump(Opcode::JUMP_IF_NOT_ZERO);
+      loop.breakJumps.push_back(jump);
+      addBranchSite(stmt, false, jump);
+      return;
+    }
+    if (dynamic_cast<const ContinueStmt *>(&only)) {
+      size_t jump = emitJump(Opcode::JUMP_IF_NOT_ZERO);
+      if (loop.continueTarget != -1) {
+        patchJump(jump, static_cast<uint16_t>(loop.continueTarget));
+      } else {
+        loop.continueJumps.push_back(jump);
+      }
+      addBranchSite(stmt, false, jump);
+      return;
+    }
+  }
+
+  // An unlikely body moves out of line, so the likely path falls through
+  if (isUnlikely(stmt)) {
+    size_t jump = emitJump(Opcode::JUMP_IF_NOT_ZERO);
+    coldBlocks_.push_back({&stmt, jump, currentIndex()});
+    addBranchSite(stmt, false, jump);
+    return;
+  }
+
   // Jump to end if zero (false)
   uint16_t jumpToEnd = emit(Opcode::JUMP_IF_ZERO, 0);
 
@@ -276,40 +801,32 @@ void CodeGenerator::visitIfStmt(const IfStmt &stmt) {
 
   // Patch jump to point to after body
   patchJump(jumpToEnd, currentIndex());
+  addBranchSite(stmt, false, jumpToEnd);
 }
 
 void CodeGenerator::visitWhileStmt(const WhileStmt &stmt) {
-  // Loop start
-  uint16_t loopStart = currentIndex();
-
-  // Push loop context
-  loopStack_.push_back(
-      {(int)loopStart, {}, {}}); // continue target is loopStart
-
-  // Generate condition
-  stmt.condition().accept(*this);
+  // The condition sits after the body, so each iteration takes one jump
+  // (the back edge) instead of two; the loop is entered by jumping to it
+  size_t entry = emitJump(Opcode::JUMP);
+  uint16_t bodyStart = currentIndex();
 
-  // Jump to end if zero (false)
-  size_t jumpToEnd = emitJump(Opcode::JUMP_IF_ZERO);
+  // Push loop context (continue target is the condition, not yet emitted)
+  loopStack_.push_back({-1, {}, {}, coldBlocks_.size()});
 
   // Generate body
   for (const auto &s : stmt.body()) {
     s->accept(*this);
   }
 
-  // Jump back to start
-  emit(Opcode::JUMP, loopStart);
-
-  // Patch exit jump
-  patchJump(jumpToEnd, currentIndex());
-
-  // Patch breaks
-  uint16_t endIp = currentIndex();
-  for (size_t offset : loopStack_.back().breakJumps) {
-    patchJump(offset, endIp);
-  }
+  // Condition, jumping back while it holds
+  uint16_t test = currentIndex();
+  loopStack_.back().continueTarget = test;
+  patchJump(entry, test);
+  stmt.condition().accept(*this);
+  uint16_t backEdge = emit(Opcode::JUMP_IF_NOT_ZERO, bodyStart);
+  addBranchSite(stmt, true, backEdge, entry);
 
-  loopStack_.pop_back();
+  endLoop();
 }
 
 void CodeGenerator::visitForStmt(const ForStmt &stmt) {
@@ -319,54 +836,215 @@ void CodeGenerator::visitForStmt(const ForStmt &stmt) {
     stmt.init()->accept(*this);
   }
 
-  // 2. Start Label
-  uint16_t startIp = currentIndex();
-
-  // 3. Loop Context
-  loopStack_.push_back({-1, {}, {}}); // continueTarget is -1 initially
-
-  // 4. Condition
-  size_t jumpToEnd = -1;
+  // 2. Enter at the condition, which follows the body as in while loops
+  size_t entry = -1;
   if (stmt.condition()) {
-    stmt.condition()->accept(*this);
-    jumpToEnd = emitJump(Opcode::JUMP_IF_ZERO);
+    entry = emitJump(Opcode::JUMP);
   }
+  uint16_t bodyStart = currentIndex();
 
-  // 5. Body
+  // 3. Loop Context
+  loopStack_.push_back(
+      {-1, {}, {}, coldBlocks_.size()}); // continueTarget is -1 initially
+
+  // 4. Body
   for (const auto &s : stmt.body()) {
     s->accept(*this);
   }
 
-  // 6. Continue Target (Start of increment)
+  // 5. Continue Target (Start of increment)
   loopStack_.back().continueTarget = (int)currentIndex();
 
-  // 7. Increment
+  // 6. Increment
   if (stmt.increment()) {
     stmt.increment()->accept(*this);
   }
 
-  // 8. Jump to start
-  emit(Opcode::JUMP, startIp);
+  // 7. Condition, jumping back while it holds
+  if (stmt.condition()) {
+    patchJump(entry, currentIndex());
+    stmt.condition()->accept(*this);
+    uint16_t backEdge = emit(Opcode::JUMP_IF_NOT_ZERO, bodyStart);
+    addBranchSite(stmt, true, backEdge, entry);
+  } else {
+    emit(Opcode::JUMP, bodyStart);
+  }
 
-  // 9. Patch Break/Continue/End
-  uint16_t endIp = currentIndex();
-  if (jumpToEnd != (size_t)-1) {
-    patchJump(jumpToEnd, endIp);
+  // 8. Cold blocks, Break/Continue
+  endLoop();
+  scopes_.pop_back();
+}
+
+void CodeGenerator::visitForInStmt(const ForInStmt &stmt) {
+  // ITER_NEXT works on three consecutive slots of a new scope: the array,
+  // the next index and the element. The names cannot clash with variables,
+  // and the depth keeps nested loops apart
+  checkParallelWrite(stmt.variable());
+  scopes_.emplace_back();
+  std::string depth = std::to_string(scopes_.size());
+  stmt.iterable().accept(*this);
+  uint16_t state = getOrCreateLocal(" array" + depth);
+  emit(Opcode::STORE, state);
+  emit(Opcode::CONST, addConstant(0));
+  emit(Opcode::STORE, getOrCreateLocal(" index" + depth));
+
+  // A new loop variable is the element slot itself; an existing one gets a
+  // copy at the top of the body
+  bool declared = std::any_of(
+      scopes_.begin(), scopes_.end(),
+      [&](const auto &scope) { return scope.count(stmt.variable()) > 0; });
+  uint16_t element = getOrCreateLocal(
+      declared ? " element" + depth : stmt.variable());
+
+  // Entered at the test after the body, as in while loops
+  size_t entry = emitJump(Opcode::JUMP);
+  uint16_t bodyStart = currentIndex();
+  loopStack_.push_back({-1, {}, {}, coldBlocks_.size()});
+  if (declared) {
+    emit(Opcode::LOAD, element);
+    emit(Opcode::STORE, getLocal(stmt.variable()));
+  }
+  for (const auto &s : stmt.body()) {
+    s->accept(*this);
   }
 
-  // Patch breaks to endIp
-  for (size_t offset : loopStack_.back().breakJumps) {
-    patchJump(offset, endIp);
+  uint16_t test = currentIndex();
+  loopStack_.back().continueTarget = test;
+  patchJump(entry, test);
+  emit(Opcode::ITER_NEXT, state);
+  uint16_t backEdge = emit(Opcode::JUMP_IF_NOT_ZERO, bodyStart);
+  addBranchSite(stmt, true, backEdge, entry);
+
+  endLoop();
+  scopes_.pop_back();
+}
+
+void CodeGenerator::visitParallelForStmt(const ParallelForStmt &stmt) {
+  // Reduced variables must already exist, and an enclosing parallel for
+  // must reduce them too, with the same operator
+  ParallelLoop loop;
+  for (const auto &reduction : stmt.reductions()) {
+    checkParallelWrite(reduction.variable);
+    for (const auto &outer : parallelStack_) {
+      for (const auto &other : outer.reductions) {
+        if (other.variable == reduction.variable && other.op != reduction.op) {
+          throw CodegenError("Nested parallel for reduces '" +
+                             reduction.variable + "' with another operator");
+        }
+      }
+    }
+    loop.reductions.push_back({getLocal(reduction.variable), reduction.op});
+  }
+  for (const auto &s : stmt.body()) {
+    collectReductionUpdates(*s, stmt.reductions(), reductionUses_);
   }
 
-  // Patch continues to continueTarget
-  uint16_t continueTarget = (uint16_t)loopStack_.back().continueTarget;
-  for (size_t offset : loopStack_.back().continueJumps) {
-    patchJump(offset, continueTarget);
+  // The loop variable is always new, and the end is kept in the next slot
+  stmt.start().accept(*this);
+  stmt.end().accept(*this);
+  scopes_.emplace_back();
+  loop.indexSlot = declareLocal(stmt.variable());
+  uint16_t end = declareLocal(" end" + std::to_string(scopes_.size()));
+  emit(Opcode::STORE, end);
+  emit(Opcode::STORE, loop.indexSlot);
+
+  // Nested loops add entries while the body is generated
+  auto index = static_cast<uint16_t>(program_.parallelLoops.size());
+  program_.parallelLoops.emplace_back();
+  emit(Opcode::PARALLEL_FOR, index);
+  loop.bodyStart = currentIndex();
+  loopStack_.push_back({-1, {}, {}, coldBlocks_.size(), true});
+  parallelStack_.push_back(
+      {scopes_.size() - 1, stmt.variable(), stmt.reductions()});
+  for (const auto &s : stmt.body()) {
+    s->accept(*this);
   }
 
-  loopStack_.pop_back();
+  loopStack_.back().continueTarget = currentIndex();
+  emit(Opcode::PARALLEL_NEXT, index);
+  endLoop();
+  parallelStack_.pop_back();
+  if (parallelStack_.empty()) {
+    reductionUses_.clear();
+  }
   scopes_.pop_back();
+  loop.exit = currentIndex();
+  program_.parallelLoops[index] = std::move(loop);
+}
+
+void CodeGenerator::visitSwitchStmt(const SwitchStmt &stmt) {
+  stmt.value().accept(*this);
+
+  // Int labels that fill at least half of their range index a table;
+  // sparse ranges and string labels are hashed
+  int64_t low = INT32_MAX;
+  int64_t high = INT32_MIN;
+  int64_t intLabels = 0;
+  bool stringLabels = false;
+  for (const auto &arm : stmt.cases()) {
+    for (const auto &label : arm.labels) {
+      if (auto *num = dynamic_cast<const NumberExpr *>(label.get())) {
+        low = std::min<int64_t>(low, num->value());
+        high = std::max<int64_t>(high, num->value());
+        ++intLabels;
+      } else {
+        stringLabels = true;
+      }
+    }
+  }
+  int64_t span = high - low + 1;
+  bool dense = !stringLabels && intLabels > 0 && span <= kMaxSwitchTableSpan &&
+               span <= 2 * intLabels;
+
+  // Nested switches add tables while the arms are generated
+  auto index = static_cast<uint16_t>(program_.switchTables.size());
+  program_.switchTables.emplace_back();
+  emit(dense ? Opcode::TABLE_SWITCH : Opcode::LOOKUP_SWITCH, index);
+
+  // Arms in source order, each jumping past the rest unless it exits
+  SwitchTable table;
+  bool hasDefault = false;
+  std::vector<size_t> exits;
+  const auto &cases = stmt.cases();
+  for (size_t i = 0; i < cases.size(); ++i) {
+    uint16_t start = currentIndex();
+    for (const auto &label : cases[i].labels) {
+      if (auto *num = dynamic_cast<const NumberExpr *>(label.get())) {
+        table.intCases[num->value()] = start;
+      } else {
+        auto &str = static_cast<const StringLiteralExpr &>(*label);
+        table.stringCases[str.value()] = start;
+      }
+    }
+    if (cases[i].labels.empty()) {
+      table.defaultTarget = start;
+      hasDefault = true;
+    }
+
+    for (const auto &s : cases[i].body) {
+      s->accept(*this);
+    }
+    if (i + 1 < cases.size() && !endsWithExit(cases[i].body)) {
+      exits.push_back(emitJump(Opcode::JUMP));
+    }
+  }
+
+  uint16_t endIp = currentIndex();
+  for (size_t offset : exits) {
+    patchJump(offset, endIp);
+  }
+  if (!hasDefault) {
+    table.defaultTarget = endIp;
+  }
+  if (dense) {
+    table.low = static_cast<int32_t>(low);
+    table.targets.assign(static_cast<size_t>(span), table.defaultTarget);
+    for (const auto &[value, target] : table.intCases) {
+      table.targets[static_cast<size_t>(value - low)] = target;
+    }
+    table.intCases.clear();
+  }
+  program_.switchTables[index] = std::move(table);
 }
 
 void CodeGenerator::visitBreakStmt(const BreakStmt &stmt) {
@@ -374,6 +1052,9 @@ void CodeGenerator::visitBreakStmt(const BreakStmt &stmt) {
   if (loopStack_.empty()) {
     throw CodegenError("Break statement outside of loop");
   }
+  if (loopStack_.back().parallel) {
+    throw CodegenError("Cannot break out of a parallel for");
+  }
   loopStack_.back().breakJumps.push_back(emitJump(Opcode::JUMP));
 }
 
@@ -391,6 +1072,9 @@ void CodeGenerator::visitContinueStmt(const ContinueStmt &stmt) {
 }
 
 void CodeGenerator::visitReturnStmt(const ReturnStmt &stmt) {
+  if (!parallelStack_.empty()) {
+    throw CodegenError("Cannot return from inside a parallel for");
+  }
   if (stmt.value()) {
     stmt.value()->accept(*this);
   } else {
@@ -424,6 +1108,7 @@ void CodeGenerator::visitFunctionDecl(const FunctionDecl &decl) {
   // Implicit return 0 if no explicit return
   emit(Opcode::CONST, addConstant(0));
   emit(Opcode::RETURN);
+  emitColdBlocks(0);
 
   endFunction();
 }
@@ -444,6 +1129,13 @@ uint16_t CodeGenerator::emit(Opcode op, uint16_t operand) {
   instr.opcode = static_cast<uint8_t>(op);
   instr.operand = operand;
 
+  // Jump operands are 16 bits and 0xFFFF marks lazy functions
+  if (program_.code.size() + 1 >= LAZY_FUNCTION_ENTRY) {
+    throw CodegenError("Program too large: more than " +
+                       std::to_string(LAZY_FUNCTION_ENTRY - 1) +
+                       " instructions");
+  }
+
   uint16_t index = static_cast<uint16_t>(program_.code.size());
   program_.code.push_back(instr);
   return index;
@@ -477,14 +1169,17 @@ uint16_t CodeGenerator::getOrCreateLocal(const std::string &name) {
   }
 
   // Not found in any scope - create in current (innermost) scope
-  auto &scope = scopes_.back();
+  return declareLocal(name);
+}
 
+uint16_t CodeGenerator::declareLocal(const std::string &name) {
   // Calculate next available slot
   uint16_t slot = 0;
   for (const auto &s : scopes_)
     slot += s.size();
 
-  scope[name] = slot;
+  scopes_.back()[name] = slot;
+  peakLocals_ = std::max<uint16_t>(peakLocals_, slot + 1);
   return slot;
 }
 
@@ -501,6 +1196,69 @@ uint16_t CodeGenerator::getLocal(const std::string &name) const {
 
 bool CodeGenerator::isGlobalScope() const { return currentFunction_.empty(); }
 
+void CodeGenerator::checkParallelWrite(const std::string &name) const {
+  // Innermost scope that declares the name, if any
+  size_t scope = scopes_.size();
+  for (size_t i = scopes_.size(); i-- > 0;) {
+    if (scopes_[i].count(name)) {
+      scope = i;
+      break;
+    }
+  }
+  for (const auto &loop : parallelStack_) {
+    if (name == loop.variable && scope == loop.scope) {
+      throw CodegenError("Cannot assign loop variable '" + name +
+                         "' of a parallel for");
+    }
+    bool reduced =
+        std::any_of(loop.reductions.begin(), loop.reductions.end(),
+                    [&](const ::Reduction &r) { return r.variable == name; });
+    if (scope < loop.scope && !reduced) {
+      throw CodegenError("Cannot assign '" + name +
+                         "' inside a parallel for; add it to reduce(...)");
+    }
+  }
+}
+
+void CodeGenerator::checkReductionUse(const ASTNode &node,
+                                      const std::string &name) const {
+  if (parallelStack_.empty()) {
+    return;
+  }
+  size_t scope = scopes_.size();
+  for (size_t i = scopes_.size(); i-- > 0;) {
+    if (scopes_[i].count(name)) {
+      scope = i;
+      break;
+    }
+  }
+  for (const auto &loop : parallelStack_) {
+    const ::Reduction *reduction = findReduction(loop.reductions, name);
+    if (!reduction || scope >= loop.scope) {
+      continue;
+    }
+    auto it = reductionUses_.find(&node);
+    if (it != reductionUses_.end() && it->second == reduction->op) {
+      return;
+    }
+    switch (reduction->op) {
+    case ::Reduction::Operator::SUM:
+      throw CodegenError("Reduction '+: " + name +
+                         "' may only be updated as '" + name + " = " + name +
+                         " + e' or '" + name + " = " + name +
+                         " - e' inside a parallel for");
+    case ::Reduction::Operator::MIN:
+      throw CodegenError("Reduction 'min: " + name +
+                         "' may only be updated as 'if (e < " + name + ") { " +
+                         name + " = e; }' inside a parallel for");
+    case ::Reduction::Operator::MAX:
+      throw CodegenError("Reduction 'max: " + name +
+                         "' may only be updated as 'if (e > " + name + ") { " +
+                         name + " = e; }' inside a parallel for");
+    }
+  }
+}
+
 void CodeGenerator::patchJump(size_t jumpIndex, uint16_t target) {
   program_.code[jumpIndex].operand = target;
 }
@@ -509,11 +1267,105 @@ uint16_t CodeGenerator::currentIndex() const {
   return static_cast<uint16_t>(program_.code.size());
 }
 
+bool CodeGenerator::isUnlikely(const IfStmt &stmt) const {
+  // Top-level REPL input has no end to move the body to
+  if (incremental_ && isGlobalScope() && loopStack_.empty()) {
+    return false;
+  }
+
+  // The body must mean the same wherever it is emitted
+  std::vector<std::string> names;
+  for (const auto &s : stmt.body()) {
+    if (!collectNames(*s, names)) {
+      return false;
+    }
+  }
+  for (const auto &name : names) {
+    bool found = std::any_of(scopes_.begin(), scopes_.end(),
+                             [&](const auto &scope) {
+                               return scope.count(name) > 0;
+                             });
+    if (!found) {
+      return false;
+    }
+  }
+
+  // Out of line, a body that runs costs a jump there and one back (the
+  // second is skipped if it exits) and a skipped one costs none; inline,
+  // skipping costs one jump
+  bool exits = endsWithExit(stmt.body());
+  const BranchProfile *counts =
+      profile_ && stmt.line() > 0
+          ? profile_->branch(currentFunction_, stmt.line())
+          : nullptr;
+  if (counts) {
+    if (counts->total == 0) {
+      return true; // Never reached
+    }
+    return counts->takenRatio() < (exits ? 1.0 / 2 : 1.0 / 3);
+  }
+
+  // Without counts, assume loops keep looping
+  if (loopStack_.empty() || !exits) {
+    return false;
+  }
+  const Stmt *last = stmt.body().back().get();
+  return dynamic_cast<const BreakStmt *>(last) ||
+         dynamic_cast<const ReturnStmt *>(last);
+}
+
+void CodeGenerator::emitColdBlocks(size_t first) {
+  // Blocks emitted here may defer blocks of their own, which are appended
+  for (size_t i = first; i < coldBlocks_.size(); ++i) {
+    ColdBlock block = coldBlocks_[i];
+    patchJump(block.jump, currentIndex());
+    for (const auto &s : block.stmt->body()) {
+      s->accept(*this);
+    }
+    if (!endsWithExit(block.stmt->body())) {
+      emit(Opcode::JUMP, block.resume);
+    }
+  }
+  coldBlocks_.resize(first);
+}
+
+void CodeGenerator::endLoop() {
+  // Cold blocks go after the loop, skipped by the exit path
+  size_t coldStart = loopStack_.back().coldStart;
+  if (coldBlocks_.size() > coldStart) {
+    size_t skip = emitJump(Opcode::JUMP);
+    emitColdBlocks(coldStart);
+    patchJump(skip, currentIndex());
+  }
+
+  // Patch breaks to the end and continues to the continue target
+  const LoopContext &loop = loopStack_.back();
+  uint16_t endIp = currentIndex();
+  for (size_t offset : loop.breakJumps) {
+    patchJump(offset, endIp);
+  }
+  for (size_t offset : loop.continueJumps) {
+    patchJump(offset, static_cast<uint16_t>(loop.continueTarget));
+  }
+
+  loopStack_.pop_back();
+}
+
+void CodeGenerator::addBranchSite(const Stmt &stmt, bool loop, size_t test,
+                                  size_t entry) {
+  if (stmt.line() > 0) {
+    program_.branchSites.push_back({currentFunction_, stmt.line(), loop,
+                                    static_cast<uint16_t>(test),
+                                    static_cast<uint16_t>(entry)});
+  }
+}
+
 void CodeGenerator::beginFunction(const std::string &name,
                                   const std::vector<std::string> &params) {
   currentFunction_ = name;
   scopes_.clear();
   scopes_.emplace_back(); // Function scope
+  peakLocals_ = 0;
 
   // Add parameters as local variables (in order)
   for (const auto &param : params) {
@@ -521,43 +1373,65 @@ void CodeGenerator::beginFunction(const std::string &name,
   }
 }
 
+void CodeGenerator::registerFunctions(const Program &program) {
+  for (const auto &item : program.items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      FunctionInfo info;
+      info.name = fn->name();
+      info.entry = 0; // Will be set during code generation
+      info.arity = static_cast<uint8_t>(fn->params().size());
+      info.localCount = 0;
+
+      // A REPL redefinition replaces the body behind the existing index
+      auto existing = functionMap_.find(fn->name());
+      if (incremental_ && existing != functionMap_.end() &&
+          program_.functions[existing->second].arity == info.arity) {
+        program_.functions[existing->second] = info;
+        continue;
+      }
+
+      functionMap_[fn->name()] =
+          static_cast<uint16_t>(program_.functions.size());
+      program_.functions.push_back(info);
+    }
+  }
+}
+
 void CodeGenerator::endFunction() {
   // Record local count
   auto it = functionMap_.find(currentFunction_);
   if (it != functionMap_.end()) {
-    // Total locals is sum of all items in all scopes?
-    // Since scopes are popped, correct way is to track max slot used?
-    // Or just current count if we don't support blocks with distinct stack
-    // slots? My getOrCreateLocal implementation sums sizes of ALL ACTIVE
-    // scopes. But since I assume flat slots for now, this is simple. Wait,
-    // getOrCreateLocal logic: `slot = 0; for(s) slot += s.size();` This assigns
-    // slots 0, 1, 2... based on current active variables. If I enter block, add
-    // var (slot 3), exit block. Next var (slot 3). This allows REUSE of slots!
-    // But for `localCount` in function info, I need PEAK slot usage.
-    // I am not tracking peak.
-    // I should fix getOrCreateLocal logic to use unique slots per function if
-    // proper debugging needed. For now, let's just use `locals_.size()`
-    // equivalent: sum of active scopes. But since scopes are popped, this
-    // number shrinks. This assumes variables in parallel blocks reuse slots.
-    // This is optimizing! But `localCount` in `FunctionInfo` must be size of
-    // `locals_` vector in VM. So I need max slot index + 1. I need to track
-    // `maxLocals_` in `CodeGenerator`. I'll leave it as is for now, but
-    // `endFunction` calculation is tricky.
-
-    // Quick fix: Iterating active scopes only gives CURRENT locals.
-    // CodeGenerator needs to track `maxLocals`.
-    // Since I can't add member easily now without touching header again?
-    // I added `loopStack_` in header. I can add `maxLocals_`.
-    // I'll assume standard behavior for now: Just use 255 or something safe?
-    // No. I will modify header again if needed. For this step, I'll calculate
-    // based on current scopes (which is top level scope of function).
-    uint8_t count = 0;
-    for (const auto &s : scopes_)
-      count += s.size();
-    program_.functions[it->second].localCount = count;
+    // Slots are reused once a nested scope closes, so the frame needs the
+    // peak number of live slots rather than what is active at the end
+    if (peakLocals_ > UINT8_MAX) {
+      throw CodegenError("Too many local variables in function: " +
+                         currentFunction_);
+    }
+    program_.functions[it->second].localCount =
+        static_cast<uint8_t>(peakLocals_);
   }
 
   currentFunction_.clear();
   scopes_.clear();
   scopes_.emplace_back(); // Global scope
 }
+
+// ============================================================================
+// Lazy Function Compiler Implementation
+// ============================================================================
+
+LazyFunctionCompiler::LazyFunctionCompiler(const Program &ast,
+                                           const ProfileData *profile)
+{
+  codegen_.setProfile(profile);
+  program_ = codegen_.generateLazy(ast);
+}
+
+void LazyFunctionCompiler::compile(uint16_t funcIndex) {
+  if (funcIndex >= program_.functions.size() ||
+      program_.functions[funcIndex].entry != LAZY_FUNCTION_ENTRY) {
+    return;
+  }
+  codegen_.compileFunction(program_, funcIndex);
+  ++compiled_;
+}
@@ -0,0 +1,200 @@
+#include "effects.h"
+#include "callgraph.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Construction
+// ============================================================================
+
+EffectAnalysis::EffectAnalysis(const Program &program) {
+  CallGraph graph(program);
+
+  std::unordered_map<std::string, std::vector<std::string>> calls;
+  for (const auto &item : program.items()) {
+    auto *fn = dynamic_cast<const FunctionDecl *>(item.get());
+    if (!fn || !graph.isReachable(fn->name())) {
+      continue;
+    }
+    FunctionEffects &effects = effects_[fn->name()];
+    for (const auto &stmt : fn->body()) {
+      effects.prints = effects.prints || containsPrint(*stmt);
+      collectArrayAccesses(*stmt, effects);
+      CallGraph::collectCalls(stmt.get(), calls[fn->name()]);
+    }
+    effects.recursive = graph.isRecursive(fn->name());
+  }
+
+  // A call does whatever its callee does; unknown callees may do anything
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const auto &[name, callees] : calls) {
+      FunctionEffects &effects = effects_.at(name);
+      FunctionEffects merged = effects;
+      for (const auto &callee : callees) {
+        auto it = effects_.find(callee);
+        if (it == effects_.end()) {
+          merged.callsUnknown = true;
+          continue;
+        }
+        merged.prints = merged.prints || it->second.prints;
+        merged.readsArrays = merged.readsArrays || it->second.readsArrays;
+        merged.writesArrays = merged.writesArrays || it->second.writesArrays;
+        merged.callsUnknown = merged.callsUnknown || it->second.callsUnknown;
+      }
+      if (merged.prints != effects.prints ||
+          merged.readsArrays != effects.readsArrays ||
+          merged.writesArrays != effects.writesArrays ||
+          merged.callsUnknown != effects.callsUnknown) {
+        effects = merged;
+        changed = true;
+      }
+    }
+  }
+
+  for (const auto &[name, effects] : effects_) {
+    if (effects.pure()) {
+      pure_.insert(name);
+    }
+  }
+}
+
+const FunctionEffects *EffectAnalysis::effectsOf(const std::string &fn) const {
+  auto it = effects_.find(fn);
+  return it == effects_.end() ? nullptr : &it->second;
+}
+
+std::string FunctionEffects::describe() const {
+  std::string text = pure() ? "pure" : "impure";
+  if (prints) {
+    text += ", prints";
+  }
+  if (callsUnknown) {
+    text += ", calls unknown functions";
+  }
+  if (readsArrays) {
+    text += ", reads arrays";
+  }
+  if (writesArrays) {
+    text += ", writes arrays";
+  }
+  if (recursive) {
+    text += ", recursive";
+  }
+  return text;
+}
+
+// ============================================================================
+// AST Walkers
+// ============================================================================
+
+bool EffectAnalysis::containsPrint(const Stmt &stmt) {
+  auto list = [](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    return std::any_of(stmts.begin(), stmts.end(),
+                       [](const auto &s) { return containsPrint(*s); });
+  };
+
+  if (dynamic_cast<const PrintStmt *>(&stmt)) {
+    return true;
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    return list(ifstmt->body());
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    return std::any_of(switchstmt->cases().begin(), switchstmt->cases().end(),
+                       [&](const SwitchCase &arm) { return list(arm.body); });
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(&stmt)) {
+    return list(whilestmt->body());
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(&stmt)) {
+    return (forstmt->init() && containsPrint(*forstmt->init())) ||
+           (forstmt->increment() && containsPrint(*forstmt->increment())) ||
+           list(forstmt->body());
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(&stmt)) {
+    return list(forin->body());
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(&stmt)) {
+    return list(parallel->body());
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    return list(block->statements());
+  }
+  return false;
+}
+
+void EffectAnalysis::collectArrayAccesses(const Stmt &stmt,
+                                          FunctionEffects &effects) {
+  auto list = [&](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    for (const auto &s : stmts) {
+      collectArrayAccesses(*s, effects);
+    }
+  };
+
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(&stmt)) {
+    collectArrayAccesses(assign->value(), effects);
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(&stmt)) {
+    effects.writesArrays = true;
+    collectArrayAccesses(arrAssign->target(), effects);
+    collectArrayAccesses(arrAssign->index(), effects);
+    collectArrayAccesses(arrAssign->value(), effects);
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(&stmt)) {
+    collectArrayAccesses(exprStmt->expr(), effects);
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(&stmt)) {
+    collectArrayAccesses(print->value(), effects);
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(&stmt)) {
+    if (ret->value()) {
+      collectArrayAccesses(*ret->value(), effects);
+    }
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    collectArrayAccesses(ifstmt->condition(), effects);
+    list(ifstmt->body());
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    collectArrayAccesses(switchstmt->value(), effects);
+    for (const auto &arm : switchstmt->cases()) {
+      list(arm.body);
+    }
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(&stmt)) {
+    collectArrayAccesses(whilestmt->condition(), effects);
+    list(whilestmt->body());
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(&stmt)) {
+    if (forstmt->init()) {
+      collectArrayAccesses(*forstmt->init(), effects);
+    }
+    if (forstmt->condition()) {
+      collectArrayAccesses(*forstmt->condition(), effects);
+    }
+    if (forstmt->increment()) {
+      collectArrayAccesses(*forstmt->increment(), effects);
+    }
+    list(forstmt->body());
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(&stmt)) {
+    effects.readsArrays = true;
+    collectArrayAccesses(forin->iterable(), effects);
+    list(forin->body());
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(&stmt)) {
+    collectArrayAccesses(parallel->start(), effects);
+    collectArrayAccesses(parallel->end(), effects);
+    list(parallel->body());
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    list(block->statements());
+  }
+}
+
+void EffectAnalysis::collectArrayAccesses(const Expr &expr,
+                                          FunctionEffects &effects) {
+  if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    collectArrayAccesses(binop->left(), effects);
+    collectArrayAccesses(binop->right(), effects);
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    collectArrayAccesses(unary->operand(), effects);
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(&expr)) {
+    effects.readsArrays = true;
+    collectArrayAccesses(index->target(), effects);
+    collectArrayAccesses(index->index(), effects);
+  } else if (auto *call = dynamic_cast<const FunctionCallExpr *>(&expr)) {
+    for (const auto &arg : call->args()) {
+      collectArrayAccesses(*arg, effects);
+    }
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(&expr)) {
+    for (const auto &element : array->elements()) {
+      collectArrayAccesses(*element, effects);
+    }
+  }
+}
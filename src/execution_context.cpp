@@ -0,0 +1,22 @@
+#include "execution_context.h"
+
+ExecutionContext::ExecutionContext(
+    std::shared_ptr<const BytecodeProgram> program)
+    : program_(std::move(program)) {
+  for (const auto &fn : program_->functions) {
+    if (fn.entry == LAZY_FUNCTION_ENTRY) {
+      throw VMError("Cannot share a program with lazy function: " + fn.name);
+    }
+  }
+  vm_.setOutputStream(output_);
+}
+
+Value ExecutionContext::execute(Profiler *profiler) {
+  return vm_.execute(*program_, profiler);
+}
+
+std::string ExecutionContext::takeOutput() {
+  std::string text = output_.str();
+  output_.str("");
+  return text;
+}
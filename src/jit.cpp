@@ -0,0 +1,862 @@
+#include "jit.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+bool isComparison(Opcode op) {
+  return op == Opcode::EQ || op == Opcode::NEQ || op == Opcode::LT ||
+         op == Opcode::LTE || op == Opcode::GT || op == Opcode::GTE;
+}
+
+bool canFail(Opcode op) { return op == Opcode::DIV || op == Opcode::MOD; }
+
+int32_t wrap(int64_t value) {
+  return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+} // namespace
+
+// ============================================================================
+// Bookkeeping
+// ============================================================================
+
+void TraceJit::reset() {
+  hotness_.clear();
+  failures_.clear();
+  traces_.clear();
+  recording_.reset();
+}
+
+const Trace *TraceJit::traceFor(uint16_t header) const {
+  auto it = traces_.find(header);
+  return it != traces_.end() ? it->second.get() : nullptr;
+}
+
+void TraceJit::onBackwardJump(uint16_t header) {
+  if (recording_ || traces_.count(header)) {
+    return;
+  }
+  if (failures_[header] >= MAX_RECORD_ATTEMPTS) {
+    return; // Blacklisted: this loop keeps doing untraceable things
+  }
+  if (++hotness_[header] < HOT_LOOP_THRESHOLD) {
+    return;
+  }
+  hotness_[header] = 0;
+  recording_ = std::make_unique<Recording>();
+  recording_->header = header;
+}
+
+void TraceJit::abortRecording() {
+  if (!recording_) {
+    return;
+  }
+  failures_[recording_->header]++;
+  stats_.recordingsAborted++;
+  recording_.reset();
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+void TraceJit::record(const BytecodeProgram &program, uint16_t ip,
+                      const std::vector<Value> &stack,
+                      const std::vector<Value> &locals, uint16_t basePointer) {
+  Recording &rec = *recording_;
+  if (rec.ops.size() >= MAX_TRACE_LENGTH || ip >= program.code.size()) {
+    abortRecording();
+    return;
+  }
+  ++rec.instructions;
+
+  const Instruction &instr = program.code[ip];
+  auto op = static_cast<Opcode>(instr.opcode);
+  uint16_t operand = instr.operand;
+  auto &kinds = rec.kinds;
+
+  auto topIsInt = [&](size_t n) {
+    if (kinds.size() < n)
+      return false;
+    for (size_t i = 0; i < n; ++i) {
+      if (kinds[kinds.size() - 1 - i] != -1)
+        return false;
+    }
+    return true;
+  };
+
+  TraceOp t;
+  t.ip = ip;
+  t.executed = static_cast<uint32_t>(rec.instructions - 1);
+
+  switch (op) {
+  case Opcode::CONST:
+    if (operand >= program.constants.size() ||
+        !program.constants[operand].isInt()) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::PUSH_INT;
+    t.imm = program.constants[operand].asInt();
+    kinds.push_back(-1);
+    break;
+
+  case Opcode::LOAD: {
+    size_t slot = static_cast<uint16_t>(basePointer + operand);
+    if (slot >= locals.size()) {
+      abortRecording();
+      return;
+    }
+    t.slot = operand;
+    if (locals[slot].isInt()) {
+      t.kind = TraceOpKind::LOAD_INT;
+      kinds.push_back(-1);
+    } else if (locals[slot].isArray()) {
+      t.kind = TraceOpKind::LOAD_ARRAY;
+      kinds.push_back(operand);
+    } else {
+      abortRecording();
+      return;
+    }
+    break;
+  }
+
+  case Opcode::STORE:
+    if (!topIsInt(1)) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::STORE_INT;
+    t.slot = operand;
+    kinds.pop_back();
+    break;
+
+  case Opcode::ADD:
+  case Opcode::SUB:
+  case Opcode::MUL:
+  case Opcode::DIV:
+  case Opcode::MOD:
+  case Opcode::EQ:
+  case Opcode::NEQ:
+  case Opcode::LT:
+  case Opcode::LTE:
+  case Opcode::GT:
+  case Opcode::GTE:
+    if (!topIsInt(2)) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::BINARY;
+    t.op = op;
+    kinds.pop_back();
+    break;
+
+  case Opcode::SHL:
+  case Opcode::SHR:
+  case Opcode::MASK:
+    if (!topIsInt(1) || operand > MAX_SHIFT) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::BINARY;
+    t.op = op;
+    t.hasImmediate = true;
+    t.imm = operand;
+    break;
+
+  case Opcode::JUMP_IF_ZERO: {
+    if (!topIsInt(1)) {
+      abortRecording();
+      return;
+    }
+    bool zero = stack.back().asInt() == 0;
+    t.kind = TraceOpKind::GUARD;
+    // Leave the trace whenever the branch would go the other way
+    t.exitOnZero = !zero;
+    t.exitIp = zero ? static_cast<uint16_t>(ip + 1) : operand;
+    ++t.executed;
+    kinds.pop_back();
+    break;
+  }
+
+  case Opcode::JUMP_IF_NOT_ZERO: {
+    if (!topIsInt(1)) {
+      abortRecording();
+      return;
+    }
+    bool zero = stack.back().asInt() == 0;
+    t.kind = TraceOpKind::GUARD;
+    t.exitOnZero = !zero;
+    t.exitIp = zero ? operand : static_cast<uint16_t>(ip + 1);
+    ++t.executed;
+    kinds.pop_back();
+    if (zero || operand > ip) {
+      break;
+    }
+    // Taken backward: the condition of a rotated loop
+    if (operand != rec.header || !kinds.empty()) {
+      abortRecording(); // Inner loop or unbalanced stack
+      return;
+    }
+    rec.ops.push_back(t);
+    t.kind = TraceOpKind::LOOP;
+    rec.ops.push_back(t);
+    finishRecording();
+    return;
+  }
+
+  case Opcode::TABLE_SWITCH:
+  case Opcode::LOOKUP_SWITCH:
+    if (!topIsInt(1)) {
+      abortRecording();
+      return;
+    }
+    // Any other value re-dispatches at the switch in the interpreter
+    t.kind = TraceOpKind::SWITCH_GUARD;
+    t.imm = stack.back().asInt();
+    kinds.pop_back();
+    break;
+
+  case Opcode::JUMP:
+    if (operand > ip) {
+      return; // Forward jumps are simply followed
+    }
+    if (operand != rec.header || !kinds.empty()) {
+      abortRecording(); // Inner loop or unbalanced stack
+      return;
+    }
+    t.kind = TraceOpKind::LOOP;
+    rec.ops.push_back(t);
+    finishRecording();
+    return;
+
+  case Opcode::ARRAY_LOAD: {
+    if (!topIsInt(1) || kinds.size() < 2 || kinds[kinds.size() - 2] < 0) {
+      abortRecording();
+      return;
+    }
+    const auto &array = *stack[stack.size() - 2].asArray();
+    int32_t index = stack.back().asInt();
+    if (index < 0 || static_cast<size_t>(index) >= array.size() ||
+        !array[index].isInt()) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::ARRAY_LOAD_INT;
+    t.slot = static_cast<uint16_t>(kinds[kinds.size() - 2]);
+    kinds.pop_back();
+    kinds.back() = -1;
+    break;
+  }
+
+  case Opcode::ARRAY_STORE:
+    if (!topIsInt(2) || kinds.size() < 3 || kinds[kinds.size() - 3] < 0) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::ARRAY_STORE_INT;
+    t.slot = static_cast<uint16_t>(kinds[kinds.size() - 3]);
+    kinds.resize(kinds.size() - 3);
+    break;
+
+  case Opcode::ARRAY_ADD_STORE: {
+    if (!topIsInt(2) || kinds.size() < 3 || kinds[kinds.size() - 3] < 0) {
+      abortRecording();
+      return;
+    }
+    const auto &array = *stack[stack.size() - 3].asArray();
+    int32_t index = stack[stack.size() - 2].asInt();
+    if (index < 0 || static_cast<size_t>(index) >= array.size() ||
+        !array[index].isInt()) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::ARRAY_ADD_INT;
+    t.slot = static_cast<uint16_t>(kinds[kinds.size() - 3]);
+    kinds.resize(kinds.size() - 3);
+    break;
+  }
+
+  case Opcode::LOCAL_INC:
+  case Opcode::LOCAL_DEC: {
+    size_t slot = static_cast<uint16_t>(basePointer + operand);
+    if (!topIsInt(1) || slot >= locals.size() || !locals[slot].isInt()) {
+      abortRecording();
+      return;
+    }
+    bool constantStep =
+        !rec.ops.empty() && rec.ops.back().kind == TraceOpKind::PUSH_INT;
+    // The LOAD goes after a computed step, which only ADD can take
+    if (op == Opcode::LOCAL_DEC && !constantStep) {
+      abortRecording();
+      return;
+    }
+    // As LOAD, ADD/SUB, STORE; a constant step ends up as INC_LOCAL
+    TraceOp load = t;
+    load.kind = TraceOpKind::LOAD_INT;
+    load.slot = operand;
+    if (constantStep) {
+      TraceOp step = rec.ops.back();
+      rec.ops.back() = load;
+      rec.ops.push_back(step);
+    } else {
+      rec.ops.push_back(load);
+    }
+    TraceOp arith = t;
+    arith.kind = TraceOpKind::BINARY;
+    arith.op = op == Opcode::LOCAL_INC ? Opcode::ADD : Opcode::SUB;
+    rec.ops.push_back(arith);
+    t.kind = TraceOpKind::STORE_INT;
+    t.slot = operand;
+    kinds.pop_back();
+    break;
+  }
+
+  case Opcode::DUP2:
+    if (kinds.size() < 2) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::DUP2;
+    kinds.push_back(kinds[kinds.size() - 2]);
+    kinds.push_back(kinds[kinds.size() - 2]);
+    break;
+
+  case Opcode::ITER_NEXT: {
+    size_t slot = static_cast<uint16_t>(basePointer + operand);
+    if (slot + 2 >= locals.size() || !locals[slot].isArray() ||
+        !locals[slot + 1].isInt()) {
+      abortRecording();
+      return;
+    }
+    const auto &array = *locals[slot].asArray();
+    int32_t next = locals[slot + 1].asInt();
+    if (static_cast<size_t>(next) < array.size() && !array[next].isInt()) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::ITER_NEXT_INT;
+    t.slot = operand;
+    kinds.push_back(-1);
+    break;
+  }
+
+  case Opcode::POP:
+    if (kinds.empty()) {
+      abortRecording();
+      return;
+    }
+    t.kind = TraceOpKind::POP;
+    kinds.pop_back();
+    break;
+
+  default:
+    // Calls, returns, printing, strings, array construction and parallel
+    // loops stay in the interpreter
+    abortRecording();
+    return;
+  }
+
+  rec.ops.push_back(t);
+}
+
+void TraceJit::finishRecording() {
+  auto trace = std::make_unique<Trace>();
+  trace->header = recording_->header;
+  trace->ops = std::move(recording_->ops);
+  trace->length = recording_->instructions;
+
+  if (!computeEntryGuards(*trace)) {
+    abortRecording();
+    return;
+  }
+  foldConstants(trace->ops);
+  fuseOps(trace->ops);
+  computeShapes(*trace);
+
+  traces_[trace->header] = std::move(trace);
+  recording_.reset();
+  stats_.tracesCompiled++;
+}
+
+// ============================================================================
+// Optimization
+// ============================================================================
+
+bool TraceJit::computeEntryGuards(Trace &trace) {
+  // The trace is the only thing writing locals while it runs, and it only
+  // writes ints. So a type check at entry covers every iteration: ints read
+  // before being written and array slots never written.
+  std::unordered_set<uint16_t> stored;
+  std::unordered_set<uint16_t> ints;
+  std::unordered_set<uint16_t> arrays;
+
+  for (const auto &op : trace.ops) {
+    switch (op.kind) {
+    case TraceOpKind::LOAD_INT:
+      if (arrays.count(op.slot))
+        return false;
+      if (!stored.count(op.slot) && ints.insert(op.slot).second)
+        trace.intSlots.push_back(op.slot);
+      break;
+    case TraceOpKind::LOAD_ARRAY:
+      if (stored.count(op.slot) || ints.count(op.slot))
+        return false;
+      if (arrays.insert(op.slot).second)
+        trace.arraySlots.push_back(op.slot);
+      break;
+    case TraceOpKind::STORE_INT:
+      if (arrays.count(op.slot))
+        return false;
+      stored.insert(op.slot);
+      break;
+    case TraceOpKind::ITER_NEXT_INT: {
+      // Reads the array and the index, writes the index and the element
+      uint16_t index = op.slot + 1;
+      uint16_t element = op.slot + 2;
+      if (stored.count(op.slot) || ints.count(op.slot) ||
+          arrays.count(index) || arrays.count(element))
+        return false;
+      if (arrays.insert(op.slot).second)
+        trace.arraySlots.push_back(op.slot);
+      if (!stored.count(index) && ints.insert(index).second)
+        trace.intSlots.push_back(index);
+      stored.insert(index);
+      stored.insert(element);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+bool TraceJit::evalBinary(Opcode op, int32_t a, int32_t b, int32_t &result) {
+  switch (op) {
+  case Opcode::ADD:
+    result = wrap(static_cast<int64_t>(a) + b);
+    return true;
+  case Opcode::SUB:
+    result = wrap(static_cast<int64_t>(a) - b);
+    return true;
+  case Opcode::MUL:
+    result = wrap(static_cast<int64_t>(a) * b);
+    return true;
+  case Opcode::DIV:
+    if (b == 0)
+      return false;
+    result = wrapDivide(a, b);
+    return true;
+  case Opcode::MOD:
+    if (b == 0)
+      return false;
+    result = wrapModulo(a, b);
+    return true;
+  case Opcode::SHL:
+    result = shiftLeft(a, static_cast<unsigned>(b));
+    return true;
+  case Opcode::SHR:
+    result = shiftRight(a, static_cast<unsigned>(b));
+    return true;
+  case Opcode::MASK:
+    result = maskLow(a, static_cast<unsigned>(b));
+    return true;
+  case Opcode::EQ:
+    result = a == b;
+    return true;
+  case Opcode::NEQ:
+    result = a != b;
+    return true;
+  case Opcode::LT:
+    result = a < b;
+    return true;
+  case Opcode::LTE:
+    result = a <= b;
+    return true;
+  case Opcode::GT:
+    result = a > b;
+    return true;
+  case Opcode::GTE:
+    result = a >= b;
+    return true;
+  default:
+    return false;
+  }
+}
+
+void TraceJit::foldConstants(std::vector<TraceOp> &ops) {
+  std::vector<TraceOp> out;
+  out.reserve(ops.size());
+
+  auto isPush = [&](size_t fromEnd) {
+    return out.size() > fromEnd &&
+           out[out.size() - 1 - fromEnd].kind == TraceOpKind::PUSH_INT;
+  };
+
+  for (const auto &op : ops) {
+    if (op.kind == TraceOpKind::BINARY && op.hasImmediate && isPush(0)) {
+      int32_t result;
+      if (evalBinary(op.op, out.back().imm, op.imm, result)) {
+        out.back().imm = result;
+        continue;
+      }
+    }
+    if (op.kind == TraceOpKind::BINARY && !op.hasImmediate && isPush(0) &&
+        isPush(1)) {
+      int32_t result;
+      int32_t a = out[out.size() - 2].imm;
+      int32_t b = out[out.size() - 1].imm;
+      if (evalBinary(op.op, a, b, result)) {
+        out.pop_back();
+        out.back().imm = result;
+        continue;
+      }
+    }
+    if (op.kind == TraceOpKind::GUARD && isPush(0)) {
+      bool zero = out.back().imm == 0;
+      if (zero != op.exitOnZero) {
+        out.pop_back(); // Guard always holds, e.g. while (1)
+        continue;
+      }
+    }
+    if (op.kind == TraceOpKind::SWITCH_GUARD && isPush(0) &&
+        out.back().imm == op.imm) {
+      out.pop_back();
+      continue;
+    }
+    out.push_back(op);
+  }
+
+  ops = std::move(out);
+}
+
+void TraceJit::fuseOps(std::vector<TraceOp> &ops) {
+  std::vector<TraceOp> out;
+  out.reserve(ops.size());
+
+  for (const auto &op : ops) {
+    // PUSH_INT k; BINARY  ->  BINARY with immediate right operand.
+    // DIV/MOD by a constant zero keep the explicit push so the side exit can
+    // rebuild the stack the interpreter expects.
+    if (op.kind == TraceOpKind::BINARY && !op.hasImmediate && !out.empty() &&
+        out.back().kind == TraceOpKind::PUSH_INT &&
+        !(canFail(op.op) && out.back().imm == 0)) {
+      TraceOp fused = op;
+      fused.hasImmediate = true;
+      fused.imm = out.back().imm;
+      fused.ip = out.back().ip;
+      fused.executed = out.back().executed;
+      out.back() = fused;
+      continue;
+    }
+
+    // LOAD_INT s; ADD/SUB k; STORE_INT s  ->  INC_LOCAL s, +/-k
+    if (op.kind == TraceOpKind::STORE_INT && out.size() >= 2) {
+      const TraceOp &arith = out[out.size() - 1];
+      const TraceOp &load = out[out.size() - 2];
+      if (arith.kind == TraceOpKind::BINARY && arith.hasImmediate &&
+          (arith.op == Opcode::ADD || arith.op == Opcode::SUB) &&
+          load.kind == TraceOpKind::LOAD_INT && load.slot == op.slot) {
+        TraceOp inc;
+        inc.kind = TraceOpKind::INC_LOCAL;
+        inc.slot = op.slot;
+        inc.imm = arith.op == Opcode::ADD
+                      ? arith.imm
+                      : wrap(-static_cast<int64_t>(arith.imm));
+        inc.ip = load.ip;
+        inc.executed = load.executed;
+        out.pop_back();
+        out.back() = inc;
+        continue;
+      }
+    }
+
+    // Comparison feeding a guard
+    if (op.kind == TraceOpKind::GUARD && !out.empty() &&
+        out.back().kind == TraceOpKind::BINARY && isComparison(out.back().op)) {
+      TraceOp fused = out.back();
+      fused.kind = TraceOpKind::COMPARE_GUARD;
+      fused.exitOnZero = op.exitOnZero;
+      fused.exitIp = op.exitIp;
+      fused.executed = op.executed;
+      out.back() = fused;
+      continue;
+    }
+
+    out.push_back(op);
+  }
+
+  ops = std::move(out);
+}
+
+void TraceJit::computeShapes(Trace &trace) {
+  std::vector<int32_t> kinds;
+
+  auto snapshot = [&](TraceOp &op) {
+    op.shape = static_cast<uint32_t>(trace.shapes.size());
+    trace.shapes.push_back(kinds);
+  };
+
+  for (auto &op : trace.ops) {
+    switch (op.kind) {
+    case TraceOpKind::PUSH_INT:
+    case TraceOpKind::LOAD_INT:
+      kinds.push_back(-1);
+      break;
+    case TraceOpKind::LOAD_ARRAY:
+      kinds.push_back(op.slot);
+      break;
+    case TraceOpKind::STORE_INT:
+    case TraceOpKind::POP:
+      kinds.pop_back();
+      break;
+    case TraceOpKind::INC_LOCAL:
+    case TraceOpKind::LOOP:
+      break;
+    case TraceOpKind::BINARY:
+      if (!op.hasImmediate && canFail(op.op))
+        snapshot(op); // Exit before the op so the VM reports the error
+      if (!op.hasImmediate)
+        kinds.pop_back();
+      kinds.back() = -1;
+      break;
+    case TraceOpKind::GUARD:
+      kinds.pop_back();
+      snapshot(op);
+      break;
+    case TraceOpKind::COMPARE_GUARD:
+      kinds.pop_back();
+      if (!op.hasImmediate)
+        kinds.pop_back();
+      snapshot(op);
+      break;
+    case TraceOpKind::SWITCH_GUARD:
+      snapshot(op); // The switch runs again on the value
+      kinds.pop_back();
+      break;
+    case TraceOpKind::ARRAY_LOAD_INT:
+      snapshot(op);
+      kinds.pop_back();
+      kinds.back() = -1;
+      break;
+    case TraceOpKind::ARRAY_STORE_INT:
+    case TraceOpKind::ARRAY_ADD_INT:
+      snapshot(op);
+      kinds.resize(kinds.size() - 3);
+      break;
+    case TraceOpKind::DUP2:
+      kinds.push_back(kinds[kinds.size() - 2]);
+      kinds.push_back(kinds[kinds.size() - 2]);
+      break;
+    case TraceOpKind::ITER_NEXT_INT:
+      snapshot(op); // A non-int element is loaded by the interpreter
+      kinds.push_back(-1);
+      break;
+    }
+  }
+}
+
+// ============================================================================
+// Execution
+// ============================================================================
+
+uint16_t TraceJit::run(const Trace &trace, std::vector<Value> &stack,
+                       std::vector<Value> &locals, uint16_t basePointer,
+                       uint64_t &budget) {
+  auto localAt = [&](uint16_t slot) -> Value * {
+    size_t index = static_cast<uint16_t>(basePointer + slot);
+    return index < locals.size() ? &locals[index] : nullptr;
+  };
+
+  // Entry guards; on failure just interpret the iteration
+  if (basePointer >= locals.size())
+    return trace.header;
+  for (uint16_t slot : trace.intSlots) {
+    Value *v = localAt(slot);
+    if (!v || !v->isInt())
+      return trace.header;
+  }
+  for (uint16_t slot : trace.arraySlots) {
+    Value *v = localAt(slot);
+    if (!v || !v->isArray())
+      return trace.header;
+  }
+  for (const auto &op : trace.ops) {
+    if ((op.kind == TraceOpKind::STORE_INT ||
+         op.kind == TraceOpKind::INC_LOCAL) &&
+        !localAt(op.slot))
+      return trace.header;
+    if (op.kind == TraceOpKind::ITER_NEXT_INT && !localAt(op.slot + 2))
+      return trace.header;
+  }
+
+  stats_.traceEntries++;
+
+  int32_t st[MAX_STACK_SIZE];
+  size_t sp = 0;
+  size_t pc = 0;
+  Value *frame = &locals[basePointer];
+
+  auto readInt = [&](uint16_t slot) -> int32_t {
+    return *std::get_if<int32_t>(&frame[slot].data);
+  };
+  auto writeInt = [&](uint16_t slot, int32_t value) {
+    if (auto *p = std::get_if<int32_t>(&frame[slot].data))
+      *p = value;
+    else
+      frame[slot].data = value;
+  };
+
+  // Rebuild the interpreter stack described by a shape and leave the trace
+  auto sideExit = [&](const TraceOp &op, uint16_t resumeIp) -> uint16_t {
+    const auto &shape = trace.shapes[op.shape];
+    for (size_t i = 0; i < shape.size(); ++i) {
+      if (stack.size() >= MAX_STACK_SIZE) {
+        throw VMError("Stack overflow");
+      }
+      if (shape[i] < 0) {
+        stack.emplace_back(st[i]);
+      } else {
+        stack.push_back(frame[shape[i]]);
+      }
+    }
+    stats_.sideExits++;
+    budget -= std::min<uint64_t>(budget, op.executed);
+    return resumeIp;
+  };
+
+  while (true) {
+    const TraceOp &op = trace.ops[pc];
+    switch (op.kind) {
+    case TraceOpKind::PUSH_INT:
+      st[sp++] = op.imm;
+      break;
+
+    case TraceOpKind::LOAD_INT:
+      st[sp++] = readInt(op.slot);
+      break;
+
+    case TraceOpKind::LOAD_ARRAY:
+      st[sp++] = 0; // Placeholder; array lives in the local itself
+      break;
+
+    case TraceOpKind::STORE_INT:
+      writeInt(op.slot, st[--sp]);
+      break;
+
+    case TraceOpKind::INC_LOCAL:
+      writeInt(op.slot, wrap(static_cast<int64_t>(readInt(op.slot)) + op.imm));
+      break;
+
+    case TraceOpKind::BINARY: {
+      int32_t b = op.hasImmediate ? op.imm : st[--sp];
+      int32_t a = st[sp - 1];
+      int32_t result;
+      if (!evalBinary(op.op, a, b, result)) {
+        if (!op.hasImmediate)
+          st[sp++] = b;
+        return sideExit(op, op.ip);
+      }
+      st[sp - 1] = result;
+      break;
+    }
+
+    case TraceOpKind::GUARD: {
+      bool zero = st[--sp] == 0;
+      if (zero == op.exitOnZero)
+        return sideExit(op, op.exitIp);
+      break;
+    }
+
+    case TraceOpKind::COMPARE_GUARD: {
+      int32_t b = op.hasImmediate ? op.imm : st[--sp];
+      int32_t a = st[--sp];
+      int32_t result = 0;
+      evalBinary(op.op, a, b, result);
+      if ((result == 0) == op.exitOnZero)
+        return sideExit(op, op.exitIp);
+      break;
+    }
+
+    case TraceOpKind::SWITCH_GUARD:
+      if (st[sp - 1] != op.imm)
+        return sideExit(op, op.ip);
+      --sp;
+      break;
+
+    case TraceOpKind::ARRAY_LOAD_INT: {
+      const auto &vec = **std::get_if<ArrayPtr>(&frame[op.slot].data);
+      int32_t index = st[sp - 1];
+      if (index < 0 || static_cast<size_t>(index) >= vec.size())
+        return sideExit(op, op.ip);
+      const auto *element = std::get_if<int32_t>(&vec[index].data);
+      if (!element)
+        return sideExit(op, op.ip);
+      --sp;
+      st[sp - 1] = *element;
+      break;
+    }
+
+    case TraceOpKind::ARRAY_STORE_INT: {
+      auto &vec = **std::get_if<ArrayPtr>(&frame[op.slot].data);
+      int32_t index = st[sp - 2];
+      if (index < 0 || static_cast<size_t>(index) >= vec.size())
+        return sideExit(op, op.ip);
+      vec[index].data = st[sp - 1];
+      sp -= 3;
+      break;
+    }
+
+    case TraceOpKind::ARRAY_ADD_INT: {
+      auto &vec = **std::get_if<ArrayPtr>(&frame[op.slot].data);
+      int32_t index = st[sp - 2];
+      if (index < 0 || static_cast<size_t>(index) >= vec.size())
+        return sideExit(op, op.ip);
+      auto *element = std::get_if<int32_t>(&vec[index].data);
+      if (!element)
+        return sideExit(op, op.ip);
+      *element = wrap(static_cast<int64_t>(*element) + st[sp - 1]);
+      sp -= 3;
+      break;
+    }
+
+    case TraceOpKind::DUP2:
+      st[sp] = st[sp - 2];
+      st[sp + 1] = st[sp - 1];
+      sp += 2;
+      break;
+
+    case TraceOpKind::ITER_NEXT_INT: {
+      const auto &vec = **std::get_if<ArrayPtr>(&frame[op.slot].data);
+      int32_t next = readInt(op.slot + 1);
+      bool more = static_cast<size_t>(next) < vec.size();
+      if (more) {
+        const auto *element = std::get_if<int32_t>(&vec[next].data);
+        if (!element)
+          return sideExit(op, op.ip);
+        writeInt(op.slot + 2, *element);
+        writeInt(op.slot + 1, next + 1);
+      }
+      st[sp++] = more ? 1 : 0;
+      break;
+    }
+
+    case TraceOpKind::POP:
+      --sp;
+      break;
+
+    case TraceOpKind::LOOP:
+      // The stack is empty between iterations, as at the header
+      if (budget <= trace.length) {
+        budget = 0;
+        return trace.header;
+      }
+      budget -= trace.length;
+      pc = 0;
+      continue;
+    }
+    ++pc;
+  }
+}
@@ -35,10 +35,20 @@ std::string Token::typeString() const {
     return "KW_PRINT";
   case TokenType::KW_FOR:
     return "KW_FOR";
+  case TokenType::KW_IN:
+    return "KW_IN";
+  case TokenType::KW_PARALLEL:
+    return "KW_PARALLEL";
   case TokenType::KW_BREAK:
     return "KW_BREAK";
   case TokenType::KW_CONTINUE:
     return "KW_CONTINUE";
+  case TokenType::KW_SWITCH:
+    return "KW_SWITCH";
+  case TokenType::KW_CASE:
+    return "KW_CASE";
+  case TokenType::KW_DEFAULT:
+    return "KW_DEFAULT";
   case TokenType::PLUS:
     return "PLUS";
   case TokenType::MINUS:
@@ -51,6 +61,16 @@ std::string Token::typeString() const {
     return "PERCENT";
   case TokenType::ASSIGN:
     return "ASSIGN";
+  case TokenType::PLUS_ASSIGN:
+    return "PLUS_ASSIGN";
+  case TokenType::MINUS_ASSIGN:
+    return "MINUS_ASSIGN";
+  case TokenType::STAR_ASSIGN:
+    return "STAR_ASSIGN";
+  case TokenType::PLUS_PLUS:
+    return "PLUS_PLUS";
+  case TokenType::MINUS_MINUS:
+    return "MINUS_MINUS";
   case TokenType::EQ:
     return "EQ";
   case TokenType::NEQ:
@@ -81,6 +101,8 @@ std::string Token::typeString() const {
     return "SEMICOLON";
   case TokenType::COMMA:
     return "COMMA";
+  case TokenType::COLON:
+    return "COLON";
   case TokenType::LBRACKET:
     return "LBRACKET";
   case TokenType::RBRACKET:
@@ -95,7 +117,8 @@ std::string Token::typeString() const {
 // ============================================================================
 
 Lexer::Lexer(const std::string &source)
-    : source_(source), index_(0), line_(1), column_(1) {}
+    : source_(source), index_(0), line_(1), column_(1),
+      previousType_(TokenType::END_OF_FILE) {}
 
 // ============================================================================
 // Core Character Methods
@@ -115,6 +138,15 @@ char Lexer::peekChar() const {
   return source_[index_ + 1];
 }
 
+char Lexer::peekNonWhitespaceChar() const {
+  for (size_t i = index_ + 1; i < source_.length(); ++i) {
+    if (!isWhitespace(source_[i])) {
+      return source_[i];
+    }
+  }
+  return '\0';
+}
+
 bool Lexer::isAtEnd() const { return index_ >= source_.length(); }
 
 void Lexer::advance() {
@@ -196,10 +228,20 @@ TokenType Lexer::keywordType(const std::string &ident) {
     return TokenType::KW_PRINT;
   if (ident == "for")
     return TokenType::KW_FOR;
+  if (ident == "in")
+    return TokenType::KW_IN;
+  if (ident == "parallel")
+    return TokenType::KW_PARALLEL;
   if (ident == "break")
     return TokenType::KW_BREAK;
   if (ident == "continue")
     return TokenType::KW_CONTINUE;
+  if (ident == "switch")
+    return TokenType::KW_SWITCH;
+  if (ident == "case")
+    return TokenType::KW_CASE;
+  if (ident == "default")
+    return TokenType::KW_DEFAULT;
   return TokenType::IDENTIFIER;
 }
 
@@ -273,10 +315,34 @@ Token Lexer::lexOperatorOrDelimiter() {
 
   switch (c) {
   case '+':
+    if (currentChar() == '=') {
+      advance();
+      return Token{TokenType::PLUS_ASSIGN, "+=", startLine, startCol};
+    }
+    if (currentChar() == '+') {
+      advance();
+      return Token{TokenType::PLUS_PLUS, "++", startLine, startCol};
+    }
     return Token{TokenType::PLUS, "+", startLine, startCol};
   case '-':
+    if (currentChar() == '=') {
+      advance();
+      return Token{TokenType::MINUS_ASSIGN, "-=", startLine, startCol};
+    }
+    // Look past the second '-' for the end of the statement or increment
+    if (currentChar() == '-' &&
+        (previousType_ == TokenType::IDENTIFIER ||
+         previousType_ == TokenType::RBRACKET) &&
+        (peekNonWhitespaceChar() == ';' || peekNonWhitespaceChar() == ')')) {
+      advance();
+      return Token{TokenType::MINUS_MINUS, "--", startLine, startCol};
+    }
     return Token{TokenType::MINUS, "-", startLine, startCol};
   case '*':
+    if (currentChar() == '=') {
+      advance();
+      return Token{TokenType::STAR_ASSIGN, "*=", startLine, startCol};
+    }
     return Token{TokenType::STAR, "*", startLine, startCol};
   case '%':
     return Token{TokenType::PERCENT, "%", startLine, startCol};
@@ -292,6 +358,8 @@ Token Lexer::lexOperatorOrDelimiter() {
     return Token{TokenType::SEMICOLON, ";", startLine, startCol};
   case ',':
     return Token{TokenType::COMMA, ",", startLine, startCol};
+  case ':':
+    return Token{TokenType::COLON, ":", startLine, startCol};
   case '[':
     return Token{TokenType::LBRACKET, "[", startLine, startCol};
   case ']':
@@ -390,6 +458,7 @@ std::vector<Token> Lexer::tokenize() {
     } else {
       tokens.push_back(lexOperatorOrDelimiter());
     }
+    previousType_ = tokens.back().type;
   }
 
   // Append end-of-file token
@@ -1,16 +1,24 @@
+#include <csignal>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 
+#include "cbackend.h"
 #include "codegen.h"
 #include "common.h"
+#include "effects.h"
 #include "lexer.h"
 #include "optimizer.h"
 #include "parser.h"
+#include "profile_data.h"
 #include "profiler.h"
+#include "repl_session.h"
+#include "server.h"
 #include "vm.h"
 
 struct CompilerConfig {
@@ -19,6 +27,21 @@ struct CompilerConfig {
   bool profile = false;
   bool verbose = false;
   bool dumpBytecode = false;
+  bool emitC = false;
+  std::string emitCPath; // Empty means stdout
+  bool jit = false;
+  bool lazy = false;
+  bool memoize = false;
+  size_t threads = 0;     // Parallel for threads (0 = one per core)
+  std::string profileOut; // Save execution counts here (empty = don't)
+  std::string profileUse; // Optimize with counts from here (empty = don't)
+  std::string snapshotIn;  // Start from this VM image (empty = don't)
+  std::string snapshotOut; // Save a VM image here after the run
+  std::string servePath;  // Serve requests on this socket (empty = don't)
+  size_t serveWorkers = 0;
+  size_t serveQueue = 64;
+  uint64_t serveInstructionLimit = ServerOptions().instructionLimit;
+  size_t serveMaxOutput = ServerOptions().maxOutput;
 };
 
 /**
@@ -68,12 +91,62 @@ std::optional<CompilerConfig> parse_arguments(int argc, char *argv[]) {
       config.verbose = true;
     } else if (arg == "--dump") {
       config.dumpBytecode = true;
+    } else if (arg == "--emit-c") {
+      config.emitC = true;
+    } else if (arg.rfind("--emit-c=", 0) == 0) {
+      config.emitC = true;
+      config.emitCPath = std::string(arg.substr(9));
+    } else if (arg == "--jit") {
+      config.jit = true;
+    } else if (arg == "--lazy") {
+      config.lazy = true;
+    } else if (arg == "--memoize") {
+      config.memoize = true;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      config.threads = std::stoul(std::string(arg.substr(10)));
+    } else if (arg.rfind("--profile-out=", 0) == 0) {
+      config.profileOut = std::string(arg.substr(14));
+    } else if (arg.rfind("--profile-use=", 0) == 0) {
+      config.profileUse = std::string(arg.substr(14));
+    } else if (arg.rfind("--snapshot=", 0) == 0) {
+      config.snapshotIn = std::string(arg.substr(11));
+    } else if (arg.rfind("--snapshot-out=", 0) == 0) {
+      config.snapshotOut = std::string(arg.substr(15));
+    } else if (arg.rfind("--serve=", 0) == 0) {
+      config.servePath = std::string(arg.substr(8));
+    } else if (arg.rfind("--serve-workers=", 0) == 0) {
+      config.serveWorkers = std::stoul(std::string(arg.substr(16)));
+    } else if (arg.rfind("--serve-queue=", 0) == 0) {
+      config.serveQueue = std::stoul(std::string(arg.substr(14)));
+    } else if (arg.rfind("--serve-instruction-limit=", 0) == 0) {
+      config.serveInstructionLimit = std::stoull(std::string(arg.substr(26)));
+    } else if (arg.rfind("--serve-max-output=", 0) == 0) {
+      config.serveMaxOutput = std::stoull(std::string(arg.substr(19)));
     } else {
       std::cerr << "Unknown flag: " << arg << "\n";
       return std::nullopt;
     }
   }
 
+  // Snapshot runs go through a ReplSession, which has none of these stages
+  if (!config.snapshotIn.empty() || !config.snapshotOut.empty()) {
+    const std::pair<bool, const char *> unsupported[] = {
+        {config.memoize, "--memoize"},
+        {config.profile, "--profile"},
+        {!config.profileOut.empty(), "--profile-out"},
+        {!config.profileUse.empty(), "--profile-use"},
+        {config.lazy, "--lazy"},
+        {config.dumpBytecode, "--dump"},
+        {config.emitC, "--emit-c"}};
+    for (const auto &[set, flag] : unsupported) {
+      if (set) {
+        std::cerr << flag
+                  << " cannot be combined with --snapshot or --snapshot-out\n";
+        return std::nullopt;
+      }
+    }
+  }
+
   return config;
 }
 
@@ -82,10 +155,7 @@ void runRepl() {
   std::cout << "Type 'exit' to quit.\n";
 
   std::string line;
-  CodeGenerator codegen;
-  VirtualMachine vm;
-  Optimizer optimizer; // Optimizer might be tricky with incremental, maybe skip
-                       // for REPL or verify safety
+  ReplSession session;
 
   while (true) {
     std::cout << "> ";
@@ -97,20 +167,8 @@ void runRepl() {
       continue;
 
     try {
-      Lexer lexer(line);
-      auto tokens = lexer.tokenize();
-
-      Parser parser(tokens);
-      auto program = parser.parseProgram();
-
-      // Skip optimization in REPL for now to avoid complexity with incremental
-      // state Optimizer optimizer; optimizer.run(*program);
-
-      // Generate bytecode incrementally (preserve symbol tables)
-      auto bytecode = codegen.generate(*program, true);
-
-      // Execute incrementally (preserve stack/heap)
-      Value result = vm.execute(bytecode, nullptr, true);
+      // Appends to the session's program and runs only this line
+      Value result = session.eval(line);
 
       // Only print non-void results
       if (!result.isVoid()) {
@@ -129,6 +187,35 @@ void runRepl() {
   }
 }
 
+Server *activeServer = nullptr;
+
+void stopServer(int) {
+  if (activeServer) {
+    activeServer->stop();
+  }
+}
+
+/**
+ * Serve compile-and-run requests until SIGINT or SIGTERM
+ */
+void runServer(const CompilerConfig &config) {
+  ServerOptions options;
+  options.socketPath = config.servePath;
+  options.workers = config.serveWorkers;
+  options.maxQueue = config.serveQueue;
+  options.instructionLimit = config.serveInstructionLimit;
+  options.maxOutput = config.serveMaxOutput;
+  Server server(options);
+  activeServer = &server;
+  std::signal(SIGINT, stopServer);
+  std::signal(SIGTERM, stopServer);
+  std::cout << "Serving on " << config.servePath << std::endl;
+  server.run();
+  activeServer = nullptr;
+  std::cout << "Served " << server.served() << " requests, shed "
+            << server.shed() << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   try {
     auto config = parse_arguments(argc, argv);
@@ -136,6 +223,11 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    if (!config->servePath.empty()) {
+      runServer(*config);
+      return 0;
+    }
+
     if (config->verbose) {
       std::cout << "=================================================\n";
       std::cout << "  Optimizing Bytecode Compiler v1.0.0\n";
@@ -144,6 +236,8 @@ int main(int argc, char *argv[]) {
       std::cout << "Optimization: "
                 << (config->optimize ? "enabled" : "disabled") << "\n";
       std::cout << "Profiling: " << (config->profile ? "enabled" : "disabled")
+                << "\n";
+      std::cout << "Trace JIT: " << (config->jit ? "enabled" : "disabled")
                 << "\n\n";
     }
 
@@ -157,30 +251,68 @@ int main(int argc, char *argv[]) {
       std::cout << "[1/5] Reading source file...\n";
     std::string source = readFile(config->input_file);
 
+    // Snapshots hold a REPL session's program, so such runs go through one
+    if (!config->snapshotIn.empty() || !config->snapshotOut.empty()) {
+      std::unique_ptr<ReplSession> session =
+          config->snapshotIn.empty()
+              ? std::make_unique<ReplSession>()
+              : std::make_unique<ReplSession>(
+                    Snapshot::load(config->snapshotIn));
+      session->setOptimize(config->optimize);
+      session->vm().setJitEnabled(config->jit);
+      session->vm().setThreads(config->threads);
+      session->eval(source);
+      if (!config->snapshotOut.empty()) {
+        session->snapshot().save(config->snapshotOut);
+        if (config->verbose) {
+          std::cout << "--- Snapshot written to " << config->snapshotOut
+                    << " ---\n";
+        }
+      }
+      return 0;
+    }
+
     // Stage 2: Lexical analysis
     if (config->verbose)
       std::cout << "[2/5] Lexical analysis...\n";
     Lexer lexer(source);
-    auto tokens = lexer.tokenize();
+    auto tokens = std::make_shared<const std::vector<Token>>(lexer.tokenize());
     if (config->verbose) {
-      std::cout << "      Generated " << tokens.size() << " tokens\n";
+      std::cout << "      Generated " << tokens->size() << " tokens\n";
     }
 
     // Stage 3: Parsing
     if (config->verbose)
       std::cout << "[3/5] Parsing...\n";
     Parser parser(tokens);
+    parser.setLazyFunctionBodies(config->lazy);
     auto program = parser.parseProgram();
     if (config->verbose) {
       std::cout << "      AST with " << program->items().size()
                 << " top-level items\n";
     }
 
+    // Counts from an earlier run steer the optimizer and the code layout
+    ProfileData trainedProfile;
+    if (!config->profileUse.empty()) {
+      trainedProfile = ProfileData::load(config->profileUse);
+    }
+    const ProfileData *profileUse =
+        config->profileUse.empty() ? nullptr : &trainedProfile;
+
     // Stage 4: Optimization (optional)
     if (config->optimize) {
       if (config->verbose)
         std::cout << "[4/5] Optimizing...\n";
       Optimizer optimizer;
+      // Loop counts describe source loops only while those stay rolled
+      optimizer.setUnrollLoops(config->profileOut.empty());
+      if (profileUse) {
+        optimizer.setProfile(profileUse);
+        if (config->verbose) {
+          std::cout << "      Using profile " << config->profileUse << "\n";
+        }
+      }
       optimizer.run(*program);
       if (config->verbose) {
         auto stats = optimizer.getStats();
@@ -188,19 +320,48 @@ int main(int argc, char *argv[]) {
                   << "\n";
         std::cout << "      Dead code removed: " << stats.deadCodeRemoved
                   << "\n";
-        std::cout << "      Functions inlinable: " << stats.functionsInlined
+        std::cout << "      Calls evaluated: " << stats.callsEvaluated
+                  << "\n";
+        std::cout << "      Inline candidates: " << stats.inlineCandidates
+                  << "\n";
+        std::cout << "      Functions removed: " << stats.functionsRemoved
                   << "\n";
+        std::cout << "      Loops unrolled: " << stats.loopsUnrolled << "\n";
+        std::cout << "      Induction variables reduced: "
+                  << stats.inductionVariablesReduced << "\n";
+        std::cout << "      Subexpressions reused: "
+                  << stats.subexpressionsEliminated << "\n";
       }
     } else {
       if (config->verbose)
         std::cout << "[4/5] Skipping optimization\n";
     }
+    if (config->verbose) {
+      EffectAnalysis effects(*program);
+      for (const auto &item : program->items()) {
+        auto *fn = dynamic_cast<const FunctionDecl *>(item.get());
+        if (fn && effects.effectsOf(fn->name())) {
+          std::cout << "      Effects of " << fn->name() << ": "
+                    << effects.effectsOf(fn->name())->describe() << "\n";
+        }
+      }
+    }
 
     // Stage 5: Code generation
     if (config->verbose)
       std::cout << "[5/5] Generating bytecode...\n";
+    // Lazy mode only generates main; function bodies follow on first call.
+    // The C++ backend needs every body up front.
     CodeGenerator codegen;
-    auto bytecode = codegen.generate(*program);
+    codegen.setProfile(profileUse);
+    BytecodeProgram eagerBytecode;
+    std::unique_ptr<LazyFunctionCompiler> lazy;
+    if (config->lazy && !config->emitC) {
+      lazy = std::make_unique<LazyFunctionCompiler>(*program, profileUse);
+    } else {
+      eagerBytecode = codegen.generate(*program);
+    }
+    const BytecodeProgram &bytecode = lazy ? lazy->program() : eagerBytecode;
     if (config->verbose) {
       std::cout << "      Generated " << bytecode.code.size()
                 << " instructions\n";
@@ -214,22 +375,51 @@ int main(int argc, char *argv[]) {
       std::cout << "\n";
     }
 
+    // Ahead-of-time mode: translate to C++ instead of executing
+    if (config->emitC) {
+      CBackend backend;
+      if (config->emitCPath.empty()) {
+        backend.emit(bytecode, std::cout);
+      } else {
+        std::ofstream out(config->emitCPath);
+        if (!out.is_open()) {
+          throw std::runtime_error("Cannot open file: " + config->emitCPath);
+        }
+        backend.emit(bytecode, out);
+        if (config->verbose) {
+          std::cout << "      Wrote C++ source to " << config->emitCPath
+                    << "\n";
+        }
+      }
+      return 0;
+    }
+
     // Stage 6: Execute
     if (config->verbose)
       std::cout << "\n--- Execution ---\n";
 
     VirtualMachine vm;
     Profiler profiler;
+    vm.setJitEnabled(config->jit);
+    vm.setLazyCompiler(lazy.get());
+    vm.setThreads(config->threads);
+    if (config->memoize) {
+      vm.setMemoizedFunctions(EffectAnalysis(*program).pureFunctions());
+    }
 
-    if (config->profile) {
+    bool profiling = config->profile || !config->profileOut.empty();
+    if (profiling) {
       profiler.startTiming();
     }
 
-    Value result = vm.execute(bytecode, config->profile ? &profiler : nullptr);
+    Value result = vm.execute(bytecode, profiling ? &profiler : nullptr);
 
-    if (config->profile) {
+    if (profiling) {
       profiler.stopTiming();
     }
+    if (!config->profileOut.empty()) {
+      ProfileData::collect(bytecode, profiler).save(config->profileOut);
+    }
 
     if (config->verbose) {
       if (result.isInt()) {
@@ -237,6 +427,33 @@ int main(int argc, char *argv[]) {
       } else {
         std::cout << "\n--- Result: \"" << result.asString() << "\" ---\n";
       }
+      if (lazy) {
+        size_t parsed = 0;
+        for (const auto &item : program->items()) {
+          auto *fn = dynamic_cast<const FunctionDecl *>(item.get());
+          if (fn && fn->isBodyParsed()) {
+            ++parsed;
+          }
+        }
+        std::cout << "--- Lazy: " << parsed << " parsed, "
+                  << lazy->compiledCount() << " generated of "
+                  << bytecode.functions.size() << " functions ---\n";
+      }
+      if (!config->profileOut.empty()) {
+        std::cout << "--- Profile written to " << config->profileOut
+                  << " ---\n";
+      }
+      if (config->memoize) {
+        std::cout << "--- Memo: " << vm.getMemoHits()
+                  << " calls answered from memo tables ---\n";
+      }
+      if (const auto *jitStats = vm.getJitStats()) {
+        std::cout << "--- JIT: " << jitStats->tracesCompiled
+                  << " traces compiled, " << jitStats->recordingsAborted
+                  << " recordings aborted, " << jitStats->traceEntries
+                  << " trace entries, " << jitStats->sideExits
+                  << " side exits ---\n";
+      }
     }
 
     if (config->profile) {
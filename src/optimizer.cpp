@@ -1,6 +1,16 @@
 #include "optimizer.h"
+#include "callgraph.h"
+#include "codegen.h"
 #include "common.h"
+#include "effects.h"
+#include "profile_data.h"
+#include "vm.h"
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
 
 // ============================================================================
 // Main Entry Points
@@ -8,19 +18,60 @@
 
 void Optimizer::run(Program &program) {
   // Build function map for inlining
+  computeAnalyzedFunctions(program);
   functionMap_.clear();
   for (const auto &item : program.items()) {
     if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
-      functionMap_[fn->name()] = fn;
+      if (isAnalyzed(*fn)) {
+        functionMap_[fn->name()] = fn;
+      }
     }
   }
 
-  // Run passes in order: CF -> DCE -> Inlining -> CF again
+  // Run passes in order: CF -> DCE -> PE -> inline candidates -> CF again ->
+  // Unrolling -> SR -> CSE
   runConstantFolding(program);
   runDeadCodeElimination(program);
-  runFunctionInlining(program);
-  // Re-run CF after inlining might expose more opportunities
+  // Replace constant calls before anything copies or inlines them
+  runPartialEvaluation(program);
+  countInlineCandidates(program);
+  // Re-run CF: partial evaluation may have exposed more opportunities
   runConstantFolding(program);
+  // Unroll first so that the copies are reduced and shared like other code
+  if (unrollLoops_) {
+    runLoopUnrolling(program);
+  }
+  runStrengthReduction(program);
+  // Share repeated values once the expressions are in their final shape
+  runCommonSubexpressionElimination(program);
+  // Drop functions nothing can call any more
+  if (removeDeadFunctions_) {
+    runDeadFunctionElimination(program);
+  }
+}
+
+// ============================================================================
+// Reachability
+// ============================================================================
+
+void Optimizer::computeAnalyzedFunctions(const Program &program) {
+  analyzed_.clear();
+
+  bool deferred = false;
+  for (const auto &item : program.items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      analyzed_.insert(fn->name());
+      deferred = deferred || !fn->isBodyParsed();
+    }
+  }
+
+  // Fully parsed programs: every function is analyzed
+  if (!deferred) {
+    return;
+  }
+
+  // Otherwise follow calls from top-level code, parsing only what is reached
+  analyzed_ = CallGraph(program).reachable();
 }
 
 // ============================================================================
@@ -39,8 +90,12 @@ void Optimizer::runConstantFolding(Program &program) {
   // 3. Operate on an IR
 
   // For demonstration, we count opportunities
+  computeAnalyzedFunctions(program);
   for (const auto &item : program.items()) {
     if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      if (!isAnalyzed(*fn)) {
+        continue;
+      }
       for (const auto &stmt : fn->body()) {
         countFoldingOpportunities(stmt.get());
       }
@@ -101,12 +156,12 @@ std::unique_ptr<Expr> Optimizer::foldBinaryOp(const BinaryOpExpr &expr) {
   case BinaryOpExpr::Operator::DIVIDE:
     if (right == 0)
       return nullptr; // Don't fold div by zero
-    result = left / right;
+    result = wrapDivide(left, right);
     break;
   case BinaryOpExpr::Operator::MODULO:
     if (right == 0)
       return nullptr;
-    result = left % right;
+    result = wrapModulo(left, right);
     break;
   default:
     return nullptr; // Don't fold comparisons yet
@@ -140,38 +195,433 @@ std::unique_ptr<Expr> Optimizer::foldUnaryOp(const UnaryOpExpr &expr) {
 // ============================================================================
 
 void Optimizer::runDeadCodeElimination(Program &program) {
-  // Find variables that are used
-  // Remove assignments to unused variables
-  // Remove statements after return
+  computeAnalyzedFunctions(program);
 
-  // Note: Similar to CF, full DCE requires mutable AST
-  // For demonstration, we identify opportunities
+  std::unordered_set<std::string> assignedBefore;
+  std::vector<std::unique_ptr<Stmt>> topLevel;
+  for (auto &item : program.mutableItems()) {
+    if (auto *fn = dynamic_cast<FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        eliminateDeadCode(*fn);
+      }
+    } else if (auto *stmt = dynamic_cast<Stmt *>(item.get())) {
+      collectAssignedVars(stmt, assignedBefore);
+    }
+  }
 
-  for (const auto &item : program.items()) {
-    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
-      auto used = findUsedVariables(fn->body());
-      countDeadCode(fn->body(), used);
+  // Top-level code only gets branch simplification: its variables persist
+  // (REPL) and a top-level return must not hide later function declarations
+  auto &items = program.mutableItems();
+  for (auto it = items.begin(); it != items.end();) {
+    if (!dynamic_cast<Stmt *>(it->get())) {
+      ++it;
+      continue;
+    }
+    std::unique_ptr<Stmt> stmt(static_cast<Stmt *>(it->release()));
+    stmt = simplifyBranches(std::move(stmt));
+    if (stmt) {
+      *it = std::move(stmt);
+      ++it;
+    } else {
+      it = items.erase(it);
+    }
+  }
+
+  // Variables whose only assignments were removed still need a slot
+  std::unordered_set<std::string> assigned, used;
+  for (const auto &item : items) {
+    if (auto *stmt = dynamic_cast<const Stmt *>(item.get())) {
+      collectAssignedVars(stmt, assigned);
+      collectUsedVars(stmt, used);
+    }
+  }
+  for (const auto &name : used) {
+    if (!assigned.count(name) && assignedBefore.count(name)) {
+      items.insert(items.begin(), std::make_unique<AssignmentStmt>(
+                                      name, std::make_unique<NumberExpr>(0)));
     }
   }
 }
 
-std::unordered_set<std::string>
-Optimizer::findUsedVariables(const std::vector<std::unique_ptr<Stmt>> &stmts) {
+void Optimizer::eliminateDeadCode(FunctionDecl &fn) {
+  auto &body = fn.mutableBody();
 
-  std::unordered_set<std::string> used;
+  std::unordered_set<std::string> assignedBefore;
+  for (const auto &stmt : body) {
+    collectAssignedVars(stmt.get(), assignedBefore);
+  }
+
+  eliminateDeadCode(body);
 
-  // Simplified: just look for identifier expressions
-  for (const auto &stmt : stmts) {
+  // Dead stores: all variables are local, so nothing is live at exit.
+  // Removing a store can make the stores feeding it dead, so repeat.
+  int before;
+  do {
+    before = stats_.deadCodeRemoved;
+    std::vector<LoopLiveness> loops;
+    removeDeadStores(body, {}, loops);
+  } while (stats_.deadCodeRemoved != before);
+
+  // Keep a slot for variables that are still read but lost every assignment
+  // (e.g. first assigned in a branch that was removed)
+  std::unordered_set<std::string> assigned(fn.params().begin(),
+                                           fn.params().end());
+  std::unordered_set<std::string> used;
+  for (const auto &stmt : body) {
+    collectAssignedVars(stmt.get(), assigned);
     collectUsedVars(stmt.get(), used);
   }
+  for (const auto &name : used) {
+    if (!assigned.count(name) && assignedBefore.count(name)) {
+      body.insert(body.begin(), std::make_unique<AssignmentStmt>(
+                                    name, std::make_unique<NumberExpr>(0)));
+    }
+  }
+}
+
+void Optimizer::eliminateDeadCode(std::vector<std::unique_ptr<Stmt>> &stmts) {
+  for (size_t i = 0; i < stmts.size(); ++i) {
+    stmts[i] = simplifyBranches(std::move(stmts[i]));
+    if (!stmts[i]) {
+      stmts.erase(stmts.begin() + static_cast<std::ptrdiff_t>(i));
+      --i;
+      continue;
+    }
+
+    // Everything after an unconditional exit is unreachable
+    if (alwaysExits(*stmts[i]) && i + 1 < stmts.size()) {
+      stats_.deadCodeRemoved += static_cast<int>(stmts.size() - i - 1);
+      stmts.erase(stmts.begin() + static_cast<std::ptrdiff_t>(i + 1),
+                  stmts.end());
+    }
+  }
+}
+
+std::unique_ptr<Stmt>
+Optimizer::simplifyBranches(std::unique_ptr<Stmt> stmt) {
+  int32_t value = 0;
+
+  if (auto *ifstmt = dynamic_cast<IfStmt *>(stmt.get())) {
+    if (evaluateConstant(ifstmt->condition(), value)) {
+      stats_.deadCodeRemoved++;
+      if (value == 0) {
+        return nullptr;
+      }
+      // Always taken: keep the body in place (if bodies have no own scope)
+      auto block =
+          std::make_unique<BlockStmt>(std::move(ifstmt->mutableBody()));
+      eliminateDeadCode(block->mutableStatements());
+      return block;
+    }
+    eliminateDeadCode(ifstmt->mutableBody());
+  } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(stmt.get())) {
+    auto &cases = switchstmt->mutableCases();
+    auto *str = dynamic_cast<const StringLiteralExpr *>(&switchstmt->value());
+    if (str || evaluateConstant(switchstmt->value(), value)) {
+      // Known value: keep only the arm it selects
+      auto matches = [&](const std::unique_ptr<Expr> &label) {
+        auto *num = dynamic_cast<const NumberExpr *>(label.get());
+        auto *text = dynamic_cast<const StringLiteralExpr *>(label.get());
+        return str ? text && text->value() == str->value()
+                   : num && num->value() == value;
+      };
+      auto arm = std::find_if(cases.begin(), cases.end(), [&](auto &c) {
+        return std::any_of(c.labels.begin(), c.labels.end(), matches);
+      });
+      if (arm == cases.end()) {
+        arm = std::find_if(cases.begin(), cases.end(),
+                           [](auto &c) { return c.labels.empty(); });
+      }
+      stats_.deadCodeRemoved++;
+      if (arm == cases.end()) {
+        return nullptr;
+      }
+      auto block = std::make_unique<BlockStmt>(std::move(arm->body));
+      eliminateDeadCode(block->mutableStatements());
+      return block;
+    }
+    for (auto &arm : cases) {
+      eliminateDeadCode(arm.body);
+    }
+  } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(stmt.get())) {
+    if (evaluateConstant(whilestmt->condition(), value) && value == 0) {
+      stats_.deadCodeRemoved++;
+      return nullptr;
+    }
+    eliminateDeadCode(whilestmt->mutableBody());
+  } else if (auto *forstmt = dynamic_cast<ForStmt *>(stmt.get())) {
+    if (forstmt->condition() &&
+        evaluateConstant(*forstmt->condition(), value) && value == 0) {
+      stats_.deadCodeRemoved++;
+      return forstmt->takeInit(); // The initializer still runs once
+    }
+    eliminateDeadCode(forstmt->mutableBody());
+  } else if (auto *forin = dynamic_cast<ForInStmt *>(stmt.get())) {
+    eliminateDeadCode(forin->mutableBody());
+  } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(stmt.get())) {
+    eliminateDeadCode(parallel->mutableBody());
+  } else if (auto *block = dynamic_cast<BlockStmt *>(stmt.get())) {
+    eliminateDeadCode(block->mutableStatements());
+  }
+
+  return stmt;
+}
+
+bool Optimizer::alwaysExits(const Stmt &stmt) const {
+  if (dynamic_cast<const ReturnStmt *>(&stmt) ||
+      dynamic_cast<const BreakStmt *>(&stmt) ||
+      dynamic_cast<const ContinueStmt *>(&stmt)) {
+    return true;
+  }
+  if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    return !block->statements().empty() &&
+           alwaysExits(*block->statements().back());
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Liveness
+// ----------------------------------------------------------------------------
+
+Optimizer::LiveSet
+Optimizer::removeDeadStores(std::vector<std::unique_ptr<Stmt>> &stmts,
+                            LiveSet live, std::vector<LoopLiveness> &loops) {
+  for (size_t i = stmts.size(); i-- > 0;) {
+    Stmt *stmt = stmts[i].get();
+
+    if (auto *assign = dynamic_cast<AssignmentStmt *>(stmt)) {
+      if (!live.count(assign->name()) && isRemovable(assign->value())) {
+        stmts.erase(stmts.begin() + static_cast<std::ptrdiff_t>(i));
+        stats_.deadCodeRemoved++;
+        continue;
+      }
+    } else if (auto *ifstmt = dynamic_cast<IfStmt *>(stmt)) {
+      removeDeadStores(ifstmt->mutableBody(), live, loops);
+    } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(stmt)) {
+      for (auto &arm : switchstmt->mutableCases()) {
+        removeDeadStores(arm.body, live, loops);
+      }
+    } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(stmt)) {
+      LiveSet head = whileHeadLiveness(*whilestmt, live, loops);
+      loops.push_back({live, head});
+      removeDeadStores(whilestmt->mutableBody(), head, loops);
+      loops.pop_back();
+    } else if (auto *forstmt = dynamic_cast<ForStmt *>(stmt)) {
+      LiveSet next;
+      forHeadLiveness(*forstmt, live, loops, next);
+      loops.push_back({live, next});
+      removeDeadStores(forstmt->mutableBody(), next, loops);
+      loops.pop_back();
+    } else if (auto *forin = dynamic_cast<ForInStmt *>(stmt)) {
+      LiveSet head =
+          iteratorHeadLiveness(forin->body(), forin->variable(), live, loops);
+      loops.push_back({live, head});
+      removeDeadStores(forin->mutableBody(), head, loops);
+      loops.pop_back();
+    } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(stmt)) {
+      LiveSet head = iteratorHeadLiveness(parallel->body(),
+                                          parallel->variable(), live, loops);
+      loops.push_back({live, head});
+      removeDeadStores(parallel->mutableBody(), head, loops);
+      loops.pop_back();
+    } else if (auto *block = dynamic_cast<BlockStmt *>(stmt)) {
+      removeDeadStores(block->mutableStatements(), live, loops);
+    }
+
+    live = liveIn(stmts[i].get(), live, loops);
+  }
+  return live;
+}
+
+Optimizer::LiveSet
+Optimizer::liveIn(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                  LiveSet live, std::vector<LoopLiveness> &loops) const {
+  for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) {
+    live = liveIn(it->get(), live, loops);
+  }
+  return live;
+}
+
+Optimizer::LiveSet Optimizer::liveIn(const Stmt *stmt, const LiveSet &out,
+                                     std::vector<LoopLiveness> &loops) const {
+  LiveSet live = out;
+
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
+    live.erase(assign->name());
+    collectUsedVarsFromExpr(&assign->value(), live);
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&arrAssign->target(), live);
+    collectUsedVarsFromExpr(&arrAssign->index(), live);
+    collectUsedVarsFromExpr(&arrAssign->value(), live);
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&exprStmt->expr(), live);
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&print->value(), live);
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
+    live.clear();
+    if (ret->value()) {
+      collectUsedVarsFromExpr(ret->value(), live);
+    }
+  } else if (dynamic_cast<const BreakStmt *>(stmt)) {
+    if (!loops.empty()) {
+      live = loops.back().exit;
+    }
+  } else if (dynamic_cast<const ContinueStmt *>(stmt)) {
+    if (!loops.empty()) {
+      live = loops.back().next;
+    }
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
+    LiveSet taken = liveIn(ifstmt->body(), out, loops);
+    live.insert(taken.begin(), taken.end());
+    collectUsedVarsFromExpr(&ifstmt->condition(), live);
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    // Without a default arm an unmatched value skips straight to `out`
+    if (switchstmt->hasDefault()) {
+      live.clear();
+    }
+    for (const auto &arm : switchstmt->cases()) {
+      LiveSet taken = liveIn(arm.body, out, loops);
+      live.insert(taken.begin(), taken.end());
+    }
+    collectUsedVarsFromExpr(&switchstmt->value(), live);
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
+    live = whileHeadLiveness(*whilestmt, out, loops);
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(stmt)) {
+    LiveSet next;
+    live = forHeadLiveness(*forstmt, out, loops, next);
+    if (forstmt->init()) {
+      live = liveIn(forstmt->init(), live, loops);
+    }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    live = iteratorHeadLiveness(forin->body(), forin->variable(), out, loops);
+    collectUsedVarsFromExpr(&forin->iterable(), live);
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    live = iteratorHeadLiveness(parallel->body(), parallel->variable(), out,
+                                loops);
+    collectUsedVarsFromExpr(&parallel->start(), live);
+    collectUsedVarsFromExpr(&parallel->end(), live);
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+    live = liveIn(block->statements(), out, loops);
+  }
 
-  return used;
+  return live;
 }
 
+Optimizer::LiveSet
+Optimizer::whileHeadLiveness(const WhileStmt &stmt, const LiveSet &out,
+                             std::vector<LoopLiveness> &loops) const {
+  // Iterate to a fixed point; sets only grow and are bounded by the names
+  // in the function, so this terminates
+  LiveSet head = out;
+  collectUsedVarsFromExpr(&stmt.condition(), head);
+  for (;;) {
+    loops.push_back({out, head});
+    LiveSet bodyIn = liveIn(stmt.body(), head, loops);
+    loops.pop_back();
+
+    LiveSet nextHead = head;
+    nextHead.insert(bodyIn.begin(), bodyIn.end());
+    if (nextHead == head) {
+      return head;
+    }
+    head = std::move(nextHead);
+  }
+}
+
+Optimizer::LiveSet
+Optimizer::forHeadLiveness(const ForStmt &stmt, const LiveSet &out,
+                           std::vector<LoopLiveness> &loops,
+                           LiveSet &next) const {
+  LiveSet head = out;
+  if (stmt.condition()) {
+    collectUsedVarsFromExpr(stmt.condition(), head);
+  }
+  for (;;) {
+    // Continue target is the increment, which falls through to the head
+    next = stmt.increment() ? liveIn(stmt.increment(), head, loops) : head;
+
+    loops.push_back({out, next});
+    LiveSet bodyIn = liveIn(stmt.body(), next, loops);
+    loops.pop_back();
+
+    LiveSet nextHead = head;
+    nextHead.insert(bodyIn.begin(), bodyIn.end());
+    if (nextHead == head) {
+      return head;
+    }
+    head = std::move(nextHead);
+  }
+}
+
+Optimizer::LiveSet Optimizer::iteratorHeadLiveness(
+    const std::vector<std::unique_ptr<Stmt>> &body,
+    const std::string &variable, const LiveSet &out,
+    std::vector<LoopLiveness> &loops) const {
+  // For for-in and parallel for loops. The head is the step, which assigns
+  // the variable before every run of the body
+  LiveSet head = out;
+  for (;;) {
+    loops.push_back({out, head});
+    LiveSet bodyIn = liveIn(body, head, loops);
+    loops.pop_back();
+
+    bodyIn.erase(variable);
+    LiveSet nextHead = head;
+    nextHead.insert(bodyIn.begin(), bodyIn.end());
+    if (nextHead == head) {
+      return head;
+    }
+    head = std::move(nextHead);
+  }
+}
+
+bool Optimizer::isRemovable(const Expr &expr) const {
+  // Conservative: anything that can call, index out of bounds or divide by
+  // zero stays. Type errors in otherwise pure arithmetic are not preserved.
+  if (dynamic_cast<const NumberExpr *>(&expr) ||
+      dynamic_cast<const StringLiteralExpr *>(&expr) ||
+      dynamic_cast<const IdentifierExpr *>(&expr)) {
+    return true;
+  }
+  if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    if (binop->op() == BinaryOpExpr::Operator::DIVIDE ||
+        binop->op() == BinaryOpExpr::Operator::MODULO) {
+      int32_t divisor = 0;
+      if (!evaluateConstant(binop->right(), divisor) || divisor == 0) {
+        return false;
+      }
+    }
+    return isRemovable(binop->left()) && isRemovable(binop->right());
+  }
+  if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    return isRemovable(unary->operand());
+  }
+  if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(&expr)) {
+    for (const auto &element : array->elements()) {
+      if (!isRemovable(*element)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Variable Collection
+// ----------------------------------------------------------------------------
+
 void Optimizer::collectUsedVars(const Stmt *stmt,
                                 std::unordered_set<std::string> &used) {
   if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
     collectUsedVarsFromExpr(&assign->value(), used);
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&arrAssign->target(), used);
+    collectUsedVarsFromExpr(&arrAssign->index(), used);
+    collectUsedVarsFromExpr(&arrAssign->value(), used);
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&exprStmt->expr(), used);
   } else if (auto *print = dynamic_cast<const PrintStmt *>(stmt)) {
     collectUsedVarsFromExpr(&print->value(), used);
   } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
@@ -179,20 +629,55 @@ void Optimizer::collectUsedVars(const Stmt *stmt,
     for (const auto &s : ifstmt->body()) {
       collectUsedVars(s.get(), used);
     }
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&switchstmt->value(), used);
+    for (const auto &arm : switchstmt->cases()) {
+      for (const auto &s : arm.body) {
+        collectUsedVars(s.get(), used);
+      }
+    }
   } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
     collectUsedVarsFromExpr(&whilestmt->condition(), used);
     for (const auto &s : whilestmt->body()) {
       collectUsedVars(s.get(), used);
     }
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(stmt)) {
+    if (forstmt->init()) {
+      collectUsedVars(forstmt->init(), used);
+    }
+    if (forstmt->condition()) {
+      collectUsedVarsFromExpr(forstmt->condition(), used);
+    }
+    if (forstmt->increment()) {
+      collectUsedVars(forstmt->increment(), used);
+    }
+    for (const auto &s : forstmt->body()) {
+      collectUsedVars(s.get(), used);
+    }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&forin->iterable(), used);
+    for (const auto &s : forin->body()) {
+      collectUsedVars(s.get(), used);
+    }
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    collectUsedVarsFromExpr(&parallel->start(), used);
+    collectUsedVarsFromExpr(&parallel->end(), used);
+    for (const auto &s : parallel->body()) {
+      collectUsedVars(s.get(), used);
+    }
   } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
     if (ret->value()) {
       collectUsedVarsFromExpr(ret->value(), used);
     }
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+    for (const auto &s : block->statements()) {
+      collectUsedVars(s.get(), used);
+    }
   }
 }
 
-void Optimizer::collectUsedVarsFromExpr(const Expr *expr,
-                                        std::unordered_set<std::string> &used) {
+void Optimizer::collectUsedVarsFromExpr(
+    const Expr *expr, std::unordered_set<std::string> &used) const {
   if (auto *id = dynamic_cast<const IdentifierExpr *>(expr)) {
     used.insert(id->name());
   } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(expr)) {
@@ -204,114 +689,2003 @@ void Optimizer::collectUsedVarsFromExpr(const Expr *expr,
     for (const auto &arg : call->args()) {
       collectUsedVarsFromExpr(arg.get(), used);
     }
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(expr)) {
+    for (const auto &element : array->elements()) {
+      collectUsedVarsFromExpr(element.get(), used);
+    }
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(expr)) {
+    collectUsedVarsFromExpr(&index->target(), used);
+    collectUsedVarsFromExpr(&index->index(), used);
   }
 }
 
-void Optimizer::countDeadCode(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                              const std::unordered_set<std::string> &used) {
-  bool afterReturn = false;
-
-  for (const auto &stmt : stmts) {
-    if (afterReturn) {
-      stats_.deadCodeRemoved++;
-      continue;
-    }
-
-    if (dynamic_cast<const ReturnStmt *>(stmt.get())) {
-      afterReturn = true;
+void Optimizer::collectAssignedVars(const Stmt *stmt,
+                                    std::unordered_set<std::string> &assigned) {
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
+    assigned.insert(assign->name());
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
+    for (const auto &s : ifstmt->body()) {
+      collectAssignedVars(s.get(), assigned);
     }
-
-    // Check for unused assignments
-    if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt.get())) {
-      if (used.find(assign->name()) == used.end()) {
-        stats_.deadCodeRemoved++;
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    for (const auto &arm : switchstmt->cases()) {
+      for (const auto &s : arm.body) {
+        collectAssignedVars(s.get(), assigned);
       }
     }
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
+    for (const auto &s : whilestmt->body()) {
+      collectAssignedVars(s.get(), assigned);
+    }
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(stmt)) {
+    if (forstmt->init()) {
+      collectAssignedVars(forstmt->init(), assigned);
+    }
+    if (forstmt->increment()) {
+      collectAssignedVars(forstmt->increment(), assigned);
+    }
+    for (const auto &s : forstmt->body()) {
+      collectAssignedVars(s.get(), assigned);
+    }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    assigned.insert(forin->variable());
+    for (const auto &s : forin->body()) {
+      collectAssignedVars(s.get(), assigned);
+    }
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    assigned.insert(parallel->variable());
+    for (const auto &s : parallel->body()) {
+      collectAssignedVars(s.get(), assigned);
+    }
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+    for (const auto &s : block->statements()) {
+      collectAssignedVars(s.get(), assigned);
+    }
   }
 }
 
-void Optimizer::eliminateDeadCode(
-    std::vector<std::unique_ptr<Stmt>> & /*stmts*/) {
-  // Would modify stmts in place - requires mutable AST
+// ----------------------------------------------------------------------------
+// Constant Evaluation
+// ----------------------------------------------------------------------------
+
+bool Optimizer::evaluateConstant(const Expr &expr, int32_t &result) const {
+  if (auto *num = dynamic_cast<const NumberExpr *>(&expr)) {
+    result = num->value();
+    return true;
+  }
+
+  if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    int32_t operand = 0;
+    if (!evaluateConstant(unary->operand(), operand)) {
+      return false;
+    }
+    if (unary->op() == UnaryOpExpr::Operator::NEGATE) {
+      result = static_cast<int32_t>(0u - static_cast<uint32_t>(operand));
+    } else {
+      result = operand == 0 ? 1 : 0;
+    }
+    return true;
+  }
+
+  auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr);
+  int32_t a = 0, b = 0;
+  if (!binop || !evaluateConstant(binop->left(), a) ||
+      !evaluateConstant(binop->right(), b)) {
+    return false;
+  }
+
+  // Same semantics as the VM (wrapping arithmetic, AND/OR as MUL/ADD)
+  auto ua = static_cast<uint32_t>(a);
+  auto ub = static_cast<uint32_t>(b);
+  switch (binop->op()) {
+  case BinaryOpExpr::Operator::PLUS:
+  case BinaryOpExpr::Operator::OR:
+    result = static_cast<int32_t>(ua + ub);
+    return true;
+  case BinaryOpExpr::Operator::MINUS:
+    result = static_cast<int32_t>(ua - ub);
+    return true;
+  case BinaryOpExpr::Operator::MULTIPLY:
+  case BinaryOpExpr::Operator::AND:
+    result = static_cast<int32_t>(ua * ub);
+    return true;
+  case BinaryOpExpr::Operator::DIVIDE:
+  case BinaryOpExpr::Operator::MODULO:
+    // Leave runtime errors to the VM
+    if (b == 0) {
+      return false;
+    }
+    result = binop->op() == BinaryOpExpr::Operator::DIVIDE ? wrapDivide(a, b)
+                                                           : wrapModulo(a, b);
+    return true;
+  case BinaryOpExpr::Operator::EQUAL:
+    result = a == b;
+    return true;
+  case BinaryOpExpr::Operator::NOT_EQUAL:
+    result = a != b;
+    return true;
+  case BinaryOpExpr::Operator::LESS:
+    result = a < b;
+    return true;
+  case BinaryOpExpr::Operator::LESS_EQUAL:
+    result = a <= b;
+    return true;
+  case BinaryOpExpr::Operator::GREATER:
+    result = a > b;
+    return true;
+  case BinaryOpExpr::Operator::GREATER_EQUAL:
+    result = a >= b;
+    return true;
+  }
+  return false;
 }
 
 // ============================================================================
-// Function Inlining
+// Strength Reduction
 // ============================================================================
 
-void Optimizer::runFunctionInlining(Program & /*program*/) {
-  // Find small, non-recursive functions
-  // Count call sites
-  // Inline if criteria met
+namespace {
 
-  for (const auto &[name, fn] : functionMap_) {
-    if (canInline(*fn)) {
-      stats_.functionsInlined++;
+constexpr const char *kInductionPrefix = "$iv";
+
+// Keeping a derived variable in step costs a LOAD, CONST/LOAD, ADD and STORE
+constexpr int kUpdateCost = 4;
+
+// Static guess at how often a nested loop body runs per outer iteration
+constexpr int kNestedLoopWeight = 8;
+
+/**
+ * True if an expression can only produce an integer (or fail). Only `+`
+ * (and OR, which compiles to ADD) can build strings.
+ */
+bool isIntExpr(const Expr &expr) {
+  if (dynamic_cast<const NumberExpr *>(&expr) ||
+      dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    return true;
+  }
+  if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    if (binop->op() == BinaryOpExpr::Operator::PLUS ||
+        binop->op() == BinaryOpExpr::Operator::OR) {
+      return isIntExpr(binop->left()) && isIntExpr(binop->right());
     }
+    return true;
   }
+  return false;
 }
 
-bool Optimizer::canInline(const FunctionDecl &fn) const {
-  // Inline if:
-  // 1. Small (< 20 AST nodes)
-  // 2. Not recursive
-  // 3. Has <= 3 parameters
+/**
+ * Call fn for every AssignmentStmt in a statement, including nested ones,
+ * and onLoopVariable with the variable of every for-in and parallel for
+ * (which assign it without one)
+ */
+template <typename Fn, typename OnLoopVariable>
+void forEachWrite(Stmt *stmt, Fn &&fn, OnLoopVariable &&onLoopVariable) {
+  if (auto *assign = dynamic_cast<AssignmentStmt *>(stmt)) {
+    fn(*assign);
+  } else if (auto *ifstmt = dynamic_cast<IfStmt *>(stmt)) {
+    for (auto &s : ifstmt->mutableBody()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(stmt)) {
+    for (auto &arm : switchstmt->mutableCases()) {
+      for (auto &s : arm.body) {
+        forEachWrite(s.get(), fn, onLoopVariable);
+      }
+    }
+  } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(stmt)) {
+    for (auto &s : whilestmt->mutableBody()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  } else if (auto *forstmt = dynamic_cast<ForStmt *>(stmt)) {
+    if (forstmt->init()) {
+      forEachWrite(forstmt->mutableInit().get(), fn, onLoopVariable);
+    }
+    if (forstmt->increment()) {
+      forEachWrite(forstmt->mutableIncrement().get(), fn, onLoopVariable);
+    }
+    for (auto &s : forstmt->mutableBody()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  } else if (auto *forin = dynamic_cast<ForInStmt *>(stmt)) {
+    onLoopVariable(forin->variable());
+    for (auto &s : forin->mutableBody()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(stmt)) {
+    onLoopVariable(parallel->variable());
+    for (auto &s : parallel->mutableBody()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  } else if (auto *block = dynamic_cast<BlockStmt *>(stmt)) {
+    for (auto &s : block->mutableStatements()) {
+      forEachWrite(s.get(), fn, onLoopVariable);
+    }
+  }
+}
 
-  if (fn.params().size() > 3)
-    return false;
-  if (countAstNodes(fn) > 20)
-    return false;
+template <typename Fn> void forEachAssignment(Stmt *stmt, Fn &&fn) {
+  forEachWrite(stmt, fn, [](const std::string &) {});
+}
 
-  // Check for recursion (function calls itself)
-  // Simplified check
-  for (const auto &stmt : fn.body()) {
-    if (containsCall(stmt.get(), fn.name())) {
+/**
+ * Call fn with the name of every variable a statement assigns
+ */
+template <typename Fn> void forEachAssignedName(Stmt *stmt, Fn &&fn) {
+  forEachWrite(
+      stmt, [&](AssignmentStmt &assign) { fn(assign.name()); },
+      [&](const std::string &name) { fn(name); });
+}
+
+/**
+ * Match `iv = iv + c`, `iv = c + iv` or `iv = iv - c`
+ */
+bool isStep(const AssignmentStmt &assign, int64_t &step) {
+  auto *binop = dynamic_cast<const BinaryOpExpr *>(&assign.value());
+  if (!binop) {
+    return false;
+  }
+  auto isVar = [&](const Expr &e) {
+    auto *ident = dynamic_cast<const IdentifierExpr *>(&e);
+    return ident && ident->name() == assign.name();
+  };
+  auto *left = dynamic_cast<const NumberExpr *>(&binop->left());
+  auto *right = dynamic_cast<const NumberExpr *>(&binop->right());
+  if (binop->op() == BinaryOpExpr::Operator::PLUS) {
+    if (isVar(binop->left()) && right) {
+      step = right->value();
+    } else if (left && isVar(binop->right())) {
+      step = left->value();
+    } else {
       return false;
     }
+  } else if (binop->op() == BinaryOpExpr::Operator::MINUS &&
+             isVar(binop->left()) && right) {
+    step = -static_cast<int64_t>(right->value());
+  } else {
+    return false;
   }
-
-  return true;
+  return step != 0;
 }
 
-bool Optimizer::containsCall(const Stmt *stmt,
-                             const std::string &fnName) const {
-  if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
-    return containsCallExpr(&assign->value(), fnName);
-  } else if (auto *print = dynamic_cast<const PrintStmt *>(stmt)) {
-    return containsCallExpr(&print->value(), fnName);
-  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
-    return ret->value() && containsCallExpr(ret->value(), fnName);
-  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
-    if (containsCallExpr(&ifstmt->condition(), fnName))
-      return true;
-    for (const auto &s : ifstmt->body()) {
-      if (containsCall(s.get(), fnName))
-        return true;
-    }
-  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
-    if (containsCallExpr(&whilestmt->condition(), fnName))
-      return true;
-    for (const auto &s : whilestmt->body()) {
-      if (containsCall(s.get(), fnName))
-        return true;
+/**
+ * True if the last statement before `end` that assigns `name` certainly
+ * stores an integer (straight-line code, so it is the value seen at `end`)
+ */
+template <typename Node>
+bool isKnownInt(std::vector<std::unique_ptr<Node>> &stmts, size_t end,
+                const std::string &name) {
+  for (size_t j = end; j-- > 0;) {
+    auto *stmt = dynamic_cast<Stmt *>(stmts[j].get());
+    if (!stmt) {
+      continue;
     }
-  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
-    for (const auto &s : block->statements()) {
-      if (containsCall(s.get(), fnName))
-        return true;
+    bool assigned = false;
+    forEachAssignedName(stmt, [&](const std::string &target) {
+      assigned = assigned || target == name;
+    });
+    if (assigned) {
+      auto *assign = dynamic_cast<AssignmentStmt *>(stmt);
+      return assign && isIntExpr(assign->value());
     }
   }
   return false;
 }
 
-bool Optimizer::containsCallExpr(const Expr *expr,
-                                 const std::string &fnName) const {
-  if (auto *call = dynamic_cast<const FunctionCallExpr *>(expr)) {
-    if (call->name() == fnName)
-      return true;
-    for (const auto &arg : call->args()) {
-      if (containsCallExpr(arg.get(), fnName))
-        return true;
+/**
+ * Induction variable strength reduction.
+ *
+ * A basic induction variable is assigned exactly once in a loop, by
+ * `i = i + c` or `i = i - c`, either as the for increment or directly in the
+ * loop body. Products `i * k` with a constant or loop-invariant k then get
+ * a derived variable that is initialized before the loop and advanced by
+ * `k * c` right after every update of `i`, so the multiplication leaves the
+ * loop. Values have to be known integers before the loop: the derived
+ * variable is computed even if the loop body never runs.
+ */
+class InductionVariables {
+public:
+  explicit InductionVariables(int &reduced) : reduced_(reduced) {}
+
+  template <typename Node> void run(std::vector<std::unique_ptr<Node>> &stmts) {
+    for (auto &stmt : stmts) {
+      if (auto *s = dynamic_cast<Stmt *>(stmt.get())) {
+        forEachAssignment(s, [&](AssignmentStmt &assign) {
+          const std::string &name = assign.name();
+          if (name.rfind(kInductionPrefix, 0) == 0) {
+            nextTemp_ = std::max(
+                nextTemp_,
+                std::stoi(name.substr(std::strlen(kInductionPrefix))) + 1);
+          }
+        });
+      }
+    }
+    walk(stmts);
+  }
+
+private:
+  int &reduced_;
+  int nextTemp_ = 0;
+
+  // A loop being reduced
+  struct Loop {
+    std::unique_ptr<Expr> *condition = nullptr;
+    std::vector<std::unique_ptr<Stmt>> *body = nullptr;
+    std::unique_ptr<Stmt> *init = nullptr;      // For loops only
+    std::unique_ptr<Stmt> *increment = nullptr; // For loops only
+  };
+
+  // A product of the induction variable and a factor
+  struct Use {
+    std::unique_ptr<Expr> *slot;
+    std::string factor; // Variable name, or "#k" for a constant
+    int weight;
+  };
+
+  template <typename Node>
+  void walk(std::vector<std::unique_ptr<Node>> &stmts) {
+    for (size_t i = 0; i < stmts.size(); ++i) {
+      auto *stmt = dynamic_cast<Stmt *>(stmts[i].get());
+      if (!stmt) {
+        continue;
+      }
+
+      // Inner loops first; outer induction variables are invariant there
+      Loop loop;
+      if (auto *ifstmt = dynamic_cast<IfStmt *>(stmt)) {
+        walk(ifstmt->mutableBody());
+        continue;
+      } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(stmt)) {
+        for (auto &arm : switchstmt->mutableCases()) {
+          walk(arm.body);
+        }
+        continue;
+      } else if (auto *block = dynamic_cast<BlockStmt *>(stmt)) {
+        walk(block->mutableStatements());
+        continue;
+      } else if (auto *forin = dynamic_cast<ForInStmt *>(stmt)) {
+        walk(forin->mutableBody()); // The iterator has no induction variable
+        continue;
+      } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(stmt)) {
+        // Iterations do not run in order, so nothing can be carried
+        // from one to the next
+        walk(parallel->mutableBody());
+        continue;
+      } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(stmt)) {
+        walk(whilestmt->mutableBody());
+        loop.condition = &whilestmt->mutableCondition();
+        loop.body = &whilestmt->mutableBody();
+      } else if (auto *forstmt = dynamic_cast<ForStmt *>(stmt)) {
+        walk(forstmt->mutableBody());
+        loop.condition = &forstmt->mutableCondition();
+        loop.body = &forstmt->mutableBody();
+        loop.init = &forstmt->mutableInit();
+        loop.increment = &forstmt->mutableIncrement();
+      } else {
+        continue;
+      }
+
+      auto knownInt = [&](const std::string &name) {
+        return isKnownInt(stmts, i, name);
+      };
+      std::vector<std::unique_ptr<Stmt>> before;
+      reduce(loop, knownInt, before);
+      for (auto &def : before) {
+        stmts.insert(stmts.begin() + static_cast<std::ptrdiff_t>(i++),
+                     std::move(def));
+      }
+    }
+  }
+
+  template <typename KnownInt>
+  void reduce(Loop &loop, KnownInt &knownInt,
+              std::vector<std::unique_ptr<Stmt>> &before) {
+    // Every assignment inside the loop, in order (the init runs only once)
+    std::vector<AssignmentStmt *> assignments;
+    auto record = [&](AssignmentStmt &assign) {
+      assignments.push_back(&assign);
+    };
+    for (auto &stmt : *loop.body) {
+      forEachAssignment(stmt.get(), record);
+    }
+    if (loop.increment && *loop.increment) {
+      forEachAssignment(loop.increment->get(), record);
+    }
+    std::unordered_map<std::string, int> assignCount;
+    for (auto *assign : assignments) {
+      ++assignCount[assign->name()];
+    }
+    for (auto &stmt : *loop.body) {
+      forEachWrite(
+          stmt.get(), [](AssignmentStmt &) {},
+          [&](const std::string &name) { ++assignCount[name]; });
+    }
+
+    for (auto *update : assignments) {
+      const std::string &iv = update->name();
+      int64_t step = 0;
+      if (assignCount[iv] != 1 || !isStep(*update, step)) {
+        continue;
+      }
+      bool inIncrement = loop.increment && loop.increment->get() == update;
+      if (!inIncrement && indexIn(*loop.body, update) < 0) {
+        continue; // Conditional update
+      }
+      if (!startsAsInt(loop, iv, knownInt)) {
+        continue;
+      }
+
+      auto isInvariantInt = [&](const std::string &name) {
+        return name != iv && !assignCount.count(name) && knownInt(name);
+      };
+      std::vector<Use> uses;
+      if (loop.condition && *loop.condition) {
+        collectUses(*loop.condition, iv, 1, isInvariantInt, uses);
+      }
+      for (auto &stmt : *loop.body) {
+        collectUses(*stmt, iv, 1, isInvariantInt, uses);
+      }
+      if (loop.increment && *loop.increment) {
+        collectUses(**loop.increment, iv, 1, isInvariantInt, uses);
+      }
+
+      // One derived variable per distinct factor
+      std::vector<std::string> factors;
+      for (const auto &use : uses) {
+        if (std::find(factors.begin(), factors.end(), use.factor) ==
+            factors.end()) {
+          factors.push_back(use.factor);
+        }
+      }
+      for (const auto &factor : factors) {
+        reduceFactor(loop, *update, step, inIncrement, factor, uses, before);
+      }
+    }
+  }
+
+  static int indexIn(const std::vector<std::unique_ptr<Stmt>> &stmts,
+                     const Stmt *stmt) {
+    for (size_t k = 0; k < stmts.size(); ++k) {
+      if (stmts[k].get() == stmt) {
+        return static_cast<int>(k);
+      }
+    }
+    return -1;
+  }
+
+  template <typename KnownInt>
+  static bool startsAsInt(Loop &loop, const std::string &iv,
+                          KnownInt &knownInt) {
+    if (loop.init && *loop.init) {
+      if (auto *init = dynamic_cast<AssignmentStmt *>(loop.init->get())) {
+        if (init->name() == iv) {
+          return isIntExpr(init->value());
+        }
+      }
+      bool assigned = false;
+      forEachAssignment(loop.init->get(), [&](AssignmentStmt &assign) {
+        assigned = assigned || assign.name() == iv;
+      });
+      if (assigned) {
+        return false;
+      }
+    }
+    return knownInt(iv);
+  }
+
+  template <typename IsInvariant>
+  void collectUses(Stmt &stmt, const std::string &iv, int weight,
+                   IsInvariant &isInvariant, std::vector<Use> &uses) {
+    auto expr = [&](std::unique_ptr<Expr> &slot) {
+      collectUses(slot, iv, weight, isInvariant, uses);
+    };
+    auto list = [&](std::vector<std::unique_ptr<Stmt>> &stmts, int w) {
+      for (auto &s : stmts) {
+        collectUses(*s, iv, w, isInvariant, uses);
+      }
+    };
+
+    if (auto *assign = dynamic_cast<AssignmentStmt *>(&stmt)) {
+      expr(assign->mutableValue());
+    } else if (auto *arrAssign = dynamic_cast<ArrayAssignmentStmt *>(&stmt)) {
+      expr(arrAssign->mutableTarget());
+      expr(arrAssign->mutableIndex());
+      expr(arrAssign->mutableValue());
+    } else if (auto *exprStmt = dynamic_cast<ExpressionStmt *>(&stmt)) {
+      expr(exprStmt->mutableExpr());
+    } else if (auto *print = dynamic_cast<PrintStmt *>(&stmt)) {
+      expr(print->mutableValue());
+    } else if (auto *ret = dynamic_cast<ReturnStmt *>(&stmt)) {
+      if (ret->value()) {
+        expr(ret->mutableValue());
+      }
+    } else if (auto *ifstmt = dynamic_cast<IfStmt *>(&stmt)) {
+      expr(ifstmt->mutableCondition());
+      list(ifstmt->mutableBody(), weight);
+    } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(&stmt)) {
+      expr(switchstmt->mutableValue());
+      for (auto &arm : switchstmt->mutableCases()) {
+        list(arm.body, weight);
+      }
+    } else if (auto *block = dynamic_cast<BlockStmt *>(&stmt)) {
+      list(block->mutableStatements(), weight);
+    } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(&stmt)) {
+      int inner = std::max(weight, kNestedLoopWeight);
+      collectUses(whilestmt->mutableCondition(), iv, inner, isInvariant, uses);
+      list(whilestmt->mutableBody(), inner);
+    } else if (auto *forstmt = dynamic_cast<ForStmt *>(&stmt)) {
+      int inner = std::max(weight, kNestedLoopWeight);
+      if (forstmt->init()) {
+        collectUses(*forstmt->mutableInit(), iv, weight, isInvariant, uses);
+      }
+      if (forstmt->condition()) {
+        collectUses(forstmt->mutableCondition(), iv, inner, isInvariant, uses);
+      }
+      if (forstmt->increment()) {
+        collectUses(*forstmt->mutableIncrement(), iv, inner, isInvariant,
+                    uses);
+      }
+      list(forstmt->mutableBody(), inner);
+    } else if (auto *forin = dynamic_cast<ForInStmt *>(&stmt)) {
+      expr(forin->mutableIterable());
+      list(forin->mutableBody(), std::max(weight, kNestedLoopWeight));
+    } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(&stmt)) {
+      expr(parallel->mutableStart());
+      expr(parallel->mutableEnd());
+      list(parallel->mutableBody(), std::max(weight, kNestedLoopWeight));
+    }
+  }
+
+  template <typename IsInvariant>
+  void collectUses(std::unique_ptr<Expr> &slot, const std::string &iv,
+                   int weight, IsInvariant &isInvariant,
+                   std::vector<Use> &uses) {
+    auto recurse = [&](std::unique_ptr<Expr> &child) {
+      collectUses(child, iv, weight, isInvariant, uses);
+    };
+
+    if (auto *binop = dynamic_cast<BinaryOpExpr *>(slot.get())) {
+      if (binop->op() == BinaryOpExpr::Operator::MULTIPLY) {
+        std::string factor = factorOf(binop->left(), binop->right(), iv,
+                                      isInvariant);
+        if (factor.empty()) {
+          factor = factorOf(binop->right(), binop->left(), iv, isInvariant);
+        }
+        if (!factor.empty()) {
+          uses.push_back({&slot, factor, weight});
+          return;
+        }
+      }
+      recurse(binop->mutableLeft());
+      recurse(binop->mutableRight());
+    } else if (auto *unary = dynamic_cast<UnaryOpExpr *>(slot.get())) {
+      recurse(unary->mutableOperand());
+    } else if (auto *index = dynamic_cast<IndexExpr *>(slot.get())) {
+      recurse(index->mutableTarget());
+      recurse(index->mutableIndex());
+    } else if (auto *call = dynamic_cast<FunctionCallExpr *>(slot.get())) {
+      for (auto &arg : call->mutableArgs()) {
+        recurse(arg);
+      }
+    } else if (auto *array = dynamic_cast<ArrayLiteralExpr *>(slot.get())) {
+      for (auto &element : array->mutableElements()) {
+        recurse(element);
+      }
+    }
+  }
+
+  /**
+   * Factor key if `var * other` is a product of the induction variable
+   */
+  template <typename IsInvariant>
+  static std::string factorOf(const Expr &var, const Expr &other,
+                              const std::string &iv, IsInvariant &isInvariant) {
+    auto *ident = dynamic_cast<const IdentifierExpr *>(&var);
+    if (!ident || ident->name() != iv) {
+      return {};
+    }
+    if (auto *num = dynamic_cast<const NumberExpr *>(&other)) {
+      if (num->value() < -1 || num->value() > 1) {
+        return "#" + std::to_string(num->value());
+      }
+    } else if (auto *factor = dynamic_cast<const IdentifierExpr *>(&other)) {
+      if (isInvariant(factor->name())) {
+        return factor->name();
+      }
+    }
+    return {};
+  }
+
+  void reduceFactor(Loop &loop, AssignmentStmt &update, int64_t step,
+                    bool inIncrement, const std::string &factor,
+                    std::vector<Use> &uses,
+                    std::vector<std::unique_ptr<Stmt>> &before) {
+    bool constant = factor[0] == '#';
+    int64_t k = constant ? std::stoll(factor.substr(1)) : 0;
+    if (!constant && step != 1 && step != -1) {
+      return; // The increment would need its own multiplication
+    }
+
+    // A power-of-two product is already a single SHL after codegen
+    int perUse = constant && k > 0 && (k & (k - 1)) == 0 ? 1 : 2;
+    int savings = 0;
+    for (const auto &use : uses) {
+      if (use.factor == factor) {
+        savings += use.weight * perUse;
+      }
+    }
+    if (savings <= kUpdateCost) {
+      return;
+    }
+
+    std::string temp = kInductionPrefix + std::to_string(nextTemp_++);
+    auto factorExpr = [&]() -> std::unique_ptr<Expr> {
+      if (constant) {
+        return std::make_unique<NumberExpr>(static_cast<int>(k));
+      }
+      return std::make_unique<IdentifierExpr>(factor);
+    };
+
+    // temp = iv * k, before the loop (after a for loop's own init)
+    auto init = std::make_unique<AssignmentStmt>(
+        temp, std::make_unique<BinaryOpExpr>(
+                  std::make_unique<IdentifierExpr>(update.name()),
+                  BinaryOpExpr::Operator::MULTIPLY, factorExpr()));
+    if (!loop.init) {
+      before.push_back(std::move(init));
+    } else {
+      appendStmt(*loop.init, std::move(init));
+    }
+
+    // temp = temp + k * step, right after the update of iv
+    std::unique_ptr<Expr> delta;
+    auto op = BinaryOpExpr::Operator::PLUS;
+    if (constant) {
+      delta = std::make_unique<NumberExpr>(
+          static_cast<int32_t>(static_cast<uint32_t>(k * step)));
+    } else {
+      delta = factorExpr();
+      if (step < 0) {
+        op = BinaryOpExpr::Operator::MINUS;
+      }
+    }
+    auto advance = std::make_unique<AssignmentStmt>(
+        temp, std::make_unique<BinaryOpExpr>(
+                  std::make_unique<IdentifierExpr>(temp), op,
+                  std::move(delta)));
+    if (inIncrement) {
+      appendStmt(*loop.increment, std::move(advance));
+    } else {
+      auto &body = *loop.body;
+      body.insert(body.begin() + indexIn(body, &update) + 1,
+                  std::move(advance));
+    }
+
+    for (auto &use : uses) {
+      if (use.factor == factor) {
+        *use.slot = std::make_unique<IdentifierExpr>(temp);
+      }
+    }
+    ++reduced_;
+  }
+
+  /**
+   * Run `stmt` after `slot` (which may be empty), grouping them in a block
+   */
+  static void appendStmt(std::unique_ptr<Stmt> &slot,
+                         std::unique_ptr<Stmt> stmt) {
+    if (!slot) {
+      slot = std::move(stmt);
+      return;
+    }
+    if (auto *block = dynamic_cast<BlockStmt *>(slot.get())) {
+      block->mutableStatements().push_back(std::move(stmt));
+      return;
+    }
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    stmts.push_back(std::move(slot));
+    stmts.push_back(std::move(stmt));
+    slot = std::make_unique<BlockStmt>(std::move(stmts));
+  }
+};
+
+} // namespace
+
+void Optimizer::runStrengthReduction(Program &program) {
+  computeAnalyzedFunctions(program);
+
+  for (auto &item : program.mutableItems()) {
+    if (auto *fn = dynamic_cast<FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        InductionVariables(stats_.inductionVariablesReduced)
+            .run(fn->mutableBody());
+      }
+    }
+  }
+  InductionVariables(stats_.inductionVariablesReduced)
+      .run(program.mutableItems());
+}
+
+// ============================================================================
+// Loop Unrolling
+// ============================================================================
+
+namespace {
+
+constexpr const char *kUnrollPrefix = "$unroll";
+
+// Body copies per iteration of a partially unrolled loop
+constexpr int kUnrollFactor = 4;
+
+// Largest constant trip count that is unrolled completely
+constexpr int64_t kMaxFullUnrollTrips = 8;
+
+// AST nodes the copies of one loop body may add up to
+constexpr int kUnrollBudget = 96;
+
+// Profiled body executions from which a loop counts as hot and may use
+// twice the budget
+constexpr uint64_t kHotLoopIterations = 10000;
+
+// A variable whose reads are replaced by a constant while cloning
+struct Binding {
+  std::string name;
+  int32_t value;
+};
+
+std::unique_ptr<Expr> cloneExpr(const Expr &expr,
+                                const Binding *bind = nullptr) {
+  auto list = [&](const std::vector<std::unique_ptr<Expr>> &exprs) {
+    std::vector<std::unique_ptr<Expr>> copies;
+    for (const auto &e : exprs) {
+      copies.push_back(cloneExpr(*e, bind));
+    }
+    return copies;
+  };
+
+  if (auto *num = dynamic_cast<const NumberExpr *>(&expr)) {
+    return std::make_unique<NumberExpr>(num->value());
+  } else if (auto *str = dynamic_cast<const StringLiteralExpr *>(&expr)) {
+    return std::make_unique<StringLiteralExpr>(str->value());
+  } else if (auto *ident = dynamic_cast<const IdentifierExpr *>(&expr)) {
+    if (bind && ident->name() == bind->name) {
+      return std::make_unique<NumberExpr>(bind->value);
+    }
+    return std::make_unique<IdentifierExpr>(ident->name());
+  } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    return std::make_unique<BinaryOpExpr>(cloneExpr(binop->left(), bind),
+                                          binop->op(),
+                                          cloneExpr(binop->right(), bind));
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    return std::make_unique<UnaryOpExpr>(unary->op(),
+                                         cloneExpr(unary->operand(), bind));
+  } else if (auto *call = dynamic_cast<const FunctionCallExpr *>(&expr)) {
+    return std::make_unique<FunctionCallExpr>(call->name(),
+                                              list(call->args()));
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(&expr)) {
+    return std::make_unique<ArrayLiteralExpr>(list(array->elements()));
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(&expr)) {
+    return std::make_unique<IndexExpr>(cloneExpr(index->target(), bind),
+                                       cloneExpr(index->index(), bind));
+  }
+  throw OptimizerError("Cannot copy expression");
+}
+
+std::unique_ptr<Stmt> cloneStmt(const Stmt &stmt,
+                                const Binding *bind = nullptr) {
+  auto list = [&](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    std::vector<std::unique_ptr<Stmt>> copies;
+    for (const auto &s : stmts) {
+      copies.push_back(cloneStmt(*s, bind));
+    }
+    return copies;
+  };
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(&stmt)) {
+    return std::make_unique<AssignmentStmt>(assign->name(),
+                                            cloneExpr(assign->value(), bind));
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(&stmt)) {
+    return std::make_unique<ArrayAssignmentStmt>(
+        cloneExpr(arrAssign->target(), bind),
+        cloneExpr(arrAssign->index(), bind),
+        cloneExpr(arrAssign->value(), bind), arrAssign->compoundOp());
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(&stmt)) {
+    return std::make_unique<ExpressionStmt>(cloneExpr(exprStmt->expr(), bind));
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(&stmt)) {
+    return std::make_unique<PrintStmt>(cloneExpr(print->value(), bind));
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    auto copy = std::make_unique<IfStmt>(cloneExpr(ifstmt->condition(), bind),
+                                         list(ifstmt->body()));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    std::vector<SwitchCase> cases;
+    for (const auto &arm : switchstmt->cases()) {
+      SwitchCase &copy = cases.emplace_back();
+      for (const auto &label : arm.labels) {
+        copy.labels.push_back(cloneExpr(*label));
+      }
+      copy.body = list(arm.body);
+    }
+    auto copy = std::make_unique<SwitchStmt>(
+        cloneExpr(switchstmt->value(), bind), std::move(cases));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(&stmt)) {
+    auto copy = std::make_unique<WhileStmt>(
+        cloneExpr(whilestmt->condition(), bind), list(whilestmt->body()));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (auto *forstmt = dynamic_cast<const ForStmt *>(&stmt)) {
+    auto copy = std::make_unique<ForStmt>(
+        forstmt->init() ? cloneStmt(*forstmt->init(), bind) : nullptr,
+        forstmt->condition() ? cloneExpr(*forstmt->condition(), bind) : nullptr,
+        forstmt->increment() ? cloneStmt(*forstmt->increment(), bind)
+                             : nullptr,
+        list(forstmt->body()));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(&stmt)) {
+    auto copy = std::make_unique<ForInStmt>(
+        forin->variable(), cloneExpr(forin->iterable(), bind),
+        list(forin->body()));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(&stmt)) {
+    auto copy = std::make_unique<ParallelForStmt>(
+        parallel->variable(), cloneExpr(parallel->start(), bind),
+        cloneExpr(parallel->end(), bind), parallel->reductions(),
+        list(parallel->body()));
+    copy->setLine(stmt.line());
+    return copy;
+  } else if (dynamic_cast<const BreakStmt *>(&stmt)) {
+    return std::make_unique<BreakStmt>();
+  } else if (dynamic_cast<const ContinueStmt *>(&stmt)) {
+    return std::make_unique<ContinueStmt>();
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(&stmt)) {
+    return std::make_unique<ReturnStmt>(
+        ret->value() ? cloneExpr(*ret->value(), bind) : nullptr);
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    return std::make_unique<BlockStmt>(list(block->statements()));
+  }
+  throw OptimizerError("Cannot copy statement");
+}
+
+int exprSize(const Expr &expr) {
+  int size = 1;
+  if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+    size += exprSize(binop->left()) + exprSize(binop->right());
+  } else if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+    size += exprSize(unary->operand());
+  } else if (auto *call = dynamic_cast<const FunctionCallExpr *>(&expr)) {
+    for (const auto &arg : call->args()) {
+      size += exprSize(*arg);
+    }
+  } else if (auto *array = dynamic_cast<const ArrayLiteralExpr *>(&expr)) {
+    for (const auto &element : array->elements()) {
+      size += exprSize(*element);
+    }
+  } else if (auto *index = dynamic_cast<const IndexExpr *>(&expr)) {
+    size += exprSize(index->target()) + exprSize(index->index());
+  }
+  return size;
+}
+
+/**
+ * AST nodes in a loop body statement, or -1 if it contains a loop, break or
+ * continue (only innermost loops with a single exit are unrolled)
+ */
+int bodySize(const Stmt &stmt) {
+  auto list = [](const std::vector<std::unique_ptr<Stmt>> &stmts) {
+    int size = 0;
+    for (const auto &s : stmts) {
+      int n = bodySize(*s);
+      if (n < 0) {
+        return -1;
+      }
+      size += n;
+    }
+    return size;
+  };
+
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(&stmt)) {
+    return 1 + exprSize(assign->value());
+  } else if (auto *arrAssign = dynamic_cast<const ArrayAssignmentStmt *>(&stmt)) {
+    return 1 + exprSize(arrAssign->target()) + exprSize(arrAssign->index()) +
+           exprSize(arrAssign->value());
+  } else if (auto *exprStmt = dynamic_cast<const ExpressionStmt *>(&stmt)) {
+    return 1 + exprSize(exprStmt->expr());
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(&stmt)) {
+    return 1 + exprSize(print->value());
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(&stmt)) {
+    return 1 + (ret->value() ? exprSize(*ret->value()) : 0);
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(&stmt)) {
+    int body = list(ifstmt->body());
+    return body < 0 ? -1 : 1 + exprSize(ifstmt->condition()) + body;
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(&stmt)) {
+    int size = 1 + exprSize(switchstmt->value());
+    for (const auto &arm : switchstmt->cases()) {
+      int body = list(arm.body);
+      if (body < 0) {
+        return -1;
+      }
+      size += static_cast<int>(arm.labels.size()) + body;
+    }
+    return size;
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(&stmt)) {
+    int body = list(block->statements());
+    return body < 0 ? -1 : 1 + body;
+  }
+  return -1;
+}
+
+/**
+ * Unrolling of counted for loops `for (i = a; i < b; i = i + c)` (or `<=`,
+ * or `>`/`>=` counting down) whose body does not assign `i`.
+ *
+ * With constant bounds and a tiny trip count the loop is replaced by one copy
+ * of the body per iteration, with `i` replaced by its value, followed by the
+ * final value of `i`. Otherwise the body is repeated kUnrollFactor times in a
+ * while loop that runs while all copies are in range, and the original loop
+ * (without its init) finishes the remaining iterations. A variable bound gets
+ * a limit `b - 3c` that is checked against wrap-around before the loop.
+ *
+ * With a profile, loops that never ran or average fewer than kUnrollFactor
+ * trips per entry are left alone, and hot loops get a larger budget.
+ */
+class LoopUnroller {
+public:
+  LoopUnroller(const ProfileData *profile, std::string function,
+               int &unrolled)
+      : profile_(profile), function_(std::move(function)),
+        unrolled_(unrolled) {}
+
+  template <typename Node> void run(std::vector<std::unique_ptr<Node>> &stmts) {
+    for (auto &stmt : stmts) {
+      if (auto *s = dynamic_cast<Stmt *>(stmt.get())) {
+        forEachAssignment(s, [&](AssignmentStmt &assign) {
+          const std::string &name = assign.name();
+          if (name.rfind(kUnrollPrefix, 0) == 0) {
+            nextTemp_ = std::max(
+                nextTemp_,
+                std::stoi(name.substr(std::strlen(kUnrollPrefix))) + 1);
+          }
+        });
+      }
+    }
+    walk(stmts);
+  }
+
+private:
+  const ProfileData *profile_;
+  std::string function_; // Empty for top-level code
+  int &unrolled_;
+  int nextTemp_ = 0;
+
+  // The parts of a loop that unrolling needs
+  struct Counted {
+    std::string var;
+    BinaryOpExpr::Operator op;
+    int64_t step;
+    const Expr *bound;
+    int size; // AST nodes in the body and increment
+  };
+
+  template <typename Node>
+  void walk(std::vector<std::unique_ptr<Node>> &stmts) {
+    for (auto &slot : stmts) {
+      auto *stmt = dynamic_cast<Stmt *>(slot.get());
+      if (auto *ifstmt = dynamic_cast<IfStmt *>(stmt)) {
+        walk(ifstmt->mutableBody());
+      } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(stmt)) {
+        for (auto &arm : switchstmt->mutableCases()) {
+          walk(arm.body);
+        }
+      } else if (auto *block = dynamic_cast<BlockStmt *>(stmt)) {
+        walk(block->mutableStatements());
+      } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(stmt)) {
+        walk(whilestmt->mutableBody());
+      } else if (auto *forin = dynamic_cast<ForInStmt *>(stmt)) {
+        walk(forin->mutableBody());
+      } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(stmt)) {
+        walk(parallel->mutableBody());
+      } else if (auto *forstmt = dynamic_cast<ForStmt *>(stmt)) {
+        walk(forstmt->mutableBody());
+        if (auto unrolled = unroll(*forstmt)) {
+          slot = std::move(unrolled);
+          ++unrolled_;
+        }
+      }
+    }
+  }
+
+  std::unique_ptr<Stmt> unroll(ForStmt &loop) {
+    Counted counted;
+    if (!match(loop, counted)) {
+      return nullptr;
+    }
+    const LoopProfile *counts =
+        profile_ ? profile_->loop(function_, loop.line()) : nullptr;
+    if (counts && counts->iterations == 0) {
+      return nullptr; // Cold: copies would only cost code size
+    }
+    int budget = counts && counts->iterations >= kHotLoopIterations
+                     ? 2 * kUnrollBudget
+                     : kUnrollBudget;
+
+    auto *start = dynamic_cast<const NumberExpr *>(
+        &static_cast<const AssignmentStmt *>(loop.init())->value());
+    auto *bound = dynamic_cast<const NumberExpr *>(counted.bound);
+    if (start && bound) {
+      std::vector<int32_t> values;
+      int64_t value = start->value();
+      while (inRange(value, counted.op, bound->value())) {
+        if (static_cast<int64_t>(values.size()) == kMaxFullUnrollTrips) {
+          break;
+        }
+        values.push_back(static_cast<int32_t>(value));
+        value += counted.step;
+        if (value < INT32_MIN || value > INT32_MAX) {
+          return nullptr; // `i` would wrap around
+        }
+      }
+      bool finished = !inRange(value, counted.op, bound->value());
+      if (finished &&
+          static_cast<int64_t>(values.size()) * counted.size <= budget) {
+        return unrollFully(loop, counted, values,
+                           static_cast<int32_t>(value));
+      }
+    }
+    if (counted.size * kUnrollFactor > budget ||
+        (counts && counts->averageTrips() < kUnrollFactor)) {
+      return nullptr;
+    }
+    return unrollPartially(loop, counted);
+  }
+
+  bool match(ForStmt &loop, Counted &counted) {
+    auto *init = dynamic_cast<const AssignmentStmt *>(loop.init());
+    auto *cond = dynamic_cast<const BinaryOpExpr *>(loop.condition());
+    auto *inc = dynamic_cast<const AssignmentStmt *>(loop.increment());
+    if (!init || !cond || !inc || init->name() != inc->name() ||
+        !isStep(*inc, counted.step)) {
+      return false;
+    }
+    counted.var = inc->name();
+    counted.op = cond->op();
+    counted.bound = &cond->right();
+
+    auto *var = dynamic_cast<const IdentifierExpr *>(&cond->left());
+    if (!var || var->name() != counted.var) {
+      return false;
+    }
+    using Op = BinaryOpExpr::Operator;
+    bool up = counted.op == Op::LESS || counted.op == Op::LESS_EQUAL;
+    bool down = counted.op == Op::GREATER || counted.op == Op::GREATER_EQUAL;
+    if (!(up && counted.step > 0) && !(down && counted.step < 0)) {
+      return false;
+    }
+    // The limit b - (kUnrollFactor - 1) * c has to fit in an integer
+    if (std::abs(counted.step) > INT32_MAX / (kUnrollFactor - 1)) {
+      return false;
+    }
+
+    counted.size = exprSize(inc->value()) + 1;
+    for (const auto &stmt : loop.body()) {
+      int size = bodySize(*stmt);
+      if (size < 0) {
+        return false;
+      }
+      counted.size += size;
+    }
+
+    // Neither `i` nor a variable bound may change inside the loop
+    auto *limit = dynamic_cast<const IdentifierExpr *>(counted.bound);
+    if (!limit && !dynamic_cast<const NumberExpr *>(counted.bound)) {
+      return false;
+    }
+    bool assigned = false;
+    for (auto &stmt : loop.mutableBody()) {
+      forEachAssignedName(stmt.get(), [&](const std::string &name) {
+        assigned = assigned || name == counted.var ||
+                   (limit && name == limit->name());
+      });
+    }
+    return !assigned && !(limit && limit->name() == counted.var);
+  }
+
+  static bool inRange(int64_t value, BinaryOpExpr::Operator op,
+                      int64_t bound) {
+    switch (op) {
+    case BinaryOpExpr::Operator::LESS:
+      return value < bound;
+    case BinaryOpExpr::Operator::LESS_EQUAL:
+      return value <= bound;
+    case BinaryOpExpr::Operator::GREATER:
+      return value > bound;
+    default:
+      return value >= bound;
+    }
+  }
+
+  std::unique_ptr<Stmt> unrollFully(ForStmt &loop, const Counted &counted,
+                                    const std::vector<int32_t> &values,
+                                    int32_t last) {
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    for (int32_t value : values) {
+      Binding bind{counted.var, value};
+      for (const auto &stmt : loop.body()) {
+        stmts.push_back(cloneStmt(*stmt, &bind));
+      }
+    }
+    stmts.push_back(std::make_unique<AssignmentStmt>(
+        counted.var, std::make_unique<NumberExpr>(last)));
+    return std::make_unique<BlockStmt>(std::move(stmts));
+  }
+
+  std::unique_ptr<Stmt> unrollPartially(ForStmt &loop, const Counted &counted) {
+    using Op = BinaryOpExpr::Operator;
+    auto var = [&] { return std::make_unique<IdentifierExpr>(counted.var); };
+    int32_t span = static_cast<int32_t>(counted.step * (kUnrollFactor - 1));
+
+    // All copies run while i OP limit, with limit = bound - span
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    std::unique_ptr<Expr> limit;
+    if (auto *bound = dynamic_cast<const NumberExpr *>(counted.bound)) {
+      int64_t value = static_cast<int64_t>(bound->value()) - span;
+      if (value < INT32_MIN || value > INT32_MAX) {
+        return nullptr;
+      }
+      stmts.push_back(std::move(loop.mutableInit()));
+      limit = std::make_unique<NumberExpr>(static_cast<int32_t>(value));
+    } else {
+      if (counted.op != Op::LESS && counted.op != Op::GREATER) {
+        return nullptr; // No limit value could skip a `<=` loop
+      }
+      // limit = i; if (i OP b) { limit = b - span; if (b OP limit) limit = i; }
+      // The first comparison fails exactly like the loop's own test would,
+      // and a limit that wrapped around makes the unrolled loop skip.
+      std::string temp = kUnrollPrefix + std::to_string(nextTemp_++);
+      std::vector<std::unique_ptr<Stmt>> wrapped;
+      wrapped.push_back(std::make_unique<AssignmentStmt>(temp, var()));
+      std::vector<std::unique_ptr<Stmt>> compute;
+      compute.push_back(std::make_unique<AssignmentStmt>(
+          temp, std::make_unique<BinaryOpExpr>(
+                    cloneExpr(*counted.bound), Op::MINUS,
+                    std::make_unique<NumberExpr>(span))));
+      compute.push_back(std::make_unique<IfStmt>(
+          std::make_unique<BinaryOpExpr>(cloneExpr(*counted.bound),
+                                         counted.op,
+                                         std::make_unique<IdentifierExpr>(temp)),
+          std::move(wrapped)));
+      stmts.push_back(std::move(loop.mutableInit()));
+      stmts.push_back(std::make_unique<AssignmentStmt>(temp, var()));
+      stmts.push_back(std::make_unique<IfStmt>(
+          std::make_unique<BinaryOpExpr>(var(), counted.op,
+                                         cloneExpr(*counted.bound)),
+          std::move(compute)));
+      limit = std::make_unique<IdentifierExpr>(temp);
+    }
+
+    std::vector<std::unique_ptr<Stmt>> body;
+    for (int copy = 0; copy < kUnrollFactor; ++copy) {
+      for (const auto &stmt : loop.body()) {
+        body.push_back(cloneStmt(*stmt));
+      }
+      body.push_back(cloneStmt(*loop.increment()));
+    }
+    stmts.push_back(std::make_unique<WhileStmt>(
+        std::make_unique<BinaryOpExpr>(var(), counted.op, std::move(limit)),
+        std::move(body)));
+
+    // The original loop, without its init, runs the remaining iterations
+    stmts.push_back(std::make_unique<ForStmt>(
+        nullptr, std::move(loop.mutableCondition()),
+        std::move(loop.mutableIncrement()), std::move(loop.mutableBody())));
+    return std::make_unique<BlockStmt>(std::move(stmts));
+  }
+};
+
+} // namespace
+
+void Optimizer::runLoopUnrolling(Program &program) {
+  computeAnalyzedFunctions(program);
+
+  for (auto &item : program.mutableItems()) {
+    if (auto *fn = dynamic_cast<FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        LoopUnroller(profile_, fn->name(), stats_.loopsUnrolled)
+            .run(fn->mutableBody());
+      }
+    }
+  }
+  LoopUnroller(profile_, "", stats_.loopsUnrolled).run(program.mutableItems());
+}
+
+// ============================================================================
+// Partial Evaluation
+// ============================================================================
+
+namespace {
+
+// Instructions all compile-time calls of one compilation may run together,
+// so that many call sites cannot make compiling itself expensive
+constexpr uint64_t kEvaluationBudget = 1000000;
+
+// Longest string result embedded in the program as a literal
+constexpr size_t kMaxStringResult = 4096;
+
+/**
+ * Replaces calls whose arguments are all literals by their result.
+ *
+ * A callee qualifies if it is pure (see EffectAnalysis); with literal
+ * arguments no array can reach it, so array writes inside it are invisible.
+ * The callee and the functions it reaches are copied into a small program
+ * that returns the call's value, which runs in a VirtualMachine limited to
+ * what is left of kEvaluationBudget; once that is spent, no more calls are
+ * tried. Calls that fail, run out of budget or produce an array or a string
+ * longer than kMaxStringResult are left for runtime.
+ */
+class CallEvaluator {
+public:
+  CallEvaluator(const std::unordered_map<std::string, const FunctionDecl *>
+                    &functions,
+                const EffectAnalysis &effects, int &evaluated)
+      : functions_(functions), effects_(effects), evaluated_(evaluated) {}
+
+  template <typename Node> void run(std::vector<std::unique_ptr<Node>> &stmts) {
+    for (auto &stmt : stmts) {
+      if (auto *s = dynamic_cast<Stmt *>(stmt.get())) {
+        walk(*s);
+      }
+    }
+  }
+
+private:
+  const std::unordered_map<std::string, const FunctionDecl *> &functions_;
+  const EffectAnalysis &effects_;
+  int &evaluated_;
+  uint64_t budget_ = kEvaluationBudget;
+
+  // Results by call text; an empty pointer marks a call left for runtime
+  std::unordered_map<std::string, std::unique_ptr<Expr>> results_;
+
+  void walk(Stmt &stmt) {
+    if (auto *assign = dynamic_cast<AssignmentStmt *>(&stmt)) {
+      walk(assign->mutableValue());
+    } else if (auto *arrAssign = dynamic_cast<ArrayAssignmentStmt *>(&stmt)) {
+      walk(arrAssign->mutableTarget());
+      walk(arrAssign->mutableIndex());
+      walk(arrAssign->mutableValue());
+    } else if (auto *exprStmt = dynamic_cast<ExpressionStmt *>(&stmt)) {
+      walk(exprStmt->mutableExpr());
+    } else if (auto *print = dynamic_cast<PrintStmt *>(&stmt)) {
+      walk(print->mutableValue());
+    } else if (auto *ret = dynamic_cast<ReturnStmt *>(&stmt)) {
+      if (ret->value()) {
+        walk(ret->mutableValue());
+      }
+    } else if (auto *ifstmt = dynamic_cast<IfStmt *>(&stmt)) {
+      walk(ifstmt->mutableCondition());
+      run(ifstmt->mutableBody());
+    } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(&stmt)) {
+      walk(switchstmt->mutableValue());
+      for (auto &arm : switchstmt->mutableCases()) {
+        run(arm.body);
+      }
+    } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(&stmt)) {
+      walk(whilestmt->mutableCondition());
+      run(whilestmt->mutableBody());
+    } else if (auto *forstmt = dynamic_cast<ForStmt *>(&stmt)) {
+      if (forstmt->init()) {
+        walk(*forstmt->mutableInit());
+      }
+      if (forstmt->condition()) {
+        walk(forstmt->mutableCondition());
+      }
+      if (forstmt->increment()) {
+        walk(*forstmt->mutableIncrement());
+      }
+      run(forstmt->mutableBody());
+    } else if (auto *forin = dynamic_cast<ForInStmt *>(&stmt)) {
+      walk(forin->mutableIterable());
+      run(forin->mutableBody());
+    } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(&stmt)) {
+      walk(parallel->mutableStart());
+      walk(parallel->mutableEnd());
+      run(parallel->mutableBody());
+    } else if (auto *block = dynamic_cast<BlockStmt *>(&stmt)) {
+      run(block->mutableStatements());
+    }
+  }
+
+  void walk(std::unique_ptr<Expr> &slot) {
+    if (auto *binop = dynamic_cast<BinaryOpExpr *>(slot.get())) {
+      walk(binop->mutableLeft());
+      walk(binop->mutableRight());
+    } else if (auto *unary = dynamic_cast<UnaryOpExpr *>(slot.get())) {
+      walk(unary->mutableOperand());
+    } else if (auto *index = dynamic_cast<IndexExpr *>(slot.get())) {
+      walk(index->mutableTarget());
+      walk(index->mutableIndex());
+    } else if (auto *array = dynamic_cast<ArrayLiteralExpr *>(slot.get())) {
+      for (auto &element : array->mutableElements()) {
+        walk(element);
+      }
+    } else if (auto *call = dynamic_cast<FunctionCallExpr *>(slot.get())) {
+      // Inner calls first, so that f(g(1)) can use the value of g(1)
+      for (auto &arg : call->mutableArgs()) {
+        walk(arg);
+      }
+      if (auto result = evaluate(*call)) {
+        slot = std::move(result);
+        ++evaluated_;
+      }
+    }
+  }
+
+  std::unique_ptr<Expr> evaluate(const FunctionCallExpr &call) {
+    if (!effects_.isPure(call.name())) {
+      return nullptr;
+    }
+    std::string key = call.name() + "(";
+    for (const auto &arg : call.args()) {
+      if (auto *num = dynamic_cast<const NumberExpr *>(arg.get())) {
+        key += std::to_string(num->value()) + ",";
+      } else if (auto *str = dynamic_cast<const StringLiteralExpr *>(arg.get())) {
+        key += "\"" + std::to_string(str->value().size()) + ":" +
+               str->value() + ",";
+      } else {
+        return nullptr;
+      }
+    }
+
+    auto cached = results_.find(key);
+    if (cached == results_.end()) {
+      if (budget_ == 0) {
+        return nullptr;
+      }
+      cached = results_.emplace(key, execute(call)).first;
+    }
+    return cached->second ? cloneExpr(*cached->second) : nullptr;
+  }
+
+  std::unique_ptr<Expr> execute(const FunctionCallExpr &call) {
+    // The callee and everything it can reach, followed by `return call;`
+    std::vector<std::unique_ptr<ASTNode>> items;
+    std::unordered_set<std::string> copied;
+    std::vector<std::string> worklist{call.name()};
+    while (!worklist.empty()) {
+      std::string name = std::move(worklist.back());
+      worklist.pop_back();
+      if (!copied.insert(name).second) {
+        continue;
+      }
+      const FunctionDecl *fn = functions_.at(name);
+      std::vector<std::unique_ptr<Stmt>> body;
+      for (const auto &stmt : fn->body()) {
+        body.push_back(cloneStmt(*stmt));
+        CallGraph::collectCalls(stmt.get(), worklist);
+      }
+      items.push_back(std::make_unique<FunctionDecl>(name, fn->params(),
+                                                     std::move(body)));
+    }
+    items.push_back(std::make_unique<ReturnStmt>(cloneExpr(call)));
+    Program program(std::move(items));
+
+    VirtualMachine vm;
+    vm.setInstructionLimit(budget_);
+    std::unique_ptr<Expr> literal;
+    try {
+      CodeGenerator codegen;
+      BytecodeProgram bytecode = codegen.generate(program);
+      Value result = vm.execute(bytecode);
+      if (result.isInt()) {
+        literal = std::make_unique<NumberExpr>(result.asInt());
+      } else if (result.isString() &&
+                 result.asString().size() <= kMaxStringResult) {
+        literal = std::make_unique<StringLiteralExpr>(result.asString());
+      }
+    } catch (const std::runtime_error &) {
+      // Errors and runaway loops happen at runtime, as written
+    }
+    budget_ -= std::min(budget_, vm.getInstructionCount());
+    return literal;
+  }
+};
+
+} // namespace
+
+void Optimizer::runPartialEvaluation(Program &program) {
+  computeAnalyzedFunctions(program);
+
+  std::unordered_map<std::string, const FunctionDecl *> functions;
+  for (const auto &item : program.items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        functions[fn->name()] = fn;
+      }
+    }
+  }
+
+  EffectAnalysis effects(program);
+  CallEvaluator evaluator(functions, effects, stats_.callsEvaluated);
+  for (auto &item : program.mutableItems()) {
+    if (auto *fn = dynamic_cast<FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        evaluator.run(fn->mutableBody());
+      }
+    }
+  }
+  evaluator.run(program.mutableItems());
+}
+
+// ============================================================================
+// Common Subexpression Elimination
+// ============================================================================
+
+namespace {
+
+// Temporaries use a prefix the lexer can never produce in an identifier
+constexpr const char *kTempPrefix = "$cse";
+
+// Each temporary takes a frame slot; keep well below the 255-slot limit
+constexpr int kMaxTemporaries = 32;
+
+/**
+ * Local value numbering for one function body or for the top-level code.
+ *
+ * Every expression gets a key naming the value it computes: variables carry
+ * a version that changes on each assignment, array loads carry an epoch that
+ * changes on every array store or call that may store into an array (see
+ * EffectAnalysis), and calls and array literals never match anything. The code is walked twice: the first walk counts keys, the
+ * second stores worthwhile repeated values in a temporary just before the
+ * statement that first needs them and replaces later occurrences with the
+ * temporary while it is still available.
+ */
+class ValueNumbering {
+public:
+  ValueNumbering(const EffectAnalysis &effects, int &eliminated)
+      : effects_(effects), eliminated_(eliminated) {}
+
+  template <typename Node> void run(std::vector<std::unique_ptr<Node>> &stmts) {
+    rewrite_ = false;
+    walk(stmts);
+
+    versions_.clear();
+    available_.clear();
+    epoch_ = 0;
+    rewrite_ = true;
+    walk(stmts);
+  }
+
+private:
+  const EffectAnalysis &effects_;
+  int &eliminated_;
+  bool rewrite_ = false;
+  bool reuseOnly_ = false; // Inside loop conditions and increments
+  bool define_ = false;    // Current statement may get new temporaries
+  std::vector<std::unique_ptr<Stmt>> *defs_ = nullptr;
+
+  std::unordered_map<std::string, int> versions_;
+  int epoch_ = 0;
+
+  // Filled by the counting walk
+  std::unordered_map<std::string, int> counts_;
+  std::unordered_map<std::string, int> costs_;
+
+  // Filled by the rewriting walk
+  std::unordered_map<std::string, std::string> available_; // key -> temp
+  std::unordered_map<std::string, std::string> tempKeys_;  // temp -> key
+  int nextTemp_ = 0; // Past any temporary from an earlier run
+  int created_ = 0;
+
+  template <typename Node>
+  void walk(std::vector<std::unique_ptr<Node>> &stmts) {
+    auto *outer = defs_;
+    for (size_t i = 0; i < stmts.size(); ++i) {
+      auto *stmt = dynamic_cast<Stmt *>(stmts[i].get());
+      if (!stmt) {
+        continue;
+      }
+      std::vector<std::unique_ptr<Stmt>> defs;
+      defs_ = &defs;
+      walkStmt(*stmt);
+      for (auto &def : defs) {
+        stmts.insert(stmts.begin() + static_cast<std::ptrdiff_t>(i++),
+                     std::move(def));
+      }
+    }
+    defs_ = outer;
+  }
+
+  void walkStmt(Stmt &stmt) {
+    if (auto *assign = dynamic_cast<AssignmentStmt *>(&stmt)) {
+      allowDefinitions({&assign->value()});
+      visit(assign->mutableValue());
+      ++versions_[assign->name()];
+      if (assign->name().rfind(kTempPrefix, 0) == 0) {
+        nextTemp_ = std::max(nextTemp_, std::stoi(assign->name().substr(
+                                            std::strlen(kTempPrefix))) +
+                                            1);
+      }
+    } else if (auto *arrAssign = dynamic_cast<ArrayAssignmentStmt *>(&stmt)) {
+      allowDefinitions(
+          {&arrAssign->target(), &arrAssign->index(), &arrAssign->value()});
+      visit(arrAssign->mutableTarget());
+      visit(arrAssign->mutableIndex());
+      visit(arrAssign->mutableValue());
+      ++epoch_;
+    } else if (auto *exprStmt = dynamic_cast<ExpressionStmt *>(&stmt)) {
+      allowDefinitions({&exprStmt->expr()});
+      visit(exprStmt->mutableExpr());
+    } else if (auto *print = dynamic_cast<PrintStmt *>(&stmt)) {
+      allowDefinitions({&print->value()});
+      visit(print->mutableValue());
+    } else if (auto *ret = dynamic_cast<ReturnStmt *>(&stmt)) {
+      if (ret->value()) {
+        allowDefinitions({ret->value()});
+        visit(ret->mutableValue());
+      }
+    } else if (auto *ifstmt = dynamic_cast<IfStmt *>(&stmt)) {
+      allowDefinitions({&ifstmt->condition()});
+      visit(ifstmt->mutableCondition());
+      walkBranch(ifstmt->mutableBody());
+      invalidateWrites(stmt);
+    } else if (auto *switchstmt = dynamic_cast<SwitchStmt *>(&stmt)) {
+      allowDefinitions({&switchstmt->value()});
+      visit(switchstmt->mutableValue());
+      for (auto &arm : switchstmt->mutableCases()) {
+        walkBranch(arm.body);
+      }
+      invalidateWrites(stmt);
+    } else if (auto *block = dynamic_cast<BlockStmt *>(&stmt)) {
+      walkBranch(block->mutableStatements());
+      invalidateWrites(stmt);
+    } else if (auto *whilestmt = dynamic_cast<WhileStmt *>(&stmt)) {
+      // Values from before the loop only survive if the loop never changes
+      // them; the condition and body see every iteration's state
+      invalidateWrites(stmt);
+      auto saved = available_;
+      withReuseOnly([&] {
+        allowDefinitions({});
+        visit(whilestmt->mutableCondition());
+      });
+      walk(whilestmt->mutableBody());
+      available_ = std::move(saved);
+      invalidateWrites(stmt);
+    } else if (auto *forstmt = dynamic_cast<ForStmt *>(&stmt)) {
+      if (forstmt->init()) {
+        walkStmt(*forstmt->mutableInit());
+      }
+      invalidateWrites(stmt);
+      auto saved = available_;
+      if (forstmt->condition()) {
+        withReuseOnly([&] {
+          allowDefinitions({});
+          visit(forstmt->mutableCondition());
+        });
+      }
+      walk(forstmt->mutableBody());
+      // The increment also runs after a continue, so only values from before
+      // the loop are certain to be there
+      available_ = saved;
+      if (forstmt->increment()) {
+        withReuseOnly([&] { walkStmt(*forstmt->mutableIncrement()); });
+      }
+      available_ = std::move(saved);
+      invalidateWrites(stmt);
+    } else if (auto *forin = dynamic_cast<ForInStmt *>(&stmt)) {
+      // The array is evaluated once, before the loop
+      allowDefinitions({&forin->iterable()});
+      visit(forin->mutableIterable());
+      invalidateWrites(stmt);
+      auto saved = available_;
+      walk(forin->mutableBody());
+      available_ = std::move(saved);
+      invalidateWrites(stmt);
+    } else if (auto *parallel = dynamic_cast<ParallelForStmt *>(&stmt)) {
+      // The bounds are evaluated once, before the loop
+      allowDefinitions({&parallel->start(), &parallel->end()});
+      visit(parallel->mutableStart());
+      visit(parallel->mutableEnd());
+      invalidateWrites(stmt);
+      auto saved = available_;
+      walk(parallel->mutableBody());
+      available_ = std::move(saved);
+      invalidateWrites(stmt);
+    }
+  }
+
+  void walkBranch(std::vector<std::unique_ptr<Stmt>> &stmts) {
+    auto saved = available_;
+    walk(stmts);
+    available_ = std::move(saved);
+  }
+
+  template <typename Fn> void withReuseOnly(Fn fn) {
+    bool outer = reuseOnly_;
+    reuseOnly_ = true;
+    fn();
+    reuseOnly_ = outer;
+  }
+
+  /**
+   * Temporaries are computed before the statement, which would move them
+   * ahead of any call in it
+   */
+  void allowDefinitions(std::initializer_list<const Expr *> exprs) {
+    std::vector<std::string> calls;
+    for (const Expr *expr : exprs) {
+      CallGraph::collectCallsFromExpr(expr, calls);
+    }
+    define_ = !reuseOnly_ && calls.empty();
+  }
+
+  /**
+   * Give every variable assigned in a statement a fresh version, and start
+   * a new array epoch if it may store into an array
+   */
+  void invalidateWrites(const Stmt &stmt) {
+    bool storesArrays = false;
+    collectWrites(&stmt, storesArrays);
+    if (storesArrays) {
+      ++epoch_;
+    }
+  }
+
+  void collectWrites(const Stmt *stmt, bool &storesArrays) {
+    std::vector<std::string> calls;
+    if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
+      ++versions_[assign->name()];
+      CallGraph::collectCallsFromExpr(&assign->value(), calls);
+    } else if (dynamic_cast<const ArrayAssignmentStmt *>(stmt)) {
+      storesArrays = true;
+    } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
+      CallGraph::collectCallsFromExpr(&ifstmt->condition(), calls);
+      for (const auto &s : ifstmt->body()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+      CallGraph::collectCallsFromExpr(&switchstmt->value(), calls);
+      for (const auto &arm : switchstmt->cases()) {
+        for (const auto &s : arm.body) {
+          collectWrites(s.get(), storesArrays);
+        }
+      }
+    } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
+      CallGraph::collectCallsFromExpr(&whilestmt->condition(), calls);
+      for (const auto &s : whilestmt->body()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else if (auto *forstmt = dynamic_cast<const ForStmt *>(stmt)) {
+      if (forstmt->init()) {
+        collectWrites(forstmt->init(), storesArrays);
+      }
+      if (forstmt->condition()) {
+        CallGraph::collectCallsFromExpr(forstmt->condition(), calls);
+      }
+      if (forstmt->increment()) {
+        collectWrites(forstmt->increment(), storesArrays);
+      }
+      for (const auto &s : forstmt->body()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+      ++versions_[forin->variable()];
+      CallGraph::collectCallsFromExpr(&forin->iterable(), calls);
+      for (const auto &s : forin->body()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+      ++versions_[parallel->variable()];
+      CallGraph::collectCallsFromExpr(&parallel->start(), calls);
+      CallGraph::collectCallsFromExpr(&parallel->end(), calls);
+      for (const auto &s : parallel->body()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+      for (const auto &s : block->statements()) {
+        collectWrites(s.get(), storesArrays);
+      }
+    } else {
+      CallGraph::collectCalls(stmt, calls);
+    }
+    // A callee may store into any array it was handed
+    storesArrays = storesArrays ||
+                   std::any_of(calls.begin(), calls.end(), [&](const auto &fn) {
+                     return effects_.mayWriteArrays(fn);
+                   });
+  }
+
+  /**
+   * Number an expression, rewriting it in the second walk
+   */
+  void visit(std::unique_ptr<Expr> &slot) {
+    int cost = 0;
+    std::string key = keyOf(*slot, cost);
+    if (key.empty()) {
+      visitChildren(*slot);
+      return;
+    }
+    if (cost <= 1) {
+      return; // Leaves are as cheap as loading a temporary
+    }
+
+    // A repeat is replaced as a whole, so its operands are not counted again
+    if (rewrite_) {
+      auto it = available_.find(key);
+      if (it != available_.end()) {
+        slot = std::make_unique<IdentifierExpr>(it->second);
+        ++eliminated_;
+        return;
+      }
+    } else if (counts_.count(key)) {
+      ++counts_[key];
+      return;
+    }
+
+    visitChildren(*slot);
+
+    if (!rewrite_) {
+      counts_[key] = 1;
+      costs_[key] = cost;
+    } else if (define_ && created_ < kMaxTemporaries && isWorthwhile(key)) {
+      std::string temp = kTempPrefix + std::to_string(nextTemp_++);
+      ++created_;
+      defs_->push_back(std::make_unique<AssignmentStmt>(temp, std::move(slot)));
+      slot = std::make_unique<IdentifierExpr>(temp);
+      available_[key] = temp;
+      tempKeys_[temp] = key;
+    }
+  }
+
+  void visitChildren(Expr &expr) {
+    if (auto *binop = dynamic_cast<BinaryOpExpr *>(&expr)) {
+      visit(binop->mutableLeft());
+      visit(binop->mutableRight());
+    } else if (auto *unary = dynamic_cast<UnaryOpExpr *>(&expr)) {
+      visit(unary->mutableOperand());
+    } else if (auto *index = dynamic_cast<IndexExpr *>(&expr)) {
+      visit(index->mutableTarget());
+      visit(index->mutableIndex());
+    } else if (auto *call = dynamic_cast<FunctionCallExpr *>(&expr)) {
+      for (auto &arg : call->mutableArgs()) {
+        visit(arg);
+      }
+      if (effects_.mayWriteArrays(call->name())) {
+        ++epoch_;
+      }
+    } else if (auto *array = dynamic_cast<ArrayLiteralExpr *>(&expr)) {
+      for (auto &element : array->mutableElements()) {
+        visit(element);
+      }
+    }
+  }
+
+  /**
+   * Key for the value of an expression, or empty if it contains a call or
+   * an array literal (each evaluation creates a distinct array). Cost
+   * approximates the instructions it takes to compute.
+   */
+  std::string keyOf(const Expr &expr, int &cost) const {
+    cost = 1;
+    if (auto *num = dynamic_cast<const NumberExpr *>(&expr)) {
+      return "#" + std::to_string(num->value());
+    }
+    if (auto *str = dynamic_cast<const StringLiteralExpr *>(&expr)) {
+      return "\"" + std::to_string(str->value().size()) + ":" + str->value();
+    }
+    if (auto *ident = dynamic_cast<const IdentifierExpr *>(&expr)) {
+      auto temp = tempKeys_.find(ident->name());
+      if (temp != tempKeys_.end()) {
+        return temp->second;
+      }
+      auto version = versions_.find(ident->name());
+      return ident->name() + "@" +
+             std::to_string(version == versions_.end() ? 0 : version->second);
+    }
+
+    int leftCost = 0;
+    int rightCost = 0;
+    if (auto *binop = dynamic_cast<const BinaryOpExpr *>(&expr)) {
+      std::string left = keyOf(binop->left(), leftCost);
+      std::string right = keyOf(binop->right(), rightCost);
+      if (left.empty() || right.empty()) {
+        return {};
+      }
+      // Only operators that are symmetric for every operand type
+      auto op = binop->op();
+      if ((op == BinaryOpExpr::Operator::MULTIPLY ||
+           op == BinaryOpExpr::Operator::AND ||
+           op == BinaryOpExpr::Operator::EQUAL ||
+           op == BinaryOpExpr::Operator::NOT_EQUAL) &&
+          right < left) {
+        std::swap(left, right);
+      }
+      cost = 1 + leftCost + rightCost;
+      return "(" + std::to_string(static_cast<int>(op)) + " " + left + " " +
+             right + ")";
+    }
+    if (auto *unary = dynamic_cast<const UnaryOpExpr *>(&expr)) {
+      std::string operand = keyOf(unary->operand(), leftCost);
+      if (operand.empty()) {
+        return {};
+      }
+      bool negate = unary->op() == UnaryOpExpr::Operator::NEGATE;
+      cost = (negate ? 2 : 4) + leftCost;
+      return std::string(negate ? "(neg " : "(not ") + operand + ")";
+    }
+    if (auto *index = dynamic_cast<const IndexExpr *>(&expr)) {
+      std::string target = keyOf(index->target(), leftCost);
+      std::string idx = keyOf(index->index(), rightCost);
+      if (target.empty() || idx.empty()) {
+        return {};
+      }
+      // Bounds and type checks make a load dearer than arithmetic
+      cost = 3 + leftCost + rightCost;
+      return "([] " + target + " " + idx + " " + std::to_string(epoch_) + ")";
+    }
+    return {};
+  }
+
+  /**
+   * A temporary costs a store plus a load per use; it pays off once the
+   * uses it saves outweigh that
+   */
+  bool isWorthwhile(const std::string &key) const {
+    auto count = counts_.find(key);
+    if (count == counts_.end() || count->second < 2) {
+      return false;
+    }
+    int cost = costs_.at(key);
+    return (count->second - 1) * (cost - 1) - 2 > 0;
+  }
+};
+
+} // namespace
+
+void Optimizer::runCommonSubexpressionElimination(Program &program) {
+  computeAnalyzedFunctions(program);
+  EffectAnalysis effects(program);
+
+  for (auto &item : program.mutableItems()) {
+    if (auto *fn = dynamic_cast<FunctionDecl *>(item.get())) {
+      if (isAnalyzed(*fn)) {
+        ValueNumbering(effects, stats_.subexpressionsEliminated)
+            .run(fn->mutableBody());
+      }
+    }
+  }
+
+  // Top-level statements share one frame, so they are numbered together
+  ValueNumbering(effects, stats_.subexpressionsEliminated)
+      .run(program.mutableItems());
+}
+
+// ============================================================================
+// Dead Function Elimination
+// ============================================================================
+
+void Optimizer::runDeadFunctionElimination(Program &program) {
+  CallGraph graph(program);
+
+  auto &items = program.mutableItems();
+  auto isDead = [&](const std::unique_ptr<ASTNode> &item) {
+    auto *fn = dynamic_cast<const FunctionDecl *>(item.get());
+    return fn && !graph.isReachable(fn->name());
+  };
+
+  auto firstDead = std::remove_if(items.begin(), items.end(), isDead);
+  stats_.functionsRemoved += static_cast<int>(items.end() - firstDead);
+  items.erase(firstDead, items.end());
+
+  for (auto it = functionMap_.begin(); it != functionMap_.end();) {
+    if (graph.isReachable(it->first)) {
+      ++it;
+    } else {
+      it = functionMap_.erase(it);
+    }
+  }
+}
+
+// ============================================================================
+// Inline Candidates
+// ============================================================================
+
+void Optimizer::countInlineCandidates(Program & /*program*/) {
+  // Calls are not rewritten yet; this only reports the functions that
+  // inlining would consider
+  for (const auto &[name, fn] : functionMap_) {
+    if (isInlineCandidate(*fn)) {
+      stats_.inlineCandidates++;
+    }
+  }
+}
+
+bool Optimizer::isInlineCandidate(const FunctionDecl &fn) const {
+  // Candidate if:
+  // 1. Small (< 20 AST nodes)
+  // 2. Not recursive
+  // 3. Has <= 3 parameters
+
+  if (fn.params().size() > 3)
+    return false;
+  if (countAstNodes(fn) > 20)
+    return false;
+
+  // Check for recursion (function calls itself)
+  // Simplified check
+  for (const auto &stmt : fn.body()) {
+    if (containsCall(stmt.get(), fn.name())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Optimizer::containsCall(const Stmt *stmt,
+                             const std::string &fnName) const {
+  if (auto *assign = dynamic_cast<const AssignmentStmt *>(stmt)) {
+    return containsCallExpr(&assign->value(), fnName);
+  } else if (auto *print = dynamic_cast<const PrintStmt *>(stmt)) {
+    return containsCallExpr(&print->value(), fnName);
+  } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
+    return ret->value() && containsCallExpr(ret->value(), fnName);
+  } else if (auto *ifstmt = dynamic_cast<const IfStmt *>(stmt)) {
+    if (containsCallExpr(&ifstmt->condition(), fnName))
+      return true;
+    for (const auto &s : ifstmt->body()) {
+      if (containsCall(s.get(), fnName))
+        return true;
+    }
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    if (containsCallExpr(&switchstmt->value(), fnName))
+      return true;
+    for (const auto &arm : switchstmt->cases()) {
+      for (const auto &s : arm.body) {
+        if (containsCall(s.get(), fnName))
+          return true;
+      }
+    }
+  } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
+    if (containsCallExpr(&whilestmt->condition(), fnName))
+      return true;
+    for (const auto &s : whilestmt->body()) {
+      if (containsCall(s.get(), fnName))
+        return true;
+    }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    if (containsCallExpr(&forin->iterable(), fnName))
+      return true;
+    for (const auto &s : forin->body()) {
+      if (containsCall(s.get(), fnName))
+        return true;
+    }
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    if (containsCallExpr(&parallel->start(), fnName) ||
+        containsCallExpr(&parallel->end(), fnName))
+      return true;
+    for (const auto &s : parallel->body()) {
+      if (containsCall(s.get(), fnName))
+        return true;
+    }
+  } else if (auto *block = dynamic_cast<const BlockStmt *>(stmt)) {
+    for (const auto &s : block->statements()) {
+      if (containsCall(s.get(), fnName))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool Optimizer::containsCallExpr(const Expr *expr,
+                                 const std::string &fnName) const {
+  if (auto *call = dynamic_cast<const FunctionCallExpr *>(expr)) {
+    if (call->name() == fnName)
+      return true;
+    for (const auto &arg : call->args()) {
+      if (containsCallExpr(arg.get(), fnName))
+        return true;
     }
   } else if (auto *binop = dynamic_cast<const BinaryOpExpr *>(expr)) {
     return containsCallExpr(&binop->left(), fnName) ||
@@ -341,11 +2715,30 @@ int Optimizer::countStmtNodes(const Stmt *stmt) const {
     for (const auto &s : ifstmt->body()) {
       count += countStmtNodes(s.get());
     }
+  } else if (auto *switchstmt = dynamic_cast<const SwitchStmt *>(stmt)) {
+    count += countExprNodes(&switchstmt->value());
+    for (const auto &arm : switchstmt->cases()) {
+      count += static_cast<int>(arm.labels.size());
+      for (const auto &s : arm.body) {
+        count += countStmtNodes(s.get());
+      }
+    }
   } else if (auto *whilestmt = dynamic_cast<const WhileStmt *>(stmt)) {
     count += countExprNodes(&whilestmt->condition());
     for (const auto &s : whilestmt->body()) {
       count += countStmtNodes(s.get());
     }
+  } else if (auto *forin = dynamic_cast<const ForInStmt *>(stmt)) {
+    count += countExprNodes(&forin->iterable());
+    for (const auto &s : forin->body()) {
+      count += countStmtNodes(s.get());
+    }
+  } else if (auto *parallel = dynamic_cast<const ParallelForStmt *>(stmt)) {
+    count += countExprNodes(&parallel->start()) +
+             countExprNodes(&parallel->end());
+    for (const auto &s : parallel->body()) {
+      count += countStmtNodes(s.get());
+    }
   } else if (auto *ret = dynamic_cast<const ReturnStmt *>(stmt)) {
     if (ret->value()) {
       count += countExprNodes(ret->value());
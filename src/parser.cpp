@@ -1,14 +1,29 @@
 #include "parser.h"
 #include "common.h"
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <unordered_set>
 
 // ============================================================================
 // Constructor
 // ============================================================================
 
 Parser::Parser(const std::vector<Token> &tokens)
-    : tokens_(tokens), current_(0) {}
+    : tokens_(&tokens), current_(0), end_(tokens.size()),
+      endToken_{TokenType::END_OF_FILE, "", 0, 0} {}
+
+Parser::Parser(std::shared_ptr<const std::vector<Token>> tokens)
+    : shared_(std::move(tokens)), tokens_(shared_.get()), current_(0),
+      end_(tokens_->size()), endToken_{TokenType::END_OF_FILE, "", 0, 0} {}
+
+Parser::Parser(std::shared_ptr<const std::vector<Token>> tokens, size_t begin,
+               size_t end, const Token &endToken)
+    : shared_(std::move(tokens)), tokens_(shared_.get()), current_(begin),
+      end_(end), endToken_{TokenType::END_OF_FILE, "", endToken.line,
+                           endToken.column} {}
 
 // ============================================================================
 // Main Entry Points
@@ -54,6 +69,11 @@ std::unique_ptr<FunctionDecl> Parser::parseFunction() {
   expect(TokenType::RPAREN, "Expected ')' after parameters");
   expect(TokenType::LBRACE, "Expected '{' before function body");
 
+  if (lazyBodies_) {
+    return std::make_unique<FunctionDecl>(std::move(name), std::move(params),
+                                          skipFunctionBody());
+  }
+
   // Parse function body
   std::vector<std::unique_ptr<Stmt>> body;
   while (!check(TokenType::RBRACE) && !isAtEnd()) {
@@ -66,6 +86,42 @@ std::unique_ptr<FunctionDecl> Parser::parseFunction() {
                                         std::move(body));
 }
 
+FunctionDecl::BodyParser Parser::skipFunctionBody() {
+  size_t start = current_;
+  int depth = 0;
+  while (!isAtEnd()) {
+    if (check(TokenType::LBRACE)) {
+      ++depth;
+    } else if (check(TokenType::RBRACE)) {
+      if (depth == 0) {
+        break;
+      }
+      --depth;
+    }
+    advance();
+  }
+
+  // Deferred parses need the tokens to outlive the caller's vector; a
+  // parser built on a borrowed vector takes one copy for all bodies
+  if (!shared_) {
+    shared_ = std::make_shared<const std::vector<Token>>(*tokens_);
+    tokens_ = shared_.get();
+  }
+  size_t end = current_;
+  Token closing = currentToken();
+
+  expect(TokenType::RBRACE, "Expected '}' after function body");
+
+  return [tokens = shared_, start, end, closing]() {
+    Parser parser(tokens, start, end, closing);
+    std::vector<std::unique_ptr<Stmt>> body;
+    while (!parser.isAtEnd()) {
+      body.push_back(parser.parseStatement());
+    }
+    return body;
+  };
+}
+
 std::vector<std::unique_ptr<Stmt>> Parser::parseBlock() {
   expect(TokenType::LBRACE, "Expected '{' to start block");
 
@@ -80,6 +136,8 @@ std::vector<std::unique_ptr<Stmt>> Parser::parseBlock() {
 }
 
 std::unique_ptr<Stmt> Parser::parseStatement() {
+  Nesting nesting(*this);
+  nesting.enter();
   if (check(TokenType::KW_LET)) {
     return parseVarDecl();
   }
@@ -92,6 +150,12 @@ std::unique_ptr<Stmt> Parser::parseStatement() {
   if (check(TokenType::KW_FOR)) {
     return parseForStatement();
   }
+  if (check(TokenType::KW_PARALLEL)) {
+    return parseParallelForStatement();
+  }
+  if (check(TokenType::KW_SWITCH)) {
+    return parseSwitchStatement();
+  }
   if (check(TokenType::KW_BREAK)) {
     return parseBreakStatement();
   }
@@ -111,25 +175,51 @@ std::unique_ptr<Stmt> Parser::parseStatement() {
   // Expression statement or Assignment
   auto expr = parseExpression();
 
-  if (check(TokenType::ASSIGN)) {
-    advance(); // consume '='
-    auto value = parseExpression();
+  if (auto assign = parseAssignmentTail(expr)) {
     expect(TokenType::SEMICOLON, "Expected ';' after assignment");
-
-    if (auto *idExpr = dynamic_cast<IdentifierExpr *>(expr.get())) {
-      return std::make_unique<AssignmentStmt>(idExpr->name(), std::move(value));
-    } else if (auto *idxExpr = dynamic_cast<IndexExpr *>(expr.get())) {
-      return std::make_unique<ArrayAssignmentStmt>(
-          idxExpr->takeTarget(), idxExpr->takeIndex(), std::move(value));
-    } else {
-      error("Invalid assignment target");
-    }
+    return assign;
   }
 
   expect(TokenType::SEMICOLON, "Expected ';' after expression");
   return std::make_unique<ExpressionStmt>(std::move(expr));
 }
 
+std::unique_ptr<Stmt>
+Parser::parseAssignmentTail(std::unique_ptr<Expr> &target) {
+  std::optional<BinaryOpExpr::Operator> op;
+  std::unique_ptr<Expr> value;
+  TokenType type = currentToken().type;
+  if (match({TokenType::ASSIGN})) {
+    value = parseExpression();
+  } else if (match({TokenType::PLUS_ASSIGN, TokenType::MINUS_ASSIGN,
+                    TokenType::STAR_ASSIGN})) {
+    op = type == TokenType::PLUS_ASSIGN    ? BinaryOpExpr::Operator::PLUS
+         : type == TokenType::MINUS_ASSIGN ? BinaryOpExpr::Operator::MINUS
+                                           : BinaryOpExpr::Operator::MULTIPLY;
+    value = parseExpression();
+  } else if (match({TokenType::PLUS_PLUS, TokenType::MINUS_MINUS})) {
+    op = type == TokenType::PLUS_PLUS ? BinaryOpExpr::Operator::PLUS
+                                      : BinaryOpExpr::Operator::MINUS;
+    value = std::make_unique<NumberExpr>(1);
+  } else {
+    return nullptr;
+  }
+
+  if (auto *idExpr = dynamic_cast<IdentifierExpr *>(target.get())) {
+    if (op) {
+      value = std::make_unique<BinaryOpExpr>(
+          std::make_unique<IdentifierExpr>(idExpr->name()), *op,
+          std::move(value));
+    }
+    return std::make_unique<AssignmentStmt>(idExpr->name(), std::move(value));
+  } else if (auto *idxExpr = dynamic_cast<IndexExpr *>(target.get())) {
+    return std::make_unique<ArrayAssignmentStmt>(
+        idxExpr->takeTarget(), idxExpr->takeIndex(), std::move(value), op);
+  }
+  error("Invalid assignment target");
+  return nullptr;
+}
+
 std::unique_ptr<Stmt> Parser::parseVarDecl() {
   expect(TokenType::KW_LET, "Expected 'let' keyword");
 
@@ -180,7 +270,9 @@ std::unique_ptr<Expr> Parser::parseArrayLiteral() {
 }
 
 std::unique_ptr<Expr> Parser::parsePostfix(std::unique_ptr<Expr> left) {
+  Nesting nesting(*this);
   while (check(TokenType::LBRACKET)) {
+    nesting.enter();
     advance(); // consume '['
     auto index = parseExpression();
     expect(TokenType::RBRACKET, "Expected ']' after index");
@@ -190,6 +282,7 @@ std::unique_ptr<Expr> Parser::parsePostfix(std::unique_ptr<Expr> left) {
 }
 
 std::unique_ptr<Stmt> Parser::parseIfStatement() {
+  int line = currentToken().line;
   expect(TokenType::KW_IF, "Expected 'if' keyword");
   expect(TokenType::LPAREN, "Expected '(' after 'if'");
 
@@ -208,10 +301,13 @@ std::unique_ptr<Stmt> Parser::parseIfStatement() {
   // Note: IfStmt doesn't have else branch in current AST
   // We could add it later if needed
 
-  return std::make_unique<IfStmt>(std::move(condition), std::move(body));
+  auto stmt = std::make_unique<IfStmt>(std::move(condition), std::move(body));
+  stmt->setLine(line);
+  return stmt;
 }
 
 std::unique_ptr<Stmt> Parser::parseWhileStatement() {
+  int line = currentToken().line;
   expect(TokenType::KW_WHILE, "Expected 'while' keyword");
   expect(TokenType::LPAREN, "Expected '(' after 'while'");
 
@@ -227,12 +323,18 @@ std::unique_ptr<Stmt> Parser::parseWhileStatement() {
 
   expect(TokenType::RBRACE, "Expected '}' after while body");
 
-  return std::make_unique<WhileStmt>(std::move(condition), std::move(body));
+  auto stmt = std::make_unique<WhileStmt>(std::move(condition), std::move(body));
+  stmt->setLine(line);
+  return stmt;
 }
 
 std::unique_ptr<Stmt> Parser::parseForStatement() {
+  int line = currentToken().line;
   expect(TokenType::KW_FOR, "Expected 'for' keyword");
   expect(TokenType::LPAREN, "Expected '(' after 'for'");
+  if (check(TokenType::IDENTIFIER) && peek(1).type == TokenType::KW_IN) {
+    return parseForInStatement(line);
+  }
 
   // Init
   std::unique_ptr<Stmt> init = nullptr;
@@ -261,15 +363,10 @@ std::unique_ptr<Stmt> Parser::parseForStatement() {
   // Increment
   std::unique_ptr<Stmt> inc = nullptr;
   if (!check(TokenType::RPAREN)) {
-    if (check(TokenType::IDENTIFIER) && peek(1).type == TokenType::ASSIGN) {
-      // Parse assignment without consuming semicolon
-      std::string name = currentToken().lexeme;
-      advance();
-      expect(TokenType::ASSIGN, "Expected '='");
-      auto value = parseExpression();
-      inc = std::make_unique<AssignmentStmt>(std::move(name), std::move(value));
-    } else {
-      auto expr = parseExpression();
+    // Assignment without the semicolon
+    auto expr = parseExpression();
+    inc = parseAssignmentTail(expr);
+    if (!inc) {
       inc = std::make_unique<PrintStmt>(std::move(expr));
     }
   }
@@ -282,8 +379,202 @@ std::unique_ptr<Stmt> Parser::parseForStatement() {
   }
   expect(TokenType::RBRACE, "Expected '}' after for body");
 
-  return std::make_unique<ForStmt>(std::move(init), std::move(cond),
-                                   std::move(inc), std::move(body));
+  auto stmt = std::make_unique<ForStmt>(std::move(init), std::move(cond),
+                                        std::move(inc), std::move(body));
+  stmt->setLine(line);
+  return stmt;
+}
+
+std::unique_ptr<Stmt> Parser::parseForInStatement(int line) {
+  std::string variable = currentToken().lexeme;
+  advance(); // consume identifier
+  expect(TokenType::KW_IN, "Expected 'in' after loop variable");
+  auto iterable = parseExpression();
+  expect(TokenType::RPAREN, "Expected ')' after for-in array");
+
+  expect(TokenType::LBRACE, "Expected '{' to start for body");
+  std::vector<std::unique_ptr<Stmt>> body;
+  while (!check(TokenType::RBRACE) && !isAtEnd()) {
+    body.push_back(parseStatement());
+  }
+  expect(TokenType::RBRACE, "Expected '}' after for body");
+
+  auto stmt = std::make_unique<ForInStmt>(std::move(variable),
+                                          std::move(iterable), std::move(body));
+  stmt->setLine(line);
+  return stmt;
+}
+
+std::unique_ptr<Stmt> Parser::parseParallelForStatement() {
+  int line = currentToken().line;
+  expect(TokenType::KW_PARALLEL, "Expected 'parallel' keyword");
+  expect(TokenType::KW_FOR, "Expected 'for' after 'parallel'");
+  expect(TokenType::LPAREN, "Expected '(' after 'for'");
+
+  match({TokenType::KW_LET});
+  if (!check(TokenType::IDENTIFIER)) {
+    errorExpected("loop variable");
+  }
+  std::string variable = currentToken().lexeme;
+  advance();
+  expect(TokenType::ASSIGN, "Expected '=' after loop variable");
+  auto start = parseExpression();
+  expect(TokenType::SEMICOLON, "Expected ';' after parallel for start");
+
+  // Only `i < end; i++` (or an equivalent step of 1) can be split up
+  auto isVar = [&](const Expr &expr) {
+    auto *id = dynamic_cast<const IdentifierExpr *>(&expr);
+    return id && id->name() == variable;
+  };
+  auto condition = parseExpression();
+  auto *less = dynamic_cast<BinaryOpExpr *>(condition.get());
+  if (!less || less->op() != BinaryOpExpr::Operator::LESS ||
+      !isVar(less->left())) {
+    error("parallel for needs the condition '" + variable + " < end'");
+    return nullptr;
+  }
+  expect(TokenType::SEMICOLON, "Expected ';' after for condition");
+
+  auto target = parseExpression();
+  auto increment = parseAssignmentTail(target);
+  auto *step = dynamic_cast<AssignmentStmt *>(increment.get());
+  auto *sum = step ? dynamic_cast<const BinaryOpExpr *>(&step->value())
+                   : nullptr;
+  auto *one = sum ? dynamic_cast<const NumberExpr *>(&sum->right()) : nullptr;
+  if (!step || step->name() != variable || !sum ||
+      sum->op() != BinaryOpExpr::Operator::PLUS || !isVar(sum->left()) ||
+      !one || one->value() != 1) {
+    error("parallel for must step '" + variable + "' by 1");
+    return nullptr;
+  }
+  expect(TokenType::RPAREN, "Expected ')' after for clauses");
+
+  std::vector<Reduction> reductions;
+  if (check(TokenType::IDENTIFIER) && currentToken().lexeme == "reduce") {
+    advance();
+    expect(TokenType::LPAREN, "Expected '(' after 'reduce'");
+    do {
+      Reduction reduction;
+      if (match({TokenType::PLUS})) {
+        reduction.op = Reduction::Operator::SUM;
+      } else if (check(TokenType::IDENTIFIER) &&
+                 (currentToken().lexeme == "min" ||
+                  currentToken().lexeme == "max")) {
+        reduction.op = currentToken().lexeme == "min"
+                           ? Reduction::Operator::MIN
+                           : Reduction::Operator::MAX;
+        advance();
+      } else {
+        errorExpected("'+', 'min' or 'max'");
+        return nullptr;
+      }
+      expect(TokenType::COLON, "Expected ':' after reduction operator");
+      if (!check(TokenType::IDENTIFIER)) {
+        errorExpected("reduction variable");
+      }
+      reduction.variable = currentToken().lexeme;
+      advance();
+      if (reduction.variable == variable) {
+        error("Cannot reduce loop variable '" + variable + "'");
+        return nullptr;
+      }
+      if (std::any_of(reductions.begin(), reductions.end(),
+                      [&](const Reduction &r) {
+                        return r.variable == reduction.variable;
+                      })) {
+        error("Variable '" + reduction.variable + "' is reduced twice");
+        return nullptr;
+      }
+      reductions.push_back(std::move(reduction));
+    } while (match({TokenType::COMMA}));
+    expect(TokenType::RPAREN, "Expected ')' after reductions");
+  }
+
+  expect(TokenType::LBRACE, "Expected '{' to start for body");
+  std::vector<std::unique_ptr<Stmt>> body;
+  while (!check(TokenType::RBRACE) && !isAtEnd()) {
+    body.push_back(parseStatement());
+  }
+  expect(TokenType::RBRACE, "Expected '}' after for body");
+
+  auto stmt = std::make_unique<ParallelForStmt>(
+      std::move(variable), std::move(start), std::move(less->mutableRight()),
+      std::move(reductions), std::move(body));
+  stmt->setLine(line);
+  return stmt;
+}
+
+std::unique_ptr<Stmt> Parser::parseSwitchStatement() {
+  expect(TokenType::KW_SWITCH, "Expected 'switch' keyword");
+  expect(TokenType::LPAREN, "Expected '(' after 'switch'");
+
+  auto value = parseExpression();
+
+  expect(TokenType::RPAREN, "Expected ')' after switch value");
+  expect(TokenType::LBRACE, "Expected '{' after switch value");
+
+  std::vector<SwitchCase> cases;
+  std::unordered_set<std::string> seen; // Labels so far, as "#1" or "\"text"
+  bool hasDefault = false;
+  while (!check(TokenType::RBRACE) && !isAtEnd()) {
+    SwitchCase arm;
+    if (check(TokenType::KW_DEFAULT)) {
+      if (hasDefault) {
+        error("Duplicate default in switch");
+      }
+      hasDefault = true;
+      advance();
+    } else {
+      expect(TokenType::KW_CASE, "Expected 'case' or 'default' in switch");
+      do {
+        std::string key;
+        arm.labels.push_back(parseCaseLabel(key));
+        if (!seen.insert(std::move(key)).second) {
+          error("Duplicate case label");
+        }
+      } while (match({TokenType::COMMA}));
+    }
+    expect(TokenType::COLON, "Expected ':' after case label");
+
+    // An arm runs up to the next label; there is no fall-through
+    while (!check(TokenType::KW_CASE) && !check(TokenType::KW_DEFAULT) &&
+           !check(TokenType::RBRACE) && !isAtEnd()) {
+      arm.body.push_back(parseStatement());
+    }
+    cases.push_back(std::move(arm));
+  }
+
+  expect(TokenType::RBRACE, "Expected '}' after switch body");
+
+  return std::make_unique<SwitchStmt>(std::move(value), std::move(cases));
+}
+
+std::unique_ptr<Expr> Parser::parseCaseLabel(std::string &key) {
+  if (check(TokenType::STRING)) {
+    std::string value = currentToken().lexeme;
+    key = "\"" + value;
+    advance();
+    return std::make_unique<StringLiteralExpr>(std::move(value));
+  }
+  bool negative = match({TokenType::MINUS});
+  if (!check(TokenType::NUMBER)) {
+    errorExpected("integer or string case label");
+  }
+  int64_t value = 0;
+  try {
+    value = std::stoll(currentToken().lexeme);
+  } catch (const std::out_of_range &) {
+    error("Case label out of range");
+  }
+  if (negative) {
+    value = -value;
+  }
+  if (value < INT32_MIN || value > INT32_MAX) {
+    error("Case label out of range");
+  }
+  key = "#" + std::to_string(value);
+  advance();
+  return std::make_unique<NumberExpr>(static_cast<int>(value));
 }
 
 std::unique_ptr<Stmt> Parser::parseBreakStatement() {
@@ -327,12 +618,18 @@ std::unique_ptr<Stmt> Parser::parsePrintStatement() {
 // Expression Parsing - Precedence Climbing
 // ============================================================================
 
-std::unique_ptr<Expr> Parser::parseExpression() { return parseLogicalOr(); }
+std::unique_ptr<Expr> Parser::parseExpression() {
+  Nesting nesting(*this);
+  nesting.enter();
+  return parseLogicalOr();
+}
 
 std::unique_ptr<Expr> Parser::parseLogicalOr() {
   auto left = parseLogicalAnd();
+  Nesting nesting(*this);
 
   while (check(TokenType::OR_OR)) {
+    nesting.enter();
     advance();
     auto right = parseLogicalAnd();
     left = std::make_unique<BinaryOpExpr>(
@@ -344,8 +641,10 @@ std::unique_ptr<Expr> Parser::parseLogicalOr() {
 
 std::unique_ptr<Expr> Parser::parseLogicalAnd() {
   auto left = parseComparison();
+  Nesting nesting(*this);
 
   while (check(TokenType::AND_AND)) {
+    nesting.enter();
     advance();
     auto right = parseComparison();
     left = std::make_unique<BinaryOpExpr>(
@@ -357,11 +656,13 @@ std::unique_ptr<Expr> Parser::parseLogicalAnd() {
 
 std::unique_ptr<Expr> Parser::parseComparison() {
   auto left = parseRelational();
+  Nesting nesting(*this);
 
   while (check(TokenType::EQ) || check(TokenType::NEQ)) {
     BinaryOpExpr::Operator op = check(TokenType::EQ)
                                     ? BinaryOpExpr::Operator::EQUAL
                                     : BinaryOpExpr::Operator::NOT_EQUAL;
+    nesting.enter();
     advance();
     auto right = parseRelational();
     left =
@@ -373,6 +674,7 @@ std::unique_ptr<Expr> Parser::parseComparison() {
 
 std::unique_ptr<Expr> Parser::parseRelational() {
   auto left = parseTerm();
+  Nesting nesting(*this);
 
   while (check(TokenType::LT) || check(TokenType::LTE) ||
          check(TokenType::GT) || check(TokenType::GTE)) {
@@ -386,6 +688,7 @@ std::unique_ptr<Expr> Parser::parseRelational() {
     else
       op = BinaryOpExpr::Operator::GREATER_EQUAL;
 
+    nesting.enter();
     advance();
     auto right = parseTerm();
     left =
@@ -397,11 +700,13 @@ std::unique_ptr<Expr> Parser::parseRelational() {
 
 std::unique_ptr<Expr> Parser::parseTerm() {
   auto left = parseFactor();
+  Nesting nesting(*this);
 
   while (check(TokenType::PLUS) || check(TokenType::MINUS)) {
     BinaryOpExpr::Operator op = check(TokenType::PLUS)
                                     ? BinaryOpExpr::Operator::PLUS
                                     : BinaryOpExpr::Operator::MINUS;
+    nesting.enter();
     advance();
     auto right = parseFactor();
     left =
@@ -413,6 +718,7 @@ std::unique_ptr<Expr> Parser::parseTerm() {
 
 std::unique_ptr<Expr> Parser::parseFactor() {
   auto left = parseUnary();
+  Nesting nesting(*this);
 
   while (check(TokenType::STAR) || check(TokenType::SLASH) ||
          check(TokenType::PERCENT)) {
@@ -424,6 +730,7 @@ std::unique_ptr<Expr> Parser::parseFactor() {
     else
       op = BinaryOpExpr::Operator::MODULO;
 
+    nesting.enter();
     advance();
     auto right = parseUnary();
     left =
@@ -434,13 +741,16 @@ std::unique_ptr<Expr> Parser::parseFactor() {
 }
 
 std::unique_ptr<Expr> Parser::parseUnary() {
+  Nesting nesting(*this);
   if (check(TokenType::MINUS)) {
+    nesting.enter();
     advance();
     auto operand = parseUnary();
     return std::make_unique<UnaryOpExpr>(UnaryOpExpr::Operator::NEGATE,
                                          std::move(operand));
   }
   if (check(TokenType::BANG)) {
+    nesting.enter();
     advance();
     auto operand = parseUnary();
     return std::make_unique<UnaryOpExpr>(UnaryOpExpr::Operator::NOT,
@@ -511,21 +821,19 @@ std::unique_ptr<Expr> Parser::parsePrimary() {
 // ============================================================================
 
 const Token &Parser::currentToken() const {
-  if (current_ < tokens_.size()) {
-    return tokens_[current_];
+  if (current_ < end_) {
+    return (*tokens_)[current_];
   }
-  static const Token eofToken{TokenType::END_OF_FILE, "", 0, 0};
-  return eofToken;
+  return endToken_;
 }
 
 const Token &Parser::peekToken() const { return peek(1); }
 
 const Token &Parser::peek(size_t n) const {
-  if (current_ + n < tokens_.size()) {
-    return tokens_[current_ + n];
+  if (current_ + n < end_) {
+    return (*tokens_)[current_ + n];
   }
-  static const Token eofToken{TokenType::END_OF_FILE, "", 0, 0};
-  return eofToken;
+  return endToken_;
 }
 
 bool Parser::isAtEnd() const {
@@ -573,6 +881,14 @@ bool Parser::match(const std::vector<TokenType> &types) {
 // Error Handling
 // ============================================================================
 
+void Parser::Nesting::enter() {
+  ++levels_;
+  if (++parser_.depth_ > MAX_NESTING_DEPTH) {
+    parser_.error("Nesting too deep (more than " +
+                  std::to_string(MAX_NESTING_DEPTH) + " levels)");
+  }
+}
+
 void Parser::error(const std::string &message) {
   throw ParserError(formatError(message));
 }
@@ -0,0 +1,298 @@
+#include "profile_data.h"
+#include "common.h"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// ============================================================================
+// Collection
+// ============================================================================
+
+ProfileData ProfileData::collect(const BytecodeProgram &program,
+                                 const Profiler &profiler) {
+  ProfileData data;
+  for (size_t i = 0; i < program.functions.size(); ++i) {
+    data.calls_[program.functions[i].name] +=
+        profiler.getCallCount(static_cast<uint16_t>(i));
+  }
+
+  for (const auto &site : program.branchSites) {
+    Site key{functionKey(site.function), site.line};
+    Profiler::BranchCounts test = profiler.getBranchCounts(site.test);
+    bool jumpsWhenTrue = static_cast<Opcode>(program.code[site.test].opcode) ==
+                         Opcode::JUMP_IF_NOT_ZERO;
+    uint64_t held = jumpsWhenTrue ? test.jumped : test.fellThrough;
+    if (!site.loop) {
+      BranchProfile &branch = data.branches_[key];
+      branch.taken += held;
+      branch.total += test.jumped + test.fellThrough;
+    } else {
+      LoopProfile &loop = data.loops_[key];
+      loop.entries += profiler.getBranchCounts(site.entry).jumped;
+      loop.iterations += held;
+    }
+  }
+  return data;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+int64_t ProfileData::callCount(const std::string &fn) const {
+  auto it = calls_.find(fn);
+  return it != calls_.end() ? static_cast<int64_t>(it->second) : -1;
+}
+
+const BranchProfile *ProfileData::branch(const std::string &fn,
+                                         int line) const {
+  auto it = branches_.find({functionKey(fn), line});
+  return it != branches_.end() ? &it->second : nullptr;
+}
+
+const LoopProfile *ProfileData::loop(const std::string &fn, int line) const {
+  auto it = loops_.find({functionKey(fn), line});
+  return it != loops_.end() ? &it->second : nullptr;
+}
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+namespace {
+
+std::string quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+/**
+ * Reader for the subset of JSON that save() writes: objects, arrays,
+ * strings with `\"` and `\\` escapes, and non-negative integers
+ */
+class JsonReader {
+public:
+  explicit JsonReader(const std::string &text) : text_(text) {}
+
+  /**
+   * Read an object, calling onMember(key) with the reader positioned at
+   * each member's value
+   */
+  template <typename Fn> void object(Fn onMember) {
+    expect('{');
+    if (consume('}')) {
+      return;
+    }
+    do {
+      std::string key = string();
+      expect(':');
+      onMember(key);
+    } while (consume(','));
+    expect('}');
+  }
+
+  /**
+   * Read an array, calling onElement() at each element
+   */
+  template <typename Fn> void array(Fn onElement) {
+    expect('[');
+    if (consume(']')) {
+      return;
+    }
+    do {
+      onElement();
+    } while (consume(','));
+    expect(']');
+  }
+
+  std::string string() {
+    expect('"');
+    std::string value;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      if (text_[pos_] == '\\') {
+        ++pos_;
+      }
+      if (pos_ < text_.size()) {
+        value += text_[pos_++];
+      }
+    }
+    expect('"');
+    return value;
+  }
+
+  uint64_t number() {
+    skipSpace();
+    if (pos_ >= text_.size() || !std::isdigit(static_cast<unsigned char>(
+                                    text_[pos_]))) {
+      fail("expected a number");
+    }
+    uint64_t value = 0;
+    while (pos_ < text_.size() &&
+           std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+      value = value * 10 + static_cast<uint64_t>(text_[pos_++] - '0');
+    }
+    return value;
+  }
+
+  void end() {
+    skipSpace();
+    if (pos_ != text_.size()) {
+      fail("unexpected text after the profile");
+    }
+  }
+
+  [[noreturn]] void fail(const std::string &message) const {
+    throw CompilerError("Invalid profile: " + message + " at offset " +
+                        std::to_string(pos_));
+  }
+
+private:
+  const std::string &text_;
+  size_t pos_ = 0;
+
+  void skipSpace() {
+    while (pos_ < text_.size() &&
+           std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(std::string("expected '") + c + "'");
+    }
+  }
+};
+
+} // namespace
+
+std::string ProfileData::toJson() const {
+  std::ostringstream out;
+  out << "{\n  \"version\": 1,\n  \"functions\": {";
+  const char *separator = "\n";
+  for (const auto &[name, calls] : calls_) {
+    out << separator << "    " << quote(name) << ": {\"calls\": " << calls
+        << "}";
+    separator = ",\n";
+  }
+  out << "\n  },\n  \"branches\": [";
+  separator = "\n";
+  for (const auto &[site, branch] : branches_) {
+    out << separator << "    {\"function\": " << quote(site.first)
+        << ", \"line\": " << site.second << ", \"taken\": " << branch.taken
+        << ", \"total\": " << branch.total << "}";
+    separator = ",\n";
+  }
+  out << "\n  ],\n  \"loops\": [";
+  separator = "\n";
+  for (const auto &[site, loop] : loops_) {
+    out << separator << "    {\"function\": " << quote(site.first)
+        << ", \"line\": " << site.second << ", \"entries\": " << loop.entries
+        << ", \"iterations\": " << loop.iterations << "}";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+  return out.str();
+}
+
+ProfileData ProfileData::fromJson(const std::string &json) {
+  ProfileData data;
+  JsonReader reader(json);
+
+  // Branch and loop records share a shape apart from their two counts
+  auto readSite = [&](const char *first, const char *second, Site &site,
+                      uint64_t &a, uint64_t &b) {
+    int seen = 0;
+    reader.object([&](const std::string &key) {
+      if (key == "function") {
+        site.first = reader.string();
+      } else if (key == "line") {
+        site.second = static_cast<int>(reader.number());
+      } else if (key == first) {
+        a = reader.number();
+      } else if (key == second) {
+        b = reader.number();
+      } else {
+        reader.fail("unknown key \"" + key + "\"");
+      }
+      ++seen;
+    });
+    if (seen != 4) {
+      reader.fail("incomplete record");
+    }
+  };
+
+  reader.object([&](const std::string &key) {
+    if (key == "version") {
+      if (reader.number() != 1) {
+        reader.fail("unsupported version");
+      }
+    } else if (key == "functions") {
+      reader.object([&](const std::string &name) {
+        reader.object([&](const std::string &field) {
+          if (field != "calls") {
+            reader.fail("unknown key \"" + field + "\"");
+          }
+          data.calls_[name] = reader.number();
+        });
+      });
+    } else if (key == "branches") {
+      reader.array([&] {
+        Site site;
+        BranchProfile branch;
+        readSite("taken", "total", site, branch.taken, branch.total);
+        data.branches_[site] = branch;
+      });
+    } else if (key == "loops") {
+      reader.array([&] {
+        Site site;
+        LoopProfile loop;
+        readSite("entries", "iterations", site, loop.entries,
+                 loop.iterations);
+        data.loops_[site] = loop;
+      });
+    } else {
+      reader.fail("unknown key \"" + key + "\"");
+    }
+  });
+  reader.end();
+  return data;
+}
+
+// ============================================================================
+// Files
+// ============================================================================
+
+ProfileData ProfileData::load(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw CompilerError("Cannot open profile: " + path);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return fromJson(buffer.str());
+}
+
+void ProfileData::save(const std::string &path) const {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw CompilerError("Cannot write profile: " + path);
+  }
+  file << toJson();
+}
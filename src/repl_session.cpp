@@ -0,0 +1,35 @@
+#include "repl_session.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+
+ReplSession::ReplSession(const Snapshot &snapshot)
+    : program_(snapshot.program) {
+  codegen_.restore(program_, snapshot.globals);
+  vm_.setLocals(Snapshot::deepCopy(snapshot.values));
+}
+
+Snapshot ReplSession::snapshot() const {
+  Snapshot image;
+  image.program = program_;
+  image.globals = codegen_.globalSlots();
+  image.values =
+      Snapshot::deepCopy(vm_.getLocals(program_.mainLocalCount));
+  return image;
+}
+
+Value ReplSession::eval(const std::string &source) {
+  Lexer lexer(source);
+  auto tokens = lexer.tokenize();
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+
+  if (optimize_) {
+    Optimizer optimizer;
+    optimizer.setRemoveDeadFunctions(false);
+    optimizer.run(*program);
+  }
+
+  codegen_.append(program_, *program);
+  return vm_.execute(program_, nullptr, true);
+}
@@ -0,0 +1,116 @@
+#include "scheduler.h"
+#include "execution_context.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+// Stride of a priority 1 job; divisible by every small priority
+constexpr uint64_t kStrideUnit = 720720;
+} // namespace
+
+Scheduler::Scheduler(size_t threads, uint64_t slice)
+    : slice_(std::max<uint64_t>(slice, 1)) {
+  if (threads == 0) {
+    threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this] { threadLoop(); });
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+Scheduler::JobId
+Scheduler::submit(std::shared_ptr<const BytecodeProgram> program,
+                  uint32_t priority) {
+  auto job = std::make_unique<Job>();
+  job->context = std::make_unique<ExecutionContext>(std::move(program));
+  job->context->start();
+  job->stride = kStrideUnit / std::max<uint32_t>(priority, 1);
+
+  JobId id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = nextId_++;
+    // Join at the current virtual time, so new jobs cannot crowd out old ones
+    job->pass = now_;
+    queue_.push({job->pass, order_++, job.get()});
+    jobs_.emplace(id, std::move(job));
+    ++pending_;
+  }
+  ready_.notify_one();
+  return id;
+}
+
+Scheduler::Result Scheduler::wait(JobId id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = jobs_.find(id);
+  if (it == jobs_.end()) {
+    throw std::out_of_range("Unknown job " + std::to_string(id));
+  }
+  Job &job = *it->second;
+  done_.wait(lock, [&] { return job.done; });
+  Result result = std::move(job.result);
+  jobs_.erase(it);
+  return result;
+}
+
+size_t Scheduler::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+void Scheduler::threadLoop() {
+  while (true) {
+    Job *job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      job = queue_.top().job;
+      queue_.pop();
+      now_ = job->pass;
+    }
+
+    bool finished = runSlice(*job);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished) {
+      job->done = true;
+      --pending_;
+      done_.notify_all();
+    } else {
+      job->pass += job->stride;
+      queue_.push({job->pass, order_++, job});
+      ready_.notify_one();
+    }
+  }
+}
+
+bool Scheduler::runSlice(Job &job) {
+  // Only this thread touches the job until it is queued again
+  ++job.result.slices;
+  try {
+    if (!job.context->resume(slice_)) {
+      return false;
+    }
+    job.result.value = job.context->vm().result();
+  } catch (const std::exception &e) {
+    job.result.error = e.what();
+  }
+  job.result.output = job.context->takeOutput();
+  // Release the VM now rather than when someone collects the result
+  job.context.reset();
+  return true;
+}
@@ -0,0 +1,481 @@
+#include "server.h"
+#include "bytecode_api.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Frame header: the payload length, big-endian
+constexpr size_t kHeaderBytes = 4;
+
+// Linux suppresses SIGPIPE per send; elsewhere it is set per socket
+// (SO_NOSIGPIPE) when the connection is accepted
+#ifdef MSG_NOSIGNAL
+constexpr int kNoSignal = MSG_NOSIGNAL;
+#else
+constexpr int kNoSignal = 0;
+#endif
+
+// pipe2/accept4/SOCK_CLOEXEC are Linux-only, so flags are set afterwards
+bool setDescriptorFlags(int fd, bool nonBlocking) {
+  if (::fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+    return false;
+  }
+  int status = nonBlocking ? ::fcntl(fd, F_GETFL) : 0;
+  return !nonBlocking ||
+         (status >= 0 && ::fcntl(fd, F_SETFL, status | O_NONBLOCK) == 0);
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Waits for a client that does not read until deadline, then fails; a
+// deadline already passed fails as soon as the socket buffer is full
+bool writeFull(int fd, const char *data, size_t size,
+               Clock::time_point deadline) {
+  while (size > 0) {
+    ssize_t n = ::send(fd, data, size, kNoSignal | MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(
+          deadline - Clock::now());
+      if (left.count() <= 0) {
+        return false;
+      }
+      pollfd writable = {fd, POLLOUT, 0};
+      if (::poll(&writable, 1, static_cast<int>(left.count())) < 0 &&
+          errno != EINTR) {
+        return false;
+      }
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool writeFrame(int fd, const std::string &payload,
+                Clock::time_point deadline) {
+  uint32_t size = static_cast<uint32_t>(payload.size());
+  char header[kHeaderBytes] = {
+      static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+      static_cast<char>(size >> 8), static_cast<char>(size)};
+  return writeFull(fd, header, sizeof(header), deadline) &&
+         writeFull(fd, payload.data(), payload.size(), deadline);
+}
+
+std::string statusOnly(const std::string &status, const std::string &error) {
+  return "status=" + status + "\nerror=" + error + "\n\n";
+}
+
+uint64_t microseconds(std::chrono::steady_clock::duration duration) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+} // namespace
+
+Server::Server(ServerOptions options) : options_(std::move(options)) {
+  if (options_.workers == 0) {
+    options_.workers =
+        std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+}
+
+Server::~Server() {
+  stop();
+  for (int fd : wakeFds_) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+void Server::stop() {
+  stopping_ = true;
+  wake();
+}
+
+void Server::wake() {
+  if (wakeFds_[1] >= 0) {
+    char byte = 0;
+    // A full pipe already has a wake-up pending
+    [[maybe_unused]] ssize_t n = ::write(wakeFds_[1], &byte, 1);
+  }
+}
+
+void Server::run() {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (options_.socketPath.empty() ||
+      options_.socketPath.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Invalid socket path: " + options_.socketPath);
+  }
+  std::strcpy(address.sun_path, options_.socketPath.c_str());
+
+  if (wakeFds_[0] < 0 &&
+      (::pipe(wakeFds_) != 0 || !setDescriptorFlags(wakeFds_[0], true) ||
+       !setDescriptorFlags(wakeFds_[1], true))) {
+    throw std::runtime_error("Cannot create pipe: " +
+                             std::string(std::strerror(errno)));
+  }
+  listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(options_.socketPath.c_str());
+  if (listenFd_ < 0 || !setDescriptorFlags(listenFd_, false) ||
+      ::bind(listenFd_, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listenFd_, SOMAXCONN) != 0) {
+    std::string reason = std::strerror(errno);
+    if (listenFd_ >= 0) {
+      ::close(listenFd_);
+      listenFd_ = -1;
+    }
+    throw std::runtime_error("Cannot listen on " + options_.socketPath +
+                             ": " + reason);
+  }
+
+  for (size_t i = 0; i < options_.workers; ++i) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+
+  auto closeConnection = [this](int fd) {
+    ::close(fd);
+    connections_.erase(fd);
+  };
+  auto frameTimeout = std::chrono::milliseconds(options_.frameTimeoutMs);
+
+  std::vector<pollfd> fds;
+  while (!stopping_) {
+    // Idle connections; a partial frame also sets when poll must return
+    fds.clear();
+    fds.push_back({wakeFds_[0], POLLIN, 0});
+    fds.push_back({listenFd_, POLLIN, 0});
+    Clock::time_point now = Clock::now();
+    int timeout = -1;
+    for (auto &[fd, connection] : connections_) {
+      if (connection.busy) {
+        continue;
+      }
+      fds.push_back({fd, POLLIN, 0});
+      if (!connection.buffer.empty()) {
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(
+            connection.started + frameTimeout - now);
+        int ms = static_cast<int>(std::max<int64_t>(0, left.count()));
+        timeout = timeout < 0 ? ms : std::min(timeout, ms);
+      }
+    }
+    if (::poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    now = Clock::now();
+    for (size_t i = 2; i < fds.size(); ++i) {
+      int fd = fds[i].fd;
+      Connection &connection = connections_[fd];
+      if (fds[i].revents) {
+        if (!receive(fd, connection) || !dispatch(fd, connection)) {
+          closeConnection(fd);
+        }
+      } else if (!connection.buffer.empty() &&
+                 now - connection.started >= frameTimeout) {
+        closeConnection(fd); // Too slow to finish its frame
+      }
+    }
+
+    if (fds[0].revents) {
+      char drain[64];
+      while (::read(wakeFds_[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+    std::vector<int> returned;
+    std::vector<int> failed;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      returned.swap(returned_);
+      failed.swap(failed_);
+    }
+    for (int fd : failed) {
+      closeConnection(fd);
+    }
+    for (int fd : returned) {
+      // The client may already have sent its next request
+      Connection &connection = connections_[fd];
+      connection.busy = false;
+      connection.started = Clock::now();
+      if (!dispatch(fd, connection)) {
+        closeConnection(fd);
+      }
+    }
+
+    if (fds[1].revents & POLLIN) {
+      int fd = ::accept(listenFd_, nullptr, nullptr);
+      if (fd >= 0) {
+        setDescriptorFlags(fd, false);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        connections_[fd] = Connection{};
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+
+  // Requests still queued are dropped with their connections
+  queue_.clear();
+  returned_.clear();
+  failed_.clear();
+  for (const auto &entry : connections_) {
+    ::close(entry.first);
+  }
+  connections_.clear();
+  ::close(listenFd_);
+  listenFd_ = -1;
+  ::unlink(options_.socketPath.c_str());
+}
+
+bool Server::receive(int fd, Connection &connection) {
+  char chunk[64 * 1024];
+  // Once a whole frame is buffered, the rest waits until it is served
+  while (connection.buffer.size() < kHeaderBytes + options_.maxRequestBytes) {
+    ssize_t n = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    if (connection.buffer.empty()) {
+      connection.started = Clock::now();
+    }
+    connection.buffer.append(chunk, static_cast<size_t>(n));
+  }
+  return true;
+}
+
+bool Server::dispatch(int fd, Connection &connection) {
+  std::string &buffer = connection.buffer;
+  while (buffer.size() >= kHeaderBytes) {
+    auto byte = [&](size_t i) {
+      return static_cast<size_t>(static_cast<unsigned char>(buffer[i]));
+    };
+    size_t size = (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+    if (size > options_.maxRequestBytes) {
+      // The rest of the frame is never read, so the connection cannot go on
+      writeFrame(fd, statusOnly("bad_request", "Request too large"),
+                 Clock::now());
+      return false;
+    }
+    if (buffer.size() < kHeaderBytes + size) {
+      return true;
+    }
+    std::string request = buffer.substr(kHeaderBytes, size);
+    buffer.erase(0, kHeaderBytes + size);
+    // Bytes of the next frame start its clock now
+    connection.started = Clock::now();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.size() < options_.maxQueue) {
+        queue_.push_back({fd, std::move(request), Clock::now()});
+        ready_.notify_one();
+        // The connection belongs to the workers until they return it
+        connection.busy = true;
+        return true;
+      }
+    }
+    ++shed_;
+    // The I/O thread never waits on a client that does not read
+    if (!writeFrame(fd, statusOnly("overloaded", "Server busy, try again"),
+                    Clock::now())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Server::workerLoop() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    // A client that stops reading loses its connection, not a worker
+    std::string response = process(task);
+    bool ok = writeFrame(
+        task.fd, response,
+        Clock::now() + std::chrono::milliseconds(options_.writeTimeoutMs));
+    ++served_;
+    {
+      // The I/O thread closes connections, so it can drop their buffers
+      std::lock_guard<std::mutex> lock(mutex_);
+      (ok ? returned_ : failed_).push_back(task.fd);
+    }
+    wake();
+  }
+}
+
+std::string Server::process(const Task &task) const {
+  Clock::time_point started = Clock::now();
+
+  // Headers up to the first empty line, then the source
+  bc_compile_options compileOptions;
+  bc_compile_options_init(&compileOptions);
+  bc_exec_options execOptions;
+  bc_exec_options_init(&execOptions);
+  // Requests already run side by side; loops stay on their worker
+  execOptions.threads = 1;
+  uint64_t instructionLimit = 0;
+  size_t maxOutput = 0;
+
+  size_t pos = 0;
+  const std::string &request = task.request;
+  while (pos < request.size() && request[pos] != '\n') {
+    size_t end = request.find('\n', pos);
+    if (end == std::string::npos) {
+      return statusOnly("bad_request", "Missing empty line before source");
+    }
+    std::string line = request.substr(pos, end - pos);
+    pos = end + 1;
+    size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      return statusOnly("bad_request", "Malformed header: " + line);
+    }
+    std::string key = line.substr(0, eq);
+    // Digits only: stoull alone would take "-1" as 2^64 - 1
+    std::string text = line.substr(eq + 1);
+    uint64_t value;
+    try {
+      if (text.empty() || !std::all_of(text.begin(), text.end(), [](char c) {
+            return c >= '0' && c <= '9';
+          })) {
+        throw std::invalid_argument(text);
+      }
+      value = std::stoull(text);
+    } catch (const std::exception &) {
+      return statusOnly("bad_request", "Malformed header: " + line);
+    }
+    if (key == "optimize") {
+      compileOptions.optimize = value != 0;
+    } else if (key == "jit") {
+      execOptions.jit = value != 0;
+    } else if (key == "memoize") {
+      execOptions.memoize = value != 0;
+    } else if (key == "profile") {
+      execOptions.profile = value != 0;
+    } else if (key == "instruction_limit") {
+      instructionLimit = value;
+    } else if (key == "max_output") {
+      maxOutput = static_cast<size_t>(value);
+    } else {
+      return statusOnly("bad_request", "Unknown header: " + key);
+    }
+  }
+  ++pos; // Empty line
+  if (pos > request.size()) {
+    return statusOnly("bad_request", "Missing empty line before source");
+  }
+
+  // The server's cap wins over a larger (or missing) request limit
+  if (options_.instructionLimit &&
+      (!instructionLimit || instructionLimit > options_.instructionLimit)) {
+    instructionLimit = options_.instructionLimit;
+  }
+  execOptions.instruction_limit = instructionLimit;
+  if (options_.maxOutput && (!maxOutput || maxOutput > options_.maxOutput)) {
+    maxOutput = options_.maxOutput;
+  }
+  execOptions.max_output = maxOutput;
+
+  std::string status = "ok";
+  std::string error;
+  std::string output;
+  bool truncated = false;
+  bc_stats stats;
+  bc_stats_init(&stats);
+  bool ran = false;
+
+  bc_program *program = bc_compile(request.data() + pos, request.size() - pos,
+                                   &compileOptions);
+  if (!program) {
+    return statusOnly("error", "Out of memory");
+  }
+  double compileMs = bc_program_compile_ms(program);
+  if (const char *message = bc_program_error(program)) {
+    status = "error";
+    error = message;
+  } else if (bc_run *run = bc_execute(program, &execOptions)) {
+    ran = true;
+    size_t length = 0;
+    const char *text = bc_run_output(run, &length);
+    output.assign(text, length);
+    if (const char *message = bc_run_error(run)) {
+      status = "error";
+      error = message;
+      truncated = error.find("Output limit exceeded") != std::string::npos;
+    }
+    bc_run_stats(run, &stats);
+    bc_run_free(run);
+  } else {
+    status = "error";
+    error = "Out of memory";
+  }
+  bc_program_free(program);
+
+  // Keep the error on its header line
+  std::replace(error.begin(), error.end(), '\n', ' ');
+  std::ostringstream response;
+  response << "status=" << status << "\n";
+  if (!error.empty()) {
+    response << "error=" << error << "\n";
+  }
+  response << "queue_us=" << microseconds(started - task.queued) << "\n";
+  response << "compile_us=" << static_cast<uint64_t>(compileMs * 1000)
+           << "\n";
+  response << "execute_us=" << static_cast<uint64_t>(stats.execute_ms * 1000)
+           << "\n";
+  response << "total_us=" << microseconds(Clock::now() - task.queued) << "\n";
+  if (ran) {
+    response << "instructions=" << stats.instructions << "\n";
+  }
+  if (truncated) {
+    response << "truncated=1\n";
+  }
+  response << "\n" << output;
+  return response.str();
+}
@@ -0,0 +1,545 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr char kMagic[] = "BCSNAP";
+constexpr uint32_t kVersion = 1;
+
+enum class ValueTag : uint8_t { VOID, INT, STRING, ARRAY };
+
+class Writer {
+public:
+  void u8(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+  void u16(uint16_t value) {
+    u8(static_cast<uint8_t>(value));
+    u8(static_cast<uint8_t>(value >> 8));
+  }
+  void u32(uint32_t value) {
+    u16(static_cast<uint16_t>(value));
+    u16(static_cast<uint16_t>(value >> 16));
+  }
+  void i32(int32_t value) { u32(static_cast<uint32_t>(value)); }
+  void string(const std::string &value) {
+    u32(static_cast<uint32_t>(value.size()));
+    out_ += value;
+  }
+
+  std::string take() { return std::move(out_); }
+
+private:
+  std::string out_;
+};
+
+class Reader {
+public:
+  explicit Reader(const std::string &data) : data_(data) {}
+
+  uint8_t u8() {
+    need(1);
+    return static_cast<uint8_t>(data_[pos_++]);
+  }
+  uint16_t u16() {
+    uint16_t low = u8();
+    return static_cast<uint16_t>(low | (u8() << 8));
+  }
+  uint32_t u32() {
+    uint32_t low = u16();
+    return low | (static_cast<uint32_t>(u16()) << 16);
+  }
+  int32_t i32() { return static_cast<int32_t>(u32()); }
+  std::string string() {
+    uint32_t size = u32();
+    need(size);
+    std::string value = data_.substr(pos_, size);
+    pos_ += size;
+    return value;
+  }
+
+  /**
+   * A count of items that each take at least `itemBytes` bytes
+   */
+  uint32_t count(size_t itemBytes) {
+    uint32_t n = u32();
+    need(static_cast<size_t>(n) * itemBytes);
+    return n;
+  }
+
+  bool atEnd() const { return pos_ == data_.size(); }
+
+  [[noreturn]] void fail(const std::string &message) const {
+    throw CompilerError("Invalid snapshot: " + message + " at offset " +
+                        std::to_string(pos_));
+  }
+
+private:
+  const std::string &data_;
+  size_t pos_ = 0;
+
+  void need(size_t bytes) const {
+    if (data_.size() - pos_ < bytes) {
+      fail("unexpected end");
+    }
+  }
+};
+
+// Numbers every array reachable from the values, parents before children
+class ArrayTable {
+public:
+  explicit ArrayTable(const std::vector<Value> &values) {
+    for (const auto &value : values) {
+      visit(value);
+    }
+  }
+
+  const std::vector<const std::vector<Value> *> &arrays() const {
+    return arrays_;
+  }
+  uint32_t indexOf(const ArrayPtr &array) const {
+    return index_.at(array.get());
+  }
+
+private:
+  std::vector<const std::vector<Value> *> arrays_;
+  std::unordered_map<const std::vector<Value> *, uint32_t> index_;
+
+  void visit(const Value &value) {
+    if (!value.isArray()) {
+      return;
+    }
+    // Iterative, so deeply nested arrays cannot overflow the stack
+    std::vector<const std::vector<Value> *> pending{
+        std::get<ArrayPtr>(value.data).get()};
+    while (!pending.empty()) {
+      const std::vector<Value> *array = pending.back();
+      pending.pop_back();
+      if (!index_.emplace(array, static_cast<uint32_t>(arrays_.size()))
+               .second) {
+        continue;
+      }
+      arrays_.push_back(array);
+      for (const auto &element : *array) {
+        if (element.isArray()) {
+          pending.push_back(std::get<ArrayPtr>(element.data).get());
+        }
+      }
+    }
+  }
+};
+
+void writeValue(Writer &out, const Value &value, const ArrayTable &table) {
+  if (value.isInt()) {
+    out.u8(static_cast<uint8_t>(ValueTag::INT));
+    out.i32(value.asInt());
+  } else if (value.isString()) {
+    out.u8(static_cast<uint8_t>(ValueTag::STRING));
+    out.string(value.asString());
+  } else if (value.isArray()) {
+    out.u8(static_cast<uint8_t>(ValueTag::ARRAY));
+    out.u32(table.indexOf(std::get<ArrayPtr>(value.data)));
+  } else {
+    out.u8(static_cast<uint8_t>(ValueTag::VOID));
+  }
+}
+
+Value readValue(Reader &in, const std::vector<ArrayPtr> &arrays) {
+  switch (static_cast<ValueTag>(in.u8())) {
+  case ValueTag::VOID:
+    return Value();
+  case ValueTag::INT:
+    return Value(in.i32());
+  case ValueTag::STRING:
+    return Value(in.string());
+  case ValueTag::ARRAY: {
+    uint32_t index = in.u32();
+    if (index >= arrays.size()) {
+      in.fail("array index out of range");
+    }
+    return Value(arrays[index]);
+  }
+  }
+  in.fail("unknown value tag");
+}
+
+// A decoded program the VM can index without further checks: every operand
+// names an existing constant, function, table, loop or local slot, and
+// every jump target, entry and table target lies within the code (the end
+// of the code, where a run stops, included)
+void validate(const Snapshot &snapshot) {
+  const BytecodeProgram &program = snapshot.program;
+  auto invalid = [](const std::string &message) {
+    throw CompilerError("Invalid snapshot: " + message);
+  };
+  size_t codeSize = program.code.size();
+  auto checkTarget = [&](uint16_t target, const char *what) {
+    if (target > codeSize) {
+      invalid(std::string(what) + " " + std::to_string(target) +
+              " is outside the code");
+    }
+  };
+  auto checkSlot = [&](size_t slot) {
+    if (slot >= MAX_VARIABLES) {
+      invalid("local slot " + std::to_string(slot) + " out of range");
+    }
+  };
+
+  if (codeSize >= LAZY_FUNCTION_ENTRY) {
+    invalid("program too large");
+  }
+  for (size_t ip = 0; ip < codeSize; ++ip) {
+    const Instruction &instr = program.code[ip];
+    uint16_t operand = instr.operand;
+    auto checkIndex = [&](size_t count, const char *what) {
+      if (operand >= count) {
+        invalid(std::string(what) + " " + std::to_string(operand) +
+                " at instruction " + std::to_string(ip) + " does not exist");
+      }
+    };
+    switch (static_cast<Opcode>(instr.opcode)) {
+    case Opcode::CONST:
+      checkIndex(program.constants.size(), "constant");
+      break;
+    case Opcode::CALL:
+      checkIndex(program.functions.size(), "function");
+      break;
+    case Opcode::TABLE_SWITCH:
+    case Opcode::LOOKUP_SWITCH:
+      checkIndex(program.switchTables.size(), "switch table");
+      break;
+    case Opcode::PARALLEL_FOR:
+    case Opcode::PARALLEL_NEXT:
+      checkIndex(program.parallelLoops.size(), "parallel loop");
+      break;
+    case Opcode::JUMP:
+    case Opcode::JUMP_IF_ZERO:
+    case Opcode::JUMP_IF_NOT_ZERO:
+      checkTarget(operand, "jump target");
+      break;
+    case Opcode::LOAD:
+    case Opcode::STORE:
+    case Opcode::LOCAL_INC:
+    case Opcode::LOCAL_DEC:
+      checkSlot(operand);
+      break;
+    case Opcode::ITER_NEXT:
+      checkSlot(operand + 2u);
+      break;
+    case Opcode::SHL:
+    case Opcode::SHR:
+    case Opcode::MASK:
+      if (operand > MAX_SHIFT) {
+        invalid("shift by " + std::to_string(operand));
+      }
+      break;
+    case Opcode::ADD:
+    case Opcode::SUB:
+    case Opcode::MUL:
+    case Opcode::DIV:
+    case Opcode::MOD:
+    case Opcode::RETURN:
+    case Opcode::PRINT:
+    case Opcode::EQ:
+    case Opcode::NEQ:
+    case Opcode::LT:
+    case Opcode::LTE:
+    case Opcode::GT:
+    case Opcode::GTE:
+    case Opcode::BUILD_ARRAY:
+    case Opcode::ARRAY_LOAD:
+    case Opcode::ARRAY_STORE:
+    case Opcode::POP:
+    case Opcode::ARRAY_ADD_STORE:
+    case Opcode::DUP2:
+      break;
+    default:
+      invalid("unknown opcode " + std::to_string(instr.opcode) +
+              " at instruction " + std::to_string(ip));
+    }
+  }
+
+  for (const auto &fn : program.functions) {
+    if (fn.entry != LAZY_FUNCTION_ENTRY) {
+      checkTarget(fn.entry, "function entry");
+    }
+  }
+  checkTarget(program.mainEntry, "main entry");
+  if (program.mainLocalCount > MAX_VARIABLES) {
+    invalid("too many main locals");
+  }
+  for (const auto &site : program.branchSites) {
+    if (site.test >= codeSize || (site.loop && site.entry >= codeSize)) {
+      invalid("branch site outside the code");
+    }
+  }
+  for (const auto &table : program.switchTables) {
+    for (uint16_t target : table.targets) {
+      checkTarget(target, "switch target");
+    }
+    for (const auto &entry : table.intCases) {
+      checkTarget(entry.second, "switch target");
+    }
+    for (const auto &entry : table.stringCases) {
+      checkTarget(entry.second, "switch target");
+    }
+    checkTarget(table.defaultTarget, "switch target");
+  }
+  for (const auto &loop : program.parallelLoops) {
+    checkTarget(loop.bodyStart, "parallel loop body");
+    checkTarget(loop.exit, "parallel loop exit");
+    checkSlot(loop.indexSlot + 1u);
+    for (const auto &reduction : loop.reductions) {
+      checkSlot(reduction.slot);
+    }
+  }
+  for (const auto &entry : snapshot.globals) {
+    checkSlot(entry.second);
+  }
+  if (snapshot.values.size() > MAX_VARIABLES) {
+    invalid("too many values");
+  }
+}
+
+} // namespace
+
+std::vector<Value> Snapshot::deepCopy(const std::vector<Value> &values) {
+  ArrayTable table(values);
+  std::vector<ArrayPtr> copies;
+  copies.reserve(table.arrays().size());
+  for (size_t i = 0; i < table.arrays().size(); ++i) {
+    copies.push_back(std::make_shared<std::vector<Value>>());
+  }
+
+  auto copy = [&](const Value &value) {
+    return value.isArray()
+               ? Value(copies[table.indexOf(std::get<ArrayPtr>(value.data))])
+               : value;
+  };
+  for (size_t i = 0; i < table.arrays().size(); ++i) {
+    for (const auto &element : *table.arrays()[i]) {
+      copies[i]->push_back(copy(element));
+    }
+  }
+
+  std::vector<Value> result;
+  result.reserve(values.size());
+  for (const auto &value : values) {
+    result.push_back(copy(value));
+  }
+  return result;
+}
+
+std::string Snapshot::toBinary() const {
+  Writer out;
+  for (const char *c = kMagic; *c; ++c) {
+    out.u8(static_cast<uint8_t>(*c));
+  }
+  out.u32(kVersion);
+
+  out.u32(static_cast<uint32_t>(program.code.size()));
+  for (const auto &instr : program.code) {
+    out.u8(instr.opcode);
+    out.u16(instr.operand);
+  }
+  // Constants are ints and strings; arrays only exist at run time
+  ArrayTable noArrays({});
+  out.u32(static_cast<uint32_t>(program.constants.size()));
+  for (const auto &constant : program.constants) {
+    writeValue(out, constant.isArray() ? Value() : constant, noArrays);
+  }
+  out.u32(static_cast<uint32_t>(program.functions.size()));
+  for (const auto &fn : program.functions) {
+    out.string(fn.name);
+    out.u16(fn.entry);
+    out.u8(fn.arity);
+    out.u8(fn.localCount);
+  }
+  out.u16(program.mainEntry);
+  out.u16(program.mainLocalCount);
+  out.u32(static_cast<uint32_t>(program.branchSites.size()));
+  for (const auto &site : program.branchSites) {
+    out.string(site.function);
+    out.i32(site.line);
+    out.u8(site.loop ? 1 : 0);
+    out.u16(site.test);
+    out.u16(site.entry);
+  }
+  out.u32(static_cast<uint32_t>(program.switchTables.size()));
+  for (const auto &table : program.switchTables) {
+    out.i32(table.low);
+    out.u32(static_cast<uint32_t>(table.targets.size()));
+    for (uint16_t target : table.targets) {
+      out.u16(target);
+    }
+    out.u32(static_cast<uint32_t>(table.intCases.size()));
+    for (const auto &[label, target] : table.intCases) {
+      out.i32(label);
+      out.u16(target);
+    }
+    out.u32(static_cast<uint32_t>(table.stringCases.size()));
+    for (const auto &[label, target] : table.stringCases) {
+      out.string(label);
+      out.u16(target);
+    }
+    out.u16(table.defaultTarget);
+  }
+  out.u32(static_cast<uint32_t>(program.parallelLoops.size()));
+  for (const auto &loop : program.parallelLoops) {
+    out.u16(loop.indexSlot);
+    out.u16(loop.bodyStart);
+    out.u16(loop.exit);
+    out.u32(static_cast<uint32_t>(loop.reductions.size()));
+    for (const auto &reduction : loop.reductions) {
+      out.u16(reduction.slot);
+      out.u8(static_cast<uint8_t>(reduction.op));
+    }
+  }
+
+  // Slot order keeps the image byte-for-byte stable across saves
+  std::vector<std::pair<uint16_t, const std::string *>> slots;
+  for (const auto &[name, slot] : globals) {
+    slots.emplace_back(slot, &name);
+  }
+  std::sort(slots.begin(), slots.end());
+  out.u32(static_cast<uint32_t>(slots.size()));
+  for (const auto &[slot, name] : slots) {
+    out.string(*name);
+    out.u16(slot);
+  }
+
+  ArrayTable table(values);
+  out.u32(static_cast<uint32_t>(table.arrays().size()));
+  for (const auto *array : table.arrays()) {
+    out.u32(static_cast<uint32_t>(array->size()));
+    for (const auto &element : *array) {
+      writeValue(out, element, table);
+    }
+  }
+  out.u32(static_cast<uint32_t>(values.size()));
+  for (const auto &value : values) {
+    writeValue(out, value, table);
+  }
+  return out.take();
+}
+
+Snapshot Snapshot::fromBinary(const std::string &data) {
+  Reader in(data);
+  for (const char *c = kMagic; *c; ++c) {
+    if (in.u8() != static_cast<uint8_t>(*c)) {
+      in.fail("not a snapshot");
+    }
+  }
+  if (in.u32() != kVersion) {
+    in.fail("unsupported version");
+  }
+
+  Snapshot snapshot;
+  BytecodeProgram &program = snapshot.program;
+  program.code.resize(in.count(3));
+  for (auto &instr : program.code) {
+    instr.opcode = in.u8();
+    instr.operand = in.u16();
+  }
+  uint32_t constantCount = in.count(1);
+  for (uint32_t i = 0; i < constantCount; ++i) {
+    program.constants.push_back(readValue(in, {}));
+  }
+  program.functions.resize(in.count(8));
+  for (auto &fn : program.functions) {
+    fn.name = in.string();
+    fn.entry = in.u16();
+    fn.arity = in.u8();
+    fn.localCount = in.u8();
+  }
+  program.mainEntry = in.u16();
+  program.mainLocalCount = in.u16();
+  program.branchSites.resize(in.count(13));
+  for (auto &site : program.branchSites) {
+    site.function = in.string();
+    site.line = in.i32();
+    site.loop = in.u8() != 0;
+    site.test = in.u16();
+    site.entry = in.u16();
+  }
+  program.switchTables.resize(in.count(18));
+  for (auto &table : program.switchTables) {
+    table.low = in.i32();
+    table.targets.resize(in.count(2));
+    for (auto &target : table.targets) {
+      target = in.u16();
+    }
+    uint32_t intCount = in.count(6);
+    for (uint32_t i = 0; i < intCount; ++i) {
+      int32_t label = in.i32();
+      table.intCases[label] = in.u16();
+    }
+    uint32_t stringCount = in.count(6);
+    for (uint32_t i = 0; i < stringCount; ++i) {
+      std::string label = in.string();
+      table.stringCases[label] = in.u16();
+    }
+    table.defaultTarget = in.u16();
+  }
+  program.parallelLoops.resize(in.count(10));
+  for (auto &loop : program.parallelLoops) {
+    loop.indexSlot = in.u16();
+    loop.bodyStart = in.u16();
+    loop.exit = in.u16();
+    loop.reductions.resize(in.count(3));
+    for (auto &reduction : loop.reductions) {
+      reduction.slot = in.u16();
+      uint8_t op = in.u8();
+      if (op > static_cast<uint8_t>(Reduction::Operator::MAX)) {
+        in.fail("unknown reduction");
+      }
+      reduction.op = static_cast<Reduction::Operator>(op);
+    }
+  }
+
+  uint32_t globalCount = in.count(6);
+  for (uint32_t i = 0; i < globalCount; ++i) {
+    std::string name = in.string();
+    snapshot.globals[name] = in.u16();
+  }
+
+  // Create every array first so that elements can refer to any of them
+  std::vector<ArrayPtr> arrays(in.count(4));
+  for (auto &array : arrays) {
+    array = std::make_shared<std::vector<Value>>();
+  }
+  for (auto &array : arrays) {
+    uint32_t size = in.count(1);
+    array->reserve(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      array->push_back(readValue(in, arrays));
+    }
+  }
+  uint32_t valueCount = in.count(1);
+  for (uint32_t i = 0; i < valueCount; ++i) {
+    snapshot.values.push_back(readValue(in, arrays));
+  }
+  if (!in.atEnd()) {
+    in.fail("trailing data");
+  }
+  validate(snapshot);
+  return snapshot;
+}
+
+Snapshot Snapshot::load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw CompilerError("Cannot open snapshot: " + path);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return fromBinary(buffer.str());
+}
+
+void Snapshot::save(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw CompilerError("Cannot write snapshot: " + path);
+  }
+  file << toBinary();
+}
@@ -1,7 +1,10 @@
 #include "vm.h"
 #include "profiler.h"
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 // ============================================================================
 // Stack Operations
@@ -25,6 +28,13 @@ Value VirtualMachine::peek() const {
 }
 
 void VirtualMachine::printValue(const Value &value, std::ostream &os) const {
+  std::vector<const std::vector<Value> *> open;
+  printValue(value, os, open);
+}
+
+void VirtualMachine::printValue(
+    const Value &value, std::ostream &os,
+    std::vector<const std::vector<Value> *> &open) const {
   if (value.isVoid()) {
     os << "void";
   } else if (value.isInt()) {
@@ -32,15 +42,33 @@ void VirtualMachine::printValue(const Value &value, std::ostream &os) const {
   } else if (value.isString()) {
     os << value.asString();
   } else if (value.isArray()) {
-    os << "[";
     auto arr = value.asArray();
+    if (std::find(open.begin(), open.end(), arr.get()) != open.end()) {
+      throw VMError("Cannot print an array that contains itself");
+    }
+    if (open.size() >= MAX_NESTING_DEPTH) {
+      throw VMError("Arrays nested too deep to print");
+    }
+    open.push_back(arr.get());
+    os << "[";
     for (size_t i = 0; i < arr->size(); ++i) {
       if (i > 0)
         os << ", ";
-      printValue((*arr)[i], os);
+      printValue((*arr)[i], os, open);
     }
     os << "]";
+    open.pop_back();
+  }
+}
+
+void VirtualMachine::writeOutput(const std::string &text) {
+  if (text.size() > outputLeft_) {
+    output_->write(text.data(), static_cast<std::streamsize>(outputLeft_));
+    outputLeft_ = 0;
+    throw VMError("Output limit exceeded");
   }
+  outputLeft_ -= text.size();
+  *output_ << text;
 }
 
 void VirtualMachine::checkStackOverflow() const {
@@ -55,13 +83,289 @@ void VirtualMachine::checkStackUnderflow() const {
   }
 }
 
+namespace {
+
+/**
+ * ADD on two values: int sum or string concatenation
+ */
+Value add(const Value &a, const Value &b) {
+  if (a.isInt() && b.isInt()) {
+    return Value(a.asInt() + b.asInt());
+  } else if (a.isString() && b.isString()) {
+    return Value(a.asString() + b.asString());
+  }
+  throw VMError("Type mismatch for ADD");
+}
+
+} // namespace
+
+size_t VirtualMachine::memoSlot(const std::vector<int32_t> &args) {
+  uint64_t hash = 1469598103934665603ULL; // FNV-1a over the argument words
+  for (int32_t arg : args) {
+    hash = (hash ^ static_cast<uint32_t>(arg)) * 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash % MEMO_TABLE_SIZE);
+}
+
+VirtualMachine::MemoEntry *
+VirtualMachine::findMemoEntry(const BytecodeProgram &program,
+                              uint16_t funcIndex) {
+  if (memo_[funcIndex].empty()) {
+    return nullptr;
+  }
+  uint8_t arity = program.functions[funcIndex].arity;
+  if (stack_.size() < arity) {
+    throw VMError("Stack underflow");
+  }
+  std::vector<int32_t> args;
+  args.reserve(arity);
+  for (size_t i = stack_.size() - arity; i < stack_.size(); ++i) {
+    if (!stack_[i].isInt()) {
+      return nullptr;
+    }
+    args.push_back(stack_[i].asInt());
+  }
+  MemoEntry *entry = &memo_[funcIndex][memoSlot(args)];
+  memoArgs_.push_back(std::move(args));
+  return entry;
+}
+
+// ============================================================================
+// Parallel Loops
+// ============================================================================
+
+size_t VirtualMachine::threadCount() const {
+  return threads_ ? threads_
+                  : std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+void VirtualMachine::runParallel(const BytecodeProgram &program,
+                                 uint16_t loopIndex, uint16_t basePointer) {
+  const ParallelLoop &loop = program.parallelLoops[loopIndex];
+  size_t threads = threadCount();
+  if (!pool_ || pool_->size() != threads) {
+    pool_ = std::make_unique<WorkerPool>(threads);
+  }
+  while (workers_.size() < threads) {
+    workers_.push_back(std::make_unique<VirtualMachine>());
+  }
+
+  // A few chunks per worker, claimed from a shared counter, even out
+  // iterations of uneven cost
+  int64_t start = locals_[basePointer + loop.indexSlot].asInt();
+  int64_t count = locals_[basePointer + loop.indexSlot + 1].asInt() - start;
+  auto chunks = static_cast<size_t>(std::min<int64_t>(
+      count, static_cast<int64_t>(threads * kChunksPerWorker)));
+  auto bound = [&](size_t chunk) {
+    return static_cast<int32_t>(start + count * static_cast<int64_t>(chunk) /
+                                            static_cast<int64_t>(chunks));
+  };
+
+  struct Chunk {
+    std::ostringstream output;
+    std::vector<Value> values;
+    std::vector<Value> reductions;
+    std::exception_ptr error;
+  };
+  std::vector<Chunk> results(chunks);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+
+  uint16_t frameSize =
+      callStack_.empty()
+          ? program.mainLocalCount
+          : program.functions[callStack_.back().funcIndex].localCount;
+  std::vector<Value> initial;
+  for (const auto &reduction : loop.reductions) {
+    if (static_cast<size_t>(basePointer) + reduction.slot >= locals_.size()) {
+      throw VMError("Invalid local variable index");
+    }
+    initial.push_back(locals_[basePointer + reduction.slot]);
+  }
+
+  pool_->run([&](size_t worker) {
+    VirtualMachine &vm = *workers_[worker];
+    vm.beginWorker(*this, program, basePointer, frameSize, loopIndex);
+    size_t chunk;
+    while (!failed && (chunk = next++) < chunks) {
+      Chunk &result = results[chunk];
+      try {
+        result.reductions = vm.runChunk(program, loop, initial, bound(chunk),
+                                        bound(chunk + 1), result.output);
+        result.values = std::move(vm.outputValues_);
+      } catch (...) {
+        result.error = std::current_exception();
+        failed = true;
+      }
+    }
+  });
+
+  // Each worker could spend the whole remaining budget; charge what they
+  // spent together, so a limit stops the program at the end of the loop
+  // at the latest
+  uint64_t spent = 0;
+  for (size_t i = 0; i < threads; ++i) {
+    spent += workers_[i]->budgetStart_ - workers_[i]->budget_;
+  }
+  budget_ = spent < budget_ ? budget_ - spent : 0;
+
+  // Chunks finish in any order but are merged in iteration order, so output
+  // and reductions come out as if the loop ran serially
+  for (Chunk &result : results) {
+    writeOutput(result.output.str());
+    outputValues_.insert(outputValues_.end(), result.values.begin(),
+                         result.values.end());
+    if (result.error) {
+      std::rethrow_exception(result.error);
+    }
+    for (size_t i = 0; i < loop.reductions.size(); ++i) {
+      Value &total = locals_[basePointer + loop.reductions[i].slot];
+      const Value &part = result.reductions[i];
+      if (loop.reductions[i].op == Reduction::Operator::SUM) {
+        total = add(total, part);
+        continue;
+      }
+      if (!total.isInt() || !part.isInt()) {
+        throw VMError("Type error in comparison");
+      }
+      total = loop.reductions[i].op == Reduction::Operator::MIN
+                  ? std::min(total.asInt(), part.asInt())
+                  : std::max(total.asInt(), part.asInt());
+    }
+  }
+}
+
+void VirtualMachine::beginWorker(const VirtualMachine &parent,
+                                 const BytecodeProgram &program,
+                                 uint16_t basePointer, uint16_t frameSize,
+                                 uint16_t loopIndex) {
+  // The parent's frame is copied to the bottom; calls made from the body
+  // need the caller's frame size, which a copy of its call frame provides
+  stack_.clear();
+  callStack_.clear();
+  if (!parent.callStack_.empty()) {
+    callStack_.push_back(parent.callStack_.back());
+  }
+  workerDepth_ = callStack_.size();
+  workerLoop_ = loopIndex;
+  budget_ = parent.budget_;
+  budgetStart_ = budget_;
+  outputLeft_ = parent.outputLeft_;
+  locals_.assign(MAX_VARIABLES, Value(0));
+  std::copy_n(parent.locals_.begin() + basePointer, frameSize,
+              locals_.begin());
+  memo_.assign(program.functions.size(), {});
+  memoArgs_.clear();
+}
+
+std::vector<Value> VirtualMachine::runChunk(const BytecodeProgram &program,
+                                            const ParallelLoop &loop,
+                                            const std::vector<Value> &initial,
+                                            int32_t from, int32_t to,
+                                            std::ostream &output) {
+  // Sums start from nothing; min and max can start from the current value
+  for (size_t i = 0; i < loop.reductions.size(); ++i) {
+    bool sum = loop.reductions[i].op == Reduction::Operator::SUM;
+    locals_[loop.reductions[i].slot] =
+        !sum ? initial[i]
+             : initial[i].isString() ? Value(std::string()) : Value(0);
+  }
+  locals_[loop.indexSlot] = Value(from);
+  locals_[loop.indexSlot + 1] = Value(to);
+  output_ = &output;
+  outputValues_.clear();
+  run(program, loop.bodyStart, 0, nullptr, nullptr);
+
+  std::vector<Value> parts;
+  for (const auto &reduction : loop.reductions) {
+    parts.push_back(locals_[reduction.slot]);
+  }
+  return parts;
+}
+
+void VirtualMachine::setJitEnabled(bool enabled) {
+  if (!enabled) {
+    jit_.reset();
+  } else if (!jit_) {
+    jit_ = std::make_unique<TraceJit>();
+  }
+}
+
 // ============================================================================
 // Main Execution Loop
 // ============================================================================
 
 Value VirtualMachine::execute(const BytecodeProgram &program,
                               Profiler *profiler, bool keepState) {
-  // Reset state
+  reset(program, keepState);
+  suspended_ = nullptr;
+
+  // Traces are only valid for the program they were recorded from
+  TraceJit *jit = profiler ? nullptr : jit_.get();
+  if (jit) {
+    jit->reset();
+  }
+
+  // Start execution at main entry point
+  return run(program, program.mainEntry, 0, profiler, jit);
+}
+
+void VirtualMachine::start(const BytecodeProgram &program) {
+  reset(program, false);
+  suspended_ = &program;
+  resumeIp_ = program.mainEntry;
+  resumeBase_ = 0;
+  result_ = Value();
+}
+
+bool VirtualMachine::resume(uint64_t safepoints) {
+  if (!suspended_) {
+    throw VMError("No program to resume");
+  }
+
+  // Sliced runs stay in the interpreter, so every loop reaches a safepoint
+  safepoints_ = std::max<uint64_t>(safepoints, 1);
+  yielded_ = false;
+  Value result;
+  try {
+    result = run(*suspended_, resumeIp_, resumeBase_, nullptr, nullptr);
+  } catch (...) {
+    suspended_ = nullptr;
+    safepoints_ = UINT64_MAX;
+    throw;
+  }
+  safepoints_ = UINT64_MAX;
+  if (yielded_) {
+    return false;
+  }
+  suspended_ = nullptr;
+  result_ = std::move(result);
+  return true;
+}
+
+Value VirtualMachine::suspend(uint16_t ip, uint16_t basePointer) {
+  resumeIp_ = ip;
+  resumeBase_ = basePointer;
+  yielded_ = true;
+  return Value();
+}
+
+std::vector<Value> VirtualMachine::getLocals(size_t count) const {
+  count = std::min(count, locals_.size());
+  return std::vector<Value>(locals_.begin(), locals_.begin() + count);
+}
+
+void VirtualMachine::setLocals(const std::vector<Value> &values) {
+  if (values.size() > MAX_VARIABLES) {
+    throw VMError("Too many locals: " + std::to_string(values.size()));
+  }
+  if (locals_.size() < MAX_VARIABLES) {
+    locals_.resize(MAX_VARIABLES, Value(0));
+  }
+  std::copy(values.begin(), values.end(), locals_.begin());
+}
+
+void VirtualMachine::reset(const BytecodeProgram &program, bool keepState) {
   stack_.clear();
   callStack_.clear();
   outputValues_.clear();
@@ -78,20 +382,43 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
     }
   }
 
-  // Start execution at main entry point
-  uint16_t ip = program.mainEntry;
-  uint16_t basePointer = 0;
+  budget_ = instructionLimit_ ? instructionLimit_ : UINT64_MAX;
+  budgetStart_ = budget_;
+  outputLeft_ = outputLimit_ ? outputLimit_ : SIZE_MAX;
+
+  // Memo tables only hold results of this program's functions
+  memo_.assign(program.functions.size(), {});
+  memoArgs_.clear();
+  memoHits_ = 0;
+  for (size_t i = 0; i < program.functions.size(); ++i) {
+    if (memoized_.count(program.functions[i].name)) {
+      memo_[i].resize(MEMO_TABLE_SIZE);
+    }
+  }
+}
 
+Value VirtualMachine::run(const BytecodeProgram &program, uint16_t ip,
+                          uint16_t basePointer, Profiler *profiler,
+                          TraceJit *jit) {
   while (ip < program.code.size()) {
     const Instruction &instr = program.code[ip];
     Opcode op = static_cast<Opcode>(instr.opcode);
     uint16_t operand = instr.operand;
 
+    if (budget_-- == 0) {
+      budget_ = 0;
+      throw VMError("Instruction limit exceeded");
+    }
+
     // Profile if enabled
     if (profiler) {
       profiler->onExecute(op);
     }
 
+    if (jit && jit->isRecording()) {
+      jit->record(program, ip, stack_, locals_, basePointer);
+    }
+
     switch (op) {
     case Opcode::CONST: {
       // Push constant value onto stack
@@ -129,13 +456,19 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
     case Opcode::ADD: {
       Value b = pop();
       Value a = pop();
-      if (a.isInt() && b.isInt()) {
-        push(Value(a.asInt() + b.asInt()));
-      } else if (a.isString() && b.isString()) {
-        push(Value(a.asString() + b.asString()));
-      } else {
-        throw VMError("Type mismatch for ADD");
+      push(add(a, b));
+      ++ip;
+      break;
+    }
+
+    case Opcode::LOCAL_INC: {
+      // Fused LOAD, ADD, STORE for `x = x + value`
+      Value value = pop();
+      uint16_t slot = basePointer + operand;
+      if (slot >= locals_.size()) {
+        throw VMError("Invalid local variable index");
       }
+      locals_[slot] = add(locals_[slot], value);
       ++ip;
       break;
     }
@@ -148,6 +481,18 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       break;
     }
 
+    case Opcode::LOCAL_DEC: {
+      // Fused LOAD, SUB, STORE for `x = x - value`
+      Value value = pop();
+      uint16_t slot = basePointer + operand;
+      if (slot >= locals_.size()) {
+        throw VMError("Invalid local variable index");
+      }
+      locals_[slot] = Value(locals_[slot].asInt() - value.asInt());
+      ++ip;
+      break;
+    }
+
     case Opcode::MUL: {
       Value b = pop();
       Value a = pop();
@@ -162,7 +507,7 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       if (b.asInt() == 0) {
         throw VMError("Division by zero");
       }
-      push(Value(a.asInt() / b.asInt()));
+      push(Value(wrapDivide(a.asInt(), b.asInt())));
       ++ip;
       break;
     }
@@ -173,21 +518,112 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       if (b.asInt() == 0) {
         throw VMError("Modulo by zero");
       }
-      push(Value(a.asInt() % b.asInt()));
+      push(Value(wrapModulo(a.asInt(), b.asInt())));
+      ++ip;
+      break;
+    }
+
+    case Opcode::SHL: {
+      if (operand > MAX_SHIFT) {
+        throw VMError("Invalid shift amount");
+      }
+      Value a = pop();
+      push(Value(shiftLeft(a.asInt(), operand)));
+      ++ip;
+      break;
+    }
+
+    case Opcode::SHR: {
+      if (operand > MAX_SHIFT) {
+        throw VMError("Invalid shift amount");
+      }
+      Value a = pop();
+      push(Value(shiftRight(a.asInt(), operand)));
+      ++ip;
+      break;
+    }
+
+    case Opcode::MASK: {
+      if (operand > MAX_SHIFT) {
+        throw VMError("Invalid shift amount");
+      }
+      Value a = pop();
+      push(Value(maskLow(a.asInt(), operand)));
       ++ip;
       break;
     }
 
     case Opcode::JUMP: {
+      // Backward jumps close loops: run the compiled trace if there is one
+      if (jit && operand <= ip) {
+        if (const Trace *trace = jit->traceFor(operand)) {
+          ip = jit->run(*trace, stack_, locals_, basePointer, budget_);
+          break;
+        }
+        jit->onBackwardJump(operand);
+      }
+      if (profiler) {
+        profiler->onBranch(ip, true);
+      }
+      if (operand <= ip && --safepoints_ == 0) {
+        return suspend(operand, basePointer);
+      }
       // Unconditional jump
       ip = operand;
       break;
     }
 
+    case Opcode::JUMP_IF_NOT_ZERO: {
+      // Conditional jump unless top of stack is zero; closes rotated loops
+      Value value = pop();
+      bool jump = !value.isInt() || value.asInt() != 0;
+      if (profiler) {
+        profiler->onBranch(ip, jump);
+      }
+      if (!jump) {
+        ++ip;
+        break;
+      }
+      if (jit && operand <= ip) {
+        if (const Trace *trace = jit->traceFor(operand)) {
+          ip = jit->run(*trace, stack_, locals_, basePointer, budget_);
+          break;
+        }
+        jit->onBackwardJump(operand);
+      }
+      if (operand <= ip && --safepoints_ == 0) {
+        return suspend(operand, basePointer);
+      }
+      ip = operand;
+      break;
+    }
+
+    case Opcode::TABLE_SWITCH: {
+      // Index the dense table directly; other values take the default
+      const SwitchTable &table = program.switchTables[operand];
+      Value value = pop();
+      int64_t offset = value.isInt() ? static_cast<int64_t>(value.asInt()) -
+                                           table.low
+                                     : -1;
+      ip = offset >= 0 && offset < static_cast<int64_t>(table.targets.size())
+               ? table.targets[static_cast<size_t>(offset)]
+               : table.defaultTarget;
+      break;
+    }
+
+    case Opcode::LOOKUP_SWITCH: {
+      ip = program.switchTables[operand].targetFor(pop());
+      break;
+    }
+
     case Opcode::JUMP_IF_ZERO: {
       // Conditional jump if top of stack is zero
       Value value = pop();
-      if (value.isInt() && value.asInt() == 0) {
+      bool jump = value.isInt() && value.asInt() == 0;
+      if (profiler) {
+        profiler->onBranch(ip, jump);
+      }
+      if (jump) {
         ip = operand;
       } else {
         ++ip;
@@ -200,28 +636,62 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       if (operand >= program.functions.size()) {
         throw VMError("Invalid function index");
       }
+      if (profiler) {
+        profiler->onCall(operand);
+      }
+
+      // Generate the body on first call; this appends to program.code
+      if (program.functions[operand].entry == LAZY_FUNCTION_ENTRY) {
+        if (!lazy_) {
+          throw VMError("Function not compiled: " +
+                        program.functions[operand].name);
+        }
+        lazy_->compile(operand);
+      }
 
       const FunctionInfo &fn = program.functions[operand];
 
+      // Answer a repeated call of a memoized function from its table
+      MemoEntry *memo = findMemoEntry(program, operand);
+      if (memo && memo->used && memo->args == memoArgs_.back()) {
+        memoArgs_.pop_back();
+        stack_.resize(stack_.size() - fn.arity);
+        push(memo->result);
+        ++memoHits_;
+        ++ip;
+        break;
+      }
+
+      // The callee's frame starts right after the caller's slots
+      uint16_t callerLocals =
+          callStack_.empty()
+              ? program.mainLocalCount
+              : program.functions[callStack_.back().funcIndex].localCount;
+      size_t newBase = static_cast<size_t>(basePointer) + callerLocals;
+      if (newBase + std::max<size_t>(fn.localCount, fn.arity) >
+          locals_.size()) {
+        throw VMError("Call stack overflow");
+      }
+
       // Save current frame
       CallFrame frame;
       frame.ip = ip + 1; // Return to instruction after CALL
       frame.basePointer = basePointer;
       frame.funcIndex = operand;
+      frame.memoize = memo != nullptr;
       callStack_.push_back(frame);
 
-      // Set up new frame
-      uint16_t newBase =
-          static_cast<uint16_t>(basePointer + fn.localCount + 16); // Some room
-
       // Pop arguments and place in new frame's locals
       for (int i = fn.arity - 1; i >= 0; --i) {
         Value arg = pop();
         locals_[newBase + i] = arg;
       }
 
-      basePointer = newBase;
+      basePointer = static_cast<uint16_t>(newBase);
       ip = fn.entry;
+      if (--safepoints_ == 0) {
+        return suspend(ip, basePointer);
+      }
       break;
     }
 
@@ -238,6 +708,17 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       CallFrame frame = callStack_.back();
       callStack_.pop_back();
 
+      // Arrays are shared by reference, so only values can be replayed
+      if (frame.memoize) {
+        if (returnValue.isInt() || returnValue.isString()) {
+          MemoEntry &entry = memo_[frame.funcIndex][memoSlot(memoArgs_.back())];
+          entry.args = std::move(memoArgs_.back());
+          entry.result = returnValue;
+          entry.used = true;
+        }
+        memoArgs_.pop_back();
+      }
+
       ip = frame.ip;
       basePointer = frame.basePointer;
 
@@ -249,8 +730,16 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
     case Opcode::PRINT: {
       // Print top of stack
       Value value = pop();
-      printValue(value, *output_);
-      *output_ << std::endl;
+      if (outputLeft_ == SIZE_MAX && !value.isArray()) {
+        printValue(value, *output_);
+        *output_ << std::endl;
+      } else {
+        // Arrays are formatted first, so a failed print writes nothing
+        std::ostringstream line;
+        printValue(value, line);
+        line << '\n';
+        writeOutput(line.str());
+      }
       outputValues_.push_back(value);
       ++ip;
       break;
@@ -365,12 +854,113 @@ Value VirtualMachine::execute(const BytecodeProgram &program,
       break;
     }
 
+    case Opcode::ARRAY_ADD_STORE: {
+      // Add to an element in place, evaluating array and index once
+      Value value = pop();
+      Value index = pop();
+      Value array = pop();
+      if (!array.isArray()) {
+        throw VMError("Runtime Error: Expected array for assignment");
+      }
+      if (!index.isInt()) {
+        throw VMError("Runtime Error: Array index must be an integer");
+      }
+      auto &vec = *array.asArray();
+      int idx = index.asInt();
+      if (idx < 0 || static_cast<size_t>(idx) >= vec.size()) {
+        throw VMError("Runtime Error: Array index out of bounds");
+      }
+      vec[idx] = add(vec[idx], value);
+      ++ip;
+      break;
+    }
+
+    case Opcode::ITER_NEXT: {
+      // Locals operand..operand+2 hold the array, the next index and the
+      // element; push whether there was one. The index is in range by
+      // construction, so the element needs no bounds check
+      uint16_t slot = basePointer + operand;
+      if (static_cast<size_t>(slot) + 2 >= locals_.size()) {
+        throw VMError("Invalid local variable index");
+      }
+      if (!locals_[slot].isArray()) {
+        throw VMError("Runtime Error: Expected array for iteration");
+      }
+      const auto &vec = *std::get<ArrayPtr>(locals_[slot].data);
+      int32_t next = std::get<int32_t>(locals_[slot + 1].data);
+      bool more = static_cast<size_t>(next) < vec.size();
+      if (more) {
+        locals_[slot + 2] = vec[next];
+        locals_[slot + 1] = Value(next + 1);
+      }
+      push(Value(more ? 1 : 0));
+      ++ip;
+      break;
+    }
+
+    case Opcode::PARALLEL_FOR: {
+      // Skip an empty range, and run iterations in this thread if workers
+      // cannot (profiling, lazy compilation) or if this is a worker already
+      const ParallelLoop &loop = program.parallelLoops[operand];
+      uint16_t slot = basePointer + loop.indexSlot;
+      if (static_cast<size_t>(slot) + 1 >= locals_.size()) {
+        throw VMError("Invalid local variable index");
+      }
+      if (!locals_[slot].isInt() || !locals_[slot + 1].isInt()) {
+        throw VMError("Type error in comparison");
+      }
+      if (locals_[slot].asInt() >= locals_[slot + 1].asInt()) {
+        ip = loop.exit;
+      } else if (profiler || lazy_ || suspended_ || workerLoop_ >= 0 ||
+                 threadCount() == 1) {
+        ++ip;
+      } else {
+        runParallel(program, operand, basePointer);
+        ip = loop.exit;
+      }
+      break;
+    }
+
+    case Opcode::PARALLEL_NEXT: {
+      // The loop variable is an int the body cannot assign
+      const ParallelLoop &loop = program.parallelLoops[operand];
+      uint16_t slot = basePointer + loop.indexSlot;
+      if (static_cast<size_t>(slot) + 1 >= locals_.size()) {
+        throw VMError("Invalid local variable index");
+      }
+      int32_t next = std::get<int32_t>(locals_[slot].data) + 1;
+      locals_[slot] = Value(next);
+      if (next < std::get<int32_t>(locals_[slot + 1].data)) {
+        ip = loop.bodyStart;
+        if (--safepoints_ == 0) {
+          return suspend(ip, basePointer);
+        }
+      } else if (operand == workerLoop_ && callStack_.size() == workerDepth_) {
+        return Value(); // End of a worker's chunk
+      } else {
+        ++ip;
+      }
+      break;
+    }
+
     case Opcode::POP: {
       pop();
       ++ip;
       break;
     }
 
+    case Opcode::DUP2: {
+      if (stack_.size() < 2) {
+        throw VMError("Stack underflow");
+      }
+      Value a = stack_[stack_.size() - 2];
+      Value b = stack_.back();
+      push(std::move(a));
+      push(std::move(b));
+      ++ip;
+      break;
+    }
+
     default:
       throw VMError("Unknown opcode: " + std::to_string(instr.opcode));
     }
@@ -0,0 +1,70 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t size) {
+  for (size_t i = 1; i < size; ++i) {
+    threads_.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(const std::function<void(size_t)> &task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    running_ = threads_.size();
+    error_ = nullptr;
+    ++generation_;
+  }
+  start_.notify_all();
+
+  perform(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return running_ == 0; });
+  task_ = nullptr;
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void WorkerPool::workerLoop(size_t worker) {
+  size_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+    }
+
+    perform(worker);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--running_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::perform(size_t worker) {
+  try {
+    (*task_)(worker);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+}
@@ -50,6 +50,22 @@ TEST_F(ArrayTest, ArrayAssignment) {
   EXPECT_EQ(output, "1\n50\n3\n");
 }
 
+TEST_F(ArrayTest, CompoundElementUpdates) {
+  std::string source = R"(
+    let arr = [1, 2, 3];
+    let i = 0;
+    arr[i] += 10;
+    arr[i + 1] -= 5;
+    arr[2] *= 4;
+    arr[2]++;
+    arr[1]--;
+    arr[0] = arr[0] + arr[2];
+    print(arr);
+  )";
+  std::string output = TestUtils::compileAndRun(source);
+  EXPECT_EQ(output, "[24, -4, 13]\n");
+}
+
 TEST_F(ArrayTest, NestedArrays) {
   std::string source = R"(
     let matrix = [[1, 2], [3, 4]];
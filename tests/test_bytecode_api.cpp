@@ -0,0 +1,228 @@
+#include "bytecode_api.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+class BytecodeApiTest : public ::testing::Test {
+protected:
+  bc_program *compile(const std::string &source) {
+    return bc_compile(source.data(), source.size(), nullptr);
+  }
+};
+
+TEST_F(BytecodeApiTest, CompilesAndRunsInProcess) {
+  bc_program *program = compile(R"(fn square(n) {
+  return n * n;
+}
+let s = 0;
+for (let i = 0; i < 10; i = i + 1) {
+  s = s + square(i % 3);
+}
+print(s);
+)");
+  ASSERT_NE(program, nullptr);
+  EXPECT_EQ(bc_program_error(program), nullptr);
+
+  bc_exec_options options;
+  bc_exec_options_init(&options);
+  options.profile = 1;
+  options.memoize = 1;
+  // The same handle runs any number of times
+  for (int i = 0; i < 2; ++i) {
+    bc_run *run = bc_execute(program, &options);
+    ASSERT_NE(run, nullptr);
+    size_t length = 0;
+    const char *output = bc_run_output(run, &length);
+    EXPECT_EQ(std::string(output, length), "15\n");
+    EXPECT_EQ(bc_run_error(run), nullptr);
+
+    bc_stats stats;
+    bc_stats_init(&stats);
+    bc_run_stats(run, &stats);
+    EXPECT_GT(stats.instructions, 0u);
+    EXPECT_EQ(stats.calls, 10u);
+    EXPECT_EQ(stats.memo_hits, 7u);
+    EXPECT_GE(stats.compile_ms, 0.0);
+    bc_run_free(run);
+  }
+  bc_program_free(program);
+}
+
+TEST_F(BytecodeApiTest, ReportsCompileErrors) {
+  bc_program *program = compile("let x = ;\n");
+  ASSERT_NE(program, nullptr);
+  ASSERT_NE(bc_program_error(program), nullptr);
+  EXPECT_NE(std::strstr(bc_program_error(program), "Parser error"), nullptr);
+  EXPECT_EQ(bc_execute(program, nullptr), nullptr);
+  bc_program_free(program);
+}
+
+TEST_F(BytecodeApiTest, ReportsRunErrorsWithOutputSoFar) {
+  bc_program *program = compile("print(1);\nwhile (1 == 1) {\n}\n");
+  bc_exec_options options;
+  bc_exec_options_init(&options);
+  options.instruction_limit = 1000;
+  bc_run *run = bc_execute(program, &options);
+  ASSERT_NE(run, nullptr);
+  EXPECT_STREQ(bc_run_output(run, nullptr), "1\n");
+  ASSERT_NE(bc_run_error(run), nullptr);
+  EXPECT_NE(std::strstr(bc_run_error(run), "Instruction limit"), nullptr);
+  bc_run_free(run);
+  bc_program_free(program);
+}
+
+TEST_F(BytecodeApiTest, InstructionLimitKeepsJitAndParallelLoops) {
+  bc_exec_options options;
+  bc_exec_options_init(&options);
+  options.instruction_limit = 200000;
+
+  // A traced loop and loops on parallel workers both reach the limit
+  options.jit = 1;
+  options.threads = 4;
+  for (const char *source :
+       {"let x = 0;\nwhile (1 == 1) {\n  x = x + 1;\n}\n",
+        "parallel for (i = 0; i < 8; i++) {\n  let x = 0;\n"
+        "  while (1 == 1) {\n    x = x + i;\n  }\n}\n"}) {
+    bc_program *program = compile(source);
+    bc_run *run = bc_execute(program, &options);
+    ASSERT_NE(run, nullptr);
+    ASSERT_NE(bc_run_error(run), nullptr) << source;
+    EXPECT_NE(std::strstr(bc_run_error(run), "Instruction limit"), nullptr);
+    bc_run_free(run);
+    bc_program_free(program);
+  }
+
+  // Without a profiler the count is still exact and calls stay unknown
+  bc_program *program =
+      compile("fn f(n) { return n + 1; }\nlet s = 0;\n"
+              "for (let i = 0; i < 50; i = i + 1) {\n  s = s + f(i);\n}\n");
+  options.jit = 0;
+  bc_stats plain;
+  bc_stats profiled;
+  bc_stats_init(&plain);
+  bc_stats_init(&profiled);
+  bc_run *run = bc_execute(program, &options);
+  bc_run_stats(run, &plain);
+  bc_run_free(run);
+  options.profile = 1;
+  run = bc_execute(program, &options);
+  bc_run_stats(run, &profiled);
+  bc_run_free(run);
+  bc_program_free(program);
+  EXPECT_GT(plain.instructions, 0u);
+  EXPECT_EQ(plain.instructions, profiled.instructions);
+  EXPECT_EQ(plain.calls, 0u);
+  EXPECT_EQ(profiled.calls, 50u);
+}
+
+TEST_F(BytecodeApiTest, OutputLimitStopsTheRun) {
+  bc_exec_options options;
+  bc_exec_options_init(&options);
+  options.max_output = 10;
+  options.threads = 4;
+
+  // Serial and parallel printing stop at the cap with the part that fits
+  for (const char *source :
+       {"while (1 == 1) {\n  print(\"abc\");\n}\n",
+        "parallel for (i = 0; i < 100000; i++) {\n  print(\"abc\");\n}\n"}) {
+    bc_program *program = compile(source);
+    bc_run *run = bc_execute(program, &options);
+    ASSERT_NE(run, nullptr);
+    ASSERT_NE(bc_run_error(run), nullptr) << source;
+    EXPECT_NE(std::strstr(bc_run_error(run), "Output limit exceeded"),
+              nullptr);
+    size_t length = 0;
+    EXPECT_EQ(std::string(bc_run_output(run, &length)), "abc\nabc\nab");
+    bc_run_free(run);
+    bc_program_free(program);
+  }
+
+  // Output that fits exactly is not an error
+  bc_program *program = compile("print(\"abcdefghi\");\n");
+  bc_run *run = bc_execute(program, &options);
+  EXPECT_EQ(bc_run_error(run), nullptr);
+  bc_run_free(run);
+  bc_program_free(program);
+}
+
+TEST_F(BytecodeApiTest, PrintingCyclicOrDeepArraysIsAnError) {
+  for (const char *source :
+       {"let a = [0];\nprint(1);\na[0] = a;\nprint(a);\n",
+        "let a = [0];\nprint(1);\nlet i = 0;\nwhile (i < 5000) {\n"
+        "  a = [a];\n  i = i + 1;\n}\nprint(a);\n"}) {
+    bc_program *program = compile(source);
+    bc_run *run = bc_execute(program, nullptr);
+    ASSERT_NE(run, nullptr);
+    ASSERT_NE(bc_run_error(run), nullptr) << source;
+    EXPECT_NE(std::strstr(bc_run_error(run), "print"), nullptr);
+    size_t length = 0;
+    EXPECT_EQ(std::string(bc_run_output(run, &length)), "1\n");
+    bc_run_free(run);
+    bc_program_free(program);
+  }
+}
+
+TEST_F(BytecodeApiTest, OptionsWithoutStructSizeAreRejected) {
+  bc_compile_options compileOptions;
+  bc_compile_options_init(&compileOptions);
+  EXPECT_EQ(compileOptions.struct_size, sizeof(bc_compile_options));
+  compileOptions.struct_size = 0;
+  bc_program *invalid = bc_compile("print(1);\n", 10, &compileOptions);
+  ASSERT_NE(invalid, nullptr);
+  ASSERT_NE(bc_program_error(invalid), nullptr);
+  EXPECT_NE(std::strstr(bc_program_error(invalid), "struct_size"), nullptr);
+  bc_program_free(invalid);
+
+  bc_program *program = compile("print(1);\n");
+  bc_exec_options options;
+  bc_exec_options_init(&options);
+  options.struct_size = sizeof(options.struct_size);
+  EXPECT_EQ(bc_execute(program, &options), nullptr);
+
+  // A host built against a larger struct still runs with what we know
+  struct {
+    bc_exec_options known;
+    uint64_t added;
+  } newer;
+  bc_exec_options_init(&newer.known);
+  newer.known.struct_size = sizeof(newer);
+  newer.added = 1;
+  bc_run *run = bc_execute(program, &newer.known);
+  ASSERT_NE(run, nullptr);
+  EXPECT_STREQ(bc_run_output(run, nullptr), "1\n");
+  bc_run_free(run);
+  bc_program_free(program);
+}
+
+TEST_F(BytecodeApiTest, StatsAreWrittenOnlyAsFarAsTheCallersStruct) {
+  bc_program *program = compile("print(1);\n");
+  bc_run *run = bc_execute(program, nullptr);
+  ASSERT_NE(run, nullptr);
+
+  bc_stats full;
+  bc_stats_init(&full);
+  bc_run_stats(run, &full);
+  EXPECT_EQ(full.struct_size, sizeof(bc_stats));
+  EXPECT_GT(full.instructions, 0u);
+
+  // Without init nothing is written
+  bc_stats unset{};
+  unset.instructions = 7;
+  bc_run_stats(run, &unset);
+  EXPECT_EQ(unset.instructions, 7u);
+
+  // A caller built against a larger struct keeps its own trailing fields
+  struct {
+    bc_stats known;
+    uint64_t added;
+  } newer;
+  bc_stats_init(&newer.known);
+  newer.known.struct_size = sizeof(newer);
+  newer.added = 42;
+  bc_run_stats(run, &newer.known);
+  EXPECT_EQ(newer.known.struct_size, sizeof(newer));
+  EXPECT_EQ(newer.known.instructions, full.instructions);
+  EXPECT_EQ(newer.added, 42u);
+  bc_run_free(run);
+  bc_program_free(program);
+}
@@ -0,0 +1,62 @@
+#include "callgraph.h"
+#include "lexer.h"
+#include "parser.h"
+#include <gtest/gtest.h>
+
+class CallGraphTest : public ::testing::Test {
+protected:
+  std::unique_ptr<Program> parse(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return parser.parseProgram();
+  }
+};
+
+TEST_F(CallGraphTest, TopLevelCallsAreRoots) {
+  auto program = parse("fn a() { return 1; } fn b() { return 2; } print(a());");
+  CallGraph graph(*program);
+
+  EXPECT_EQ(graph.topLevelCallees().count("a"), 1u);
+  EXPECT_TRUE(graph.isReachable("a"));
+  EXPECT_FALSE(graph.isReachable("b"));
+}
+
+TEST_F(CallGraphTest, FollowsTransitiveCalls) {
+  auto program = parse(R"(
+    fn leaf(x) { return x; }
+    fn mid(x) { let y = [leaf(x)]; return y[0]; }
+    fn top(x) { for (let i = 0; i < mid(x); i = i + 1) { x = x + 1; } return x; }
+    let r = top(1);
+  )");
+  CallGraph graph(*program);
+
+  EXPECT_EQ(graph.reachable().size(), 3u);
+  EXPECT_EQ(graph.callees("top").count("mid"), 1u);
+  EXPECT_EQ(graph.callees("mid").count("leaf"), 1u);
+  EXPECT_TRUE(graph.callees("leaf").empty());
+}
+
+TEST_F(CallGraphTest, DetectsDirectAndMutualRecursion) {
+  auto program = parse(R"(
+    fn fact(n) { if (n < 2) { return 1; } return n * fact(n - 1); }
+    fn even(n) { if (n == 0) { return 1; } return odd(n - 1); }
+    fn odd(n) { if (n == 0) { return 0; } return even(n - 1); }
+    fn plain(n) { return n + 1; }
+    print(fact(5) + even(4) + plain(1));
+  )");
+  CallGraph graph(*program);
+
+  EXPECT_TRUE(graph.isRecursive("fact"));
+  EXPECT_TRUE(graph.isRecursive("even"));
+  EXPECT_TRUE(graph.isRecursive("odd"));
+  EXPECT_FALSE(graph.isRecursive("plain"));
+}
+
+TEST_F(CallGraphTest, UnknownCalleesAreNotReachableFunctions) {
+  auto program = parse("print(missing(1));");
+  CallGraph graph(*program);
+
+  EXPECT_EQ(graph.topLevelCallees().count("missing"), 1u);
+  EXPECT_FALSE(graph.isReachable("missing"));
+}
@@ -0,0 +1,152 @@
+#include "cbackend.h"
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "vm.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <unistd.h>
+
+class CBackendTest : public ::testing::Test {
+protected:
+  std::string emit(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parseProgram();
+    CodeGenerator codegen;
+    auto bytecode = codegen.generate(*program);
+    CBackend backend;
+    return backend.emit(bytecode);
+  }
+
+  static std::string readFile(const std::string &path) {
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+  }
+
+  // Build the emitted C++ with the configured compiler and return its stdout
+  static std::string compileAndRunNative(const std::string &cpp) {
+    std::string base =
+        "/tmp/bytecode_cbackend_test_" + std::to_string(::getpid());
+    {
+      std::ofstream out(base + ".cpp");
+      out << cpp;
+    }
+    std::string build = std::string(CBACKEND_TEST_CXX) + " -std=c++17 -O0 " +
+                        base + ".cpp -o " + base;
+    int status = std::system(build.c_str());
+    std::remove((base + ".cpp").c_str());
+    if (status != 0) {
+      ADD_FAILURE() << "Emitted C++ failed to compile";
+      return "";
+    }
+
+    std::string output;
+    if (FILE *pipe = ::popen(base.c_str(), "r")) {
+      char chunk[4096];
+      size_t n;
+      while ((n = std::fread(chunk, 1, sizeof(chunk), pipe)) > 0) {
+        output.append(chunk, n);
+      }
+      EXPECT_EQ(::pclose(pipe), 0);
+    }
+    std::remove(base.c_str());
+    return output;
+  }
+
+  BytecodeProgram makeProgram(std::vector<Instruction> code,
+                              std::vector<Value> constants = {}) {
+    BytecodeProgram prog;
+    prog.code = std::move(code);
+    prog.constants = std::move(constants);
+    prog.mainEntry = 0;
+    return prog;
+  }
+};
+
+TEST_F(CBackendTest, EmitsStandaloneTranslationUnit) {
+  auto source = emit("print(1 + 2);");
+
+  EXPECT_NE(source.find("int main()"), std::string::npos);
+  EXPECT_NE(source.find("namespace rt"), std::string::npos);
+  EXPECT_NE(source.find("rt::print"), std::string::npos);
+}
+
+TEST_F(CBackendTest, InlinesIntegerConstants) {
+  auto source = emit("print(42);");
+
+  EXPECT_NE(source.find("rt::Value::integer(42)"), std::string::npos);
+}
+
+TEST_F(CBackendTest, JumpsBecomeGotos) {
+  auto source = emit("let i = 0; while (i < 3) { i = i + 1; }");
+
+  EXPECT_NE(source.find("goto L"), std::string::npos);
+}
+
+TEST_F(CBackendTest, CallsGetReturnDispatch) {
+  auto source = emit("fn add(a, b) { return a + b; } print(add(1, 2));");
+
+  EXPECT_NE(source.find("frames.push_back"), std::string::npos);
+  EXPECT_NE(source.find("dispatch_return:"), std::string::npos);
+}
+
+TEST_F(CBackendTest, EscapesStringConstants) {
+  auto source = emit("print(\"C:\\tmp\");");
+
+  // Lexer keeps backslashes verbatim; each must be escaped in the output
+  EXPECT_NE(source.find("\"C:\\\\tmp\""), std::string::npos);
+}
+
+TEST_F(CBackendTest, RejectsUnknownOpcode) {
+  auto prog = makeProgram({{0xFF, 0}});
+  CBackend backend;
+  EXPECT_THROW(backend.emit(prog), CodegenError);
+}
+
+TEST_F(CBackendTest, CompiledSamplesMatchInterpreter) {
+  for (const char *sample :
+       {"benchmarks/factorial.src", "benchmarks/fib.src",
+        "benchmarks/sum_loop.src", "examples/comprehensive_demo.txt"}) {
+    SCOPED_TRACE(sample);
+    std::string source = readFile(std::string(SOURCE_DIR) + "/" + sample);
+    ASSERT_FALSE(source.empty());
+
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parseProgram();
+    CodeGenerator codegen;
+    auto bytecode = codegen.generate(*program);
+
+    VirtualMachine vm;
+    std::ostringstream expected;
+    vm.setOutputStream(expected);
+    vm.execute(bytecode);
+
+    EXPECT_EQ(compileAndRunNative(CBackend().emit(bytecode)), expected.str());
+  }
+}
+
+TEST_F(CBackendTest, DivisionOverflowWrapsLikeInterpreter) {
+  Lexer lexer("let a = 0 - 2147483647 - 1;\nlet b = 0 - 1;\n"
+              "print(a / b);\nprint(a % b);\n");
+  auto tokens = lexer.tokenize();
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  CodeGenerator codegen;
+  auto bytecode = codegen.generate(*program);
+
+  VirtualMachine vm;
+  std::ostringstream expected;
+  vm.setOutputStream(expected);
+  vm.execute(bytecode);
+  EXPECT_EQ(expected.str(), "-2147483648\n0\n");
+
+  EXPECT_EQ(compileAndRunNative(CBackend().emit(bytecode)), expected.str());
+}
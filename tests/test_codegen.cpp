@@ -1,7 +1,10 @@
 #include "codegen.h"
 #include "lexer.h"
 #include "parser.h"
+#include "vm.h"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <sstream>
 
 class CodeGenTest : public ::testing::Test {
 protected:
@@ -48,6 +51,24 @@ TEST_F(CodeGenTest, BinaryAddGeneratesAddOpcode) {
   EXPECT_TRUE(hasAdd);
 }
 
+TEST_F(CodeGenTest, PowerOfTwoArithmeticUsesShifts) {
+  auto bytecode = compile("let x = 5; print(x * 8); print(4 * x); "
+                          "print(x / 16); print(x % 2); print(x * 6);");
+
+  std::vector<std::pair<Opcode, uint16_t>> ops;
+  for (const auto &instr : bytecode.code) {
+    auto op = static_cast<Opcode>(instr.opcode);
+    if (op == Opcode::SHL || op == Opcode::SHR || op == Opcode::MASK ||
+        op == Opcode::MUL || op == Opcode::DIV || op == Opcode::MOD) {
+      ops.emplace_back(op, instr.operand);
+    }
+  }
+  std::vector<std::pair<Opcode, uint16_t>> expected = {
+      {Opcode::SHL, 3}, {Opcode::SHL, 2}, {Opcode::SHR, 4},
+      {Opcode::MASK, 1}, {Opcode::MUL, 0}};
+  EXPECT_EQ(ops, expected);
+}
+
 TEST_F(CodeGenTest, VariableAssignmentGeneratesStore) {
   auto bytecode = compile("let x = 5;");
 
@@ -97,19 +118,143 @@ TEST_F(CodeGenTest, IfStatementGeneratesJump) {
 TEST_F(CodeGenTest, WhileLoopGeneratesJumps) {
   auto bytecode = compile("let i = 0; while (i) { i = 0; }");
 
-  // Should have JUMP and JUMP_IF_ZERO
+  // Should enter with JUMP and loop back with JUMP_IF_NOT_ZERO
   bool hasJump = false;
-  bool hasJumpIfZero = false;
+  bool hasJumpIfNotZero = false;
   for (const auto &instr : bytecode.code) {
     if (static_cast<Opcode>(instr.opcode) == Opcode::JUMP) {
       hasJump = true;
     }
-    if (static_cast<Opcode>(instr.opcode) == Opcode::JUMP_IF_ZERO) {
-      hasJumpIfZero = true;
+    if (static_cast<Opcode>(instr.opcode) == Opcode::JUMP_IF_NOT_ZERO) {
+      hasJumpIfNotZero = true;
+      EXPECT_LT(instr.operand, &instr - bytecode.code.data());
     }
   }
   EXPECT_TRUE(hasJump);
-  EXPECT_TRUE(hasJumpIfZero);
+  EXPECT_TRUE(hasJumpIfNotZero);
+}
+
+TEST_F(CodeGenTest, LoopExitsAreLaidOutAfterTheLoop) {
+  auto bytecode = compile("fn find(a, n, x) {\n"
+                          "  let i = 0;\n"
+                          "  while (i < n) {\n"
+                          "    if (a[i] == x) { print(i); return i; }\n"
+                          "    i = i + 1;\n"
+                          "  }\n"
+                          "  return -1;\n"
+                          "}\n"
+                          "print(find([3, 5, 8], 3, 8));");
+
+  // The loop body holds no PRINT: the match is moved past the back edge
+  size_t backEdge = 0;
+  size_t print = 0;
+  for (size_t i = 0; i < bytecode.code.size(); ++i) {
+    auto op = static_cast<Opcode>(bytecode.code[i].opcode);
+    if (op == Opcode::JUMP_IF_NOT_ZERO && bytecode.code[i].operand < i) {
+      backEdge = i;
+    }
+    if (op == Opcode::PRINT && print == 0) {
+      print = i;
+    }
+  }
+  ASSERT_GT(backEdge, 0u);
+  EXPECT_GT(print, backEdge);
+
+  std::stringstream out;
+  VirtualMachine vm;
+  vm.setOutputStream(out);
+  vm.execute(bytecode);
+  EXPECT_EQ(out.str(), "2\n2\n");
+}
+
+TEST_F(CodeGenTest, SwitchUsesTableForDenseLabels) {
+  auto run = [](const BytecodeProgram &bytecode) {
+    std::stringstream out;
+    VirtualMachine vm;
+    vm.setOutputStream(out);
+    vm.execute(bytecode);
+    return out.str();
+  };
+  auto switchOp = [](const BytecodeProgram &bytecode) {
+    for (const auto &instr : bytecode.code) {
+      auto op = static_cast<Opcode>(instr.opcode);
+      if (op == Opcode::TABLE_SWITCH || op == Opcode::LOOKUP_SWITCH) {
+        return op;
+      }
+    }
+    return Opcode::JUMP;
+  };
+
+  auto dense = compile("for (let i = 0; i < 6; i = i + 1) {\n"
+                       "  switch (i) {\n"
+                       "    case 1, 2: print(\"low\");\n"
+                       "    case 4: print(\"four\");\n"
+                       "    default: print(i);\n"
+                       "  }\n"
+                       "}");
+  EXPECT_EQ(switchOp(dense), Opcode::TABLE_SWITCH);
+  ASSERT_EQ(dense.switchTables.size(), 1u);
+  EXPECT_EQ(dense.switchTables[0].low, 1);
+  EXPECT_EQ(dense.switchTables[0].targets.size(), 4u);
+  EXPECT_EQ(run(dense), "0\nlow\nlow\n3\nfour\n5\n");
+
+  auto sparse = compile("let s = 0;\n"
+                        "for (let i = 0; i < 3; i = i + 1) {\n"
+                        "  switch (i * 1000) { case 0: s = s + 1; "
+                        "case 2000: s = s + 10; }\n"
+                        "}\n"
+                        "switch (\"b\") { case \"a\": s = 0; case \"b\": "
+                        "s = s * 2; }\n"
+                        "print(s);");
+  EXPECT_EQ(switchOp(sparse), Opcode::LOOKUP_SWITCH);
+  EXPECT_EQ(run(sparse), "22\n");
+}
+
+TEST_F(CodeGenTest, CompoundAssignmentsUpdateInPlace) {
+  auto bytecode = compile("let n = 1; let h = [0, 0];\n"
+                          "for (let i = 0; i < 5; i++) {\n"
+                          "  n *= 3; n -= 1;\n"
+                          "  h[i % 2] += i;\n"
+                          "  h[1] = h[1] + 1;\n"
+                          "  h[0] -= 1;\n"
+                          "}\n"
+                          "print(n); print(h);");
+
+  int localIncs = 0;
+  int localDecs = 0;
+  int arrayAdds = 0;
+  int dups = 0;
+  for (const auto &instr : bytecode.code) {
+    auto op = static_cast<Opcode>(instr.opcode);
+    localIncs += op == Opcode::LOCAL_INC;
+    localDecs += op == Opcode::LOCAL_DEC;
+    arrayAdds += op == Opcode::ARRAY_ADD_STORE;
+    dups += op == Opcode::DUP2;
+  }
+  EXPECT_EQ(localIncs, 1); // i++
+  EXPECT_EQ(localDecs, 1); // n -= 1
+  EXPECT_EQ(arrayAdds, 2);
+  EXPECT_EQ(dups, 1);
+
+  std::stringstream out;
+  VirtualMachine vm;
+  vm.setOutputStream(out);
+  vm.execute(bytecode);
+  EXPECT_EQ(out.str(), "122\n[1, 9]\n");
+
+  // Subtracting from a non-int fails as SUB, as written
+  for (const char *source : {"let x = \"a\"; x = x - 1;",
+                             "let x = \"a\"; x -= 1;"}) {
+    auto failing = compile(source);
+    VirtualMachine strict;
+    try {
+      strict.execute(failing);
+      FAIL() << "Expected a type error: " << source;
+    } catch (const std::runtime_error &e) {
+      EXPECT_NE(std::string(e.what()).find("expected int"), std::string::npos)
+          << e.what();
+    }
+  }
 }
 
 // ============================================================================
@@ -149,3 +294,150 @@ TEST_F(CodeGenTest, ReturnGeneratesReturnOpcode) {
   }
   EXPECT_TRUE(hasReturn);
 }
+
+// ============================================================================
+// Lazy Function Generation Tests
+// ============================================================================
+
+class LazyCodeGenTest : public ::testing::Test {
+protected:
+  std::unique_ptr<Program> parse(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return parser.parseProgram();
+  }
+};
+
+TEST_F(LazyCodeGenTest, FunctionsStartAsStubs) {
+  auto ast = parse("fn a() { return 1; } fn b() { return 2; } print(a());");
+  LazyFunctionCompiler lazy(*ast);
+
+  ASSERT_EQ(lazy.program().functions.size(), static_cast<size_t>(2));
+  EXPECT_EQ(lazy.program().functions[0].entry, LAZY_FUNCTION_ENTRY);
+  EXPECT_EQ(lazy.program().functions[1].entry, LAZY_FUNCTION_ENTRY);
+  EXPECT_EQ(lazy.program().mainEntry, 0);
+}
+
+TEST_F(LazyCodeGenTest, OnlyCalledFunctionsAreGenerated) {
+  auto ast = parse(R"(
+    fn used(x) { return x * 2; }
+    fn unused(x) { return x + undefinedName; }
+    print(used(21));
+  )");
+  LazyFunctionCompiler lazy(*ast);
+
+  VirtualMachine vm;
+  std::stringstream out;
+  vm.setOutputStream(out);
+  vm.setLazyCompiler(&lazy);
+  vm.execute(lazy.program());
+
+  EXPECT_EQ(out.str(), "42\n");
+  EXPECT_EQ(lazy.compiledCount(), static_cast<size_t>(1));
+  EXPECT_NE(lazy.program().functions[0].entry, LAZY_FUNCTION_ENTRY);
+  EXPECT_EQ(lazy.program().functions[1].entry, LAZY_FUNCTION_ENTRY);
+}
+
+TEST_F(LazyCodeGenTest, RecursionAndNestedCallsMatchEagerOutput) {
+  std::string source = R"(
+    fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    fn twice(n) { return fib(n) + fib(n); }
+    let i = 0;
+    while (i < 8) { print(twice(i)); i = i + 1; }
+  )";
+
+  auto eagerAst = parse(source);
+  CodeGenerator codegen;
+  auto eager = codegen.generate(*eagerAst);
+  VirtualMachine eagerVm;
+  std::stringstream expected;
+  eagerVm.setOutputStream(expected);
+  eagerVm.execute(eager);
+
+  auto ast = parse(source);
+  LazyFunctionCompiler lazy(*ast);
+  VirtualMachine vm;
+  std::stringstream actual;
+  vm.setOutputStream(actual);
+  vm.setLazyCompiler(&lazy);
+  vm.execute(lazy.program());
+
+  EXPECT_EQ(actual.str(), expected.str());
+  EXPECT_EQ(lazy.compiledCount(), static_cast<size_t>(2));
+}
+
+TEST_F(LazyCodeGenTest, ErrorsSurfaceOnFirstCall) {
+  auto ast = parse("fn bad() { return missing; } print(1); bad();");
+  LazyFunctionCompiler lazy(*ast);
+
+  VirtualMachine vm;
+  std::stringstream out;
+  vm.setOutputStream(out);
+  vm.setLazyCompiler(&lazy);
+  EXPECT_THROW(vm.execute(lazy.program()), CodegenError);
+  EXPECT_EQ(out.str(), "1\n");
+}
+
+TEST_F(LazyCodeGenTest, StubWithoutCompilerIsRuntimeError) {
+  auto ast = parse("fn f() { return 1; } print(f());");
+  LazyFunctionCompiler lazy(*ast);
+
+  VirtualMachine vm;
+  std::stringstream out;
+  vm.setOutputStream(out);
+  EXPECT_THROW(vm.execute(lazy.program()), VMError);
+}
+
+TEST_F(LazyCodeGenTest, ProgramTooLargeFailsWithoutPartialCode) {
+  // Twenty functions of about 3600 instructions outgrow 16-bit operands
+  std::string source;
+  for (int f = 0; f < 20; ++f) {
+    source += "fn f" + std::to_string(f) + "(x, y) {";
+    for (int i = 0; i < 600; ++i) {
+      source += " x = x * y - x;";
+    }
+    source += " return x; }\n";
+  }
+  for (int f = 0; f < 20; ++f) {
+    source += "print(f" + std::to_string(f) + "(0, 1));\n";
+  }
+
+  auto eagerAst = parse(source);
+  CodeGenerator codegen;
+  try {
+    codegen.generate(*eagerAst);
+    FAIL() << "Expected CodegenError";
+  } catch (const CodegenError &e) {
+    EXPECT_NE(std::string(e.what()).find("Program too large"),
+              std::string::npos);
+  }
+
+  auto ast = parse(source);
+  LazyFunctionCompiler lazy(*ast);
+  VirtualMachine vm;
+  std::stringstream out;
+  vm.setOutputStream(out);
+  vm.setLazyCompiler(&lazy);
+  size_t compiledSize = 0;
+  try {
+    vm.execute(lazy.program());
+    FAIL() << "Expected CodegenError";
+  } catch (const CodegenError &e) {
+    EXPECT_NE(std::string(e.what()).find("Program too large"),
+              std::string::npos);
+    compiledSize = lazy.program().code.size();
+  }
+
+  // Every function that compiled printed; the one that did not left no
+  // code behind, so the program still ends with the last good body
+  std::string printedLines = out.str();
+  size_t printed = static_cast<size_t>(
+      std::count(printedLines.begin(), printedLines.end(), '\n'));
+  EXPECT_GT(printed, static_cast<size_t>(0));
+  EXPECT_EQ(lazy.compiledCount(), printed);
+  EXPECT_EQ(lazy.program().functions[printed].entry, LAZY_FUNCTION_ENTRY);
+  EXPECT_LT(compiledSize, static_cast<size_t>(LAZY_FUNCTION_ENTRY));
+  EXPECT_EQ(lazy.program().code.back().opcode,
+            static_cast<uint8_t>(Opcode::RETURN));
+}
@@ -2,8 +2,10 @@
 #include "common.h"
 #include "lexer.h"
 #include "parser.h"
+#include "profiler.h"
 #include "vm.h"
 #include <gtest/gtest.h>
+#include <sstream>
 
 class ControlFlowTest : public ::testing::Test {
 protected:
@@ -157,3 +159,136 @@ TEST_F(ControlFlowTest, NestedLoops) {
   EXPECT_EQ(output[1].asInt(), 10);
   EXPECT_EQ(output[2].asInt(), 20);
 }
+
+TEST_F(ControlFlowTest, ForInLoop) {
+  // Nested loops each keep their own iterator; an existing variable keeps
+  // the element it had when the loop left
+  std::string source = R"(
+      let x = 0;
+      for (x in [1, 2, 3, 4, 5]) {
+        if (x == 2) { continue; }
+        if (x == 4) { break; }
+        for (y in [10, 20]) {
+          print(x * y);
+        }
+      }
+      print(x);
+  )";
+
+  auto output = getOutput(source);
+  ASSERT_EQ(output.size(), 5);
+  EXPECT_EQ(output[0].asInt(), 10);
+  EXPECT_EQ(output[1].asInt(), 20);
+  EXPECT_EQ(output[2].asInt(), 30);
+  EXPECT_EQ(output[3].asInt(), 60);
+  EXPECT_EQ(output[4].asInt(), 4);
+}
+
+TEST_F(ControlFlowTest, ForInRequiresArray) {
+  EXPECT_THROW(run("for (x in 5) { print(x); }"), VMError);
+}
+
+TEST_F(ControlFlowTest, ParallelForMatchesSerialLoop) {
+  // Output keeps iteration order and reductions combine every chunk
+  std::string source = R"(
+      let a = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
+      parallel for (i = 0; i < 20; i++) {
+        a[i] = (i * 7) % 11;
+      }
+      let total = 0;
+      let lo = 100;
+      let hi = 0 - 100;
+      parallel for (i = 0; i < 20; i++) reduce(+: total, min: lo, max: hi) {
+        total = total + a[i];
+        if (a[i] < lo) { lo = a[i]; }
+        if (a[i] > hi) { hi = a[i]; }
+        if (i % 5 == 0) { print(i); }
+      }
+      print(total);
+      print(lo);
+      print(hi);
+  )";
+
+  Lexer lexer(source);
+  auto tokens = lexer.tokenize();
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  CodeGenerator codegen;
+  auto bytecode = codegen.generate(*program);
+  for (size_t threads : {1, 4}) {
+    std::ostringstream out;
+    VirtualMachine vm;
+    vm.setThreads(threads);
+    vm.setOutputStream(out);
+    vm.execute(bytecode);
+    EXPECT_EQ(out.str(), "0\n5\n10\n15\n98\n0\n10\n") << threads;
+  }
+}
+
+TEST_F(ControlFlowTest, ParallelForReductionsMatchOnEveryPath) {
+  // One thread and a profiler both run the loop serially; four threads
+  // split it into chunks
+  std::string source = R"(
+      let total = 100;
+      let lo = 50;
+      let hi = 0;
+      let text = "";
+      parallel for (i = 0; i < 40; i++)
+          reduce(+: total, +: text, min: lo, max: hi) {
+        let v = (i * 13) % 29;
+        total -= v;
+        total++;
+        if (lo >= v) { lo = v; }
+        if (v >= hi) { hi = v; }
+        if (i % 10 == 0) { text = text + "x"; }
+      }
+      print(total);
+      print(lo);
+      print(hi);
+      print(text);
+  )";
+
+  Lexer lexer(source);
+  auto tokens = lexer.tokenize();
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  CodeGenerator codegen;
+  auto bytecode = codegen.generate(*program);
+  for (int path = 0; path < 3; ++path) {
+    std::ostringstream out;
+    VirtualMachine vm;
+    Profiler profiler;
+    vm.setThreads(path == 1 ? 4 : 1);
+    vm.setOutputStream(out);
+    vm.execute(bytecode, path == 2 ? &profiler : nullptr);
+    EXPECT_EQ(out.str(), "-401\n0\n28\nxxxx\n") << path;
+  }
+}
+
+TEST_F(ControlFlowTest, ParallelForRejectsOrderDependentReductions) {
+  // Each of these gives one answer serially and another in chunks
+  for (const char *body :
+       {"reduce(min: s) { s = 5; }", "reduce(+: s) { s = s * 2 + 1; }",
+        "reduce(+: s) { s = i - s; }", "reduce(+: s) { s = s + s; }",
+        "reduce(+: s) { print(s); }", "reduce(max: s) { if (i < s) { s = i; } }",
+        "reduce(min: s) { if (i < s) { s = i + 1; } }",
+        "reduce(+: s) { if (i < s) { s = s + i; } }"}) {
+    std::string source =
+        std::string("let s = 0; parallel for (i = 0; i < 10; i++) ") + body;
+    EXPECT_THROW(run(source), CodegenError) << body;
+  }
+  EXPECT_THROW(run("let s = 0; parallel for (i = 0; i < 4; i++) reduce(+: s) "
+                   "{ parallel for (j = 0; j < 4; j++) reduce(max: s) "
+                   "{ if (j > s) { s = j; } } }"),
+               CodegenError);
+}
+
+TEST_F(ControlFlowTest, ParallelForRejectsUnreducedWrites) {
+  EXPECT_THROW(
+      run("let s = 0; parallel for (i = 0; i < 4; i++) { s = s + i; }"),
+      CodegenError);
+  EXPECT_THROW(run("parallel for (i = 0; i < 4; i++) { break; }"),
+               CodegenError);
+  EXPECT_THROW(run("parallel for (i = 0; i < 4; i++) { i = 0; }"),
+               CodegenError);
+}
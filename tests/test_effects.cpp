@@ -0,0 +1,79 @@
+#include "effects.h"
+#include "lexer.h"
+#include "parser.h"
+#include <gtest/gtest.h>
+
+class EffectAnalysisTest : public ::testing::Test {
+protected:
+  std::unique_ptr<Program> parse(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return parser.parseProgram();
+  }
+};
+
+TEST_F(EffectAnalysisTest, PrintingMakesCallersImpure) {
+  auto program = parse(R"(
+    fn log(x) { if (x > 0) { print(x); } return x; }
+    fn viaLog(x) { return log(x) + 1; }
+    fn square(x) { return x * x; }
+    fn sumSquares(n) {
+      let s = 0;
+      for (let i = 0; i < n; i = i + 1) { s = s + square(i); }
+      return s;
+    }
+    let r = viaLog(1) + sumSquares(3);
+  )");
+  EffectAnalysis effects(*program);
+
+  EXPECT_FALSE(effects.isPure("log"));
+  EXPECT_FALSE(effects.isPure("viaLog"));
+  EXPECT_TRUE(effects.isPure("square"));
+  EXPECT_TRUE(effects.isPure("sumSquares"));
+}
+
+TEST_F(EffectAnalysisTest, RecursionStaysPureArrayStoresDoNot) {
+  auto program = parse(R"(
+    fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    fn table(n) { let a = [0, 0]; a[1] = n; return a[1]; }
+    fn unused() { return 1; }
+    print(fib(5) + table(2));
+  )");
+  EffectAnalysis effects(*program);
+
+  EXPECT_TRUE(effects.isPure("fib"));
+  EXPECT_FALSE(effects.isPure("table"));
+  // Only functions top-level code can reach are analyzed
+  EXPECT_FALSE(effects.isPure("unused"));
+  EXPECT_EQ(effects.pureFunctions().size(), 1u);
+}
+
+TEST_F(EffectAnalysisTest, SummariesFollowCalls) {
+  auto program = parse(R"(
+    fn store(a, i) { a[i] = 0; return 0; }
+    fn load(a, i) { return a[i]; }
+    fn reset(a) { return store(a, 0) + load(a, 1); }
+    fn even(n) { if (n == 0) { return 1; } return odd(n - 1); }
+    fn odd(n) { if (n == 0) { return 0; } return even(n - 1); }
+    fn shout(x) { print(x); return even(x); }
+    print(reset([1, 2]) + shout(3));
+  )");
+  EffectAnalysis effects(*program);
+
+  const FunctionEffects *reset = effects.effectsOf("reset");
+  ASSERT_NE(reset, nullptr);
+  EXPECT_TRUE(reset->readsArrays);
+  EXPECT_TRUE(reset->writesArrays);
+  EXPECT_FALSE(reset->recursive);
+  EXPECT_TRUE(effects.mayWriteArrays("reset"));
+  EXPECT_FALSE(effects.mayWriteArrays("load"));
+  EXPECT_FALSE(effects.mayWriteArrays("shout"));
+  EXPECT_TRUE(effects.mayWriteArrays("missing"));
+
+  EXPECT_TRUE(effects.effectsOf("odd")->recursive);
+  EXPECT_EQ(effects.effectsOf("even")->describe(), "pure, recursive");
+  EXPECT_EQ(effects.effectsOf("shout")->describe(), "impure, prints");
+  EXPECT_EQ(effects.effectsOf("load")->describe(), "pure, reads arrays");
+  EXPECT_EQ(reset->describe(), "impure, reads arrays, writes arrays");
+}
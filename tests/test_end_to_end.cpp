@@ -56,6 +56,15 @@ TEST_F(EndToEndTest, ParenthesizedExpression) {
   EXPECT_EQ(out[0], 20); // (2 + 3) * 4 = 20
 }
 
+TEST_F(EndToEndTest, DoubleMinusSubtractsNegation) {
+  run("let a = 5; print(a--1); print(5--1); a--; print(a);");
+  auto out = getOutput();
+  ASSERT_EQ(out.size(), static_cast<size_t>(3));
+  EXPECT_EQ(out[0], 6);
+  EXPECT_EQ(out[1], 6);
+  EXPECT_EQ(out[2], 4);
+}
+
 // ============================================================================
 // Variable Tests
 // ============================================================================
@@ -140,3 +149,198 @@ TEST_F(EndToEndTest, OptimizedAndUnoptimizedSameResult) {
   // Note: getOutput() returns cumulative, so we check last values
   EXPECT_EQ(optimized, unoptimized);
 }
+
+TEST_F(EndToEndTest, DeadCodeEliminationPreservesBehavior) {
+  std::string source = R"(
+    fn classify(n) {
+      let label = 0;
+      if (n > 10) { label = 2; return label; print(n); }
+      if (0) { label = 9; }
+      let unused = n * 3;
+      while (n > 0) { n = n - 1; if (n == 5) { break; } continue; print(n); }
+      return n;
+    }
+    print(classify(20));
+    print(classify(8));
+    print(classify(3));
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  run(source, true);
+  EXPECT_EQ(getOutput(), expected);
+  ASSERT_EQ(expected.size(), 3u);
+  EXPECT_EQ(expected[0], 2);
+  EXPECT_EQ(expected[1], 5);
+  EXPECT_EQ(expected[2], 0);
+}
+
+TEST_F(EndToEndTest, VariableAssignedOnlyInRemovedBranchStillCompiles) {
+  run("fn f() { if (0) { let y = 1; } return y; } print(f());");
+  ASSERT_EQ(getOutput().size(), 1u);
+  EXPECT_EQ(getOutput()[0], 0);
+}
+
+TEST_F(EndToEndTest, LogicalNot) {
+  run("let a = 0; let b = 5; print(!a); print(!b); if (!b) { print(9); }");
+  auto out = getOutput();
+  ASSERT_EQ(out.size(), 2u);
+  EXPECT_EQ(out[0], 1);
+  EXPECT_EQ(out[1], 0);
+}
+
+TEST_F(EndToEndTest, CommonSubexpressionsKeepResults) {
+  std::string source = R"(
+    fn f(a, i, n) {
+      let x = a[i] + a[i];
+      let y = n * n + n * n + n * n;
+      a[i] = 7;
+      return x + y + a[i] + a[i];
+    }
+    let arr = [1, 2, 3];
+    print(f(arr, 1, 5));
+    let s = 0;
+    for (let k = 0; k < 10; k = k + 1) {
+      s = s + arr[k % 3] * arr[k % 3];
+      if (k == 4) { arr[0] = 2; }
+    }
+    print(s);
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  run(source);
+  EXPECT_EQ(getOutput(), expected);
+  ASSERT_EQ(expected.size(), 2u);
+  EXPECT_EQ(expected[0], 93);
+}
+
+TEST_F(EndToEndTest, CallDoesNotClobberCallerLocals) {
+  // Frames used to start a fixed distance past the caller's base, so a
+  // caller with many locals had them overwritten by the callee
+  std::string source = "fn f(a) { let b = a + 1; return b; }";
+  for (int i = 0; i < 40; ++i) {
+    source += "let v" + std::to_string(i) + " = " + std::to_string(i) + ";";
+  }
+  source += "let r = f(100);";
+  for (int i = 0; i < 40; ++i) {
+    source += "print(v" + std::to_string(i) + ");";
+  }
+
+  run(source);
+  auto out = getOutput();
+  ASSERT_EQ(out.size(), 40u);
+  for (int i = 0; i < 40; ++i) {
+    EXPECT_EQ(out[i], i);
+  }
+}
+
+TEST_F(EndToEndTest, MemoizedCallsKeepResults) {
+  std::string source = R"(
+    fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    fn wrap(n) { return [n]; }
+    fn name(n) { if (n == 0) { return "zero"; } return "many"; }
+    let n = 20;
+    print(fib(n));
+    let a = wrap(1);
+    let b = wrap(1);
+    a[0] = 5;
+    print(b[0]);
+    print(name(0) + name(0) + name(n));
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  EXPECT_EQ(vm.getMemoHits(), 0u);
+
+  vm.setMemoizedFunctions({"fib", "wrap", "name"});
+  run(source, false);
+  EXPECT_EQ(getOutput(), expected);
+  // fib(n - 2) is always cached by the time it is called, and so is the
+  // second name(0); arrays are never replayed
+  EXPECT_EQ(vm.getMemoHits(), 19u);
+}
+
+TEST_F(EndToEndTest, PartialEvaluationKeepsResults) {
+  std::string source = R"(
+    fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    fn greet(s) { return "hi " + s; }
+    fn fill(n) {
+      let a = [0, 0, 0, 0];
+      for (let i = 0; i < 4; i = i + 1) { a[i] = n * i; }
+      return a[1] + a[3];
+    }
+    fn shout(x) { print(x); return x; }
+    print(fib(12) + fill(fib(5)));
+    print(greet("there"));
+    print(shout(7) + fib(3));
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  ASSERT_EQ(expected.size(), 4u);
+  EXPECT_EQ(expected[0], 164);
+  run(source);
+  EXPECT_EQ(getOutput(), expected);
+}
+
+TEST_F(EndToEndTest, LoopUnrollingKeepsResults) {
+  std::string source = R"(
+    fn sum(a, from, to) {
+      let s = 0;
+      for (let i = from; i < to; i = i + 1) { s = s + a[i]; }
+      return s;
+    }
+    let a = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11];
+    print(sum(a, 0, 11));
+    print(sum(a, 3, 6));
+    print(sum(a, 5, 2));
+    let s = 0;
+    for (let i = 0; i < 3; i = i + 1) { s = s + a[i] * i; }
+    for (let j = 10; j >= 0; j = j - 3) { s = s + a[j]; }
+    for (let k = 0; k < 1000; k = k + 7) { if (k % 2 == 0) { s = s + k; } }
+    print(s);
+    let top = 2147483647;
+    let count = 0;
+    for (let q = 2147483640; q < top; q = q + 1) { count = count + 1; }
+    let bottom = -2147483647;
+    for (let r = -2147483640; r > bottom; r = r - 1) { count = count + 1; }
+    let low = bottom + 1;
+    for (let w = bottom - 1; w < low; w = w + 1) { count = count + 1; }
+    print(count);
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  ASSERT_EQ(expected.size(), 5u);
+  EXPECT_EQ(expected[4], 16);
+  run(source);
+  EXPECT_EQ(getOutput(), expected);
+}
+
+TEST_F(EndToEndTest, StrengthReductionKeepsResults) {
+  std::string source = R"(
+    let n = 5;
+    let a = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+             0, 0, 0, 0, 0];
+    for (let i = 0; i < n; i = i + 1) {
+      for (let j = 0; j < n; j = j + 1) { a[i * n + j] = i * 3 - j; }
+    }
+    let s = 0;
+    let i = 5;
+    while (i > 0) {
+      i = i - 1;
+      let j = 0;
+      while (j < n) {
+        s = s + a[i * n + j] * (i * 7) + (0 - j * 8) / 4 + (0 - j) % 4;
+        j = j + 1;
+      }
+    }
+    print(s);
+  )";
+
+  run(source, false);
+  auto expected = getOutput();
+  run(source);
+  EXPECT_EQ(getOutput(), expected);
+}
@@ -0,0 +1,94 @@
+#include "codegen.h"
+#include "execution_context.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Build with -DENABLE_TSAN=ON to run the stress test under ThreadSanitizer
+class ExecutionContextTest : public ::testing::Test {
+protected:
+  std::unique_ptr<Program> parse(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return parser.parseProgram();
+  }
+};
+
+TEST_F(ExecutionContextTest, SharesOneProgramAcrossThreads) {
+  auto ast = parse(R"(fn fib(n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+fn label(name) {
+  return name + ":";
+}
+let a = [0, 0, 0, 0, 0, 0, 0, 0];
+for (let i = 0; i < 8; i = i + 1) {
+  a[i] = fib(i + 4);
+}
+let s = 0;
+for (x in a) {
+  s += x;
+}
+let t = 0;
+parallel for (let i = 0; i < 200; i = i + 1) reduce(+: t) {
+  t += a[i % 8];
+}
+print(label("sum"));
+print(s);
+print(t);
+)");
+  Optimizer optimizer;
+  optimizer.run(*ast);
+  CodeGenerator codegen;
+  auto program =
+      std::make_shared<const BytecodeProgram>(codegen.generate(*ast));
+
+  ExecutionContext reference(program);
+  reference.execute();
+  std::string expected = reference.takeOutput();
+  ASSERT_EQ(expected, "sum:\n228\n5700\n");
+
+  constexpr int kThreads = 8;
+  constexpr int kRuns = 20;
+  std::vector<std::string> outputs(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      ExecutionContext context(program);
+      // Mix the tiers: traces and parallel loops are per context too
+      context.vm().setJitEnabled(t % 2 == 1);
+      context.vm().setThreads(t % 4 == 0 ? 2 : 1);
+      std::string all;
+      for (int run = 0; run < kRuns; ++run) {
+        context.execute();
+        std::string output = context.takeOutput();
+        if (output != expected) {
+          all += output;
+        }
+      }
+      outputs[t] = all;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &output : outputs) {
+    EXPECT_EQ(output, "");
+  }
+}
+
+TEST_F(ExecutionContextTest, RejectsLazyPrograms) {
+  auto ast = parse("fn f() { return 1; }\nprint(f());\n");
+  CodeGenerator codegen;
+  auto program =
+      std::make_shared<const BytecodeProgram>(codegen.generateLazy(*ast));
+  EXPECT_THROW(ExecutionContext context(program), VMError);
+}
@@ -0,0 +1,248 @@
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "vm.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+class JitTest : public ::testing::Test {
+protected:
+  BytecodeProgram compile(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parseProgram();
+    CodeGenerator codegen;
+    return codegen.generate(*program);
+  }
+
+  // Run with and without the JIT and check both agree
+  std::string runBoth(const std::string &source) {
+    auto bytecode = compile(source);
+
+    VirtualMachine interp;
+    std::stringstream expected;
+    interp.setOutputStream(expected);
+    interp.execute(bytecode);
+
+    VirtualMachine jitted;
+    std::stringstream actual;
+    jitted.setOutputStream(actual);
+    jitted.setJitEnabled(true);
+    jitted.execute(bytecode);
+    stats = *jitted.getJitStats();
+
+    EXPECT_EQ(actual.str(), expected.str());
+    return actual.str();
+  }
+
+  TraceJit::Stats stats;
+};
+
+TEST_F(JitTest, DisabledByDefault) {
+  VirtualMachine vm;
+  EXPECT_EQ(vm.getJitStats(), nullptr);
+}
+
+TEST_F(JitTest, CompilesHotCountingLoop) {
+  auto output = runBoth(R"(
+    let sum = 0;
+    let i = 0;
+    while (i < 1000) {
+      sum = sum + i;
+      i = i + 1;
+    }
+    print(sum);
+  )");
+
+  EXPECT_EQ(output, "499500\n");
+  EXPECT_EQ(stats.tracesCompiled, 1u);
+  EXPECT_GE(stats.sideExits, 1u); // Loop exit leaves through a guard
+}
+
+TEST_F(JitTest, BranchesInsideTraceTakeSideExits) {
+  runBoth(R"(
+    let evens = 0;
+    let odds = 0;
+    for (let i = 0; i < 500; i = i + 1) {
+      if (i % 2 == 0) { evens = evens + 1; }
+      if (i % 2 == 1) { odds = odds + 1; }
+    }
+    print(evens);
+    print(odds);
+  )");
+
+  EXPECT_GE(stats.tracesCompiled, 1u);
+}
+
+TEST_F(JitTest, ArrayLoopsStayInTrace) {
+  auto output = runBoth(R"(
+    let arr = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
+    for (let k = 0; k < 200; k = k + 1) {
+      let j = k % 10;
+      arr[j] = arr[j] + k;
+    }
+    print(arr);
+  )");
+
+  EXPECT_EQ(stats.tracesCompiled, 1u);
+  EXPECT_NE(output.find("1900"), std::string::npos);
+}
+
+TEST_F(JitTest, CompoundUpdatesStayInTrace) {
+  auto output = runBoth(R"(
+    let arr = [0, 0, 0, 0];
+    let total = 0;
+    for (let k = 0; k < 200; k++) {
+      arr[k % 4] += k;
+      arr[3 - k % 4] -= 1;
+      total += arr[0];
+    }
+    print(arr);
+    print(total);
+  )");
+
+  EXPECT_EQ(stats.tracesCompiled, 1u);
+  EXPECT_EQ(stats.recordingsAborted, 0u);
+  EXPECT_EQ(output, "[4850, 4900, 4950, 5000]\n328250\n");
+}
+
+TEST_F(JitTest, ForInLoopIsTraced) {
+  auto output = runBoth(R"(
+    let arr = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
+    let i = 0;
+    while (i < 10) { arr[i] = i; i++; }
+    let squares = 0;
+    let r = 0;
+    while (r < 50) {
+      for (v in arr) { squares += v * v; }
+      r++;
+    }
+    print(squares);
+  )");
+
+  EXPECT_EQ(stats.tracesCompiled, 1u);
+  EXPECT_GT(stats.traceEntries, 0u);
+  EXPECT_EQ(output, "14250\n");
+}
+
+TEST_F(JitTest, LoopsWithCallsAreNotTraced) {
+  runBoth(R"(
+    fn inc(x) { return x + 1; }
+    let i = 0;
+    while (i < 200) { i = inc(i); }
+    print(i);
+  )");
+
+  EXPECT_EQ(stats.tracesCompiled, 0u);
+  EXPECT_GE(stats.recordingsAborted, 1u);
+}
+
+TEST_F(JitTest, TypeChangeFallsBackToInterpreter) {
+  runBoth(R"(
+    let x = 0;
+    let n = 0;
+    while (n < 300) {
+      n = n + 1;
+      if (n == 250) { x = "done"; }
+    }
+    print(x);
+    print(n);
+  )");
+}
+
+TEST_F(JitTest, RuntimeErrorsInsideTraceMatchInterpreter) {
+  auto bytecode = compile(R"(
+    let arr = [1, 2, 3];
+    let i = 0;
+    let total = 0;
+    while (i < 100) {
+      total = total + 10 / (50 - i);
+      i = i + 1;
+    }
+  )");
+
+  VirtualMachine vm;
+  vm.setJitEnabled(true);
+  EXPECT_THROW(vm.execute(bytecode), VMError);
+  EXPECT_EQ(vm.getJitStats()->tracesCompiled, 1u);
+}
+
+TEST_F(JitTest, ShiftsStayInTrace) {
+  auto output = runBoth(R"(
+    let sum = 0;
+    let i = 0 - 500;
+    while (i < 500) {
+      sum = sum + i * 4 + i / 8 + i % 16;
+      i = i + 1;
+    }
+    print(sum);
+  )");
+
+  EXPECT_EQ(output, "-2066\n");
+  EXPECT_EQ(stats.tracesCompiled, 1u);
+}
+
+TEST_F(JitTest, SubtractsComputedStepsInOrder) {
+  auto output = runBoth(R"(
+    let v = 77;
+    let w = 0;
+    let k = 0;
+    while (k < 100) {
+      k = k + 1;
+      v = v - (0 - 1);
+      w = w - (k < 50);
+    }
+    print(v);
+    print(w);
+  )");
+
+  EXPECT_EQ(output, "177\n-49\n");
+}
+
+TEST_F(JitTest, TracesRunUnderInstructionLimit) {
+  // A plain loop, one leaving through a side exit every iteration and one
+  // with array stores
+  for (const char *source : {R"(
+    let sum = 0;
+    let i = 0;
+    while (i < 1000) {
+      sum = sum + i;
+      i = i + 1;
+    }
+    print(sum);
+  )", R"(
+    let evens = 0;
+    for (let i = 0; i < 500; i = i + 1) {
+      if (i % 2 == 0) { evens = evens + 1; }
+    }
+    print(evens);
+  )", R"(
+    let arr = [0, 0, 0, 0];
+    for (let k = 0; k < 200; k++) {
+      arr[k % 4] += k;
+    }
+    print(arr);
+  )"}) {
+    auto bytecode = compile(source);
+
+    VirtualMachine interp;
+    std::stringstream ignored;
+    interp.setOutputStream(ignored);
+    interp.execute(bytecode);
+
+    // A limit no longer keeps the loop out of the JIT, and traced
+    // instructions count as the ones they were recorded from
+    VirtualMachine jitted;
+    jitted.setOutputStream(ignored);
+    jitted.setJitEnabled(true);
+    jitted.setInstructionLimit(interp.getInstructionCount());
+    jitted.execute(bytecode);
+    EXPECT_EQ(jitted.getJitStats()->tracesCompiled, 1u) << source;
+    EXPECT_EQ(jitted.getInstructionCount(), interp.getInstructionCount())
+        << source;
+
+    jitted.setInstructionLimit(interp.getInstructionCount() / 2);
+    EXPECT_THROW(jitted.execute(bytecode), VMError) << source;
+  }
+}
@@ -202,6 +202,39 @@ TEST_F(LexerTest, TokenizeAssign) {
     EXPECT_EQ(types[1], TokenType::END_OF_FILE);
 }
 
+TEST_F(LexerTest, TokenizeCompoundAssignment) {
+    auto types = tokenizeTypes("+= -= *= ++ a-- ; + -");
+    EXPECT_EQ(types[0], TokenType::PLUS_ASSIGN);
+    EXPECT_EQ(types[1], TokenType::MINUS_ASSIGN);
+    EXPECT_EQ(types[2], TokenType::STAR_ASSIGN);
+    EXPECT_EQ(types[3], TokenType::PLUS_PLUS);
+    EXPECT_EQ(types[4], TokenType::IDENTIFIER);
+    EXPECT_EQ(types[5], TokenType::MINUS_MINUS);
+    EXPECT_EQ(types[6], TokenType::SEMICOLON);
+    EXPECT_EQ(types[7], TokenType::PLUS);
+    EXPECT_EQ(types[8], TokenType::MINUS);
+    EXPECT_EQ(types[9], TokenType::END_OF_FILE);
+}
+
+TEST_F(LexerTest, DoubleMinusIsDecrementOnlyAtEndOfStatement) {
+    // a--1 is a - (-1), as before decrement existed
+    auto types = tokenizeTypes("a--1 5--1 --a a[0]--) b--;");
+    EXPECT_EQ(types[0], TokenType::IDENTIFIER);
+    EXPECT_EQ(types[1], TokenType::MINUS);
+    EXPECT_EQ(types[2], TokenType::MINUS);
+    EXPECT_EQ(types[3], TokenType::NUMBER);
+    EXPECT_EQ(types[4], TokenType::NUMBER);
+    EXPECT_EQ(types[5], TokenType::MINUS);
+    EXPECT_EQ(types[6], TokenType::MINUS);
+    EXPECT_EQ(types[7], TokenType::NUMBER);
+    EXPECT_EQ(types[8], TokenType::MINUS);
+    EXPECT_EQ(types[9], TokenType::MINUS);
+    EXPECT_EQ(types[10], TokenType::IDENTIFIER);
+    EXPECT_EQ(types[14], TokenType::RBRACKET);
+    EXPECT_EQ(types[15], TokenType::MINUS_MINUS);
+    EXPECT_EQ(types[18], TokenType::MINUS_MINUS);
+}
+
 TEST_F(LexerTest, TokenizeEquality) {
     auto types = tokenizeTypes("==");
     EXPECT_EQ(types[0], TokenType::EQ);
@@ -1,6 +1,7 @@
 #include "lexer.h"
 #include "optimizer.h"
 #include "parser.h"
+#include "profile_data.h"
 #include <gtest/gtest.h>
 
 class OptimizerTest : public ::testing::Test {
@@ -62,22 +63,141 @@ TEST_F(OptimizerTest, DetectsCodeAfterReturn) {
   EXPECT_GE(stats.deadCodeRemoved, 1);
 }
 
+TEST_F(OptimizerTest, RemovesStatementsAfterReturn) {
+  auto program = parse("fn foo(x) { return x; print(1); print(2); } "
+                       "print(foo(1));");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  ASSERT_EQ(fn->body().size(), 1u);
+  EXPECT_NE(dynamic_cast<const ReturnStmt *>(fn->body()[0].get()), nullptr);
+  EXPECT_EQ(optimizer.getStats().deadCodeRemoved, 2);
+}
+
+TEST_F(OptimizerTest, RemovesStatementsAfterBreakAndContinue) {
+  auto program = parse(R"(
+    fn foo(n) {
+      while (n > 0) { n = n - 1; if (n == 3) { break; print(n); } continue; print(0); }
+      return n;
+    }
+    print(foo(5));
+  )");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  auto *loop = dynamic_cast<const WhileStmt *>(fn->body()[0].get());
+  ASSERT_NE(loop, nullptr);
+  ASSERT_EQ(loop->body().size(), 3u);
+  auto *branch = dynamic_cast<const IfStmt *>(loop->body()[1].get());
+  ASSERT_NE(branch, nullptr);
+  EXPECT_EQ(branch->body().size(), 1u);
+}
+
+TEST_F(OptimizerTest, RemovesConstantFalseBranches) {
+  auto program = parse(R"(
+    if (0) { print(1); }
+    while (2 - 2) { print(2); }
+    if (1 < 2) { print(3); }
+    print(4);
+  )");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  ASSERT_EQ(program->items().size(), 2u);
+  auto *block = dynamic_cast<const BlockStmt *>(program->items()[0].get());
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(block->statements().size(), 1u);
+}
+
+TEST_F(OptimizerTest, RemovesDeadStoresUsingLiveness) {
+  auto program = parse(R"(
+    fn foo(a) {
+      let x = a * 2;
+      x = a + 1;
+      let y = x;
+      let z = 0;
+      while (z < 3) { z = z + 1; }
+      return y;
+    }
+    print(foo(1));
+  )");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  // The first store to x is overwritten before any read; the loop stays
+  // because z is read by its own condition
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_EQ(fn->body().size(), 5u);
+  auto *first = dynamic_cast<const AssignmentStmt *>(fn->body()[0].get());
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first->name(), "x");
+  EXPECT_NE(dynamic_cast<const BinaryOpExpr *>(&first->value()), nullptr);
+  EXPECT_EQ(optimizer.getStats().deadCodeRemoved, 1);
+}
+
+TEST_F(OptimizerTest, KeepsStoresWithSideEffects) {
+  auto program = parse(R"(
+    fn bar() { print(1); return 1; }
+    fn foo(a, arr) {
+      let unusedCall = bar();
+      let unusedIndex = arr[5];
+      let unusedDiv = 10 / a;
+      return 0;
+    }
+    print(foo(0, [1]));
+  )");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[1].get());
+  EXPECT_EQ(fn->body().size(), 4u);
+}
+
+TEST_F(OptimizerTest, KeepsStoresLiveAcrossLoopIterations) {
+  auto program = parse(R"(
+    fn foo(n) {
+      let prev = 0;
+      let cur = 1;
+      for (let i = 0; i < n; i = i + 1) {
+        let next = prev + cur;
+        prev = cur;
+        cur = next;
+      }
+      return cur;
+    }
+    print(foo(10));
+  )");
+
+  Optimizer optimizer;
+  optimizer.runDeadCodeElimination(*program);
+
+  EXPECT_EQ(optimizer.getStats().deadCodeRemoved, 0);
+}
+
 // ============================================================================
-// Function Inlining Tests
+// Inline Candidate Tests
 // ============================================================================
 
-TEST_F(OptimizerTest, IdentifiesInlinableFunction) {
+TEST_F(OptimizerTest, CountsSmallFunctionAsInlineCandidate) {
   auto program = parse("fn add(a, b) { return a + b; }");
 
   Optimizer optimizer;
   optimizer.run(*program);
 
   auto stats = optimizer.getStats();
-  // Small function should be inlinable
-  EXPECT_GE(stats.functionsInlined, 1);
+  // Small function should be a candidate
+  EXPECT_GE(stats.inlineCandidates, 1);
 }
 
-TEST_F(OptimizerTest, DoesNotInlineRecursiveFunction) {
+TEST_F(OptimizerTest, RecursiveFunctionIsNotInlineCandidate) {
   auto program = parse(
       "fn factorial(n) { if (n) { return n * factorial(n - 1); } return 1; }");
 
@@ -85,8 +205,8 @@ TEST_F(OptimizerTest, DoesNotInlineRecursiveFunction) {
   optimizer.run(*program);
 
   auto stats = optimizer.getStats();
-  // Recursive functions should not be inlined
-  EXPECT_EQ(stats.functionsInlined, 0);
+  // Recursive functions are never candidates
+  EXPECT_EQ(stats.inlineCandidates, 0);
 }
 
 // ============================================================================
@@ -104,5 +224,457 @@ TEST_F(OptimizerTest, ResetStatsClearsCounters) {
   optimizer.resetStats();
   EXPECT_EQ(optimizer.getStats().constantsFolded, 0);
   EXPECT_EQ(optimizer.getStats().deadCodeRemoved, 0);
-  EXPECT_EQ(optimizer.getStats().functionsInlined, 0);
+  EXPECT_EQ(optimizer.getStats().inlineCandidates, 0);
+}
+
+// ============================================================================
+// Lazy Parsing Interaction
+// ============================================================================
+
+TEST_F(OptimizerTest, LeavesUnreachableLazyBodiesUnparsed) {
+  Lexer lexer(R"(
+    fn used(x) { return helper(x) + 1; }
+    fn helper(x) { return x * 2; }
+    fn unused(x) { return x - 1; }
+    let n = 3;
+    print(used(n));
+  )");
+  auto tokens = lexer.tokenize();
+  Parser parser(tokens);
+  parser.setLazyFunctionBodies(true);
+  auto program = parser.parseProgram();
+
+  Optimizer optimizer;
+  optimizer.run(*program);
+
+  std::unordered_map<std::string, bool> parsed;
+  for (const auto &item : program->items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      parsed[fn->name()] = fn->isBodyParsed();
+    }
+  }
+  EXPECT_TRUE(parsed["used"]);
+  EXPECT_TRUE(parsed["helper"]);
+  EXPECT_FALSE(parsed["unused"]);
+}
+
+// ============================================================================
+// Dead Function Elimination Tests
+// ============================================================================
+
+TEST_F(OptimizerTest, RemovesUnreachableFunctions) {
+  auto program = parse(R"(
+    fn used(x) { return helper(x); }
+    fn helper(x) { return x + 1; }
+    fn unused(x) { return orphan(x); }
+    fn orphan(x) { return x; }
+    let n = 1;
+    print(used(n));
+  )");
+
+  Optimizer optimizer;
+  optimizer.run(*program);
+
+  EXPECT_EQ(optimizer.getStats().functionsRemoved, 2);
+  std::vector<std::string> remaining;
+  for (const auto &item : program->items()) {
+    if (auto *fn = dynamic_cast<const FunctionDecl *>(item.get())) {
+      remaining.push_back(fn->name());
+    }
+  }
+  EXPECT_EQ(remaining, (std::vector<std::string>{"used", "helper"}));
+  EXPECT_EQ(program->items().size(), 4u);
+}
+
+TEST_F(OptimizerTest, KeepsFunctionsWhenEliminationDisabled) {
+  auto program = parse("fn later() { return 1; } let x = 1;");
+
+  Optimizer optimizer;
+  optimizer.setRemoveDeadFunctions(false);
+  optimizer.run(*program);
+
+  EXPECT_EQ(optimizer.getStats().functionsRemoved, 0);
+  EXPECT_EQ(program->items().size(), 2u);
+}
+
+// ============================================================================
+// Partial Evaluation Tests
+// ============================================================================
+
+TEST_F(OptimizerTest, EvaluatesPureCallWithLiteralArguments) {
+  auto program = parse(R"(
+    fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    fn twice(s) { return s + s; }
+    let x = fib(15) + 1;
+    let y = twice("ab");
+  )");
+
+  Optimizer optimizer;
+  optimizer.runPartialEvaluation(*program);
+
+  EXPECT_EQ(optimizer.getStats().callsEvaluated, 2);
+  auto *x = dynamic_cast<const AssignmentStmt *>(program->items()[2].get());
+  ASSERT_NE(x, nullptr);
+  auto *sum = dynamic_cast<const BinaryOpExpr *>(&x->value());
+  ASSERT_NE(sum, nullptr);
+  auto *fib = dynamic_cast<const NumberExpr *>(&sum->left());
+  ASSERT_NE(fib, nullptr);
+  EXPECT_EQ(fib->value(), 610);
+  auto *y = dynamic_cast<const AssignmentStmt *>(program->items()[3].get());
+  ASSERT_NE(y, nullptr);
+  auto *twice = dynamic_cast<const StringLiteralExpr *>(&y->value());
+  ASSERT_NE(twice, nullptr);
+  EXPECT_EQ(twice->value(), "abab");
+}
+
+TEST_F(OptimizerTest, PartialEvaluationKeepsCallsItCannotFinish) {
+  auto program = parse(R"(
+    fn shout(x) { print(x); return x; }
+    fn viaShout(x) { return shout(x) + 1; }
+    fn divide(x) { return 10 / x; }
+    fn spin(n) { let i = 0; while (i < n) { i = i + 1; } return i; }
+    fn pair(x) { return [x, x]; }
+    let n = 2;
+    let a = viaShout(1) + divide(0) + spin(2000000000) + divide(n);
+    let b = pair(1);
+  )");
+
+  Optimizer optimizer;
+  optimizer.runPartialEvaluation(*program);
+
+  EXPECT_EQ(optimizer.getStats().callsEvaluated, 0);
+}
+
+TEST_F(OptimizerTest, PartialEvaluationWrapsDivisionOverflow) {
+  auto program = parse(R"(
+    fn f(a, b) { return (0 - a - 1) / (0 - b); }
+    fn g(a, b) { return (0 - a - 1) % (0 - b); }
+    let x = f(2147483647, 1);
+    let y = g(2147483647, 1);
+  )");
+
+  Optimizer optimizer;
+  optimizer.runPartialEvaluation(*program);
+
+  EXPECT_EQ(optimizer.getStats().callsEvaluated, 2);
+  auto *x = dynamic_cast<const AssignmentStmt *>(program->items()[2].get());
+  ASSERT_NE(x, nullptr);
+  auto *quotient = dynamic_cast<const NumberExpr *>(&x->value());
+  ASSERT_NE(quotient, nullptr);
+  EXPECT_EQ(quotient->value(), INT32_MIN);
+  auto *y = dynamic_cast<const AssignmentStmt *>(program->items()[3].get());
+  ASSERT_NE(y, nullptr);
+  auto *remainder = dynamic_cast<const NumberExpr *>(&y->value());
+  ASSERT_NE(remainder, nullptr);
+  EXPECT_EQ(remainder->value(), 0);
+}
+
+TEST_F(OptimizerTest, PartialEvaluationSharesOneBudget) {
+  auto program = parse(R"(
+    fn spin(n) { let i = 0; while (i < n) { i = i + 1; } return i; }
+    fn one() { return 1; }
+    if (0 == 1) {
+      let a = spin(100001) + spin(100002) + spin(100003) + spin(100004);
+      let b = spin(100005) + spin(100006) + spin(100007) + spin(100008);
+    }
+    let d = one();
+  )");
+
+  Optimizer optimizer;
+  optimizer.runPartialEvaluation(*program);
+
+  // The spins use up the compilation's budget, so later calls stay calls
+  EXPECT_LT(optimizer.getStats().callsEvaluated, 8);
+  auto *d = dynamic_cast<const AssignmentStmt *>(program->items()[3].get());
+  ASSERT_NE(d, nullptr);
+  EXPECT_NE(dynamic_cast<const FunctionCallExpr *>(&d->value()), nullptr);
+}
+
+TEST_F(OptimizerTest, PartialEvaluationKeepsLongStringResults) {
+  auto program = parse(R"(
+    fn grow(s) { for (let i = 0; i < 12; i = i + 1) { s = s + s; } return s; }
+    let c = grow("ab");
+    let d = grow("");
+  )");
+
+  Optimizer optimizer;
+  optimizer.runPartialEvaluation(*program);
+
+  // grow("") is empty however often it doubles
+  EXPECT_EQ(optimizer.getStats().callsEvaluated, 1);
+}
+
+// ============================================================================
+// Loop Unrolling Tests
+// ============================================================================
+
+TEST_F(OptimizerTest, FullyUnrollsTinyConstantLoop) {
+  auto program = parse(R"(
+    let s = 0;
+    for (let i = 0; i < 3; i = i + 1) { s = s + i; }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runLoopUnrolling(*program);
+
+  EXPECT_EQ(optimizer.getStats().loopsUnrolled, 1);
+  auto *block = dynamic_cast<const BlockStmt *>(program->items()[1].get());
+  ASSERT_NE(block, nullptr);
+  // One copy per iteration with the counter replaced, then its final value
+  ASSERT_EQ(block->statements().size(), 4u);
+  auto *copy =
+      dynamic_cast<const AssignmentStmt *>(block->statements()[2].get());
+  ASSERT_NE(copy, nullptr);
+  auto *sum = dynamic_cast<const BinaryOpExpr *>(&copy->value());
+  ASSERT_NE(sum, nullptr);
+  auto *value = dynamic_cast<const NumberExpr *>(&sum->right());
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value->value(), 2);
+  auto *last =
+      dynamic_cast<const AssignmentStmt *>(block->statements()[3].get());
+  ASSERT_NE(last, nullptr);
+  EXPECT_EQ(last->name(), "i");
+}
+
+TEST_F(OptimizerTest, PartiallyUnrollsLoopWithVariableBound) {
+  auto program = parse(R"(
+    fn sum(a, n) {
+      let s = 0;
+      for (let i = 0; i < n; i = i + 1) { s = s + a[i]; }
+      return s;
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runLoopUnrolling(*program);
+
+  EXPECT_EQ(optimizer.getStats().loopsUnrolled, 1);
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  auto *block = dynamic_cast<const BlockStmt *>(fn->body()[1].get());
+  ASSERT_NE(block, nullptr);
+  // init, limit, wrap-around check, unrolled loop, remainder loop
+  ASSERT_EQ(block->statements().size(), 5u);
+  auto *limit =
+      dynamic_cast<const AssignmentStmt *>(block->statements()[1].get());
+  ASSERT_NE(limit, nullptr);
+  EXPECT_EQ(limit->name(), "$unroll0");
+  auto *unrolled =
+      dynamic_cast<const WhileStmt *>(block->statements()[3].get());
+  ASSERT_NE(unrolled, nullptr);
+  EXPECT_EQ(unrolled->body().size(), 8u);
+  auto *remainder =
+      dynamic_cast<const ForStmt *>(block->statements()[4].get());
+  ASSERT_NE(remainder, nullptr);
+  EXPECT_EQ(remainder->init(), nullptr);
+}
+
+TEST_F(OptimizerTest, UnrollingSkipsLoopsItCannotCount) {
+  auto program = parse(R"(
+    let n = 10;
+    let s = 0;
+    for (let i = 0; i < 10; i = i + 1) { if (i == 3) { break; } }
+    for (let j = 0; j < 10; j = j + 1) { j = j + s; }
+    for (let k = 0; k <= n; k = k + 1) { s = s + k; }
+    for (let m = 0; m < n; m = m + 1) { n = n - 1; }
+    for (let p = 0; p < 10; p = p - 1) { s = s + p; }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runLoopUnrolling(*program);
+
+  EXPECT_EQ(optimizer.getStats().loopsUnrolled, 0);
+}
+
+TEST_F(OptimizerTest, ProfileKeepsShortAndColdLoopsRolled) {
+  const std::string source = R"(fn f(n) {
+  let s = 0;
+  for (let i = 0; i < n; i = i + 1) { s = s + i; }
+  for (let j = 0; j < n; j = j + 1) { s = s - j; }
+  for (let k = 0; k < n; k = k + 1) { s = s * k; }
+  return s;
+}
+print(f(3));
+)";
+  ProfileData profile = ProfileData::fromJson(R"({
+    "loops": [
+      {"function": "f", "line": 3, "entries": 5, "iterations": 10},
+      {"function": "f", "line": 4, "entries": 0, "iterations": 0},
+      {"function": "f", "line": 5, "entries": 5, "iterations": 500}
+    ]
+  })");
+
+  auto unprofiled = parse(source);
+  Optimizer plain;
+  plain.runLoopUnrolling(*unprofiled);
+  EXPECT_EQ(plain.getStats().loopsUnrolled, 3);
+
+  // Only the loop averaging 100 trips is worth copying
+  auto program = parse(source);
+  Optimizer optimizer;
+  optimizer.setProfile(&profile);
+  optimizer.runLoopUnrolling(*program);
+  EXPECT_EQ(optimizer.getStats().loopsUnrolled, 1);
+}
+
+// ============================================================================
+// Strength Reduction Tests
+// ============================================================================
+
+TEST_F(OptimizerTest, ReducesRowOffsetInNestedLoop) {
+  auto program = parse(R"(
+    let n = 4;
+    let a = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
+    for (let i = 0; i < n; i = i + 1) {
+      for (let j = 0; j < n; j = j + 1) {
+        a[i * n + j] = j;
+      }
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runStrengthReduction(*program);
+
+  EXPECT_EQ(optimizer.getStats().inductionVariablesReduced, 1);
+  auto *outer = dynamic_cast<const ForStmt *>(program->items()[2].get());
+  ASSERT_NE(outer, nullptr);
+  // Derived variable starts in the init and advances with the increment
+  auto *init = dynamic_cast<const BlockStmt *>(outer->init());
+  ASSERT_NE(init, nullptr);
+  ASSERT_EQ(init->statements().size(), 2u);
+  auto *derived =
+      dynamic_cast<const AssignmentStmt *>(init->statements()[1].get());
+  ASSERT_NE(derived, nullptr);
+  EXPECT_EQ(derived->name(), "$iv0");
+  auto *increment = dynamic_cast<const BlockStmt *>(outer->increment());
+  ASSERT_NE(increment, nullptr);
+  EXPECT_EQ(increment->statements().size(), 2u);
+}
+
+TEST_F(OptimizerTest, StrengthReductionNeedsKnownIntegers) {
+  // Parameters could be strings or arrays; the product must not be
+  // computed before a loop that might never run
+  auto program = parse(R"(
+    fn f(a, n) {
+      let s = 0;
+      for (let i = 0; i < 3; i = i + 1) {
+        for (let j = 0; j < 3; j = j + 1) { s = s + a[i * n + j]; }
+      }
+      return s;
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runStrengthReduction(*program);
+
+  EXPECT_EQ(optimizer.getStats().inductionVariablesReduced, 0);
+}
+
+TEST_F(OptimizerTest, StrengthReductionSkipsConditionalUpdates) {
+  auto program = parse(R"(
+    let i = 0;
+    let s = 0;
+    while (i < 10) {
+      s = s + i * 3 + i * 3 + i * 3;
+      if (s > 5) { i = i + 1; }
+      i = i + 1;
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runStrengthReduction(*program);
+
+  EXPECT_EQ(optimizer.getStats().inductionVariablesReduced, 0);
+}
+
+// ============================================================================
+// Common Subexpression Elimination Tests
+// ============================================================================
+
+TEST_F(OptimizerTest, ReusesRepeatedArrayLoad) {
+  auto program = parse("fn f(a, i) { return a[i] + a[i]; }");
+
+  Optimizer optimizer;
+  optimizer.runCommonSubexpressionElimination(*program);
+
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 1);
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  ASSERT_EQ(fn->body().size(), 2u);
+  auto *temp = dynamic_cast<const AssignmentStmt *>(fn->body()[0].get());
+  ASSERT_NE(temp, nullptr);
+  EXPECT_EQ(temp->name(), "$cse0");
+  EXPECT_NE(dynamic_cast<const IndexExpr *>(&temp->value()), nullptr);
+}
+
+TEST_F(OptimizerTest, ReusesProductOnlyWhenWorthwhile) {
+  // A second `n * n` costs as much as storing and loading a temporary
+  auto twice = parse("fn f(n) { return n * n + n * n; }");
+  auto thrice = parse("fn f(n) { return n * n + n * n + n * n; }");
+
+  Optimizer optimizer;
+  optimizer.runCommonSubexpressionElimination(*twice);
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 0);
+
+  optimizer.runCommonSubexpressionElimination(*thrice);
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 2);
+}
+
+TEST_F(OptimizerTest, ArrayStoreOrCallInvalidatesLoads) {
+  auto program = parse(R"(
+    fn g(a) { a[0] = 1; return 0; }
+    fn f(a, i) {
+      let x = a[i] + 1;
+      a[0] = 5;
+      let y = a[i] + 1;
+      let z = g(a);
+      let w = a[i] + a[i];
+      return x + y + z + w;
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runCommonSubexpressionElimination(*program);
+
+  // Only the two loads after the call share a value
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 1);
+}
+
+TEST_F(OptimizerTest, CallThatCannotStoreKeepsLoads) {
+  auto program = parse(R"(
+    fn get(a, i) { return a[i]; }
+    fn f(a, i) {
+      let x = a[i] + 1;
+      let y = get(a, i);
+      let z = a[i] + 1;
+      return x + y + z;
+    }
+    print(f([1, 2], 1));
+  )");
+
+  Optimizer optimizer;
+  optimizer.runCommonSubexpressionElimination(*program);
+
+  // get only reads arrays, so a[i] + 1 survives the call
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 1);
+}
+
+TEST_F(OptimizerTest, LoopDoesNotReuseValuesItChanges) {
+  auto program = parse(R"(
+    fn f(a, n) {
+      let s = a[n] * 3;
+      let i = 0;
+      while (i < n) {
+        s = s + a[i] * 3 + a[i] * 3;
+        i = i + 1;
+      }
+      return s + a[n] * 3;
+    }
+  )");
+
+  Optimizer optimizer;
+  optimizer.runCommonSubexpressionElimination(*program);
+
+  // a[i] * 3 inside the body and a[n] * 3 across the loop (no stores)
+  EXPECT_EQ(optimizer.getStats().subexpressionsEliminated, 2);
 }
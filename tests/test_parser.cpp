@@ -176,8 +176,11 @@ public:
   void visitPrintStmt(const PrintStmt &) override { visitCount++; }
   void visitExpressionStmt(const ExpressionStmt &) override { visitCount++; }
   void visitIfStmt(const IfStmt &) override { visitCount++; }
+  void visitSwitchStmt(const SwitchStmt &) override { visitCount++; }
   void visitWhileStmt(const WhileStmt &) override { visitCount++; }
   void visitForStmt(const ForStmt &) override { visitCount++; }
+  void visitForInStmt(const ForInStmt &) override { visitCount++; }
+  void visitParallelForStmt(const ParallelForStmt &) override { visitCount++; }
   void visitBreakStmt(const BreakStmt &) override { visitCount++; }
   void visitContinueStmt(const ContinueStmt &) override { visitCount++; }
   void visitReturnStmt(const ReturnStmt &) override { visitCount++; }
@@ -274,6 +277,78 @@ TEST_F(ParserTest, ParseBlockSuccessfully) {
   EXPECT_NE(program, nullptr);
 }
 
+TEST_F(ParserTest, ParseSwitchStatement) {
+  auto tokens = tokenize("switch (x) { case 1, -2: print(1); y = 2; "
+                         "case \"a\": print(2); default: }");
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  ASSERT_EQ(program->items().size(), 1u);
+  auto *stmt = dynamic_cast<const SwitchStmt *>(program->items()[0].get());
+  ASSERT_NE(stmt, nullptr);
+  ASSERT_EQ(stmt->cases().size(), 3u);
+  EXPECT_EQ(stmt->cases()[0].labels.size(), 2u);
+  EXPECT_EQ(stmt->cases()[0].body.size(), 2u);
+  EXPECT_EQ(stmt->cases()[1].labels.size(), 1u);
+  EXPECT_TRUE(stmt->cases()[2].labels.empty());
+  EXPECT_TRUE(stmt->hasDefault());
+}
+
+TEST_F(ParserTest, ParseForInStatement) {
+  auto tokens = tokenize("for (x in [1, 2]) { print(x); y = x; }");
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  ASSERT_EQ(program->items().size(), 1u);
+  auto *stmt = dynamic_cast<const ForInStmt *>(program->items()[0].get());
+  ASSERT_NE(stmt, nullptr);
+  EXPECT_EQ(stmt->variable(), "x");
+  EXPECT_NE(dynamic_cast<const ArrayLiteralExpr *>(&stmt->iterable()), nullptr);
+  EXPECT_EQ(stmt->body().size(), 2u);
+}
+
+TEST_F(ParserTest, ParseParallelForStatement) {
+  auto tokens = tokenize("parallel for (let i = 1; i < n; i++) "
+                         "reduce(+: s, min: lo, max: hi) { s = s + i; }");
+  Parser parser(tokens);
+  auto program = parser.parseProgram();
+  ASSERT_EQ(program->items().size(), 1u);
+  auto *stmt =
+      dynamic_cast<const ParallelForStmt *>(program->items()[0].get());
+  ASSERT_NE(stmt, nullptr);
+  EXPECT_EQ(stmt->variable(), "i");
+  EXPECT_NE(dynamic_cast<const NumberExpr *>(&stmt->start()), nullptr);
+  EXPECT_NE(dynamic_cast<const IdentifierExpr *>(&stmt->end()), nullptr);
+  ASSERT_EQ(stmt->reductions().size(), 3u);
+  EXPECT_EQ(stmt->reductions()[0].op, Reduction::Operator::SUM);
+  EXPECT_EQ(stmt->reductions()[1].op, Reduction::Operator::MIN);
+  EXPECT_EQ(stmt->reductions()[2].variable, "hi");
+  EXPECT_EQ(stmt->body().size(), 1u);
+}
+
+TEST_F(ParserTest, ParallelForRejectsOtherShapes) {
+  for (const char *source :
+       {"parallel for (i = 0; i <= n; i++) { }",
+        "parallel for (i = 0; j < n; i++) { }",
+        "parallel for (i = 0; i < n; i += 2) { }",
+        "parallel for (i = 0; i < n; i++) reduce(+: i) { }",
+        "parallel for (i = 0; i < n; i++) reduce(+: s, max: s) { }"}) {
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    EXPECT_THROW(parser.parseProgram(), ParserError) << source;
+  }
+}
+
+TEST_F(ParserTest, SwitchRejectsRepeatedLabels) {
+  for (const char *source :
+       {"switch (x) { case 1: case 1: }", "switch (x) { case \"a\", \"a\": }",
+        "switch (x) { default: default: }", "switch (x) { case x: }",
+        "switch (x) { case 2147483648: }",
+        "switch (x) { case 99999999999999999999: }"}) {
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    EXPECT_THROW(parser.parseProgram(), ParserError) << source;
+  }
+}
+
 // ============================================================================
 // Error Handling Tests
 // ============================================================================
@@ -291,6 +366,36 @@ TEST_F(ParserTest, ParserErrorHasMessage) {
   }
 }
 
+TEST_F(ParserTest, RejectsNestingDeeperThanLimit) {
+  auto repeat = [](const std::string &text, size_t times) {
+    std::string result;
+    for (size_t i = 0; i < times; ++i) {
+      result += text;
+    }
+    return result;
+  };
+  size_t fits = MAX_NESTING_DEPTH - 10;
+  size_t over = MAX_NESTING_DEPTH + 1;
+  auto sources = [&](size_t n) {
+    return std::vector<std::string>{
+        "print(" + repeat("(", n) + "1" + repeat(")", n) + ");",
+        "print(" + repeat("1 + ", n) + "1);",
+        "print(" + repeat("-", n) + "1);",
+        "print(a" + repeat("[0]", n) + ");",
+        repeat("{", n) + "print(1);" + repeat("}", n)};
+  };
+  for (const auto &source : sources(fits)) {
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    EXPECT_NO_THROW(parser.parseProgram()) << source.substr(0, 20);
+  }
+  for (const auto &source : sources(over)) {
+    auto tokens = tokenize(source);
+    Parser parser(tokens);
+    EXPECT_THROW(parser.parseProgram(), ParserError) << source.substr(0, 20);
+  }
+}
+
 // ============================================================================
 // Memory Management Tests
 // ============================================================================
@@ -318,3 +423,77 @@ TEST_F(ParserTest, DeepASTStructuresDontLeak) {
   }
   SUCCEED();
 }
+
+// ============================================================================
+// Lazy Function Body Tests
+// ============================================================================
+
+TEST_F(ParserTest, LazyBodiesAreParsedOnFirstAccess) {
+  auto tokens = tokenize("fn f(a, b) { if (a < b) { return a; } return b; } "
+                         "print(1);");
+  Parser parser(tokens);
+  parser.setLazyFunctionBodies(true);
+  auto program = parser.parseProgram();
+
+  ASSERT_EQ(program->items().size(), static_cast<size_t>(2));
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  EXPECT_EQ(fn->name(), "f");
+  EXPECT_EQ(fn->params().size(), static_cast<size_t>(2));
+  EXPECT_FALSE(fn->isBodyParsed());
+
+  EXPECT_EQ(fn->body().size(), static_cast<size_t>(2));
+  EXPECT_TRUE(fn->isBodyParsed());
+  EXPECT_NE(dynamic_cast<const IfStmt *>(fn->body()[0].get()), nullptr);
+}
+
+TEST_F(ParserTest, LazyBodiesOutliveTokens) {
+  std::unique_ptr<Program> program;
+  {
+    auto tokens = tokenize("fn f() { return 7; }");
+    Parser parser(tokens);
+    parser.setLazyFunctionBodies(true);
+    program = parser.parseProgram();
+  }
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  EXPECT_EQ(fn->body().size(), static_cast<size_t>(1));
+}
+
+TEST_F(ParserTest, LazyBodiesShareTokenStream) {
+  auto tokens = std::make_shared<const std::vector<Token>>(
+      tokenize("fn f() { return 7; } fn g(x) { return x; }"));
+  std::unique_ptr<Program> program;
+  {
+    Parser parser(tokens);
+    parser.setLazyFunctionBodies(true);
+    program = parser.parseProgram();
+  }
+
+  // Each pending body holds the caller's stream, not a copy of its tokens
+  EXPECT_EQ(tokens.use_count(), 3);
+  tokens.reset();
+  auto *g = dynamic_cast<const FunctionDecl *>(program->items()[1].get());
+  ASSERT_NE(g, nullptr);
+  ASSERT_EQ(g->body().size(), static_cast<size_t>(1));
+  EXPECT_NE(dynamic_cast<const ReturnStmt *>(g->body()[0].get()), nullptr);
+}
+
+TEST_F(ParserTest, LazyBodyErrorsAreDeferred) {
+  auto tokens = tokenize("fn broken() { let = ; } print(1);");
+  Parser parser(tokens);
+  parser.setLazyFunctionBodies(true);
+  auto program = parser.parseProgram();
+
+  auto *fn = dynamic_cast<const FunctionDecl *>(program->items()[0].get());
+  ASSERT_NE(fn, nullptr);
+  EXPECT_THROW(fn->body(), ParserError);
+  EXPECT_FALSE(fn->isBodyParsed());
+}
+
+TEST_F(ParserTest, LazyUnterminatedBodyStillFails) {
+  auto tokens = tokenize("fn f() { if (1) { print(1); }");
+  Parser parser(tokens);
+  parser.setLazyFunctionBodies(true);
+  EXPECT_THROW(parser.parseProgram(), ParserError);
+}
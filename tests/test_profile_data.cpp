@@ -0,0 +1,85 @@
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "profile_data.h"
+#include "vm.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+class ProfileDataTest : public ::testing::Test {
+protected:
+  ProfileData profile(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parseProgram();
+    CodeGenerator codegen;
+    BytecodeProgram bytecode = codegen.generate(*program);
+
+    std::ostringstream output;
+    VirtualMachine vm;
+    vm.setOutputStream(output);
+    Profiler profiler;
+    vm.execute(bytecode, &profiler);
+    return ProfileData::collect(bytecode, profiler);
+  }
+};
+
+TEST_F(ProfileDataTest, CountsCallsBranchesAndLoops) {
+  ProfileData data = profile(R"(fn odd(n) {
+  if (n % 2 == 1) {
+    return 1;
+  }
+  return 0;
+}
+fn unused() { return 0; }
+let s = 0;
+for (let i = 0; i < 10; i = i + 1) {
+  let j = 0;
+  while (j < i) {
+    s = s + odd(j);
+    j = j + 1;
+  }
+}
+print(s);
+)");
+
+  EXPECT_EQ(data.callCount("odd"), 45);
+  EXPECT_EQ(data.callCount("unused"), 0);
+  EXPECT_EQ(data.callCount("missing"), -1);
+
+  const BranchProfile *branch = data.branch("odd", 2);
+  ASSERT_NE(branch, nullptr);
+  EXPECT_EQ(branch->total, 45u);
+  EXPECT_EQ(branch->taken, 20u);
+
+  const LoopProfile *outer = data.loop("", 9);
+  ASSERT_NE(outer, nullptr);
+  EXPECT_EQ(outer->entries, 1u);
+  EXPECT_EQ(outer->iterations, 10u);
+  const LoopProfile *inner = data.loop("", 11);
+  ASSERT_NE(inner, nullptr);
+  EXPECT_EQ(inner->entries, 10u);
+  EXPECT_EQ(inner->iterations, 45u);
+  EXPECT_DOUBLE_EQ(inner->averageTrips(), 4.5);
+}
+
+TEST_F(ProfileDataTest, JsonRoundTrip) {
+  ProfileData data = profile(R"(fn f(x) { if (x > 2) { return x; } return 0; }
+let t = 0;
+for (let i = 0; i < 5; i = i + 1) { t = t + f(i); }
+)");
+
+  ProfileData copy = ProfileData::fromJson(data.toJson());
+  EXPECT_EQ(copy.toJson(), data.toJson());
+  EXPECT_EQ(copy.callCount("f"), 5);
+  ASSERT_NE(copy.branch("f", 1), nullptr);
+  EXPECT_EQ(copy.branch("f", 1)->taken, 2u);
+  ASSERT_NE(copy.loop("", 3), nullptr);
+  EXPECT_EQ(copy.loop("", 3)->iterations, 5u);
+
+  EXPECT_THROW(ProfileData::fromJson("{\"version\": 2}"), CompilerError);
+  EXPECT_THROW(ProfileData::fromJson("{\"loops\": [{\"line\": 1}]}"),
+               CompilerError);
+  EXPECT_THROW(ProfileData::fromJson("{} trailing"), CompilerError);
+}
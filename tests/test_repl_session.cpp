@@ -0,0 +1,68 @@
+#include "repl_session.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+class ReplSessionTest : public ::testing::Test {
+protected:
+  std::ostringstream output_;
+  ReplSession session_;
+
+  void SetUp() override { session_.setOutputStream(output_); }
+
+  std::string eval(const std::string &source) {
+    output_.str("");
+    session_.eval(source);
+    return output_.str();
+  }
+};
+
+TEST_F(ReplSessionTest, FunctionsAndGlobalsPersist) {
+  EXPECT_EQ(eval("fn twice(n) { return n * 2; }"), "");
+  EXPECT_EQ(eval("let x = twice(10);"), "");
+  EXPECT_EQ(eval("print(x + 1);"), "21\n");
+  EXPECT_EQ(eval("fn quad(n) { return twice(twice(n)); }"), "");
+  EXPECT_EQ(eval("print(quad(x));"), "80\n");
+
+  // Same arity: existing callers pick up the new body
+  EXPECT_EQ(eval("fn twice(n) { return n + n + 1; }"), "");
+  EXPECT_EQ(eval("print(quad(1));"), "7\n");
+  EXPECT_EQ(session_.program().functions.size(), 2u);
+  EXPECT_EQ(session_.eval("return x;").asInt(), 20);
+}
+
+TEST_F(ReplSessionTest, RunsOnlyTheNewCode) {
+  EXPECT_EQ(eval("let n = 0;\nprint(\"first\");"), "first\n");
+  EXPECT_EQ(eval("n = n + 1;"), "");
+  EXPECT_EQ(eval("n = n + 1;\nprint(n);"), "2\n");
+
+  // Earlier code is kept, not regenerated
+  size_t size = session_.program().code.size();
+  eval("print(n);");
+  EXPECT_GT(session_.program().code.size(), size);
+  EXPECT_EQ(session_.program().mainEntry, size);
+}
+
+TEST_F(ReplSessionTest, FailedInputLeavesSessionUnchanged) {
+  eval("let a = [1, 2, 3];\nfn sum(v) {\n  let s = 0;\n"
+       "  for (x in v) { s += x; }\n  return s;\n}");
+  BytecodeProgram before = session_.program();
+
+  EXPECT_THROW(session_.eval("let b = sum(a) + missing;"), CompilerError);
+  EXPECT_THROW(session_.eval("let c = ;"), CompilerError);
+  EXPECT_EQ(session_.program().code.size(), before.code.size());
+  EXPECT_EQ(session_.program().functions.size(), before.functions.size());
+  EXPECT_THROW(session_.eval("print(b);"), CompilerError);
+
+  // A runtime error keeps the effects before it
+  EXPECT_THROW(session_.eval("a[0] = 10;\nprint(a[5]);"), VMError);
+  EXPECT_EQ(eval("print(sum(a));"), "15\n");
+}
+
+TEST_F(ReplSessionTest, OptimizesEachInput) {
+  eval("fn square(n) { return n * n; }");
+  // Partial evaluation may fold this call; the result must not change
+  EXPECT_EQ(eval("let t = 0;\nfor (let i = 0; i < 4; i = i + 1) {\n"
+                 "  t = t + square(i);\n}\nprint(t);"),
+            "14\n");
+  EXPECT_EQ(eval("print(square(t));"), "196\n");
+}
@@ -0,0 +1,118 @@
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "scheduler.h"
+#include "vm.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+class SchedulerTest : public ::testing::Test {
+protected:
+  std::shared_ptr<const BytecodeProgram> compile(const std::string &source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parseProgram();
+    CodeGenerator codegen;
+    return std::make_shared<BytecodeProgram>(codegen.generate(*program));
+  }
+
+  std::string counter(int limit) {
+    return "let s = 0;\n"
+           "for (let i = 0; i < " +
+           std::to_string(limit) +
+           "; i = i + 1) {\n"
+           "  s = s + i;\n"
+           "}\n"
+           "print(s);\n";
+  }
+};
+
+TEST_F(SchedulerTest, ResumeMatchesExecute) {
+  auto program = compile(R"(fn fib(n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+let a = [0, 0, 0, 0, 0];
+for (let i = 0; i < 5; i = i + 1) {
+  a[i] = fib(i + 5);
+}
+for (x in a) {
+  print(x);
+}
+)");
+  std::ostringstream expected;
+  VirtualMachine reference;
+  reference.setOutputStream(expected);
+  reference.execute(*program);
+
+  std::ostringstream output;
+  VirtualMachine vm;
+  vm.setOutputStream(output);
+  vm.start(*program);
+  int slices = 1;
+  while (!vm.resume(3)) {
+    EXPECT_TRUE(vm.isSuspended());
+    ++slices;
+  }
+  EXPECT_FALSE(vm.isSuspended());
+  EXPECT_GT(slices, 10);
+  EXPECT_EQ(output.str(), expected.str());
+  EXPECT_THROW(vm.resume(3), VMError);
+}
+
+TEST_F(SchedulerTest, RunsManyJobsOnFewThreads) {
+  std::vector<std::shared_ptr<const BytecodeProgram>> programs;
+  for (int limit = 0; limit < 10; ++limit) {
+    programs.push_back(compile(counter(limit * 50)));
+  }
+
+  Scheduler scheduler(2, 10);
+  std::vector<Scheduler::JobId> ids;
+  for (int i = 0; i < 200; ++i) {
+    ids.push_back(scheduler.submit(programs[i % 10]));
+  }
+  for (int i = 0; i < 200; ++i) {
+    int limit = (i % 10) * 50;
+    Scheduler::Result result = scheduler.wait(ids[i]);
+    EXPECT_EQ(result.output, std::to_string(limit * (limit - 1) / 2) + "\n");
+    EXPECT_TRUE(result.error.empty());
+  }
+  EXPECT_EQ(scheduler.pending(), 0u);
+  EXPECT_THROW(scheduler.wait(ids[0]), std::out_of_range);
+}
+
+TEST_F(SchedulerTest, LongJobDoesNotStarveOthers) {
+  auto endless = compile("let i = 0;\nwhile (i == 0) {\n}\n");
+  Scheduler scheduler(1, 100);
+  scheduler.submit(endless);
+  Scheduler::JobId quick = scheduler.submit(compile(counter(1000)));
+  EXPECT_EQ(scheduler.wait(quick).output, "499500\n");
+  EXPECT_EQ(scheduler.pending(), 1u);
+}
+
+TEST_F(SchedulerTest, PrioritiesWeighSlices) {
+  auto program = compile(counter(50000));
+  Scheduler scheduler(1, 100);
+  Scheduler::JobId low = scheduler.submit(program, 1);
+  Scheduler::JobId high = scheduler.submit(program, 4);
+  EXPECT_EQ(scheduler.wait(high).output, "1249975000\n");
+  // The low job has had about a quarter of the thread so far
+  EXPECT_EQ(scheduler.pending(), 1u);
+  EXPECT_EQ(scheduler.wait(low).output, "1249975000\n");
+}
+
+TEST_F(SchedulerTest, ErrorsEndOnlyTheirJob) {
+  Scheduler scheduler(2);
+  Scheduler::JobId bad = scheduler.submit(compile("let z = 0;\nprint(1);\n"
+                                                  "print(1 / z);\n"));
+  Scheduler::JobId good = scheduler.submit(compile(counter(10)));
+  Scheduler::Result result = scheduler.wait(bad);
+  EXPECT_EQ(result.output, "1\n");
+  EXPECT_NE(result.error.find("Division by zero"), std::string::npos);
+  EXPECT_EQ(scheduler.wait(good).output, "45\n");
+}
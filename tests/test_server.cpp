@@ -0,0 +1,280 @@
+#include "server.h"
+#include <chrono>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Sockets get SO_NOSIGPIPE in connectClient() instead
+#endif
+
+class ServerTest : public ::testing::Test {
+protected:
+  std::string path_ =
+      "/tmp/bytecode_server_test_" + std::to_string(::getpid()) + ".sock";
+  std::unique_ptr<Server> server_;
+  std::thread thread_;
+
+  void start(size_t workers, size_t maxQueue, uint32_t frameTimeoutMs = 5000,
+             uint64_t instructionLimit = ServerOptions().instructionLimit,
+             uint32_t writeTimeoutMs = 5000) {
+    ServerOptions options;
+    options.instructionLimit = instructionLimit;
+    options.writeTimeoutMs = writeTimeoutMs;
+    options.socketPath = path_;
+    options.workers = workers;
+    options.maxQueue = maxQueue;
+    options.frameTimeoutMs = frameTimeoutMs;
+    server_ = std::make_unique<Server>(options);
+    thread_ = std::thread([this] { server_->run(); });
+  }
+
+  void TearDown() override {
+    if (server_) {
+      server_->stop();
+      thread_.join();
+    }
+  }
+
+  int connectClient() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path_.c_str());
+    // The server thread may not be listening yet
+    for (int attempt = 0; attempt < 100; ++attempt) {
+      int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+#ifdef SO_NOSIGPIPE
+      int on = 1;
+      ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+      if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address)) == 0) {
+        return fd;
+      }
+      ::close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ADD_FAILURE() << "Cannot connect to " << path_;
+    return -1;
+  }
+
+  static void send(int fd, const std::string &payload) {
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    std::string frame = {static_cast<char>(size >> 24),
+                         static_cast<char>(size >> 16),
+                         static_cast<char>(size >> 8), static_cast<char>(size)};
+    frame += payload;
+    ASSERT_EQ(::write(fd, frame.data(), frame.size()),
+              static_cast<ssize_t>(frame.size()));
+  }
+
+  static std::string receive(int fd) {
+    unsigned char header[4];
+    if (::recv(fd, header, 4, MSG_WAITALL) != 4) {
+      return "<closed>";
+    }
+    size_t size = (static_cast<size_t>(header[0]) << 24) |
+                  (static_cast<size_t>(header[1]) << 16) |
+                  (static_cast<size_t>(header[2]) << 8) | header[3];
+    std::string payload(size, '\0');
+    if (size && ::recv(fd, &payload[0], size, MSG_WAITALL) !=
+                    static_cast<ssize_t>(size)) {
+      return "<closed>";
+    }
+    return payload;
+  }
+
+  // Output after the headers
+  static std::string body(const std::string &response) {
+    size_t end = response.find("\n\n");
+    return end == std::string::npos ? "" : response.substr(end + 2);
+  }
+};
+
+TEST_F(ServerTest, ServesRequestsOnOneConnection) {
+  start(2, 8);
+  int fd = connectClient();
+  ASSERT_GE(fd, 0);
+
+  send(fd, "jit=1\nprofile=1\n\nfn twice(n) { return n * 2; }\n"
+           "print(twice(21));\n");
+  std::string first = receive(fd);
+  EXPECT_EQ(first.rfind("status=ok\n", 0), 0u) << first;
+  EXPECT_NE(first.find("\ncompile_us="), std::string::npos);
+  EXPECT_NE(first.find("\nexecute_us="), std::string::npos);
+  EXPECT_NE(first.find("\ninstructions="), std::string::npos);
+  EXPECT_EQ(body(first), "42\n");
+
+  send(fd, "\nlet x = ;\n");
+  std::string second = receive(fd);
+  EXPECT_EQ(second.rfind("status=error\nerror=Parser error", 0), 0u)
+      << second;
+  // Compiling took time even though it failed
+  EXPECT_EQ(second.find("\ncompile_us=0\n"), std::string::npos) << second;
+
+  // The output cap stops the run itself, not just the response
+  send(fd, "max_output=3\n\nprint(12345);\nwhile (1 == 1) {\n  print(1);\n}\n");
+  std::string third = receive(fd);
+  EXPECT_NE(third.find("Output limit exceeded"), std::string::npos);
+  EXPECT_NE(third.find("\ntruncated=1\n"), std::string::npos);
+  EXPECT_EQ(body(third), "123");
+
+  send(fd, "instruction_limit=500\n\nwhile (1 == 1) {\n}\n");
+  std::string fourth = receive(fd);
+  EXPECT_NE(fourth.find("Instruction limit exceeded"), std::string::npos);
+  EXPECT_EQ(fourth.find("truncated="), std::string::npos);
+
+  for (const char *header :
+       {"colour=blue\n", "instruction_limit=-1\n", "max_output=+5\n",
+        "jit=\n", "instruction_limit=99999999999999999999\n"}) {
+    send(fd, std::string(header) + "\nprint(1);\n");
+    EXPECT_EQ(receive(fd).rfind("status=bad_request\n", 0), 0u) << header;
+  }
+  ::close(fd);
+}
+
+TEST_F(ServerTest, ShedsLoadWhenTheQueueIsFull) {
+  start(1, 1);
+  int busy = connectClient();
+  int queued = connectClient();
+  int shed = connectClient();
+
+  // A response far larger than the socket buffers (but under the output
+  // cap) holds the only worker in its write until the client reads it,
+  // however fast the run itself is
+  send(busy, "\nlet line = \"0123456789012345678901234567890123456789\";\n"
+             "let i = 0;\nwhile (i < 20000) {\n  print(line);\n"
+             "  i = i + 1;\n}\n");
+  unsigned char header[4];
+  ASSERT_EQ(::recv(busy, header, 4, MSG_WAITALL), 4);
+  send(queued, "\nprint(1);\n");
+  for (int attempt = 0; attempt < 500 && server_->queued() == 0; ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(server_->queued(), 1u);
+  send(shed, "\nprint(2);\n");
+
+  EXPECT_EQ(receive(shed).rfind("status=overloaded\n", 0), 0u);
+  EXPECT_EQ(server_->shed(), 1u);
+
+  size_t size = (static_cast<size_t>(header[0]) << 24) |
+                (static_cast<size_t>(header[1]) << 16) |
+                (static_cast<size_t>(header[2]) << 8) | header[3];
+  std::string response(size, '\0');
+  ASSERT_EQ(::recv(busy, &response[0], size, MSG_WAITALL),
+            static_cast<ssize_t>(size));
+  EXPECT_EQ(response.rfind("status=ok\n", 0), 0u);
+  EXPECT_EQ(body(response).size(), 20000u * 41);
+  EXPECT_EQ(body(receive(queued)), "1\n");
+
+  // A shed connection stays usable
+  send(shed, "\nprint(2);\n");
+  EXPECT_EQ(body(receive(shed)), "2\n");
+  ::close(busy);
+  ::close(queued);
+  ::close(shed);
+}
+
+TEST_F(ServerTest, SlowClientsDoNotStallOthers) {
+  start(2, 8, 300);
+  int slow = connectClient();
+  int trickle = connectClient();
+  int fast = connectClient();
+
+  // Half a header, then nothing
+  ASSERT_EQ(::write(slow, "\0\0", 2), 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto before = std::chrono::steady_clock::now();
+  send(fast, "\nprint(1);\n");
+  EXPECT_EQ(body(receive(fast)), "1\n");
+  EXPECT_LT(std::chrono::steady_clock::now() - before,
+            std::chrono::milliseconds(250));
+
+  // A frame is timed from its first byte, however often bytes arrive
+  const char header[] = {0, 0, 0, 100, 'p', 'r'};
+  for (char byte : header) {
+    if (::send(trickle, &byte, 1, MSG_NOSIGNAL) != 1) {
+      break; // Already disconnected
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(receive(trickle), "<closed>");
+  EXPECT_EQ(receive(slow), "<closed>");
+
+  // Requests sent back to back are answered in order
+  std::string payload = "\nprint(2);\n";
+  std::string frame = {0, 0, 0, static_cast<char>(payload.size())};
+  frame = frame + payload + frame + payload;
+  ASSERT_EQ(::write(fast, frame.data(), frame.size()),
+            static_cast<ssize_t>(frame.size()));
+  EXPECT_EQ(body(receive(fast)), "2\n");
+  EXPECT_EQ(body(receive(fast)), "2\n");
+
+  // A run that fails in the VM is an error response, not a crash
+  send(fast, "\nlet a = [0];\na[0] = a;\nprint(a);\n");
+  std::string cyclic = receive(fast);
+  EXPECT_EQ(cyclic.rfind("status=error\n", 0), 0u) << cyclic;
+  send(fast, "\nprint(3);\n");
+  EXPECT_EQ(body(receive(fast)), "3\n");
+
+  // Nor can arithmetic that traps in C++ take the process down
+  send(fast, "\nlet a = 0 - 2147483647 - 1;\nlet b = 0 - 1;\n"
+             "print(a / b);\nprint(a % b);\nprint(a / 0);\n");
+  std::string overflow = receive(fast);
+  EXPECT_EQ(
+      overflow.rfind("status=error\nerror=VM error: Division by zero", 0), 0u)
+      << overflow;
+  EXPECT_EQ(body(overflow), "-2147483648\n0\n");
+  send(fast, "\nprint(4);\n");
+  EXPECT_EQ(body(receive(fast)), "4\n");
+  ::close(slow);
+  ::close(trickle);
+  ::close(fast);
+}
+
+TEST_F(ServerTest, ServerCapsEveryRun) {
+  EXPECT_GT(ServerOptions().instructionLimit, 0u);
+  start(1, 4, 5000, 100000);
+  int fd = connectClient();
+
+  // No limit in the request, or a larger one, still ends at the server's
+  for (const char *request :
+       {"\nwhile (1 == 1) {\n}\n",
+        "instruction_limit=0\n\nwhile (1 == 1) {\n}\n",
+        "instruction_limit=900000000\n\nwhile (1 == 1) {\n}\n"}) {
+    send(fd, request);
+    std::string response = receive(fd);
+    EXPECT_NE(response.find("Instruction limit exceeded"), std::string::npos)
+        << request;
+    EXPECT_NE(response.find("\ninstructions=100000\n"), std::string::npos)
+        << response;
+  }
+  ::close(fd);
+}
+
+TEST_F(ServerTest, ClientsThatDoNotReadAreDropped) {
+  start(1, 4, 5000, ServerOptions().instructionLimit, 200);
+  int stuck = connectClient();
+  int other = connectClient();
+
+  // The response fills the socket buffers and is never read
+  send(stuck, "\nlet line = \"0123456789012345678901234567890123456789\";\n"
+              "let i = 0;\nwhile (i < 20000) {\n  print(line);\n"
+              "  i = i + 1;\n}\n");
+  send(other, "\nprint(1);\n");
+  EXPECT_EQ(body(receive(other)), "1\n");
+  EXPECT_EQ(receive(stuck), "<closed>");
+
+  // Without a max_output of its own, a run stops at the server's cap
+  send(other, "\nwhile (1 == 1) {\n  print(1);\n}\n");
+  std::string capped = receive(other);
+  EXPECT_NE(capped.find("Output limit exceeded"), std::string::npos);
+  EXPECT_NE(capped.find("\ntruncated=1\n"), std::string::npos);
+  EXPECT_EQ(body(capped).size(), ServerOptions().maxOutput);
+  ::close(stuck);
+  ::close(other);
+}
@@ -0,0 +1,138 @@
+#include "repl_session.h"
+#include "snapshot.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+class SnapshotTest : public ::testing::Test {
+protected:
+  static constexpr const char *kPrelude = R"(fn lookup(t, i) {
+  return t[i % 4];
+}
+let squares = [0, 1, 4, 9];
+let rows = [squares, squares, [7, 8]];
+let name = "table";
+let count = 0;
+for (x in squares) {
+  count += x;
+}
+)";
+
+  std::string run(ReplSession &session, const std::string &source) {
+    std::ostringstream output;
+    session.setOutputStream(output);
+    session.eval(source);
+    return output.str();
+  }
+};
+
+TEST_F(SnapshotTest, RestoresGlobalsAndFunctions) {
+  ReplSession prelude;
+  run(prelude, kPrelude);
+  Snapshot image = prelude.snapshot();
+
+  // Each restore starts from the image, not from the other restores
+  for (int i = 0; i < 2; ++i) {
+    ReplSession session(image);
+    EXPECT_EQ(run(session, "print(lookup(squares, 7));\nprint(name);\n"
+                           "print(count);\nsquares[0] = 100;\n"
+                           "print(rows[1][0]);\nprint(rows[2][1]);\n"),
+              "9\ntable\n14\n100\n8\n");
+  }
+
+  // The session the image came from is independent of it too
+  EXPECT_EQ(run(prelude, "print(squares[0]);"), "0\n");
+}
+
+TEST_F(SnapshotTest, RoundTripsThroughBinary) {
+  ReplSession prelude;
+  run(prelude, kPrelude);
+  run(prelude, "let cycle = [1, 2];\ncycle[1] = cycle;\n"
+               "switch (count) {\ncase 14: print(\"hit\");\n"
+               "default: print(\"miss\");\n}\n");
+
+  std::string path =
+      "/tmp/bytecode_snapshot_test_" + std::to_string(::getpid()) + ".bin";
+  prelude.snapshot().save(path);
+  Snapshot image = Snapshot::load(path);
+  std::remove(path.c_str());
+
+  EXPECT_EQ(image.program.code.size(), prelude.program().code.size());
+  EXPECT_EQ(image.program.switchTables.size(), 1u);
+  ReplSession session(image);
+  EXPECT_EQ(run(session, "print(cycle[1][1][0]);\nsquares[1] = 50;\n"
+                         "print(rows[0][1] + rows[1][1]);\n"
+                         "fn more(t, n) { return lookup(t, n); }\n"
+                         "print(more(rows[2], 1));\n"),
+            "1\n100\n8\n");
+  EXPECT_EQ(image.toBinary(), Snapshot::fromBinary(image.toBinary()).toBinary());
+}
+
+TEST_F(SnapshotTest, RejectsMalformedImages) {
+  ReplSession prelude;
+  run(prelude, kPrelude);
+  std::string data = prelude.snapshot().toBinary();
+
+  EXPECT_THROW(Snapshot::fromBinary("not a snapshot"), CompilerError);
+  EXPECT_THROW(Snapshot::fromBinary(data.substr(0, data.size() - 1)),
+               CompilerError);
+  EXPECT_THROW(Snapshot::fromBinary(data + "x"), CompilerError);
+  EXPECT_THROW(Snapshot::load("/nonexistent/snapshot.bin"), CompilerError);
+}
+
+TEST_F(SnapshotTest, RejectsOrSafelyRunsCorruptedImages) {
+  ReplSession prelude;
+  run(prelude, R"(fn pick(n) {
+  switch (n) {
+  case 1: return 10;
+  case 3: return 30;
+  case "x": return 0;
+  default: return n;
+  }
+}
+fn total(n) {
+  let s = 0;
+  parallel for (i = 0; i < n; i++) reduce(+: s) {
+    s = s + i;
+  }
+  for (v in [1, 2, 3]) {
+    s += v;
+  }
+  return s;
+}
+let seen = [pick(1), pick(2)];
+)");
+  std::string data = prelude.snapshot().toBinary();
+
+  // An operand that names nothing is caught while loading
+  ReplSession intact(Snapshot::fromBinary(data));
+  EXPECT_EQ(run(intact, "print(pick(3));\nprint(total(20));\n"),
+            "30\n196\n");
+  Snapshot image = Snapshot::fromBinary(data);
+  image.program.switchTables.clear();
+  EXPECT_THROW(Snapshot::fromBinary(image.toBinary()), CompilerError);
+  image = Snapshot::fromBinary(data);
+  image.program.functions[0].entry =
+      static_cast<uint16_t>(image.program.code.size() + 1);
+  EXPECT_THROW(Snapshot::fromBinary(image.toBinary()), CompilerError);
+
+  // Anything else that loads may fail when run, but only with an error
+  std::mt19937 random(12345);
+  std::uniform_int_distribution<size_t> offset(0, data.size() - 1);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (int attempt = 0; attempt < 2000; ++attempt) {
+    std::string corrupted = data;
+    for (int i = 0; i < 2; ++i) {
+      corrupted[offset(random)] = static_cast<char>(byte(random));
+    }
+    try {
+      ReplSession session(Snapshot::fromBinary(corrupted));
+      session.vm().setInstructionLimit(100000);
+      session.vm().setOutputLimit(1000);
+      run(session, "print(pick(3));\nprint(total(20));\nprint(seen);\n");
+    } catch (const std::exception &) {
+    }
+  }
+}
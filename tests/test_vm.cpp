@@ -1,5 +1,6 @@
 #include "codegen.h"
 #include "vm.h"
+#include <cstdint>
 #include <gtest/gtest.h>
 #include <sstream>
 
@@ -79,6 +80,25 @@ TEST_F(VMTest, ModuloNumbers) {
   EXPECT_EQ(vm.execute(prog).asInt(), 2);
 }
 
+TEST_F(VMTest, ShiftsMatchMultiplyDivideAndModulo) {
+  for (int32_t value : {45, -45, -8, 7, -1, INT32_MIN, INT32_MAX}) {
+    auto shl = makeProgram(
+        {instr(Opcode::CONST, 0), instr(Opcode::SHL, 3), instr(Opcode::RETURN)},
+        {value});
+    auto shr = makeProgram(
+        {instr(Opcode::CONST, 0), instr(Opcode::SHR, 3), instr(Opcode::RETURN)},
+        {value});
+    auto mask = makeProgram({instr(Opcode::CONST, 0), instr(Opcode::MASK, 3),
+                             instr(Opcode::RETURN)},
+                            {value});
+
+    EXPECT_EQ(vm.execute(shl).asInt(),
+              static_cast<int32_t>(static_cast<uint32_t>(value) * 8u));
+    EXPECT_EQ(vm.execute(shr).asInt(), value / 8) << value;
+    EXPECT_EQ(vm.execute(mask).asInt(), value % 8) << value;
+  }
+}
+
 // ============================================================================
 // Error Handling Tests
 // ============================================================================
@@ -167,6 +187,42 @@ TEST_F(VMTest, JumpIfZeroFalse) {
   EXPECT_EQ(vm.execute(prog).asInt(), 50);
 }
 
+TEST_F(VMTest, JumpIfNotZero) {
+  auto prog = makeProgram({instr(Opcode::CONST, 0),            // Push 7
+                           instr(Opcode::JUMP_IF_NOT_ZERO, 4), // Jump to 4
+                           instr(Opcode::CONST, 1),            // Skipped
+                           instr(Opcode::RETURN),              // Skipped
+                           instr(Opcode::CONST, 2),            // Push 0
+                           instr(Opcode::JUMP_IF_NOT_ZERO, 0), // Don't jump
+                           instr(Opcode::CONST, 2),            // Push 0
+                           instr(Opcode::RETURN)},
+                          {7, 50, 0});
+
+  EXPECT_EQ(vm.execute(prog).asInt(), 0);
+}
+
+TEST_F(VMTest, SwitchJumpsThroughTable) {
+  auto prog = makeProgram({instr(Opcode::CONST, 0),         // Push 3
+                           instr(Opcode::TABLE_SWITCH, 0),  // 3 -> 4
+                           instr(Opcode::CONST, 1),         // Skipped
+                           instr(Opcode::RETURN),           // Skipped
+                           instr(Opcode::CONST, 2),         // Push 9
+                           instr(Opcode::LOOKUP_SWITCH, 1), // Default -> 6
+                           instr(Opcode::CONST, 0),         // Push 3
+                           instr(Opcode::RETURN)},
+                          {3, 50, 9});
+  SwitchTable dense;
+  dense.low = 2;
+  dense.targets = {2, 4};
+  dense.defaultTarget = 2;
+  SwitchTable sparse;
+  sparse.intCases[100] = 2;
+  sparse.defaultTarget = 6;
+  prog.switchTables = {dense, sparse};
+
+  EXPECT_EQ(vm.execute(prog).asInt(), 3);
+}
+
 // ============================================================================
 // Function Call Tests
 // ============================================================================